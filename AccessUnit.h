@@ -0,0 +1,26 @@
+/*
+* File		: AccessUnit.h
+* Time : 2026 - 10 - 19
+*/
+
+#ifndef ACCESSUNIT_H
+#define ACCESSUNIT_H
+
+#include <stddef.h>
+
+// One compressed picture (Annex-B for H.264/HEVC) produced by the native
+// inputs (RtpReceiver, TsDemuxer), ready for cuvidParseVideoData.
+//  pData points into the producer's buffer and stays valid until the
+// producer is asked for the next unit.
+struct AccessUnit
+{
+    const unsigned char *pData;
+    size_t               nSize;
+    long long            llTimestamp;   // microseconds, -1 if the unit carries none
+    long long            llArrivalUs;   // steadyClockUs() when its first byte arrived
+    bool                 bKeyFrame;     // decoding can start here (IDR/IRAP, random access point)
+    bool                 bLossBefore;   // data was lost since the previous unit
+    bool                 bIncomplete;   // parts of this unit itself were lost
+};
+
+#endif // ACCESSUNIT_H
@@ -0,0 +1,282 @@
+/*
+* File		: AsyncFileWriter.cpp
+* Time : 2026 - 10 - 19
+*/
+
+#include "AsyncFileWriter.h"
+
+#include <algorithm>
+#include <errno.h>
+#include <stdio.h>
+#include <string.h>
+
+#if defined(WIN32) || defined(_WIN32) || defined(WIN64) || defined(_WIN64)
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+AsyncFileWriter::AsyncFileWriter(unsigned int nThreads, unsigned int nBuffers)
+    : nWriting_(0)
+    , bExit_(false)
+{
+    for (unsigned int i = 0; i < (nBuffers > 0 ? nBuffers : 1); i++)
+    {
+        aBuffers_.push_back(new WriteBuffer);
+        aFree_.push_back(aBuffers_.back());
+    }
+    for (unsigned int i = 0; i < (nThreads > 0 ? nThreads : 1); i++)
+        aThreads_.push_back(std::thread(&AsyncFileWriter::writer_thread_entry, this));
+}
+
+AsyncFileWriter::~AsyncFileWriter()
+{
+    {
+        std::lock_guard<std::mutex> oLock(oMutex_);
+        bExit_ = true;
+        oCond_.notify_all();
+    }
+    for (size_t i = 0; i < aThreads_.size(); i++)
+        aThreads_[i].join();
+    for (size_t i = 0; i < aStreams_.size(); i++)
+    {
+        if (aStreams_[i].hFile != -1)
+            closeHandle(aStreams_[i].hFile);
+    }
+    for (size_t i = 0; i < aBuffers_.size(); i++)
+        delete aBuffers_[i];
+}
+
+WriteBuffer *
+AsyncFileWriter::acquire()
+{
+    std::unique_lock<std::mutex> oLock(oMutex_);
+
+    if (aFree_.empty())
+        oStats_.nStalls++;
+    while (aFree_.empty())
+        oCond_.wait(oLock);
+
+    WriteBuffer *pBuffer = aFree_.back();
+    aFree_.pop_back();
+    return pBuffer;
+}
+
+WriteBuffer *
+AsyncFileWriter::tryAcquire()
+{
+    std::lock_guard<std::mutex> oLock(oMutex_);
+
+    if (aFree_.empty())
+        return 0;
+
+    WriteBuffer *pBuffer = aFree_.back();
+    aFree_.pop_back();
+    return pBuffer;
+}
+
+void
+AsyncFileWriter::write(const std::string &sPath, WriteBuffer *pBuffer)
+{
+    Job oJob;
+    oJob.sPath    = sPath;
+    oJob.nStream  = -1;
+    oJob.llOffset = 0;
+    oJob.pBuffer  = pBuffer;
+
+    std::lock_guard<std::mutex> oLock(oMutex_);
+    aJobs_.push_back(oJob);
+    oCond_.notify_all();
+}
+
+void
+AsyncFileWriter::release(WriteBuffer *pBuffer)
+{
+    std::lock_guard<std::mutex> oLock(oMutex_);
+    aFree_.push_back(pBuffer);
+    oCond_.notify_all();
+}
+
+void
+AsyncFileWriter::flush()
+{
+    std::unique_lock<std::mutex> oLock(oMutex_);
+    while (!aJobs_.empty() || nWriting_ != 0)
+        oCond_.wait(oLock);
+}
+
+int
+AsyncFileWriter::openStream(const std::string &sPath)
+{
+#if defined(WIN32) || defined(_WIN32) || defined(WIN64) || defined(_WIN64)
+    HANDLE hFile = CreateFileA(sPath.c_str(), GENERIC_WRITE, FILE_SHARE_READ, NULL, CREATE_ALWAYS,
+                               FILE_ATTRIBUTE_NORMAL, NULL);
+    intptr_t hStream = hFile == INVALID_HANDLE_VALUE ? -1 : (intptr_t)hFile;
+#else
+    intptr_t hStream = open(sPath.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+#endif
+
+    if (hStream == -1)
+    {
+        printf("can't open %s\n", sPath.c_str());
+        oStats_.nErrors++;
+        return -1;
+    }
+
+    Stream oStream;
+    oStream.sPath  = sPath;
+    oStream.hFile  = hStream;
+    oStream.llSize = 0;
+
+    std::lock_guard<std::mutex> oLock(oMutex_);
+    aStreams_.push_back(oStream);
+    return (int)aStreams_.size() - 1;
+}
+
+unsigned long long
+AsyncFileWriter::reserve(int nStream, size_t nBytes)
+{
+    std::lock_guard<std::mutex> oLock(oMutex_);
+    unsigned long long llOffset = aStreams_[nStream].llSize;
+
+    aStreams_[nStream].llSize += nBytes;
+    return llOffset;
+}
+
+void
+AsyncFileWriter::writeAt(int nStream, unsigned long long llOffset, WriteBuffer *pBuffer)
+{
+    Job oJob;
+    oJob.nStream  = nStream;
+    oJob.llOffset = llOffset;
+    oJob.pBuffer  = pBuffer;
+
+    std::lock_guard<std::mutex> oLock(oMutex_);
+    aJobs_.push_back(oJob);
+    oCond_.notify_all();
+}
+
+void
+AsyncFileWriter::closeStream(int nStream)
+{
+    flush();
+
+    std::lock_guard<std::mutex> oLock(oMutex_);
+    if (aStreams_[nStream].hFile != -1)
+    {
+        closeHandle(aStreams_[nStream].hFile);
+        aStreams_[nStream].hFile = -1;
+    }
+}
+
+bool
+AsyncFileWriter::writeFully(intptr_t hFile, unsigned long long llOffset, const std::vector<unsigned char> &rData)
+{
+    size_t nDone = 0;
+
+    while (nDone < rData.size())
+    {
+        unsigned long long llAt = llOffset + nDone;
+#if defined(WIN32) || defined(_WIN32) || defined(WIN64) || defined(_WIN64)
+        OVERLAPPED oAt;
+        memset(&oAt, 0, sizeof(oAt));
+        oAt.Offset     = (DWORD)llAt;
+        oAt.OffsetHigh = (DWORD)(llAt >> 32);
+
+        DWORD nChunk = (DWORD)std::min<size_t>(rData.size() - nDone, 1 << 30);
+        DWORD nWritten = 0;
+        if (!WriteFile((HANDLE)hFile, &rData[nDone], nChunk, &nWritten, &oAt) || nWritten == 0)
+            return false;
+#else
+        ssize_t nWritten = pwrite((int)hFile, &rData[nDone], rData.size() - nDone, (off_t)llAt);
+        if (nWritten < 0 && errno == EINTR)
+            continue;
+        if (nWritten <= 0)
+            return false;
+#endif
+        nDone += nWritten;
+    }
+    return true;
+}
+
+void
+AsyncFileWriter::closeHandle(intptr_t hFile)
+{
+#if defined(WIN32) || defined(_WIN32) || defined(WIN64) || defined(_WIN64)
+    CloseHandle((HANDLE)hFile);
+#else
+    close((int)hFile);
+#endif
+}
+
+void
+AsyncFileWriter::writer_thread_entry()
+{
+    std::unique_lock<std::mutex> oLock(oMutex_);
+
+    for (;;)
+    {
+        while (aJobs_.empty() && !bExit_)
+            oCond_.wait(oLock);
+        if (aJobs_.empty())
+            return;
+
+        Job oJob = aJobs_.front();
+        aJobs_.pop_front();
+        nWriting_++;
+        // closeStream() flushes first, the handle stays valid for the write
+        intptr_t hStream = oJob.nStream >= 0 ? aStreams_[oJob.nStream].hFile : -1;
+        std::string sStreamPath = oJob.nStream >= 0 ? aStreams_[oJob.nStream].sPath : std::string();
+        oLock.unlock();
+
+        const std::vector<unsigned char> &rData = oJob.pBuffer->aData;
+        bool bWritten;
+
+        if (oJob.nStream >= 0)
+        {
+            bWritten = hStream != -1 && writeFully(hStream, oJob.llOffset, rData);
+            if (bWritten)
+            {
+                oStats_.nWrites++;
+                oStats_.nBytes += rData.size();
+            }
+            else
+            {
+                printf("can't write %s at %llu\n", sStreamPath.c_str(), oJob.llOffset);
+                oStats_.nErrors++;
+            }
+        }
+        else
+        {
+            FILE *pFile = fopen(oJob.sPath.c_str(), "wb");
+            bWritten = pFile != NULL &&
+                       (rData.empty() || fwrite(&rData[0], 1, rData.size(), pFile) == rData.size());
+            if (pFile && fclose(pFile) != 0)
+                bWritten = false;
+
+            if (bWritten)
+            {
+                oStats_.nFiles++;
+                oStats_.nBytes += rData.size();
+            }
+            else
+            {
+                printf("can't write %s\n", oJob.sPath.c_str());
+                oStats_.nErrors++;
+            }
+        }
+
+        oLock.lock();
+        aFree_.push_back(oJob.pBuffer);
+        nWriting_--;
+        oCond_.notify_all();
+    }
+}
+
+const AsyncFileWriterStats &
+AsyncFileWriter::stats()
+const
+{
+    return oStats_;
+}
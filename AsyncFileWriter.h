@@ -0,0 +1,155 @@
+/*
+* File		: AsyncFileWriter.h
+* Time : 2026 - 10 - 19
+*/
+
+#ifndef ASYNCFILEWRITER_H
+#define ASYNCFILEWRITER_H
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <stdint.h>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Host buffer passed from a producer to the writer threads and back.
+struct WriteBuffer
+{
+    std::vector<unsigned char> aData;   // keeps its capacity across uses
+};
+
+// Writer counters; safe to read from any thread.
+struct AsyncFileWriterStats
+{
+    std::atomic<unsigned long>      nFiles;
+    std::atomic<unsigned long>      nWrites;    // positional writes into streams
+    std::atomic<unsigned long long> nBytes;
+    std::atomic<unsigned long>      nErrors;    // open or write failed
+    std::atomic<unsigned long>      nStalls;    // acquire() had to wait for a buffer
+
+    AsyncFileWriterStats()
+        : nFiles(0), nWrites(0), nBytes(0), nErrors(0), nStalls(0)
+    {
+    }
+
+  private:
+    // Copy constructor. Don't implement.
+    AsyncFileWriterStats(const AsyncFileWriterStats &);
+
+    // Assignment operator. Don't implement.
+    void
+    operator= (const AsyncFileWriterStats &);
+};
+
+// Writes whole files on a few background threads.
+//  Producers take a buffer with acquire(), fill it and hand it to
+// write(); the buffer comes back to the pool once it is on disk. The
+// fixed number of buffers bounds the memory and is the backpressure:
+// a producer faster than the disk waits in acquire(), counted as a stall.
+//
+// Streams are single files written at offsets reserved in order: the
+// producer reserves a range while it still knows the order (e.g. on the
+// decode thread), the buffer is filled later and may be written by any
+// writer thread, with pwrite()/overlapped WriteFile(), concurrently with
+// the other ranges of the same file.
+class AsyncFileWriter
+{
+    public:
+        AsyncFileWriter(unsigned int nThreads = 2, unsigned int nBuffers = 32);
+
+        // Writes what is queued, then stops the threads.
+        ~AsyncFileWriter();
+
+        WriteBuffer *
+        acquire();
+
+        // Returns 0 instead of waiting when every buffer is in use.
+        WriteBuffer *
+        tryAcquire();
+
+        // Replaces sPath with the buffer's contents and recycles the buffer.
+        void
+        write(const std::string &sPath, WriteBuffer *pBuffer);
+
+        // Returns a buffer that won't be written.
+        void
+        release(WriteBuffer *pBuffer);
+
+        // Blocks until everything queued so far is written.
+        void
+        flush();
+
+        // Creates or truncates sPath for positional writes.
+        // Returns:
+        //      the stream ID, -1 if the file can't be opened.
+        int
+        openStream(const std::string &sPath);
+
+        // Reserves the next nBytes of the stream, returns their offset.
+        unsigned long long
+        reserve(int nStream, size_t nBytes);
+
+        // Writes the buffer at llOffset of the stream and recycles it.
+        void
+        writeAt(int nStream, unsigned long long llOffset, WriteBuffer *pBuffer);
+
+        // Waits for the stream's writes and closes it.
+        void
+        closeStream(int nStream);
+
+        const AsyncFileWriterStats &
+        stats()
+        const;
+
+    private:
+        struct Job
+        {
+            std::string         sPath;
+            int                 nStream;    // -1 for whole files
+            unsigned long long  llOffset;
+            WriteBuffer        *pBuffer;
+        };
+
+        struct Stream
+        {
+            std::string         sPath;
+            intptr_t            hFile;      // fd, or HANDLE on Windows; -1 once closed
+            unsigned long long  llSize;     // reserved so far
+        };
+
+        // Copy constructor. Don't implement.
+        AsyncFileWriter(const AsyncFileWriter &);
+
+        // Assignment operator. Don't implement.
+        void
+        operator= (const AsyncFileWriter &);
+
+        void
+        writer_thread_entry();
+
+        // Writes the whole buffer at llOffset. Thread safe for one handle.
+        static
+        bool
+        writeFully(intptr_t hFile, unsigned long long llOffset, const std::vector<unsigned char> &rData);
+
+        static
+        void
+        closeHandle(intptr_t hFile);
+
+        AsyncFileWriterStats        oStats_;
+        std::vector<WriteBuffer *>  aBuffers_;      // owned
+        std::vector<std::thread>    aThreads_;
+
+        std::mutex                  oMutex_;
+        std::condition_variable     oCond_;
+        std::vector<WriteBuffer *>  aFree_;
+        std::deque<Job>             aJobs_;
+        std::vector<Stream>         aStreams_;
+        unsigned int                nWriting_;
+        bool                        bExit_;
+};
+
+#endif // ASYNCFILEWRITER_H
@@ -0,0 +1,580 @@
+/*
+* File		: BatchAssembler.cpp
+* Time : 2026 - 10 - 19
+*/
+
+#include "BatchAssembler.h"
+#include "ColorConvert.h"
+
+#include <limits.h>
+#include <stdio.h>
+
+// Staging tensors per stream when groups wait for partners; a lone frame
+// goes straight into its batch and needs one.
+static const unsigned int cnSyncStaging = 4;
+
+// One stream: the sink its decoder delivers to.
+struct BatchAssembler::Input : public FrameSink
+{
+    BatchAssembler             *pOwner;
+    int                         nStream;
+    long long                   llClockOffset;
+    CUstream                    hStream;        // in the assembler's context
+    CUdeviceptr                 dpRaw;          // the decoded surface, copied over from the decoder's context
+    size_t                      nRawBytes;
+    std::vector<CUdeviceptr>    aStaging;
+    std::vector<bool>           aBusy;          // under the assembler's mutex
+    long long                   llLastTime;     // newest frame, with the offset; under the mutex
+
+    Input()
+        : pOwner(0)
+        , nStream(0)
+        , llClockOffset(0)
+        , hStream(0)
+        , dpRaw(0)
+        , nRawBytes(0)
+        , llLastTime(LLONG_MIN)
+    {
+    }
+
+    // Decode thread, the decoder's context is current
+    virtual
+    void
+    onFrame(const DecodedFrame &rFrame)
+    {
+        CUcontext oSource = 0;
+        cuCtxGetCurrent(&oSource);
+
+        cuCtxPushCurrent(pOwner->oContext_);
+        pOwner->onFrame(this, rFrame, oSource);
+        cuCtxPopCurrent(NULL);
+    }
+};
+
+BatchAssembler::BatchAssembler(int nGpu, unsigned int nWidth, unsigned int nHeight,
+                               unsigned int nBatchSize, unsigned int nMaxWaitMs,
+                               BatchPolicy ePolicy, unsigned int nToleranceMs,
+                               unsigned int nBuffers)
+    : oDevice_(0)
+    , oContext_(0)
+    , nWidth_(nWidth)
+    , nHeight_(nHeight)
+    , nBatchSize_(nBatchSize > 0 ? nBatchSize : 1)
+    , nMaxWaitMs_(nMaxWaitMs)
+    , ePolicy_(ePolicy)
+    , llTolerance_((long long)nToleranceMs * 1000)
+    , aBuffers_(nBuffers > 1 ? nBuffers : 2)
+    , nFilling_(-1)
+    , nOut_(0)
+    , bClosed_(false)
+{
+    static const float afMean[3] = { 0.485f, 0.456f, 0.406f };
+    static const float afStd[3]  = { 0.229f, 0.224f, 0.225f };
+    setNormalization(afMean, afStd);
+
+    cuInit(0);
+
+    if (cuDeviceGet(&oDevice_, nGpu) != CUDA_SUCCESS ||
+        cuDevicePrimaryCtxRetain(&oContext_, oDevice_) != CUDA_SUCCESS)
+    {
+        printf("BatchAssembler: can't open device %d\n", nGpu);
+        oContext_ = 0;
+    }
+
+    // Buffers are allocated on first use, once the group size is known
+    for (unsigned int i = 0; i < aBuffers_.size(); i++)
+    {
+        aBuffers_[i].dpData   = 0;
+        aBuffers_[i].nGroups  = 0;
+        aBuffers_[i].nCopying = 0;
+        aBuffers_[i].bSealed  = false;
+        aFree_.push_back((unsigned int)aBuffers_.size() - 1 - i);
+    }
+}
+
+BatchAssembler::~BatchAssembler()
+{
+    if (!oContext_)
+        return;
+
+    cuCtxPushCurrent(oContext_);
+    for (size_t i = 0; i < aInputs_.size(); i++)
+    {
+        Input *pInput = aInputs_[i];
+
+        for (size_t j = 0; j < pInput->aStaging.size(); j++)
+            cuMemFree(pInput->aStaging[j]);
+        if (pInput->dpRaw)
+            cuMemFree(pInput->dpRaw);
+        if (pInput->hStream)
+            cuStreamDestroy(pInput->hStream);
+        delete pInput;
+    }
+    for (size_t i = 0; i < aBuffers_.size(); i++)
+    {
+        if (aBuffers_[i].dpData)
+            cuMemFree(aBuffers_[i].dpData);
+    }
+    cuCtxPopCurrent(NULL);
+
+    cuDevicePrimaryCtxRelease(oDevice_);
+}
+
+bool
+BatchAssembler::isValid()
+const
+{
+    return oContext_ != 0;
+}
+
+void
+BatchAssembler::setNormalization(const float afMean[3], const float afStd[3])
+{
+    for (unsigned int i = 0; i < 3; i++)
+    {
+        afMean_[i] = afMean[i];
+        afStd_[i]  = afStd[i];
+    }
+}
+
+FrameSink *
+BatchAssembler::addStream(long long llClockOffset)
+{
+    if (!oContext_)
+        return 0;
+
+    Input *pInput = new Input;
+    pInput->pOwner        = this;
+    pInput->nStream       = (int)aInputs_.size();
+    pInput->llClockOffset = llClockOffset;
+
+    unsigned int nStaging = ePolicy_ == BatchPolicy_Synchronized ? cnSyncStaging : 1;
+    bool bOk = true;
+
+    cuCtxPushCurrent(oContext_);
+    if (cuStreamCreate(&pInput->hStream, CU_STREAM_NON_BLOCKING) != CUDA_SUCCESS)
+    {
+        pInput->hStream = 0;
+        bOk = false;
+    }
+    for (unsigned int i = 0; bOk && i < nStaging; i++)
+    {
+        CUdeviceptr dpStaging = 0;
+        if (cuMemAlloc(&dpStaging, frameBytes()) != CUDA_SUCCESS)
+        {
+            bOk = false;
+            break;
+        }
+        pInput->aStaging.push_back(dpStaging);
+        pInput->aBusy.push_back(false);
+    }
+
+    if (!bOk)
+    {
+        printf("BatchAssembler: can't allocate the buffers of stream %d\n", pInput->nStream);
+        for (size_t i = 0; i < pInput->aStaging.size(); i++)
+            cuMemFree(pInput->aStaging[i]);
+        if (pInput->hStream)
+            cuStreamDestroy(pInput->hStream);
+        cuCtxPopCurrent(NULL);
+        delete pInput;
+        return 0;
+    }
+    cuCtxPopCurrent(NULL);
+
+    std::lock_guard<std::mutex> oLock(oMutex_);
+    aInputs_.push_back(pInput);
+    return pInput;
+}
+
+unsigned int
+BatchAssembler::groupSize()
+const
+{
+    return ePolicy_ == BatchPolicy_Synchronized && !aInputs_.empty() ? (unsigned int)aInputs_.size() : 1;
+}
+
+unsigned int
+BatchAssembler::groupsPerBatch()
+const
+{
+    unsigned int nGroups = nBatchSize_ / groupSize();
+    return nGroups > 0 ? nGroups : 1;
+}
+
+size_t
+BatchAssembler::frameBytes()
+const
+{
+    return (size_t)3 * nWidth_ * nHeight_ * sizeof(float);
+}
+
+void
+BatchAssembler::onFrame(Input *pInput, const DecodedFrame &rFrame, CUcontext oSource)
+{
+    oStats_.nFrames++;
+
+    unsigned int nEntry = 0;
+    {
+        std::lock_guard<std::mutex> oLock(oMutex_);
+
+        while (nEntry < pInput->aBusy.size() && pInput->aBusy[nEntry])
+            nEntry++;
+
+        // Every staging tensor waits in a group: give up the oldest one,
+        // its partners are late or gone
+        if (nEntry == pInput->aBusy.size() && ePolicy_ == BatchPolicy_Synchronized)
+        {
+            for (std::deque<Group>::iterator it = aGroups_.begin(); it != aGroups_.end(); ++it)
+            {
+                if (it->aHave[pInput->nStream])
+                {
+                    nEntry = it->aMembers[pInput->nStream].nEntry;
+                    discardGroup(*it);
+                    aGroups_.erase(it);
+                    break;
+                }
+            }
+        }
+
+        if (nEntry == pInput->aBusy.size())
+        {
+            oStats_.nDropped++;
+            return;
+        }
+        pInput->aBusy[nEntry] = true;
+    }
+
+    // The surface is pitched, the planes follow each other: one linear
+    // copy takes the whole frame across
+    size_t nRawBytes = (size_t)rFrame.nPitch * (rFrame.nHeight + (rFrame.nHeight + 1) / 2);
+    bool bOk = true;
+
+    if (pInput->nRawBytes < nRawBytes)
+    {
+        if (pInput->dpRaw)
+            cuMemFree(pInput->dpRaw);
+        pInput->nRawBytes = 0;
+        bOk = cuMemAlloc(&pInput->dpRaw, nRawBytes) == CUDA_SUCCESS;
+        if (bOk)
+            pInput->nRawBytes = nRawBytes;
+        else
+            pInput->dpRaw = 0;
+    }
+
+    bOk = bOk &&
+          cuMemcpyPeerAsync(pInput->dpRaw, oContext_, rFrame.dpFrame, oSource, nRawBytes, pInput->hStream) == CUDA_SUCCESS &&
+          convertYuvToPlanarRgb(pInput->dpRaw, rFrame.nPitch, rFrame.nWidth, rFrame.nHeight,
+                                rFrame.eFormat == cudaVideoSurfaceFormat_P016,
+                                pInput->aStaging[nEntry], nWidth_, nHeight_,
+                                afMean_, afStd_, pInput->hStream) == CUDA_SUCCESS &&
+          cuStreamSynchronize(pInput->hStream) == CUDA_SUCCESS;
+
+    if (!bOk)
+    {
+        std::lock_guard<std::mutex> oLock(oMutex_);
+        pInput->aBusy[nEntry] = false;
+        oStats_.nErrors++;
+        return;
+    }
+
+    Staged oStaged;
+    oStaged.pInput             = pInput;
+    oStaged.nEntry             = nEntry;
+    oStaged.oSlot.nStream      = pInput->nStream;
+    oStaged.oSlot.llTimestamp  = rFrame.llTimestamp;
+    oStaged.oSlot.nFrameNumber = rFrame.nFrameNumber;
+    oStaged.oSlot.nFlags       = rFrame.nFlags;
+
+    if (ePolicy_ == BatchPolicy_MaxWait)
+    {
+        commitGroup(pInput, std::vector<Staged>(1, oStaged));
+        return;
+    }
+
+    long long llTime = rFrame.llTimestamp + pInput->llClockOffset;
+    std::vector<Staged> aComplete;
+    {
+        std::lock_guard<std::mutex> oLock(oMutex_);
+        pInput->llLastTime = llTime;
+
+        // Streams deliver in display order: a group still missing a
+        // stream that went past its window won't complete
+        for (std::deque<Group>::iterator it = aGroups_.begin(); it != aGroups_.end(); )
+        {
+            bool bStale = false;
+            for (size_t i = 0; i < aInputs_.size() && !bStale; i++)
+                bStale = !it->aHave[i] && aInputs_[i]->llLastTime > it->llAnchor + llTolerance_;
+
+            if (bStale)
+            {
+                discardGroup(*it);
+                it = aGroups_.erase(it);
+            }
+            else
+            {
+                ++it;
+            }
+        }
+
+        // The open group nearest in time that lacks this stream
+        std::deque<Group>::iterator itBest = aGroups_.end();
+        for (std::deque<Group>::iterator it = aGroups_.begin(); it != aGroups_.end(); ++it)
+        {
+            long long llDistance = llTime > it->llAnchor ? llTime - it->llAnchor : it->llAnchor - llTime;
+            if (it->aHave[pInput->nStream] || llDistance > llTolerance_)
+                continue;
+            if (itBest == aGroups_.end() ||
+                llDistance < (llTime > itBest->llAnchor ? llTime - itBest->llAnchor : itBest->llAnchor - llTime))
+                itBest = it;
+        }
+
+        if (itBest == aGroups_.end())
+        {
+            Group oGroup;
+            oGroup.llAnchor = llTime;
+            oGroup.nMembers = 0;
+            oGroup.aMembers.resize(aInputs_.size());
+            oGroup.aHave.resize(aInputs_.size(), false);
+            aGroups_.push_back(oGroup);
+            itBest = aGroups_.end() - 1;
+        }
+
+        itBest->aMembers[pInput->nStream] = oStaged;
+        itBest->aHave[pInput->nStream]    = true;
+        if (++itBest->nMembers == aInputs_.size())
+        {
+            aComplete = itBest->aMembers;
+            aGroups_.erase(itBest);
+        }
+    }
+
+    if (!aComplete.empty())
+        commitGroup(pInput, aComplete);
+}
+
+bool
+BatchAssembler::reserveGroup(unsigned int &rBuffer, unsigned int &rGroup)
+{
+    if (bClosed_)
+        return false;
+
+    if (nFilling_ < 0)
+    {
+        if (aFree_.empty())
+            return false;
+
+        Buffer &rFree = aBuffers_[aFree_.back()];
+        unsigned int nFrames = groupsPerBatch() * groupSize();
+
+        if (!rFree.dpData)
+        {
+            if (cuMemAlloc(&rFree.dpData, nFrames * frameBytes()) != CUDA_SUCCESS)
+            {
+                printf("BatchAssembler: can't allocate a batch of %u frames\n", nFrames);
+                rFree.dpData = 0;
+                return false;
+            }
+            rFree.aSlots.resize(nFrames);
+        }
+
+        nFilling_ = (int)aFree_.back();
+        aFree_.pop_back();
+        rFree.nGroups  = 0;
+        rFree.nCopying = 0;
+        rFree.bSealed  = false;
+        rFree.oFirst   = std::chrono::steady_clock::now();
+
+        // A waiting next() starts the max wait from here
+        oReady_.notify_all();
+    }
+
+    Buffer &rFilling = aBuffers_[nFilling_];
+    rBuffer = (unsigned int)nFilling_;
+    rGroup  = rFilling.nGroups++;
+    rFilling.nCopying++;
+
+    if (rFilling.nGroups == groupsPerBatch())
+    {
+        rFilling.bSealed = true;
+        nFilling_ = -1;
+    }
+    return true;
+}
+
+void
+BatchAssembler::commitGroup(Input *pInput, const std::vector<Staged> &aMembers)
+{
+    unsigned int nBuffer = 0;
+    unsigned int nGroup  = 0;
+    bool bReserved;
+    {
+        std::lock_guard<std::mutex> oLock(oMutex_);
+        bReserved = reserveGroup(nBuffer, nGroup);
+        if (!bReserved)
+        {
+            for (size_t i = 0; i < aMembers.size(); i++)
+                aMembers[i].pInput->aBusy[aMembers[i].nEntry] = false;
+            oStats_.nDropped += (unsigned long)aMembers.size();
+            return;
+        }
+    }
+
+    // The buffer can't go out before nCopying drops, nobody else touches
+    // this group's range
+    Buffer &rBuffer = aBuffers_[nBuffer];
+    unsigned int nFirst = nGroup * (unsigned int)aMembers.size();
+    bool bOk = true;
+
+    for (size_t i = 0; i < aMembers.size(); i++)
+    {
+        const Staged &rMember = aMembers[i];
+
+        rBuffer.aSlots[nFirst + i] = rMember.oSlot;
+        bOk = bOk &&
+              cuMemcpyDtoDAsync(rBuffer.dpData + (nFirst + i) * frameBytes(),
+                                rMember.pInput->aStaging[rMember.nEntry],
+                                frameBytes(), pInput->hStream) == CUDA_SUCCESS;
+    }
+    bOk = bOk && cuStreamSynchronize(pInput->hStream) == CUDA_SUCCESS;
+
+    std::lock_guard<std::mutex> oLock(oMutex_);
+    for (size_t i = 0; i < aMembers.size(); i++)
+    {
+        aMembers[i].pInput->aBusy[aMembers[i].nEntry] = false;
+
+        // The frame holds garbage; the consumer skips slots of stream -1
+        if (!bOk)
+            rBuffer.aSlots[nFirst + i].nStream = -1;
+    }
+    if (!bOk)
+        oStats_.nErrors++;
+
+    rBuffer.nCopying--;
+    finishBuffer(nBuffer);
+}
+
+void
+BatchAssembler::discardGroup(const Group &rGroup)
+{
+    for (size_t i = 0; i < rGroup.aHave.size(); i++)
+    {
+        if (!rGroup.aHave[i])
+            continue;
+
+        rGroup.aMembers[i].pInput->aBusy[rGroup.aMembers[i].nEntry] = false;
+        oStats_.nUnmatched++;
+    }
+}
+
+void
+BatchAssembler::finishBuffer(unsigned int nBuffer)
+{
+    Buffer &rBuffer = aBuffers_[nBuffer];
+
+    if (rBuffer.bSealed && rBuffer.nCopying == 0)
+    {
+        aReady_.push_back(nBuffer);
+        oReady_.notify_all();
+    }
+}
+
+void
+BatchAssembler::sealFilling()
+{
+    if (nFilling_ < 0 || aBuffers_[nFilling_].nGroups == 0)
+        return;
+
+    unsigned int nBuffer = (unsigned int)nFilling_;
+    aBuffers_[nBuffer].bSealed = true;
+    nFilling_ = -1;
+    finishBuffer(nBuffer);
+}
+
+bool
+BatchAssembler::next(FrameBatch &rBatch, int nTimeoutMs)
+{
+    std::chrono::steady_clock::time_point oDeadline =
+        std::chrono::steady_clock::now() + std::chrono::milliseconds(nTimeoutMs > 0 ? nTimeoutMs : 0);
+
+    std::unique_lock<std::mutex> oLock(oMutex_);
+    for (;;)
+    {
+        if (!aReady_.empty())
+        {
+            unsigned int nBuffer = aReady_.front();
+            aReady_.pop_front();
+            nOut_++;
+
+            rBatch.dpData  = aBuffers_[nBuffer].dpData;
+            rBatch.nFrames = aBuffers_[nBuffer].nGroups * groupSize();
+            rBatch.pSlots  = &aBuffers_[nBuffer].aSlots[0];
+            rBatch.nBuffer = nBuffer;
+            oStats_.nBatches++;
+            return true;
+        }
+
+        // Closed, nothing being filled or copied
+        if (bClosed_ && nFilling_ < 0 && aFree_.size() + nOut_ == aBuffers_.size())
+            return false;
+
+        std::chrono::steady_clock::time_point oNow = std::chrono::steady_clock::now();
+        std::chrono::steady_clock::time_point oWake = oDeadline;
+        bool bWake = nTimeoutMs >= 0;
+
+        if (nFilling_ >= 0 && aBuffers_[nFilling_].nGroups > 0)
+        {
+            std::chrono::steady_clock::time_point oDue =
+                aBuffers_[nFilling_].oFirst + std::chrono::milliseconds(nMaxWaitMs_);
+
+            if (oNow >= oDue)
+            {
+                sealFilling();
+                continue;
+            }
+            if (!bWake || oDue < oWake)
+                oWake = oDue;
+            bWake = true;
+        }
+
+        if (nTimeoutMs >= 0 && oNow >= oDeadline)
+            return false;
+
+        if (bWake)
+            oReady_.wait_until(oLock, oWake);
+        else
+            oReady_.wait(oLock);
+    }
+}
+
+void
+BatchAssembler::release(const FrameBatch &rBatch)
+{
+    std::lock_guard<std::mutex> oLock(oMutex_);
+    aFree_.push_back(rBatch.nBuffer);
+    nOut_--;
+    oReady_.notify_all();
+}
+
+void
+BatchAssembler::close()
+{
+    std::lock_guard<std::mutex> oLock(oMutex_);
+    bClosed_ = true;
+    sealFilling();
+    oReady_.notify_all();
+}
+
+CUcontext
+BatchAssembler::context()
+const
+{
+    return oContext_;
+}
+
+const BatchAssemblerStats &
+BatchAssembler::stats()
+const
+{
+    return oStats_;
+}
@@ -0,0 +1,252 @@
+/*
+* File		: BatchAssembler.h
+* Time : 2026 - 10 - 19
+*/
+
+#ifndef BATCHASSEMBLER_H
+#define BATCHASSEMBLER_H
+
+#include "FrameSink.h"
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <vector>
+
+enum BatchPolicy
+{
+    // Any frames, in arrival order; a batch goes out when it is full or
+    // nMaxWaitMs after its first frame.
+    BatchPolicy_MaxWait = 0,
+    // Groups of one frame per stream whose timestamps lie within the
+    // tolerance of each other (a multi-camera rig); a batch holds
+    // nBatchSize / streams groups and goes out like above. Frames that
+    // find no partners are dropped.
+    BatchPolicy_Synchronized
+};
+
+// Where a frame of a batch came from.
+struct BatchSlot
+{
+    int                 nStream;        // in addStream() order from 0; -1 if the copy failed
+    long long           llTimestamp;    // DecodedFrame::llTimestamp, without the stream's offset
+    unsigned long       nFrameNumber;
+    unsigned int        nFlags;         // DecodedFrameFlags
+};
+
+// A batch handed to the consumer, valid until release().
+//  dpData holds nFrames frames of 3 x height x width floats back to back
+// (planar RGB, see convertYuvToPlanarRgb()), in the assembler's context.
+// With BatchPolicy_Synchronized the frames of a group are adjacent, in
+// stream order.
+struct FrameBatch
+{
+    CUdeviceptr         dpData;
+    unsigned int        nFrames;
+    const BatchSlot    *pSlots;
+    unsigned int        nBuffer;        // for release()
+};
+
+// Assembler counters; safe to read from any thread.
+struct BatchAssemblerStats
+{
+    std::atomic<unsigned long> nFrames;         // handed to the assembler
+    std::atomic<unsigned long> nBatches;        // handed to the consumer
+    std::atomic<unsigned long> nDropped;        // no free buffer
+    std::atomic<unsigned long> nUnmatched;      // synchronized: no partners within the tolerance
+    std::atomic<unsigned long> nErrors;         // copy or conversion failed
+
+    BatchAssemblerStats()
+        : nFrames(0), nBatches(0), nDropped(0), nUnmatched(0), nErrors(0)
+    {
+    }
+
+  private:
+    // Copy constructor. Don't implement.
+    BatchAssemblerStats(const BatchAssemblerStats &);
+
+    // Assignment operator. Don't implement.
+    void
+    operator= (const BatchAssemblerStats &);
+};
+
+// Gathers the frames of many streams into batches for inference.
+//  Each stream's decoder gets a sink from addStream(). On its decode
+// thread a frame is copied into the assembler's context, resized and
+// converted into a staging tensor; once the frame (or its whole group)
+// has a place in a batch the tensor is copied there, so the batch buffer
+// is one contiguous block. Streams never wait for each other: when the
+// consumer holds every batch buffer, or a stream's staging tensors are
+// all waiting for partners, frames are dropped and counted.
+//
+// Timestamps are compared as llTimestamp + the stream's offset, with the
+// tolerance in ms taken as AV_TIME_BASE (us) units, which is what FFmpeg
+// sources deliver.
+class BatchAssembler
+{
+    public:
+        // Parameters:
+        //      nGpu - device of the batch buffers (its primary context);
+        //          the decoders must run on the same device.
+        //      nWidth, nHeight - size of every frame in the batch.
+        //      nBatchSize - frames per batch at most.
+        //      nMaxWaitMs - age of a batch's first frame at which the
+        //          batch goes out incomplete.
+        //      nBuffers - batches being filled or held by the consumer.
+        BatchAssembler(int nGpu, unsigned int nWidth, unsigned int nHeight,
+                       unsigned int nBatchSize, unsigned int nMaxWaitMs,
+                       BatchPolicy ePolicy = BatchPolicy_MaxWait, unsigned int nToleranceMs = 20,
+                       unsigned int nBuffers = 3);
+
+        // The decoders must not deliver any more frames.
+        ~BatchAssembler();
+
+        bool
+        isValid()
+        const;
+
+        // Per-channel normalization, ImageNet's by default. Set before
+        // the first frame.
+        void
+        setNormalization(const float afMean[3], const float afStd[3]);
+
+        // Adds a stream and returns the sink for its decoder, owned by
+        // the assembler, or 0 if its buffers can't be allocated.
+        // llClockOffset is added to the stream's timestamps to line them
+        // up with the other streams. Add all streams before the first
+        // frame; synchronized groups take one frame of each.
+        FrameSink *
+        addStream(long long llClockOffset = 0);
+
+        // Next batch, waiting up to nTimeoutMs (-1 forever). Returns false
+        // on timeout, or once close() was called and all batches are out.
+        // The max wait of incomplete batches is enforced from here, so
+        // it only applies while the consumer is waiting.
+        bool
+        next(FrameBatch &rBatch, int nTimeoutMs = -1);
+
+        // Gives the buffer of a batch back for filling.
+        void
+        release(const FrameBatch &rBatch);
+
+        // Sends the batch being filled as it is and makes next() return
+        // false once the consumer has everything.
+        void
+        close();
+
+        // Context of the batch buffers, to push while consuming them.
+        CUcontext
+        context()
+        const;
+
+        const BatchAssemblerStats &
+        stats()
+        const;
+
+    private:
+        struct Input;
+
+        // A frame converted and waiting for its group to complete.
+        struct Staged
+        {
+            Input              *pInput;
+            unsigned int        nEntry;         // in pInput's staging tensors
+            BatchSlot           oSlot;
+        };
+
+        // Synchronized: frames of the streams so far, by stream order.
+        struct Group
+        {
+            long long                                   llAnchor;       // time of the first member
+            unsigned int                                nMembers;       // present
+            std::vector<Staged>                         aMembers;
+            std::vector<bool>                           aHave;
+        };
+
+        struct Buffer
+        {
+            CUdeviceptr                                 dpData;
+            std::vector<BatchSlot>                      aSlots;
+            unsigned int                                nGroups;        // reserved
+            unsigned int                                nCopying;       // groups still being copied in
+            bool                                        bSealed;        // takes no more groups
+            std::chrono::steady_clock::time_point       oFirst;         // arrival of the first group
+        };
+
+        // Copy constructor. Don't implement.
+        BatchAssembler(const BatchAssembler &);
+
+        // Assignment operator. Don't implement.
+        void
+        operator= (const BatchAssembler &);
+
+        // Decode thread of pInput, with the assembler's context current.
+        void
+        onFrame(Input *pInput, const DecodedFrame &rFrame, CUcontext oSource);
+
+        // Reserves the next group position of the batch being filled.
+        // Returns false if no buffer is free. Called with the mutex held.
+        bool
+        reserveGroup(unsigned int &rBuffer, unsigned int &rGroup);
+
+        // Copies a complete group into its batch position and frees the
+        // staging tensors.
+        void
+        commitGroup(Input *pInput, const std::vector<Staged> &aMembers);
+
+        // Drops the frames of a group that won't complete. Called with
+        // the mutex held.
+        void
+        discardGroup(const Group &rGroup);
+
+        // Hands the buffer to the consumer if it is sealed and complete.
+        // Called with the mutex held.
+        void
+        finishBuffer(unsigned int nBuffer);
+
+        // Seals the buffer being filled if it has any frames. Called with
+        // the mutex held.
+        void
+        sealFilling();
+
+        // Frames per group, and groups per batch.
+        unsigned int
+        groupSize()
+        const;
+
+        unsigned int
+        groupsPerBatch()
+        const;
+
+        size_t
+        frameBytes()
+        const;
+
+        CUdevice                                    oDevice_;
+        CUcontext                                   oContext_;
+        unsigned int                                nWidth_;
+        unsigned int                                nHeight_;
+        unsigned int                                nBatchSize_;
+        unsigned int                                nMaxWaitMs_;
+        BatchPolicy                                 ePolicy_;
+        long long                                   llTolerance_;   // timestamp units
+        float                                       afMean_[3];
+        float                                       afStd_[3];
+        BatchAssemblerStats                         oStats_;
+
+        std::vector<Input *>                        aInputs_;
+
+        std::mutex                                  oMutex_;
+        std::condition_variable                     oReady_;
+        std::vector<Buffer>                         aBuffers_;
+        std::vector<unsigned int>                   aFree_;
+        std::deque<unsigned int>                    aReady_;
+        int                                         nFilling_;      // -1 if none
+        unsigned int                                nOut_;          // held by the consumer
+        std::deque<Group>                           aGroups_;       // synchronized, oldest first
+        bool                                        bClosed_;
+};
+
+#endif // BATCHASSEMBLER_H
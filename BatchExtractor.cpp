@@ -0,0 +1,254 @@
+/*
+* File		: BatchExtractor.cpp
+* Time : 2026 - 10 - 19
+*/
+
+#include "BatchExtractor.h"
+#include "ClipExtractor.h"
+#include "WorkStealingPool.h"
+
+#include <algorithm>
+#include <chrono>
+#include <fstream>
+#include <iomanip>
+#include <sstream>
+#include <stdlib.h>
+#include <string.h>
+
+// File name without directory and extension, for naming the output.
+static
+std::string
+fileStem(const std::string &sPath)
+{
+    size_t nSlash = sPath.find_last_of("/\\");
+    std::string sName = nSlash == std::string::npos ? sPath : sPath.substr(nSlash + 1);
+    size_t nDot = sName.find_last_of('.');
+
+    return nDot == std::string::npos || nDot == 0 ? sName : sName.substr(0, nDot);
+}
+
+// Writes the first frame of each clip, clip i being requested frame i.
+class FrameFileSink : public ClipSink
+{
+    public:
+        FrameFileSink(AsyncFileWriter &rWriter, const std::string &sPrefix,
+                      const std::vector<unsigned long> &rFrames)
+            : rWriter_(rWriter)
+            , sPrefix_(sPrefix)
+            , rFrames_(rFrames)
+            , aDone_(rFrames.size(), false)
+            , nWritten_(0)
+        {
+        }
+
+        virtual
+        void
+        onClipFrame(unsigned int nClip, const DecodedFrame &rFrame)
+        {
+            // A variable frame rate can put two frames into one slot
+            if (nClip >= aDone_.size() || aDone_[nClip])
+                return;
+
+            size_t nRowBytes = (size_t)rFrame.nWidth * (rFrame.nBitDepth > 8 ? 2 : 1);
+            size_t nRows     = (size_t)rFrame.nHeight * 3 / 2;
+            WriteBuffer *pBuffer = rWriter_.acquire();
+
+            pBuffer->aData.resize(nRowBytes * nRows);
+
+            CUDA_MEMCPY2D oCopy;
+            memset(&oCopy, 0, sizeof(oCopy));
+            oCopy.srcMemoryType = CU_MEMORYTYPE_DEVICE;
+            oCopy.srcDevice     = rFrame.dpFrame;
+            oCopy.srcPitch      = rFrame.nPitch;
+            oCopy.dstMemoryType = CU_MEMORYTYPE_HOST;
+            oCopy.dstHost       = &pBuffer->aData[0];
+            oCopy.dstPitch      = nRowBytes;
+            oCopy.WidthInBytes  = nRowBytes;
+            oCopy.Height        = nRows;
+
+            if (cuMemcpy2D(&oCopy) != CUDA_SUCCESS)
+            {
+                rWriter_.release(pBuffer);
+                return;
+            }
+
+            std::ostringstream oPath;
+            oPath << sPrefix_ << '_' << std::setw(6) << std::setfill('0') << rFrames_[nClip]
+                  << '_' << rFrame.nWidth << 'x' << rFrame.nHeight
+                  << (rFrame.nBitDepth > 8 ? ".p016" : ".nv12");
+            rWriter_.write(oPath.str(), pBuffer);
+
+            aDone_[nClip] = true;
+            nWritten_++;
+        }
+
+        unsigned long
+        written()
+        const
+        {
+            return nWritten_;
+        }
+
+    private:
+        // Copy constructor. Don't implement.
+        FrameFileSink(const FrameFileSink &);
+
+        // Assignment operator. Don't implement.
+        void
+        operator= (const FrameFileSink &);
+
+        AsyncFileWriter                    &rWriter_;
+        std::string                         sPrefix_;
+        const std::vector<unsigned long>   &rFrames_;
+        std::vector<bool>                   aDone_;
+        unsigned long                       nWritten_;
+};
+
+BatchExtractor::BatchExtractor(const std::string &sOutputDir, unsigned int nPipelines, int nGpu,
+                               unsigned int nWriterThreads)
+    : sOutputDir_(sOutputDir)
+    , nPipelines_(nPipelines > 0 ? nPipelines : 1)
+    , nGpu_(nGpu)
+    , oWriter_(nWriterThreads, 8 * (nPipelines > 0 ? nPipelines : 1))
+{
+}
+
+void
+BatchExtractor::add(const std::string &sFile, unsigned long nFrame)
+{
+    aRequests_[sFile].push_back(nFrame);
+}
+
+bool
+BatchExtractor::loadList(const std::string &sListFile)
+{
+    std::ifstream oList(sListFile.c_str());
+
+    if (!oList)
+    {
+        printf("can't open list %s\n", sListFile.c_str());
+        return false;
+    }
+
+    std::string sLine;
+    unsigned int nLine = 0;
+
+    while (std::getline(oList, sLine))
+    {
+        nLine++;
+        size_t nEnd = sLine.find_last_not_of(" \t\r");
+        if (nEnd == std::string::npos || sLine[sLine.find_first_not_of(" \t")] == '#')
+            continue;
+        sLine.erase(nEnd + 1);
+
+        size_t nSplit = sLine.find_last_of(" \t");
+        size_t nPathEnd = nSplit == std::string::npos ? std::string::npos : sLine.find_last_not_of(" \t", nSplit);
+        char  *pEnd = 0;
+        unsigned long nFrame = nSplit == std::string::npos ? 0 : strtoul(sLine.c_str() + nSplit + 1, &pEnd, 10);
+
+        if (nPathEnd == std::string::npos || !pEnd || *pEnd != '\0')
+        {
+            printf("%s:%u: expected \"path frame\"\n", sListFile.c_str(), nLine);
+            continue;
+        }
+        add(sLine.substr(sLine.find_first_not_of(" \t"), nPathEnd + 1 - sLine.find_first_not_of(" \t")), nFrame);
+    }
+
+    return true;
+}
+
+void
+BatchExtractor::extractFile(const std::string &sFile, const std::vector<unsigned long> &rFrames)
+{
+    std::vector<char> aName(sFile.begin(), sFile.end());
+    aName.push_back('\0');
+
+    std::string sPrefix = sOutputDir_.empty() ? fileStem(sFile) : sOutputDir_ + "/" + fileStem(sFile);
+    FrameFileSink oSink(oWriter_, sPrefix, rFrames);
+    cudaDecode oDecoder;
+    bool bResult;
+
+    {
+        ClipExtractor oExtractor(oDecoder);
+
+        bResult = oDecoder.init(&aName[0], nGpu_);
+        if (bResult)
+        {
+            // Frame n is the one displayed nearest to n frame durations in
+            double dFrameRate = oDecoder.frameRate();
+            double dFrameUs   = 1e6 / (dFrameRate > 0 ? dFrameRate : 25.0);
+            long long llStart = oDecoder.startTimestamp();
+
+            for (size_t i = 0; i < rFrames.size(); i++)
+            {
+                oExtractor.addClip(llStart + (long long)((rFrames[i] - 0.5) * dFrameUs),
+                                   llStart + (long long)((rFrames[i] + 0.5) * dFrameUs));
+            }
+            bResult = oExtractor.run(oSink);
+        }
+    }
+    oDecoder.uninit();
+
+    if (!bResult)
+    {
+        printf("batch: %s failed after %lu of %lu frames\n", sFile.c_str(), oSink.written(),
+               (unsigned long)rFrames.size());
+        oStats_.nFilesFailed++;
+    }
+    oStats_.nFiles++;
+    oStats_.nFramesWritten += oSink.written();
+    oStats_.nFramesMissing += (unsigned long)rFrames.size() - oSink.written();
+}
+
+bool
+BatchExtractor::run()
+{
+    std::chrono::steady_clock::time_point oStart = std::chrono::steady_clock::now();
+    unsigned long nFilesFailed = oStats_.nFilesFailed;
+
+    for (std::map<std::string, std::vector<unsigned long> >::iterator it = aRequests_.begin();
+         it != aRequests_.end(); ++it)
+    {
+        std::sort(it->second.begin(), it->second.end());
+        it->second.erase(std::unique(it->second.begin(), it->second.end()), it->second.end());
+        oStats_.nFramesRequested += (unsigned long)it->second.size();
+    }
+
+    {
+        WorkStealingPool oPool(nPipelines_);
+
+        for (std::map<std::string, std::vector<unsigned long> >::const_iterator it = aRequests_.begin();
+             it != aRequests_.end(); ++it)
+        {
+            oPool.submit(std::bind(&BatchExtractor::extractFile, this, it->first, it->second));
+        }
+        oPool.wait();
+    }
+    oWriter_.flush();
+    aRequests_.clear();
+
+    double dSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - oStart).count();
+    printf("batch: %lu files (%lu failed), %lu of %lu frames written, %lu missing, %.1f s, %.1f frames/s\n",
+           oStats_.nFiles.load(), oStats_.nFilesFailed.load(), oStats_.nFramesWritten.load(),
+           oStats_.nFramesRequested.load(), oStats_.nFramesMissing.load(), dSeconds,
+           dSeconds > 0 ? oStats_.nFramesWritten / dSeconds : 0.0);
+    printf("batch: writer %lu files, %llu bytes, %lu errors, %lu stalls\n",
+           oWriter_.stats().nFiles.load(), oWriter_.stats().nBytes.load(),
+           oWriter_.stats().nErrors.load(), oWriter_.stats().nStalls.load());
+
+    return oStats_.nFilesFailed == nFilesFailed;
+}
+
+const BatchExtractStats &
+BatchExtractor::stats()
+const
+{
+    return oStats_;
+}
+
+const AsyncFileWriterStats &
+BatchExtractor::writerStats()
+const
+{
+    return oWriter_.stats();
+}
@@ -0,0 +1,98 @@
+/*
+* File		: BatchExtractor.h
+* Time : 2026 - 10 - 19
+*/
+
+#ifndef BATCHEXTRACTOR_H
+#define BATCHEXTRACTOR_H
+
+#include "AsyncFileWriter.h"
+
+#include <atomic>
+#include <map>
+#include <string>
+#include <vector>
+
+// Batch counters; safe to read from any thread.
+struct BatchExtractStats
+{
+    std::atomic<unsigned long> nFiles;
+    std::atomic<unsigned long> nFilesFailed;       // couldn't be opened or seeked
+    std::atomic<unsigned long> nFramesRequested;
+    std::atomic<unsigned long> nFramesWritten;     // handed to the writer
+    std::atomic<unsigned long> nFramesMissing;     // past the end, or not delivered
+
+    BatchExtractStats()
+        : nFiles(0), nFilesFailed(0), nFramesRequested(0), nFramesWritten(0), nFramesMissing(0)
+    {
+    }
+
+  private:
+    // Copy constructor. Don't implement.
+    BatchExtractStats(const BatchExtractStats &);
+
+    // Assignment operator. Don't implement.
+    void
+    operator= (const BatchExtractStats &);
+};
+
+// Extracts a list of (file, frame number) pairs to raw frame files.
+//  Requests are grouped by file, and each file is one task of a
+// WorkStealingPool with nPipelines workers, so long files don't hold up
+// the rest. Within a file the frames are sorted and extracted with a
+// ClipExtractor: frames of the same GOP (anything closer than
+// ClipExtractor::cllMergeGapUs) come out of one decode of that GOP, and
+// only the requested frames are read back to the host. The AsyncFileWriter
+// puts them on disk while decoding goes on.
+//
+// Frame numbers count displayed frames from 0 at the nominal frame rate.
+// Each frame is written as <output dir>/<file stem>_<frame>_<W>x<H>.nv12
+// (.p016 for high bit depth), the planes tightly packed.
+class BatchExtractor
+{
+    public:
+        BatchExtractor(const std::string &sOutputDir, unsigned int nPipelines = 4, int nGpu = 0,
+                       unsigned int nWriterThreads = 2);
+
+        void
+        add(const std::string &sFile, unsigned long nFrame);
+
+        // Reads "path frame" lines; the frame number is the last field, so
+        // paths may contain spaces. Empty lines and lines starting with '#'
+        // are skipped.
+        bool
+        loadList(const std::string &sListFile);
+
+        // Extracts everything added. Returns false if any file failed.
+        bool
+        run();
+
+        const BatchExtractStats &
+        stats()
+        const;
+
+        const AsyncFileWriterStats &
+        writerStats()
+        const;
+
+    private:
+        // Copy constructor. Don't implement.
+        BatchExtractor(const BatchExtractor &);
+
+        // Assignment operator. Don't implement.
+        void
+        operator= (const BatchExtractor &);
+
+        // One pool task: decodes the requested frames of one file.
+        void
+        extractFile(const std::string &sFile, const std::vector<unsigned long> &rFrames);
+
+        std::string                                         sOutputDir_;
+        unsigned int                                        nPipelines_;
+        int                                                 nGpu_;
+        std::map<std::string, std::vector<unsigned long> >  aRequests_;
+        AsyncFileWriter                                     oWriter_;
+        BatchExtractStats                                   oStats_;
+};
+
+#endif // BATCHEXTRACTOR_H
@@ -0,0 +1,420 @@
+/*
+* File		: BatchRunner.cpp
+* Time : 2026 - 10 - 19
+*/
+
+#include "BatchRunner.h"
+#include "ClipExtractor.h"
+#include "WorkStealingPool.h"
+
+#include <chrono>
+#include <fstream>
+#include <limits.h>
+#include <stdlib.h>
+
+#if defined(WIN32) || defined(_WIN32) || defined(WIN64) || defined(_WIN64)
+#include <windows.h>
+#else
+#include <glob.h>
+#endif
+
+// Size of a file in bytes, 0 if it can't be opened.
+static
+unsigned long long
+fileSize(const std::string &sPath)
+{
+    std::ifstream oFile(sPath.c_str(), std::ios::binary | std::ios::ate);
+
+    return oFile ? (unsigned long long)oFile.tellg() : 0;
+}
+
+// Counts the frames of one segment and forwards them.
+class SegmentCounter : public ClipSink
+{
+    public:
+        explicit
+        SegmentCounter(FrameSink *pSink)
+            : pSink_(pSink)
+            , nFrames_(0)
+            , nBytes_(0)
+        {
+        }
+
+        virtual
+        void
+        onClipFrame(unsigned int nClip, const DecodedFrame &rFrame)
+        {
+            nFrames_++;
+            nBytes_ += (unsigned long long)rFrame.nWidth * (rFrame.nBitDepth > 8 ? 2 : 1) * rFrame.nHeight * 3 / 2;
+            if (pSink_)
+                pSink_->onFrame(rFrame);
+        }
+
+        unsigned long
+        frames()
+        const
+        {
+            return nFrames_;
+        }
+
+        // Decoded picture bytes, planes tightly packed.
+        unsigned long long
+        bytes()
+        const
+        {
+            return nBytes_;
+        }
+
+    private:
+        // Copy constructor. Don't implement.
+        SegmentCounter(const SegmentCounter &);
+
+        // Assignment operator. Don't implement.
+        void
+        operator= (const SegmentCounter &);
+
+        FrameSink          *pSink_;
+        unsigned long       nFrames_;
+        unsigned long long  nBytes_;
+};
+
+BatchRunner::BatchRunner(unsigned int nPipelines, int nGpu, double dSegmentSeconds)
+    : nPipelines_(nPipelines > 0 ? nPipelines : 1)
+    , nGpu_(nGpu)
+    , llSegmentUs_(dSegmentSeconds > 0 ? (long long)(dSegmentSeconds * 1e6) : 0)
+    , pSink_(0)
+    , pPool_(0)
+    , pJournal_(0)
+{
+}
+
+BatchRunner::~BatchRunner()
+{
+    if (pJournal_)
+        fclose(pJournal_);
+}
+
+void
+BatchRunner::setFrameSink(FrameSink *pSink)
+{
+    pSink_ = pSink;
+}
+
+bool
+BatchRunner::setJournal(const std::string &sPath)
+{
+    std::lock_guard<std::mutex> oLock(oJournalMutex_);
+
+    if (pJournal_)
+    {
+        fclose(pJournal_);
+        pJournal_ = 0;
+    }
+    aDone_.clear();
+
+    // "<segment> <count> <frames> <path>"; a line cut short by a crash has
+    // no newline and is ignored
+    std::ifstream oOld(sPath.c_str(), std::ios::binary);
+    std::string sLine;
+    unsigned long nEntries = 0;
+
+    while (std::getline(oOld, sLine))
+    {
+        if (oOld.eof())
+            break;
+        if (!sLine.empty() && sLine[sLine.size() - 1] == '\r')
+            sLine.erase(sLine.size() - 1);
+
+        unsigned int  nSegment, nSegments;
+        unsigned long nFrames;
+        int           nPath = 0;
+
+        if (sscanf(sLine.c_str(), "%u %u %lu %n", &nSegment, &nSegments, &nFrames, &nPath) == 3 &&
+            nPath > 0 && (size_t)nPath < sLine.size() && nSegment < nSegments)
+        {
+            aDone_[sLine.substr(nPath)].insert(std::make_pair(nSegment, nSegments));
+            nEntries++;
+        }
+    }
+    oOld.close();
+
+    pJournal_ = fopen(sPath.c_str(), "ab");
+    if (!pJournal_)
+    {
+        printf("can't open journal %s\n", sPath.c_str());
+        return false;
+    }
+    if (nEntries)
+        printf("journal %s: %lu segments of %lu files done\n", sPath.c_str(), nEntries, (unsigned long)aDone_.size());
+    return true;
+}
+
+void
+BatchRunner::addFile(const std::string &sFile)
+{
+    aFiles_.push_back(sFile);
+}
+
+bool
+BatchRunner::addList(const std::string &sListFile)
+{
+    std::ifstream oList(sListFile.c_str());
+
+    if (!oList)
+    {
+        printf("can't open list %s\n", sListFile.c_str());
+        return false;
+    }
+
+    std::string sLine;
+
+    while (std::getline(oList, sLine))
+    {
+        size_t nBegin = sLine.find_first_not_of(" \t");
+        size_t nEnd   = sLine.find_last_not_of(" \t\r");
+
+        if (nBegin == std::string::npos || sLine[nBegin] == '#')
+            continue;
+        addFile(sLine.substr(nBegin, nEnd + 1 - nBegin));
+    }
+
+    return true;
+}
+
+unsigned int
+BatchRunner::addGlob(const std::string &sPattern)
+{
+    unsigned int nAdded = 0;
+
+#if defined(WIN32) || defined(_WIN32) || defined(WIN64) || defined(_WIN64)
+    size_t nSlash = sPattern.find_last_of("/\\");
+    std::string sDir = nSlash == std::string::npos ? std::string() : sPattern.substr(0, nSlash + 1);
+    WIN32_FIND_DATAA oFind;
+    HANDLE hFind = FindFirstFileA(sPattern.c_str(), &oFind);
+
+    if (hFind != INVALID_HANDLE_VALUE)
+    {
+        do
+        {
+            if (!(oFind.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY))
+            {
+                addFile(sDir + oFind.cFileName);
+                nAdded++;
+            }
+        } while (FindNextFileA(hFind, &oFind));
+        FindClose(hFind);
+    }
+#else
+    glob_t oGlob;
+
+    if (glob(sPattern.c_str(), GLOB_MARK, NULL, &oGlob) == 0)
+    {
+        for (size_t i = 0; i < oGlob.gl_pathc; i++)
+        {
+            std::string sPath = oGlob.gl_pathv[i];
+
+            // GLOB_MARK tags directories with a trailing slash
+            if (!sPath.empty() && sPath[sPath.size() - 1] != '/')
+            {
+                addFile(sPath);
+                nAdded++;
+            }
+        }
+    }
+    globfree(&oGlob);
+#endif
+
+    if (!nAdded)
+        printf("no files match %s\n", sPattern.c_str());
+    return nAdded;
+}
+
+bool
+BatchRunner::run()
+{
+    std::chrono::steady_clock::time_point oStart = std::chrono::steady_clock::now();
+    unsigned long nFailed = oStats_.nFilesFailed + oStats_.nSegmentsFailed;
+
+    {
+        WorkStealingPool oPool(nPipelines_);
+
+        pPool_ = &oPool;
+        for (size_t i = 0; i < aFiles_.size(); i++)
+            oPool.submit(std::bind(&BatchRunner::processFile, this, aFiles_[i]));
+        oPool.wait();
+        pPool_ = 0;
+
+        printf("batch: %lu segments taken over by another pipeline\n", oPool.steals());
+    }
+    aFiles_.clear();
+
+    double dSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - oStart).count();
+    if (dSeconds <= 0)
+        dSeconds = 1e-3;
+    printf("batch: %lu files (%lu already done, %lu failed), %lu segments (%lu failed), %.1f s\n",
+           oStats_.nFiles.load(), oStats_.nFilesSkipped.load(), oStats_.nFilesFailed.load(),
+           oStats_.nSegments.load(), oStats_.nSegmentsFailed.load(), dSeconds);
+    printf("batch: %lu frames, %.1f frames/s, input %.1f MB/s, decoded %.1f MB/s\n",
+           oStats_.nFrames.load(), oStats_.nFrames / dSeconds,
+           oStats_.nInputBytes / dSeconds / 1e6, oStats_.nOutputBytes / dSeconds / 1e6);
+
+    return oStats_.nFilesFailed + oStats_.nSegmentsFailed == nFailed;
+}
+
+void
+BatchRunner::processFile(const std::string &sFile)
+{
+    oStats_.nFiles++;
+    if (fileDone(sFile))
+    {
+        oStats_.nFilesSkipped++;
+        return;
+    }
+
+    std::vector<char> aName(sFile.begin(), sFile.end());
+    aName.push_back('\0');
+
+    cudaDecode oDecoder;
+    {
+        ClipExtractor oExtractor(oDecoder);
+
+        if (oDecoder.init(&aName[0], nGpu_))
+        {
+            unsigned int nSegments = segmentCount(oDecoder);
+
+            // The others first, so idle pipelines can steal them while this
+            // one is busy with segment 0
+            for (unsigned int i = 1; i < nSegments; i++)
+            {
+                if (!segmentDone(sFile, i, nSegments))
+                    pPool_->submit(std::bind(&BatchRunner::processSegment, this, sFile, i, nSegments));
+            }
+            if (!segmentDone(sFile, 0, nSegments))
+                decodeSegment(oDecoder, oExtractor, sFile, 0, nSegments);
+        }
+        else
+        {
+            printf("batch: can't open %s\n", sFile.c_str());
+            oStats_.nFilesFailed++;
+        }
+    }
+    oDecoder.uninit();
+}
+
+void
+BatchRunner::processSegment(const std::string &sFile, unsigned int nSegment, unsigned int nSegments)
+{
+    std::vector<char> aName(sFile.begin(), sFile.end());
+    aName.push_back('\0');
+
+    cudaDecode oDecoder;
+    {
+        ClipExtractor oExtractor(oDecoder);
+
+        if (oDecoder.init(&aName[0], nGpu_))
+        {
+            decodeSegment(oDecoder, oExtractor, sFile, nSegment, nSegments);
+        }
+        else
+        {
+            printf("batch: can't reopen %s for segment %u\n", sFile.c_str(), nSegment);
+            oStats_.nSegmentsFailed++;
+        }
+    }
+    oDecoder.uninit();
+}
+
+void
+BatchRunner::decodeSegment(cudaDecode &rDecoder, ClipExtractor &rExtractor, const std::string &sFile,
+                           unsigned int nSegment, unsigned int nSegments)
+{
+    // The outer segments reach past the nominal start and duration, so
+    // frames timestamped outside them still belong to one segment
+    long long llStart = rDecoder.startTimestamp();
+    long long llBegin = nSegment == 0 ? llStart - 3600000000LL : llStart + nSegment * llSegmentUs_;
+    long long llEnd   = nSegment + 1 == nSegments ? LLONG_MAX / 4 : llStart + (nSegment + 1) * llSegmentUs_;
+
+    // Anything slower than real time, plus a minute of slack, is stuck
+    long long llDuration = nSegments > 1 ? llSegmentUs_ : rDecoder.duration();
+    long long llTimeoutMs = llDuration > 0 ? llDuration / 1000 + 60000 : 24LL * 3600 * 1000;
+
+    SegmentCounter oCounter(pSink_);
+
+    rExtractor.clear();
+    rExtractor.addClip(llBegin, llEnd);
+    if (!rExtractor.run(oCounter, (int)(llTimeoutMs < INT_MAX ? llTimeoutMs : INT_MAX)))
+    {
+        printf("batch: %s segment %u/%u failed after %lu frames\n", sFile.c_str(), nSegment, nSegments,
+               oCounter.frames());
+        oStats_.nSegmentsFailed++;
+        oStats_.nFrames += oCounter.frames();
+        return;
+    }
+
+    oStats_.nSegments++;
+    oStats_.nFrames += oCounter.frames();
+    oStats_.nOutputBytes += oCounter.bytes();
+    oStats_.nInputBytes += fileSize(sFile) / nSegments;
+    journalSegment(sFile, nSegment, nSegments, oCounter.frames());
+}
+
+unsigned int
+BatchRunner::segmentCount(cudaDecode &rDecoder)
+const
+{
+    long long llDuration = rDecoder.duration();
+
+    if (llSegmentUs_ <= 0 || llDuration <= llSegmentUs_)
+        return 1;
+    return (unsigned int)((llDuration + llSegmentUs_ - 1) / llSegmentUs_);
+}
+
+bool
+BatchRunner::segmentDone(const std::string &sFile, unsigned int nSegment, unsigned int nSegments)
+{
+    std::lock_guard<std::mutex> oLock(oJournalMutex_);
+    std::map<std::string, SegmentSet>::const_iterator it = aDone_.find(sFile);
+
+    return it != aDone_.end() && it->second.count(std::make_pair(nSegment, nSegments)) != 0;
+}
+
+bool
+BatchRunner::fileDone(const std::string &sFile)
+{
+    std::lock_guard<std::mutex> oLock(oJournalMutex_);
+    std::map<std::string, SegmentSet>::const_iterator it = aDone_.find(sFile);
+
+    if (it == aDone_.end())
+        return false;
+
+    // Checked without opening the file, so the segment count is the one
+    // the journal recorded
+    std::map<unsigned int, unsigned int> aCounts;
+    for (SegmentSet::const_iterator seg = it->second.begin(); seg != it->second.end(); ++seg)
+    {
+        if (++aCounts[seg->second] == seg->second)
+            return true;
+    }
+    return false;
+}
+
+void
+BatchRunner::journalSegment(const std::string &sFile, unsigned int nSegment, unsigned int nSegments,
+                            unsigned long nFrames)
+{
+    std::lock_guard<std::mutex> oLock(oJournalMutex_);
+
+    aDone_[sFile].insert(std::make_pair(nSegment, nSegments));
+    if (!pJournal_)
+        return;
+
+    fprintf(pJournal_, "%u %u %lu %s\n", nSegment, nSegments, nFrames, sFile.c_str());
+    fflush(pJournal_);
+}
+
+const BatchRunnerStats &
+BatchRunner::stats()
+const
+{
+    return oStats_;
+}
@@ -0,0 +1,158 @@
+/*
+* File		: BatchRunner.h
+* Time : 2026 - 10 - 19
+*/
+
+#ifndef BATCHRUNNER_H
+#define BATCHRUNNER_H
+
+#include "FrameSink.h"
+
+#include <atomic>
+#include <map>
+#include <mutex>
+#include <set>
+#include <stdio.h>
+#include <string>
+#include <utility>
+#include <vector>
+
+class ClipExtractor;
+class cudaDecode;
+class WorkStealingPool;
+
+// Batch counters; safe to read from any thread.
+struct BatchRunnerStats
+{
+    std::atomic<unsigned long>      nFiles;
+    std::atomic<unsigned long>      nFilesSkipped;      // finished in an earlier run
+    std::atomic<unsigned long>      nFilesFailed;       // couldn't be opened
+    std::atomic<unsigned long>      nSegments;          // decoded in this run
+    std::atomic<unsigned long>      nSegmentsFailed;    // seek failed or timed out
+    std::atomic<unsigned long>      nFrames;
+    std::atomic<unsigned long long> nInputBytes;        // file bytes of the decoded segments
+    std::atomic<unsigned long long> nOutputBytes;       // decoded picture bytes
+
+    BatchRunnerStats()
+        : nFiles(0), nFilesSkipped(0), nFilesFailed(0), nSegments(0), nSegmentsFailed(0)
+        , nFrames(0), nInputBytes(0), nOutputBytes(0)
+    {
+    }
+
+  private:
+    // Copy constructor. Don't implement.
+    BatchRunnerStats(const BatchRunnerStats &);
+
+    // Assignment operator. Don't implement.
+    void
+    operator= (const BatchRunnerStats &);
+};
+
+// Decodes a list of files with a fixed number of concurrent pipelines.
+//  Every file is a task of a WorkStealingPool with one worker per
+// pipeline, each worker owning at most one decode session at a time.
+// A file longer than the segment length is split: the task opening it
+// queues its other segments on its own worker, where idle pipelines steal
+// them, and decodes the first one itself. Segments are cut with a
+// ClipExtractor, so every frame belongs to exactly one segment.
+//
+// With a journal, every finished segment is appended to it and flushed.
+// A run started on the same journal skips what is recorded there, so a
+// crashed batch resumes at segment granularity.
+class BatchRunner
+{
+    public:
+        // Parameters:
+        //      nPipelines - concurrent decode sessions.
+        //      nGpu - device the sessions are created on.
+        //      dSegmentSeconds - split files longer than this, 0 never splits.
+        BatchRunner(unsigned int nPipelines = 4, int nGpu = 0, double dSegmentSeconds = 600);
+
+        ~BatchRunner();
+
+        // Receives every decoded frame, from all pipelines concurrently.
+        // Must be set before run() and outlive it.
+        void
+        setFrameSink(FrameSink *pSink);
+
+        // Loads the segments recorded in sPath, then appends to it.
+        // Returns false if the journal can't be opened for writing.
+        bool
+        setJournal(const std::string &sPath);
+
+        void
+        addFile(const std::string &sFile);
+
+        // One path per line; empty lines and lines starting with '#' are
+        // skipped.
+        bool
+        addList(const std::string &sListFile);
+
+        // Adds the files matching a wildcard pattern. On Windows only the
+        // last path component may contain wildcards.
+        // Returns:
+        //      the number of files added.
+        unsigned int
+        addGlob(const std::string &sPattern);
+
+        // Decodes every file added. Returns false if a file or segment failed.
+        bool
+        run();
+
+        const BatchRunnerStats &
+        stats()
+        const;
+
+    private:
+        // Copy constructor. Don't implement.
+        BatchRunner(const BatchRunner &);
+
+        // Assignment operator. Don't implement.
+        void
+        operator= (const BatchRunner &);
+
+        // Pool task: opens the file, queues its other segments and decodes
+        // the first.
+        void
+        processFile(const std::string &sFile);
+
+        // Pool task: opens the file again and decodes one segment.
+        void
+        processSegment(const std::string &sFile, unsigned int nSegment, unsigned int nSegments);
+
+        // Decodes a segment with an initialized decoder and journals it.
+        void
+        decodeSegment(cudaDecode &rDecoder, ClipExtractor &rExtractor, const std::string &sFile,
+                      unsigned int nSegment, unsigned int nSegments);
+
+        unsigned int
+        segmentCount(cudaDecode &rDecoder)
+        const;
+
+        bool
+        segmentDone(const std::string &sFile, unsigned int nSegment, unsigned int nSegments);
+
+        // Every segment of some earlier split of the file is done.
+        bool
+        fileDone(const std::string &sFile);
+
+        void
+        journalSegment(const std::string &sFile, unsigned int nSegment, unsigned int nSegments,
+                       unsigned long nFrames);
+
+        typedef std::set<std::pair<unsigned int, unsigned int> > SegmentSet;   // (segment, count)
+
+        unsigned int                        nPipelines_;
+        int                                 nGpu_;
+        long long                           llSegmentUs_;
+        FrameSink                          *pSink_;
+        std::vector<std::string>            aFiles_;
+        WorkStealingPool                   *pPool_;        // during run()
+        BatchRunnerStats                    oStats_;
+
+        std::mutex                          oJournalMutex_;
+        FILE                               *pJournal_;
+        std::map<std::string, SegmentSet>   aDone_;
+};
+
+#endif // BATCHRUNNER_H
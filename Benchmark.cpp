@@ -0,0 +1,425 @@
+/*
+* File		: Benchmark.cpp
+* Time : 2026 - 10 - 19
+*/
+
+#include "Benchmark.h"
+
+#include "DecodeScheduler.h"
+#include "DecodeStats.h"
+#include "DevicePlacement.h"
+#include "EsFileReader.h"
+#include "NalIterator.h"
+#include "StartCode.h"
+#include "StreamAnalyzer.h"
+#include "TsDemuxer.h"
+
+#include <map>
+#include <stdio.h>
+#include <thread>
+#include <vector>
+
+extern "C"
+{
+#include "libavcodec/avcodec.h"
+#include "libavformat/avformat.h"
+}
+
+// Reads the whole file so that disk speed doesn't enter the numbers.
+static
+bool
+readFile(const char *szFileName, std::vector<unsigned char> &rData)
+{
+    FILE *pFile = fopen(szFileName, "rb");
+    if (!pFile)
+    {
+        printf("can't open %s\n", szFileName);
+        return false;
+    }
+
+    fseek(pFile, 0, SEEK_END);
+    long nSize = ftell(pFile);
+    fseek(pFile, 0, SEEK_SET);
+
+    rData.resize(nSize > 0 ? nSize : 0);
+    size_t nRead = rData.empty() ? 0 : fread(&rData[0], 1, rData.size(), pFile);
+    fclose(pFile);
+
+    return nRead == rData.size() && !rData.empty();
+}
+
+int
+benchmarkTsDemux(const char *szFileName)
+{
+    std::vector<unsigned char> aData;
+
+    if (!readFile(szFileName, aData))
+        return 1;
+
+    double dMegabytes = aData.size() / (1024.0 * 1024.0);
+
+    // Native: fed in 7-packet chunks, as they would arrive over UDP
+    const size_t cnChunk = 7 * TsDemuxer::cnPacketSize;
+    const int    cnPasses = 10;
+    unsigned long nUnits = 0;
+
+    long long llStart = steadyClockUs();
+    for (int nPass = 0; nPass < cnPasses; nPass++)
+    {
+        TsDemuxer oDemuxer;
+        AccessUnit oUnit;
+
+        for (size_t nOffset = 0; nOffset < aData.size(); nOffset += cnChunk)
+        {
+            size_t nSize = aData.size() - nOffset < cnChunk ? aData.size() - nOffset : cnChunk;
+            oDemuxer.feed(&aData[nOffset], nSize, 0);
+            while (oDemuxer.next(oUnit))
+                nUnits++;
+        }
+        if (oDemuxer.finish(oUnit))
+            nUnits++;
+    }
+    double dNativeSeconds = (steadyClockUs() - llStart) / 1e6 / cnPasses;
+    nUnits /= cnPasses;
+
+    printf("TsDemuxer: %lu PES in %.3f ms, %.0f PES/s, %.1f MB/s\n",
+           nUnits, dNativeSeconds * 1e3, nUnits / dNativeSeconds, dMegabytes / dNativeSeconds);
+
+    // FFmpeg, from the page cache after the read above
+    av_register_all();
+
+    AVFormatContext *pFormat = NULL;
+    if (avformat_open_input(&pFormat, szFileName, NULL, NULL) != 0 ||
+        avformat_find_stream_info(pFormat, NULL) < 0)
+    {
+        printf("FFmpeg can't open %s\n", szFileName);
+        return 1;
+    }
+
+    AVPacket oPacket;
+    av_init_packet(&oPacket);
+    unsigned long nPackets = 0;
+
+    llStart = steadyClockUs();
+    while (av_read_frame(pFormat, &oPacket) >= 0)
+    {
+        nPackets++;
+        av_free_packet(&oPacket);
+    }
+    double dFfmpegSeconds = (steadyClockUs() - llStart) / 1e6;
+    avformat_close_input(&pFormat);
+
+    printf("FFmpeg   : %lu packets (all streams) in %.3f ms, %.0f packets/s, %.1f MB/s\n",
+           nPackets, dFfmpegSeconds * 1e3, nPackets / dFfmpegSeconds, dMegabytes / dFfmpegSeconds);
+    printf("speedup %.1fx\n", dFfmpegSeconds / dNativeSeconds);
+
+    return 0;
+}
+
+typedef const unsigned char *(*StartCodeSearch)(const unsigned char *, const unsigned char *);
+
+// Seconds per pass over rData with pSearch, and the start codes found.
+static
+double
+timeStartCodeSearch(StartCodeSearch pSearch, const std::vector<unsigned char> &rData,
+                    int nPasses, unsigned long &nFound)
+{
+    const unsigned char *pBegin = &rData[0];
+    const unsigned char *pEnd   = pBegin + rData.size();
+
+    nFound = 0;
+
+    long long llStart = steadyClockUs();
+    for (int nPass = 0; nPass < nPasses; nPass++)
+    {
+        for (const unsigned char *p = pSearch(pBegin, pEnd); p < pEnd; p = pSearch(p + 3, pEnd))
+            nFound++;
+    }
+    double dSeconds = (steadyClockUs() - llStart) / 1e6 / nPasses;
+    nFound /= nPasses;
+
+    return dSeconds;
+}
+
+int
+benchmarkNalScan(const char *szFileName, cudaVideoCodec eCodec)
+{
+    std::vector<unsigned char> aData;
+
+    if (!readFile(szFileName, aData))
+        return 1;
+
+    double dGigabytes = aData.size() / (1024.0 * 1024.0 * 1024.0);
+    const int cnPasses = 10;
+
+    unsigned long nScalar = 0;
+    unsigned long nSimd   = 0;
+    double dScalarSeconds = timeStartCodeSearch(findStartCodeScalar, aData, cnPasses, nScalar);
+    double dSimdSeconds   = timeStartCodeSearch(findStartCode, aData, cnPasses, nSimd);
+
+    printf("scalar search: %lu start codes, %.2f GB/s\n", nScalar, dGigabytes / dScalarSeconds);
+    printf("SIMD search  : %lu start codes, %.2f GB/s (%.1fx)\n",
+           nSimd, dGigabytes / dSimdSeconds, dScalarSeconds / dSimdSeconds);
+
+    // Full iteration: boundaries, trailing zeros and NAL types
+    unsigned long nNals = 0;
+    unsigned long nVcl  = 0;
+    unsigned long nKey  = 0;
+
+    long long llStart = steadyClockUs();
+    for (int nPass = 0; nPass < cnPasses; nPass++)
+    {
+        NalIterator oNals(&aData[0], aData.size(), eCodec);
+        NalUnit     oNal;
+
+        while (oNals.next(oNal))
+        {
+            nNals++;
+            if (NalIterator::isVcl(eCodec, oNal.nType))
+            {
+                nVcl++;
+                if (NalIterator::isKeyFrame(eCodec, oNal.nType))
+                    nKey++;
+            }
+        }
+    }
+    double dIteratorSeconds = (steadyClockUs() - llStart) / 1e6 / cnPasses;
+
+    printf("NalIterator  : %lu NAL units (%lu slices, %lu key), %.2f GB/s\n",
+           nNals / cnPasses, nVcl / cnPasses, nKey / cnPasses, dGigabytes / dIteratorSeconds);
+
+    if (nScalar != nSimd || nSimd != nNals / cnPasses)
+    {
+        printf("start code counts disagree\n");
+        return 1;
+    }
+
+    return 0;
+}
+
+int
+benchmarkAnalyzer(const char *szFileName, cudaVideoCodec eCodec)
+{
+    EsFileParams oParams;
+    oParams.sFileName = szFileName;
+    oParams.eCodec    = eCodec;
+
+    EsFileReader oReader(oParams);
+    if (!oReader.open())
+        return 1;
+
+    // Split once up front, only the analysis is timed
+    std::vector<AccessUnit> aUnits;
+    AccessUnit oUnit;
+    while (oReader.next(oUnit))
+    {
+        oUnit.llTimestamp = (long long)aUnits.size() * 40000;
+        aUnits.push_back(oUnit);
+    }
+    if (aUnits.empty())
+    {
+        printf("no access units in %s\n", szFileName);
+        return 1;
+    }
+
+    const int cnPasses = 10;
+    StreamAnalyzer oAnalyzer(eCodec);
+
+    long long llStart = steadyClockUs();
+    for (int nPass = 0; nPass < cnPasses; nPass++)
+    {
+        oAnalyzer.reset();
+        for (size_t i = 0; i < aUnits.size(); i++)
+            oAnalyzer.analyze(aUnits[i]);
+    }
+    double dSeconds = (steadyClockUs() - llStart) / 1e6 / cnPasses;
+
+    StreamAnalysis oAnalysis = oAnalyzer.snapshot();
+    double dFramesPerSecond = aUnits.size() / dSeconds;
+
+    printf("StreamAnalyzer: %lu frames, %.0f frames/s, %.0f streams at 30 fps per core\n",
+           (unsigned long)aUnits.size(), dFramesPerSecond, dFramesPerSecond / 30);
+    printf("last %u frames: I %u P %u B %u, GOP %.1f, %.0f kbit/s at 25 fps\n",
+           oAnalysis.nFrames, oAnalysis.nIFrames, oAnalysis.nPFrames, oAnalysis.nBFrames,
+           oAnalysis.dGopLength, oAnalysis.dBitrate / 1000);
+
+    return 0;
+}
+
+// A simulated stream: paced at its frame rate, or kept a few jobs ahead
+// of its decoder when dFrameRate is 0.
+struct SimulatedStream
+{
+    int             nStream;
+    double          dFrameRate;
+    unsigned int    nGop;
+    long long       llNextUs;
+    unsigned long   nFrame;
+};
+
+int
+benchmarkScheduler(unsigned int nSessions, double dSeconds)
+{
+    const unsigned int cnArchiveAhead = 8;
+
+    FakeDecodeBackend oBackend;
+    DecodeScheduler oScheduler(oBackend, nSessions);
+    std::vector<SimulatedStream> aStreams;
+    long long llStartUs = steadyClockUs();
+
+    // class, count, fps, GOP, budget, P cost, I cost
+    struct { PriorityClass eClass; unsigned int nCount; double dFrameRate; unsigned int nGop;
+             long long llBudgetUs; long long llFrameUs; long long llKeyFrameUs; } aMix[] =
+    {
+        { PriorityClass_Alarm,    4, 30, 30,  60000,  3000, 8000 },
+        { PriorityClass_Live,    24, 25, 50,  250000, 4000, 10000 },
+        { PriorityClass_Archive,  4,  0, 250, 0,      4000, 10000 }
+    };
+
+    for (size_t i = 0; i < sizeof(aMix) / sizeof(aMix[0]); i++)
+    {
+        for (unsigned int j = 0; j < aMix[i].nCount; j++)
+        {
+            ScheduledStreamParams oParams;
+            oParams.eClass     = aMix[i].eClass;
+            oParams.llBudgetUs = aMix[i].llBudgetUs;
+            oParams.bDropLate  = aMix[i].llBudgetUs > 0;
+            oParams.nWeight    = j + 1;
+
+            SimulatedStream oStream;
+            oStream.nStream    = oScheduler.addStream(oParams);
+            oStream.dFrameRate = aMix[i].dFrameRate;
+            oStream.nGop       = aMix[i].nGop;
+            oStream.llNextUs   = llStartUs;
+            oStream.nFrame     = 0;
+            aStreams.push_back(oStream);
+
+            oBackend.setCost(oStream.nStream, aMix[i].llFrameUs, aMix[i].llKeyFrameUs);
+        }
+    }
+
+    long long llEndUs = llStartUs + (long long)(dSeconds * 1e6);
+    for (long long llNowUs = llStartUs; llNowUs < llEndUs; llNowUs = steadyClockUs())
+    {
+        for (size_t i = 0; i < aStreams.size(); i++)
+        {
+            SimulatedStream &rStream = aStreams[i];
+
+            while (rStream.dFrameRate > 0 ? rStream.llNextUs <= llNowUs
+                                          : oScheduler.queued(rStream.nStream) < cnArchiveAhead)
+            {
+                DecodeJob oJob;
+                oJob.bKeyFrame   = rStream.nFrame % rStream.nGop == 0;
+                oJob.llTimestamp = (long long)rStream.nFrame++;
+                oScheduler.submit(rStream.nStream, oJob);
+
+                if (rStream.dFrameRate > 0)
+                    rStream.llNextUs += (long long)(1e6 / rStream.dFrameRate);
+            }
+        }
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    oScheduler.drain();
+
+    static const char *aszClasses[PriorityClass_Count] = { "alarm", "live", "archive" };
+    printf("%u sessions, %.0f s: %lu jobs decoded, %lu restarts at a keyframe\n",
+           nSessions, dSeconds, oBackend.decoded(), oBackend.discontinuities());
+    printf("%-8s %10s %10s %8s %8s %10s %10s\n", "class", "submitted", "decoded", "late", "shed", "wait ms", "max ms");
+    for (unsigned int i = 0; i < PriorityClass_Count; i++)
+    {
+        const DecodeSchedulerStats &rStats = oScheduler.stats((PriorityClass)i);
+        unsigned long nDecoded = rStats.nDecoded;
+
+        printf("%-8s %10lu %10lu %8lu %8lu %10.1f %10.1f\n", aszClasses[i],
+               rStats.nSubmitted.load(), nDecoded, rStats.nLate.load(), rStats.nShed.load(),
+               nDecoded ? rStats.llWaitUs / 1000.0 / nDecoded : 0.0, rStats.llMaxWaitUs / 1000.0);
+    }
+
+    return 0;
+}
+
+int
+simulatePlacement()
+{
+    const double cdSaturation = 0.9;
+    const double cd1080p      = 1920.0 * 1080.0;
+    const size_t cnGiB        = 1024 * 1024 * 1024;
+
+    FakeDeviceCapability oDevices;
+    for (int i = 0; i < 3; i++)
+        oDevices.addDevice(cd1080p * 600, 2 * cnGiB, 2 * cnGiB);
+
+    StreamPlacer oPlacer(&oDevices, cdSaturation);
+
+    // size, fps, count
+    struct { unsigned int nWidth; unsigned int nHeight; double dFrameRate; unsigned int nCount; } aMix[] =
+    {
+        { 3840, 2160, 30, 2 },
+        { 1920, 1080, 30, 9 },
+        { 1280,  720, 25, 12 }
+    };
+
+    std::map<int, double> aCosts;   // by stream ID
+
+    for (size_t i = 0; i < sizeof(aMix) / sizeof(aMix[0]); i++)
+    {
+        for (unsigned int j = 0; j < aMix[i].nCount; j++)
+        {
+            StreamDemand oDemand;
+            oDemand.nWidth     = aMix[i].nWidth;
+            oDemand.nHeight    = aMix[i].nHeight;
+            oDemand.dFrameRate = aMix[i].dFrameRate;
+
+            int nDevice = -1;
+            int nStream = oPlacer.placeStream(oDemand, nDevice);
+            if (nStream < 0)
+            {
+                printf("placement: stream %u of %ux%u not placed\n", j, oDemand.nWidth, oDemand.nHeight);
+                return 1;
+            }
+            aCosts[nStream] = oDemand.nWidth * oDemand.nHeight * oDemand.dFrameRate;
+        }
+    }
+
+    printf("placed %lu streams, loads %.2f %.2f %.2f\n", (unsigned long)aCosts.size(),
+           oPlacer.deviceLoad(0), oPlacer.deviceLoad(1), oPlacer.deviceLoad(2));
+
+    if (!oPlacer.rebalance().empty())
+    {
+        printf("placement: moves proposed with no device saturated\n");
+        return 1;
+    }
+
+    // E.g. another process took most of device 0's decoder
+    oDevices.setDecodeCapacity(0, cd1080p * 600 / 3);
+
+    std::vector<StreamMove> aMoves = oPlacer.rebalance();
+    bool bOk = !aMoves.empty();
+
+    for (size_t i = 0; i < aMoves.size(); i++)
+    {
+        const StreamMove &rMove = aMoves[i];
+
+        printf("move stream %d (%.0f Msamples/s) from GPU %d to GPU %d\n", rMove.nStreamID,
+               aCosts[rMove.nStreamID] / 1e6, rMove.nFromDevice, rMove.nToDevice);
+        if (rMove.nFromDevice != 0 || rMove.nToDevice == 0 || oPlacer.deviceOf(rMove.nStreamID) != rMove.nToDevice)
+            bOk = false;
+        if (i > 0 && aCosts[rMove.nStreamID] > aCosts[aMoves[i - 1].nStreamID])
+            bOk = false;
+    }
+
+    printf("loads after rebalance %.2f %.2f %.2f\n",
+           oPlacer.deviceLoad(0), oPlacer.deviceLoad(1), oPlacer.deviceLoad(2));
+    for (int i = 0; i < 3; i++)
+    {
+        if (oPlacer.deviceLoad(i) > cdSaturation)
+            bOk = false;
+    }
+
+    // Nothing left to do
+    if (!oPlacer.rebalance().empty())
+        bOk = false;
+
+    printf("placement: %s\n", bOk ? "ok" : "FAILED");
+    return bOk ? 0 : 1;
+}
@@ -0,0 +1,55 @@
+/*
+* File		: Benchmark.h
+* Time : 2026 - 10 - 19
+*/
+
+#ifndef BENCHMARK_H
+#define BENCHMARK_H
+
+#include <nvcuvid.h>
+
+// Ingest benchmarks, built with TEST_TIME (Makefile TESTTIME=1) and run
+// from the command line, e.g. "cudadecode --bench-ts recorded.ts".
+// They only demux; nothing is decoded.
+
+// Demuxes a recorded transport stream with TsDemuxer and with FFmpeg's
+// mpegts demuxer and prints packets/s and MB/s for both.
+// Returns:
+//      0 on success, 1 if the file can't be read.
+int
+benchmarkTsDemux(const char *szFileName);
+
+// Splits an Annex-B elementary stream into NAL units with the scalar
+// start-code search, the SIMD one and NalIterator, and prints GB/s for
+// each. Large files show the scan cost best; the file is read into
+// memory first.
+// Returns:
+//      0 on success, 1 if the file can't be read or the counts disagree.
+int
+benchmarkNalScan(const char *szFileName, cudaVideoCodec eCodec);
+
+// Runs StreamAnalyzer over the access units of an Annex-B file and prints
+// frames/s on one core, with the number of 30 fps streams that rate covers.
+// Returns:
+//      0 on success, 1 if the file can't be read.
+int
+benchmarkAnalyzer(const char *szFileName, cudaVideoCodec eCodec);
+
+// Runs DecodeScheduler over FakeDecodeBackend for dSeconds with nSessions
+// decoder sessions: alarm cameras, live cameras and archive jobs with
+// made-up costs; prints what each priority class got. No GPU needed.
+// Returns:
+//      0.
+int
+benchmarkScheduler(unsigned int nSessions, double dSeconds = 10);
+
+// Places a mix of streams on three FakeDeviceCapability devices, cuts the
+// decode capacity of one until it saturates and checks the moves
+// StreamPlacer::rebalance() proposes: all off that device, largest stream
+// first, leaving every device at or below the threshold. No GPU needed.
+// Returns:
+//      0 if the moves are as expected, 1 otherwise.
+int
+simulatePlacement();
+
+#endif // BENCHMARK_H
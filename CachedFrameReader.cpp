@@ -0,0 +1,180 @@
+/*
+* File		: CachedFrameReader.cpp
+* Time : 2026 - 10 - 19
+*/
+
+#include "CachedFrameReader.h"
+
+#include <chrono>
+
+CachedFrameReader::CachedFrameReader(cudaDecode &rDecoder, FrameCache &rCache, unsigned int nSource)
+    : rDecoder_(rDecoder)
+    , rCache_(rCache)
+    , nSource_(nSource)
+    , llFirstTimestamp_(-1)
+    , dFrameUs_(0)
+    , bActive_(true)
+    , bDropping_(false)
+    , bNewGop_(true)
+    , bTargetPassed_(false)
+    , nTarget_(0)
+    , nGopStart_(0)
+    , llPosition_(-1)
+    , nGeneration_(0)
+    , bExit_(false)
+    , nSeeks_(0)
+{
+    rDecoder_.setFrameSink(this);
+    rDecoder_.setHoldAtEnd(true);
+}
+
+CachedFrameReader::~CachedFrameReader()
+{
+    {
+        std::lock_guard<std::mutex> oLock(oMutex_);
+        bExit_ = true;
+        oCond_.notify_all();
+    }
+    rDecoder_.pause();
+}
+
+unsigned long
+CachedFrameReader::frameNumber(long long llTimestamp)
+const
+{
+    double dFrame = (llTimestamp - llFirstTimestamp_) / dFrameUs_ + 0.5;
+    return dFrame > 0 ? (unsigned long)dFrame : 0;
+}
+
+void
+CachedFrameReader::onFrame(const DecodedFrame &rFrame)
+{
+    std::unique_lock<std::mutex> oLock(oMutex_);
+
+    if (bDropping_ || bExit_)
+        return;
+
+    if (llFirstTimestamp_ < 0)
+    {
+        double dFps = rDecoder_.frameRate();
+        llFirstTimestamp_ = rFrame.llTimestamp;
+        dFrameUs_ = 1e6 / (dFps > 0 ? dFps : 25);
+        oCond_.notify_all();
+    }
+
+    unsigned long nGeneration = nGeneration_;
+    unsigned long nFrame = frameNumber(rFrame.llTimestamp);
+    bool bKeyFrame = (rFrame.nFlags & DecodedFrame_KeyFrame) != 0;
+
+    // The GOP after the one asked for: hold the decode here
+    if (bActive_ && bTargetPassed_ && bKeyFrame && nFrame > nTarget_)
+        bActive_ = false;
+
+    llPosition_ = (long long)nFrame;
+    while (!bActive_ && nGeneration_ == nGeneration && !bExit_)
+        oCond_.wait(oLock);
+    if (nGeneration_ != nGeneration || bExit_)
+        return;
+
+    if (bKeyFrame || bNewGop_)
+    {
+        nGopStart_ = nFrame;
+        bNewGop_ = false;
+    }
+    unsigned long nGopStart = nGopStart_;
+
+    oLock.unlock();
+    rCache_.insert(nSource_, nFrame, nGopStart, rFrame);
+    oLock.lock();
+
+    if (nGeneration_ == nGeneration && nFrame >= nTarget_)
+    {
+        bTargetPassed_ = true;
+        oCond_.notify_all();
+    }
+}
+
+bool
+CachedFrameReader::read(unsigned long nFrame, std::vector<unsigned char> &rData, CachedFrameInfo &rInfo, int nTimeoutMs)
+{
+    std::lock_guard<std::mutex> oRead(oReadMutex_);
+
+    if (rCache_.lookup(nSource_, nFrame, rData, rInfo))
+        return true;
+
+    std::chrono::steady_clock::time_point oDeadline =
+        std::chrono::steady_clock::now() + std::chrono::milliseconds(nTimeoutMs);
+    std::unique_lock<std::mutex> oLock(oMutex_);
+
+    // Frame numbers need the first timestamp
+    while (llFirstTimestamp_ < 0)
+    {
+        if (oCond_.wait_until(oLock, oDeadline) == std::cv_status::timeout)
+            return false;
+    }
+
+    bool bDecodeOn = llPosition_ >= 0 && (unsigned long)llPosition_ <= nFrame &&
+                     nFrame - (unsigned long)llPosition_ <= cnMaxSkipFrames;
+
+    if (bDecodeOn)
+    {
+        nTarget_       = nFrame;
+        bTargetPassed_ = false;
+        bActive_       = true;
+        oCond_.notify_all();
+    }
+    else
+    {
+        long long llTimestamp = llFirstTimestamp_ + (long long)(nFrame * dFrameUs_ + 0.5);
+
+        // A held onFrame() has to return before the source can park
+        nGeneration_++;
+        bDropping_ = true;
+        oCond_.notify_all();
+        oLock.unlock();
+
+        bool bPaused = rDecoder_.pause();
+        if (bPaused)
+            rDecoder_.seek(llTimestamp);
+
+        oLock.lock();
+        bDropping_ = false;
+        if (!bPaused)
+            return false;
+
+        nTarget_       = nFrame;
+        bTargetPassed_ = false;
+        bActive_       = true;
+        bNewGop_       = true;
+        llPosition_    = -1;
+        nSeeks_++;
+        oLock.unlock();
+
+        rDecoder_.resume();
+        oLock.lock();
+    }
+
+    while (!bTargetPassed_ && !rCache_.contains(nSource_, nFrame))
+    {
+        // The end of the stream isn't signalled, poll for it
+        if (rDecoder_.atEnd())
+            break;
+
+        std::chrono::steady_clock::time_point oNow = std::chrono::steady_clock::now();
+        if (oNow >= oDeadline)
+            break;
+
+        std::chrono::steady_clock::time_point oPoll = oNow + std::chrono::milliseconds(10);
+        oCond_.wait_until(oLock, oPoll < oDeadline ? oPoll : oDeadline);
+    }
+    oLock.unlock();
+
+    return rCache_.lookup(nSource_, nFrame, rData, rInfo, false);
+}
+
+unsigned long
+CachedFrameReader::seeks()
+const
+{
+    return nSeeks_;
+}
@@ -0,0 +1,100 @@
+/*
+* File		: CachedFrameReader.h
+* Time : 2026 - 10 - 19
+*/
+
+#ifndef CACHEDFRAMEREADER_H
+#define CACHEDFRAMEREADER_H
+
+#include "cudaDecode.h"
+#include "FrameCache.h"
+#include "FrameSink.h"
+
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <vector>
+
+// Random access to the frames of a file source through a FrameCache.
+//  read() answers from the cache when it can. On a miss the source seeks
+// to the keyframe before the frame and decodes its GOP; every frame of
+// the GOP goes into the cache, and decoding stops at the next keyframe
+// until the next read(). A frame shortly after that point is reached by
+// decoding on instead of seeking, so stepping through a clip frame by
+// frame decodes each GOP once.
+//
+// Frames are numbered in display order from the first frame's timestamp
+// and the nominal frame rate (25 fps if the source doesn't report one).
+//
+// Create before cudaDecode::init() (the reader becomes the frame sink and
+// makes the source hold at the end of the stream) and destroy before
+// cudaDecode::uninit(). The first GOP is decoded right after init().
+class CachedFrameReader : public FrameSink
+{
+    public:
+        // Parameters:
+        //      rDecoder - decoder of the stream, must outlive the reader.
+        //      rCache - cache to consult and fill, may be shared by readers
+        //          with different nSource.
+        //      nSource - the stream's key in the cache.
+        CachedFrameReader(cudaDecode &rDecoder, FrameCache &rCache, unsigned int nSource);
+
+        virtual
+        ~CachedFrameReader();
+
+        // Copies frame nFrame into rData, tightly packed as described by rInfo.
+        // Returns:
+        //      false if the frame doesn't exist, couldn't be cached or
+        //      didn't arrive within nTimeoutMs.
+        bool
+        read(unsigned long nFrame, std::vector<unsigned char> &rData, CachedFrameInfo &rInfo, int nTimeoutMs = 5000);
+
+        // Seeks done to serve misses.
+        unsigned long
+        seeks()
+        const;
+
+        virtual
+        void
+        onFrame(const DecodedFrame &rFrame);
+
+        // Frames past the decode position still reached by decoding on.
+        static const unsigned long cnMaxSkipFrames = 250;
+
+    private:
+        // Copy constructor. Don't implement.
+        CachedFrameReader(const CachedFrameReader &);
+
+        // Assignment operator. Don't implement.
+        void
+        operator= (const CachedFrameReader &);
+
+        // Call with oMutex_ held, after the first frame.
+        unsigned long
+        frameNumber(long long llTimestamp)
+        const;
+
+        cudaDecode                 &rDecoder_;
+        FrameCache                 &rCache_;
+        unsigned int                nSource_;
+
+        // Serializes read()
+        std::mutex                  oReadMutex_;
+
+        std::mutex                  oMutex_;
+        std::condition_variable     oCond_;
+        long long                   llFirstTimestamp_;  // of frame 0, -1 before the first frame
+        double                      dFrameUs_;
+        bool                        bActive_;           // false holds the decode in onFrame()
+        bool                        bDropping_;         // a seek is being set up
+        bool                        bNewGop_;           // the next frame starts a GOP
+        bool                        bTargetPassed_;
+        unsigned long               nTarget_;
+        unsigned long               nGopStart_;
+        long long                   llPosition_;        // number of the last frame seen, -1 after a seek
+        unsigned long               nGeneration_;
+        bool                        bExit_;
+        std::atomic<unsigned long>  nSeeks_;
+};
+
+#endif // CACHEDFRAMEREADER_H
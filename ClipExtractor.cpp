@@ -0,0 +1,209 @@
+/*
+* File		: ClipExtractor.cpp
+* Time : 2026 - 10 - 19
+*/
+
+#include "ClipExtractor.h"
+
+#include <algorithm>
+#include <chrono>
+
+// Orders clip indices by start time.
+struct ClipBeginLess
+{
+    const std::vector<long long> &rBegins;
+
+    explicit
+    ClipBeginLess(const std::vector<long long> &rBeginTimes)
+        : rBegins(rBeginTimes)
+    {
+    }
+
+    bool
+    operator() (unsigned int nLeft, unsigned int nRight)
+    const
+    {
+        return rBegins[nLeft] < rBegins[nRight];
+    }
+};
+
+ClipExtractor::ClipExtractor(cudaDecode &rDecoder)
+    : rDecoder_(rDecoder)
+    , pSink_(0)
+    , llSpanEnd_(0)
+    , nSpanFrames_(0)
+    , bActive_(false)
+    , bSpanDone_(false)
+{
+    rDecoder_.setFrameSink(this);
+    rDecoder_.setHoldAtEnd(true);
+}
+
+ClipExtractor::~ClipExtractor()
+{
+    {
+        std::lock_guard<std::mutex> oLock(oMutex_);
+        bActive_ = false;
+    }
+    rDecoder_.pause();
+}
+
+unsigned int
+ClipExtractor::addClip(long long llBegin, long long llEnd)
+{
+    Clip oClip;
+    oClip.llBegin = llBegin;
+    oClip.llEnd   = llEnd;
+    oClip.nFrames = 0;
+    aClips_.push_back(oClip);
+
+    return (unsigned int)aClips_.size() - 1;
+}
+
+unsigned int
+ClipExtractor::addOffsetClip(double dBegin, double dEnd)
+{
+    long long llStart = rDecoder_.startTimestamp();
+
+    return addClip(llStart + (long long)(dBegin * 1e6), llStart + (long long)(dEnd * 1e6));
+}
+
+int
+ClipExtractor::addWallClockClip(long long llBeginUs, long long llEndUs)
+{
+    long long llCreation = rDecoder_.creationTime();
+
+    if (llCreation < 0)
+        return -1;
+
+    long long llStart = rDecoder_.startTimestamp();
+
+    return (int)addClip(llStart + (llBeginUs - llCreation), llStart + (llEndUs - llCreation));
+}
+
+void
+ClipExtractor::clear()
+{
+    aClips_.clear();
+}
+
+void
+ClipExtractor::onFrame(const DecodedFrame &rFrame)
+{
+    std::unique_lock<std::mutex> oLock(oMutex_);
+
+    if (!bActive_ || bSpanDone_)
+        return;
+    nSpanFrames_++;
+
+    // Display order: the first frame past the end closes the stretch
+    if (rFrame.llTimestamp >= llSpanEnd_)
+    {
+        bSpanDone_ = true;
+        oCond_.notify_all();
+        return;
+    }
+    oLock.unlock();
+
+    // run() leaves the stretch alone until the source is parked again
+    for (size_t i = 0; i < aSpanClips_.size(); i++)
+    {
+        Clip &rClip = aClips_[aSpanClips_[i]];
+
+        if (rFrame.llTimestamp >= rClip.llBegin && rFrame.llTimestamp < rClip.llEnd)
+        {
+            rClip.nFrames++;
+            pSink_->onClipFrame(aSpanClips_[i], rFrame);
+        }
+    }
+}
+
+bool
+ClipExtractor::run(ClipSink &rSink, int nTimeoutMs)
+{
+    std::vector<long long>    aBegins(aClips_.size());
+    std::vector<unsigned int> aOrder(aClips_.size());
+
+    for (size_t i = 0; i < aClips_.size(); i++)
+    {
+        aBegins[i] = aClips_[i].llBegin;
+        aOrder[i]  = (unsigned int)i;
+        aClips_[i].nFrames = 0;
+    }
+    std::sort(aOrder.begin(), aOrder.end(), ClipBeginLess(aBegins));
+
+    bool   bResult = true;
+    size_t nNext   = 0;
+
+    while (nNext < aOrder.size() && bResult)
+    {
+        // One stretch: every clip starting before the current end plus the gap
+        std::vector<unsigned int> aSpan(1, aOrder[nNext]);
+        long long llBegin = aClips_[aOrder[nNext]].llBegin;
+        long long llEnd   = aClips_[aOrder[nNext]].llEnd;
+
+        for (nNext++; nNext < aOrder.size() && aClips_[aOrder[nNext]].llBegin <= llEnd + cllMergeGapUs; nNext++)
+        {
+            aSpan.push_back(aOrder[nNext]);
+            llEnd = std::max(llEnd, aClips_[aOrder[nNext]].llEnd);
+        }
+
+        if (llEnd <= llBegin)
+        {
+            for (size_t i = 0; i < aSpan.size(); i++)
+                rSink.onClipEnd(aSpan[i], 0);
+            continue;
+        }
+
+        if (!rDecoder_.pause())
+            return false;
+        rDecoder_.setSkipBefore(llBegin);
+        rDecoder_.seek(llBegin);
+
+        {
+            std::lock_guard<std::mutex> oLock(oMutex_);
+            pSink_       = &rSink;
+            aSpanClips_  = aSpan;
+            llSpanEnd_   = llEnd;
+            nSpanFrames_ = 0;
+            bSpanDone_   = false;
+            bActive_     = true;
+        }
+        rDecoder_.resume();
+
+        std::chrono::steady_clock::time_point oDeadline =
+            std::chrono::steady_clock::now() + std::chrono::milliseconds(nTimeoutMs);
+        {
+            std::unique_lock<std::mutex> oLock(oMutex_);
+            unsigned long nSeen = 0;
+
+            // The end of the stream isn't signalled, poll for it. A long
+            // stretch is fine as long as frames keep coming
+            while (!bSpanDone_ && !rDecoder_.atEnd())
+            {
+                if (nSpanFrames_ != nSeen)
+                {
+                    nSeen     = nSpanFrames_;
+                    oDeadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(nTimeoutMs);
+                }
+                else if (std::chrono::steady_clock::now() >= oDeadline)
+                {
+                    printf("clip extraction: stretch %lld..%lld stalled\n", llBegin, llEnd);
+                    bResult = false;
+                    break;
+                }
+                oCond_.wait_for(oLock, std::chrono::milliseconds(10));
+            }
+            bActive_ = false;
+        }
+
+        // Parked, no onFrame() is still delivering
+        rDecoder_.pause();
+
+        for (size_t i = 0; i < aSpan.size(); i++)
+            rSink.onClipEnd(aSpan[i], aClips_[aSpan[i]].nFrames);
+    }
+
+    rDecoder_.setSkipBefore(-1);
+    return bResult;
+}
@@ -0,0 +1,119 @@
+/*
+* File		: ClipExtractor.h
+* Time : 2026 - 10 - 19
+*/
+
+#ifndef CLIPEXTRACTOR_H
+#define CLIPEXTRACTOR_H
+
+#include "cudaDecode.h"
+#include "FrameSink.h"
+
+#include <condition_variable>
+#include <mutex>
+#include <vector>
+
+// Receives the frames of the clips extracted by ClipExtractor::run().
+class ClipSink
+{
+    public:
+        virtual
+        ~ClipSink() {}
+
+        // A frame of clip nClip, on the decode thread. rFrame is valid as in
+        // FrameSink::onFrame(). A frame in overlapping clips comes once per clip.
+        virtual
+        void
+        onClipFrame(unsigned int nClip, const DecodedFrame &rFrame) = 0;
+
+        // Clip nClip is complete, nFrames frames were delivered for it.
+        // Called on the thread running run().
+        virtual
+        void
+        onClipEnd(unsigned int nClip, unsigned long nFrames) {}
+};
+
+// Extracts the frames of timestamp ranges from a file source.
+//  run() sorts the clips, merges those that overlap or lie close
+// together, and visits them in one forward pass: for each stretch it
+// seeks to the keyframe at or before its start, decodes from there with
+// the lead-in frames left out (cudaDecode::setSkipBefore(), so unneeded
+// non-reference pictures aren't even decoded) and stops at its end.
+// Exactly the frames with llBegin <= timestamp < llEnd are delivered.
+//
+// Create before cudaDecode::init() (the extractor becomes the frame sink
+// and makes the source hold at the end of the stream), add clips after
+// it and destroy the extractor before cudaDecode::uninit().
+class ClipExtractor : public FrameSink
+{
+    public:
+        explicit
+        ClipExtractor(cudaDecode &rDecoder);
+
+        virtual
+        ~ClipExtractor();
+
+        // Clip [llBegin, llEnd) in CUVID timestamps (microseconds for
+        // FFmpeg sources). Returns the clip's index.
+        unsigned int
+        addClip(long long llBegin, long long llEnd);
+
+        // Clip in seconds from the start of the recording.
+        unsigned int
+        addOffsetClip(double dBegin, double dEnd);
+
+        // Clip in wall-clock time, microseconds since the Unix epoch, placed
+        // with the recording's creation time.
+        // Returns:
+        //      the clip's index, -1 if the recording has no creation time.
+        int
+        addWallClockClip(long long llBeginUs, long long llEndUs);
+
+        // Forgets the clips added so far.
+        void
+        clear();
+
+        // Extracts every clip added. Returns false if the source can't seek
+        // or a stretch stalled, no frame decoded for nTimeoutMs; the clips
+        // done up to then have been delivered.
+        bool
+        run(ClipSink &rSink, int nTimeoutMs = 10000);
+
+        virtual
+        void
+        onFrame(const DecodedFrame &rFrame);
+
+        // Clips closer than this are decoded in one stretch instead of
+        // seeking in between. A fixed gap, not the stream's GOPs: clips in
+        // one GOP longer than this still seek and decode its start twice.
+        static const long long cllMergeGapUs = 2000000;
+
+    private:
+        struct Clip
+        {
+            long long       llBegin;
+            long long       llEnd;
+            unsigned long   nFrames;
+        };
+
+        // Copy constructor. Don't implement.
+        ClipExtractor(const ClipExtractor &);
+
+        // Assignment operator. Don't implement.
+        void
+        operator= (const ClipExtractor &);
+
+        cudaDecode                 &rDecoder_;
+        std::vector<Clip>           aClips_;
+
+        std::mutex                  oMutex_;
+        std::condition_variable     oCond_;
+        ClipSink                   *pSink_;
+        std::vector<unsigned int>   aSpanClips_;    // clips of the stretch being decoded
+        long long                   llSpanEnd_;
+        unsigned long               nSpanFrames_;   // decoded in the stretch, in clips or not
+        bool                        bActive_;       // frames are delivered
+        bool                        bSpanDone_;
+};
+
+#endif // CLIPEXTRACTOR_H
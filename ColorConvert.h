@@ -0,0 +1,59 @@
+/*
+* File		: ColorConvert.h
+* Time : 2026 - 10 - 19
+*/
+
+#ifndef COLORCONVERT_H
+#define COLORCONVERT_H
+
+#include <cuda.h>
+
+// Conversions for decoded surfaces.
+//  Decoded frames come out of cuvidMapVideoFrame as NV12 (8-bit) or P016
+// (10/12-bit content, MSB aligned in 16-bit samples): a luma plane of
+// nHeight rows followed by an interleaved UV plane of nHeight/2 rows, both
+// with the same pitch. Pitches are in bytes.
+
+// GPU: P016 -> NV12 by dropping the low byte of every sample.
+CUresult
+convertP016ToNV12(CUdeviceptr dpSrc, unsigned int nSrcPitch,
+                  CUdeviceptr dpDst, unsigned int nDstPitch,
+                  unsigned int nWidth, unsigned int nHeight, CUstream hStream = 0);
+
+// GPU: NV12 -> packed 8-bit BGR (BT.601, limited range).
+CUresult
+convertNV12ToBgr(CUdeviceptr dpSrc, unsigned int nSrcPitch,
+                 CUdeviceptr dpDst, unsigned int nDstPitch,
+                 unsigned int nWidth, unsigned int nHeight, CUstream hStream = 0);
+
+// GPU: P016 -> packed 8-bit BGR, converting at full precision before rounding.
+CUresult
+convertP016ToBgr(CUdeviceptr dpSrc, unsigned int nSrcPitch,
+                 CUdeviceptr dpDst, unsigned int nDstPitch,
+                 unsigned int nWidth, unsigned int nHeight, CUstream hStream = 0);
+
+// GPU: NV12 or P016 (bP016) -> planar float RGB, the usual network input:
+// three nDstWidth x nDstHeight planes (R, G, B) back to back, resized
+// bilinearly, every sample mapped to (v / 255 - afMean[c]) / afStd[c].
+CUresult
+convertYuvToPlanarRgb(CUdeviceptr dpSrc, unsigned int nSrcPitch,
+                      unsigned int nSrcWidth, unsigned int nSrcHeight, bool bP016,
+                      CUdeviceptr dpDst, unsigned int nDstWidth, unsigned int nDstHeight,
+                      const float afMean[3], const float afStd[3], CUstream hStream = 0);
+
+// CPU: P016 -> NV12 for frames that were read back to host memory.
+// Uses AVX2 when the CPU has it (see CpuFeatures.h), SSE2 when the
+// build targets it, scalar code otherwise.
+void
+convertP016ToNV12Host(const unsigned char *pSrc, unsigned int nSrcPitch,
+                      unsigned char *pDst, unsigned int nDstPitch,
+                      unsigned int nWidth, unsigned int nHeight);
+
+// CPU: P016 -> 16-bit planar I420-style planes (Y, U, V) with samples
+// shifted down to their native bit depth, e.g. for 10-bit Y4M output.
+void
+convertP016ToPlanarHost(const unsigned char *pSrc, unsigned int nSrcPitch,
+                        unsigned short *pY, unsigned short *pU, unsigned short *pV,
+                        unsigned int nWidth, unsigned int nHeight, unsigned int nBitDepth);
+
+#endif // COLORCONVERT_H
@@ -0,0 +1,135 @@
+/*
+* File		: ColorConvertCpu.cpp
+* Time : 2026 - 10 - 19
+*/
+
+#include "ColorConvert.h"
+#include "CpuFeatures.h"
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define COLORCONVERT_SSE2 1
+#endif
+
+#if defined(CPUFEATURES_AVX2)
+static const bool cbAvx2 = cpuHasAvx2();
+
+// AVX2 part of p016RowToNV12(). Returns the samples done, a multiple of 32.
+CPUFEATURES_AVX2_TARGET
+static unsigned int
+p016RowToNV12Avx2(const unsigned short *pSrc, unsigned char *pDst, unsigned int nSamples)
+{
+    unsigned int i = 0;
+
+    for (; i + 32 <= nSamples; i += 32)
+    {
+        __m256i a = _mm256_srli_epi16(_mm256_loadu_si256((const __m256i *)(pSrc + i)), 8);
+        __m256i b = _mm256_srli_epi16(_mm256_loadu_si256((const __m256i *)(pSrc + i + 16)), 8);
+        // packus works per 128-bit lane, the permute restores sample order
+        __m256i p = _mm256_permute4x64_epi64(_mm256_packus_epi16(a, b), 0xd8);
+        _mm256_storeu_si256((__m256i *)(pDst + i), p);
+    }
+
+    return i;
+}
+#endif
+
+// High byte of each 16-bit sample of one row.
+static void
+p016RowToNV12(const unsigned short *pSrc, unsigned char *pDst, unsigned int nSamples)
+{
+    unsigned int i = 0;
+
+#if defined(CPUFEATURES_AVX2)
+    if (cbAvx2)
+        i = p016RowToNV12Avx2(pSrc, pDst, nSamples);
+#endif
+#if defined(COLORCONVERT_SSE2)
+    for (; i + 16 <= nSamples; i += 16)
+    {
+        __m128i a = _mm_srli_epi16(_mm_loadu_si128((const __m128i *)(pSrc + i)), 8);
+        __m128i b = _mm_srli_epi16(_mm_loadu_si128((const __m128i *)(pSrc + i + 8)), 8);
+        _mm_storeu_si128((__m128i *)(pDst + i), _mm_packus_epi16(a, b));
+    }
+#endif
+    for (; i < nSamples; i++)
+    {
+        pDst[i] = (unsigned char)(pSrc[i] >> 8);
+    }
+}
+
+void
+convertP016ToNV12Host(const unsigned char *pSrc, unsigned int nSrcPitch,
+                      unsigned char *pDst, unsigned int nDstPitch,
+                      unsigned int nWidth, unsigned int nHeight)
+{
+    // Luma rows then interleaved chroma rows, both nWidth samples wide
+    unsigned int nRows = nHeight + (nHeight + 1) / 2;
+
+    for (unsigned int y = 0; y < nRows; y++)
+    {
+        p016RowToNV12((const unsigned short *)(pSrc + y * nSrcPitch), pDst + y * nDstPitch, nWidth);
+    }
+}
+
+void
+convertP016ToPlanarHost(const unsigned char *pSrc, unsigned int nSrcPitch,
+                        unsigned short *pY, unsigned short *pU, unsigned short *pV,
+                        unsigned int nWidth, unsigned int nHeight, unsigned int nBitDepth)
+{
+    int nShift = 16 - (int)nBitDepth;
+
+    for (unsigned int y = 0; y < nHeight; y++)
+    {
+        const unsigned short *pRow = (const unsigned short *)(pSrc + y * nSrcPitch);
+        unsigned short *pOut = pY + y * nWidth;
+        unsigned int x = 0;
+
+#if defined(COLORCONVERT_SSE2)
+        __m128i oShift = _mm_cvtsi32_si128(nShift);
+
+        for (; x + 8 <= nWidth; x += 8)
+        {
+            __m128i s = _mm_loadu_si128((const __m128i *)(pRow + x));
+            _mm_storeu_si128((__m128i *)(pOut + x), _mm_srl_epi16(s, oShift));
+        }
+#endif
+        for (; x < nWidth; x++)
+        {
+            pOut[x] = pRow[x] >> nShift;
+        }
+    }
+
+    unsigned int nChromaWidth  = (nWidth + 1) / 2;
+    unsigned int nChromaHeight = (nHeight + 1) / 2;
+
+    for (unsigned int y = 0; y < nChromaHeight; y++)
+    {
+        const unsigned short *pRow = (const unsigned short *)(pSrc + (nHeight + y) * nSrcPitch);
+        unsigned short *pOutU = pU + y * nChromaWidth;
+        unsigned short *pOutV = pV + y * nChromaWidth;
+        unsigned int x = 0;
+
+#if defined(COLORCONVERT_SSE2)
+        __m128i oShift = _mm_cvtsi32_si128(nShift);
+        __m128i oLow   = _mm_set1_epi32(0xffff);
+
+        // packs saturates signed, fine as long as something was shifted out
+        for (; nShift > 0 && x + 8 <= nChromaWidth; x += 8)
+        {
+            // UVUV... -> shift, then split even/odd 16-bit lanes
+            __m128i a = _mm_srl_epi16(_mm_loadu_si128((const __m128i *)(pRow + 2 * x)), oShift);
+            __m128i b = _mm_srl_epi16(_mm_loadu_si128((const __m128i *)(pRow + 2 * x + 8)), oShift);
+            __m128i u = _mm_packs_epi32(_mm_and_si128(a, oLow), _mm_and_si128(b, oLow));
+            __m128i v = _mm_packs_epi32(_mm_srli_epi32(a, 16), _mm_srli_epi32(b, 16));
+            _mm_storeu_si128((__m128i *)(pOutU + x), u);
+            _mm_storeu_si128((__m128i *)(pOutV + x), v);
+        }
+#endif
+        for (; x < nChromaWidth; x++)
+        {
+            pOutU[x] = pRow[2 * x] >> nShift;
+            pOutV[x] = pRow[2 * x + 1] >> nShift;
+        }
+    }
+}
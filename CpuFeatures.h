@@ -0,0 +1,57 @@
+/*
+* File		: CpuFeatures.h
+* Time : 2026 - 10 - 19
+*/
+
+#ifndef CPUFEATURES_H
+#define CPUFEATURES_H
+
+// Runtime dispatch for the AVX2 paths of the host-side SIMD code.
+//  The shipped builds only assume SSE2 (no -mavx2 or /arch:AVX2), so the
+// AVX2 loops are compiled per function, CPUFEATURES_AVX2_TARGET, and only
+// run when cpuHasAvx2() says the CPU and the OS support them.
+// CPUFEATURES_AVX2 is defined where that is possible (x86 with GCC, clang
+// or MSVC, whose intrinsics need no compiler switch).
+#if defined(_MSC_VER) && (defined(_M_X64) || defined(_M_IX86))
+#include <intrin.h>
+#include <immintrin.h>
+#define CPUFEATURES_AVX2 1
+#define CPUFEATURES_AVX2_TARGET
+#elif (defined(__GNUC__) || defined(__clang__)) && (defined(__x86_64__) || defined(__i386__))
+#include <immintrin.h>
+#define CPUFEATURES_AVX2 1
+#define CPUFEATURES_AVX2_TARGET __attribute__((target("avx2")))
+#endif
+
+// True if AVX2 code may run: the CPU has it and the OS saves the YMM
+// registers.
+inline bool
+cpuHasAvx2()
+{
+#if defined(CPUFEATURES_AVX2) && defined(_MSC_VER)
+    int aInfo[4];
+
+    __cpuid(aInfo, 0);
+    if (aInfo[0] < 7)
+        return false;
+
+    // OSXSAVE and AVX, then the OS enabled XMM and YMM state
+    __cpuid(aInfo, 1);
+    if ((aInfo[2] & (1 << 27)) == 0 || (aInfo[2] & (1 << 28)) == 0)
+        return false;
+    if ((_xgetbv(0) & 6) != 6)
+        return false;
+
+    __cpuidex(aInfo, 7, 0);
+    return (aInfo[1] & (1 << 5)) != 0;
+#elif defined(CPUFEATURES_AVX2)
+    // Checks the OS support as well. The init makes it safe from static
+    // initializers, which may run before libgcc's own
+    __builtin_cpu_init();
+    return __builtin_cpu_supports("avx2") != 0;
+#else
+    return false;
+#endif
+}
+
+#endif // CPUFEATURES_H
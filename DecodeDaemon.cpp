@@ -0,0 +1,451 @@
+/*
+* File		: DecodeDaemon.cpp
+* Time : 2026 - 10 - 19
+*/
+
+#include "DecodeDaemon.h"
+#include "cudaDecode.h"
+#include "SharedFrameRing.h"
+
+#include <chrono>
+#include <sstream>
+#include <stdio.h>
+#include <string.h>
+
+#if defined(__linux__)
+#include <errno.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+#endif
+
+// One decoded stream and the clients sharing it.
+struct DecodeDaemon::Session : public FrameSink
+{
+    std::string                         sKey;
+    std::string                         sUrl;
+    std::string                         sRing;
+    unsigned int                        nWidth;
+    unsigned int                        nHeight;
+    size_t                              nSlotBytes;
+    cudaDecode                          oDecoder;
+    std::atomic<SharedFrameWriter *>    pWriter;        // 0 until the ring exists
+    std::atomic<int>                    eState;         // SessionState
+    bool                                bAnnounced;     // clients were told the outcome
+    std::set<int>                       aClients;       // attached, or waiting for the open
+    std::thread                         oOpener;
+
+    Session()
+        : nWidth(0)
+        , nHeight(0)
+        , nSlotBytes(0)
+        , pWriter(0)
+        , eState(Session_Opening)
+        , bAnnounced(false)
+    {
+    }
+
+    // Decode thread; frames before the ring exists are dropped
+    virtual
+    void
+    onFrame(const DecodedFrame &rFrame)
+    {
+        SharedFrameWriter *pRing = pWriter.load();
+        if (pRing)
+            pRing->onFrame(rFrame);
+    }
+};
+
+DecodeDaemon::DecodeDaemon(const std::string &sSocketPath, int nGpu, unsigned int nSlots)
+    : sSocketPath_(sSocketPath)
+    , nGpu_(nGpu)
+    , nSlots_(nSlots > 1 ? nSlots : 2)
+    , bExit_(false)
+    , nNextRing_(0)
+    , pTeardowns_(std::make_shared<Teardowns>())
+{
+}
+
+DecodeDaemon::~DecodeDaemon()
+{
+    stop();
+    while (!aClients_.empty())
+        dropClient(aClients_.begin()->first);
+    while (!aSessions_.empty())
+        closeSession(aSessions_.begin()->second);
+    waitTeardowns(10000);
+}
+
+void
+DecodeDaemon::stop()
+{
+    bExit_ = true;
+}
+
+bool
+DecodeDaemon::run()
+{
+#if defined(__linux__)
+    int nListen = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (nListen < 0)
+    {
+        printf("decode daemon: socket() failed (%d)\n", errno);
+        return false;
+    }
+
+    struct sockaddr_un oAddress;
+    memset(&oAddress, 0, sizeof(oAddress));
+    oAddress.sun_family = AF_UNIX;
+    if (sSocketPath_.size() >= sizeof(oAddress.sun_path))
+    {
+        printf("decode daemon: socket path too long\n");
+        close(nListen);
+        return false;
+    }
+    strcpy(oAddress.sun_path, sSocketPath_.c_str());
+
+    // Left behind by an earlier instance
+    unlink(sSocketPath_.c_str());
+    if (bind(nListen, (struct sockaddr *)&oAddress, sizeof(oAddress)) != 0 || listen(nListen, 16) != 0)
+    {
+        printf("decode daemon: can't listen on %s (%d)\n", sSocketPath_.c_str(), errno);
+        close(nListen);
+        return false;
+    }
+    printf("decode daemon: listening on %s\n", sSocketPath_.c_str());
+
+    while (!bExit_)
+    {
+        std::vector<struct pollfd> aPoll(1);
+        aPoll[0].fd     = nListen;
+        aPoll[0].events = POLLIN;
+        for (std::map<int, Client>::const_iterator it = aClients_.begin(); it != aClients_.end(); ++it)
+        {
+            struct pollfd oPoll;
+            oPoll.fd      = it->first;
+            oPoll.events  = POLLIN;
+            oPoll.revents = 0;
+            aPoll.push_back(oPoll);
+        }
+
+        // The timeout paces pollSessions() and the exit check
+        if (poll(&aPoll[0], aPoll.size(), 200) < 0 && errno != EINTR)
+            break;
+
+        if (aPoll[0].revents & POLLIN)
+        {
+            int nSocket = accept(nListen, NULL, NULL);
+            if (nSocket >= 0)
+            {
+                Client oClient;
+                oClient.nSocket = nSocket;
+                aClients_[nSocket] = oClient;
+            }
+        }
+
+        for (size_t i = 1; i < aPoll.size(); i++)
+        {
+            if (!aPoll[i].revents)
+                continue;
+
+            char aBuffer[4096];
+            ssize_t nRead = recv(aPoll[i].fd, aBuffer, sizeof(aBuffer), 0);
+            if (nRead <= 0)
+            {
+                dropClient(aPoll[i].fd);
+                continue;
+            }
+
+            Client &rClient = aClients_[aPoll[i].fd];
+            rClient.sInput.append(aBuffer, (size_t)nRead);
+
+            size_t nEnd;
+            while ((nEnd = rClient.sInput.find('\n')) != std::string::npos)
+            {
+                std::string sLine = rClient.sInput.substr(0, nEnd);
+                rClient.sInput.erase(0, nEnd + 1);
+                if (!sLine.empty() && sLine[sLine.size() - 1] == '\r')
+                    sLine.erase(sLine.size() - 1);
+                handleLine(rClient, sLine);
+            }
+            if (rClient.sInput.size() > 65536)
+            {
+                send(rClient.nSocket, "ERR line too long");
+                dropClient(rClient.nSocket);
+            }
+        }
+
+        pollSessions();
+    }
+
+    close(nListen);
+    unlink(sSocketPath_.c_str());
+    while (!aClients_.empty())
+        dropClient(aClients_.begin()->first);
+    while (!aSessions_.empty())
+        closeSession(aSessions_.begin()->second);
+    waitTeardowns(10000);
+    return true;
+#else
+    printf("decode daemon: needs Linux\n");
+    return false;
+#endif
+}
+
+void
+DecodeDaemon::handleLine(Client &rClient, const std::string &sLine)
+{
+    std::istringstream oLine(sLine);
+    std::string sCommand;
+
+    oLine >> sCommand;
+    if (sCommand == "OPEN")
+    {
+        unsigned int nWidth = 0, nHeight = 0;
+        std::string sUrl;
+
+        size_t nBegin = std::string::npos;
+
+        if (oLine >> nWidth >> nHeight && std::getline(oLine, sUrl))
+            nBegin = sUrl.find_first_not_of(" \t");
+        if (nBegin == std::string::npos)
+        {
+            send(rClient.nSocket, "ERR usage: OPEN <width> <height> <url>");
+            return;
+        }
+        openStream(rClient, sUrl.substr(nBegin), nWidth, nHeight);
+    }
+    else if (sCommand == "CLOSE")
+    {
+        std::string sRing;
+        oLine >> sRing;
+
+        for (std::set<Session *>::iterator it = rClient.aSessions.begin(); it != rClient.aSessions.end(); ++it)
+        {
+            if ((*it)->sRing == sRing)
+            {
+                detach(rClient, *it);
+                return;
+            }
+        }
+        send(rClient.nSocket, "ERR no such ring");
+    }
+    else if (!sCommand.empty())
+    {
+        send(rClient.nSocket, "ERR unknown command");
+    }
+}
+
+void
+DecodeDaemon::openStream(Client &rClient, const std::string &sUrl, unsigned int nWidth, unsigned int nHeight)
+{
+    std::ostringstream oKey;
+    oKey << nWidth << 'x' << nHeight << ' ' << sUrl;
+
+    std::map<std::string, Session *>::iterator it = aSessions_.find(oKey.str());
+    // A session that just failed is joined too, its clients get the error
+    if (it != aSessions_.end())
+    {
+        Session *pSession = it->second;
+
+        if (rClient.aSessions.insert(pSession).second)
+            pSession->aClients.insert(rClient.nSocket);
+
+        // Still opening: answered with the others by pollSessions()
+        if (pSession->bAnnounced)
+        {
+            std::ostringstream oReply;
+            oReply << "OK " << pSession->sRing << ' ' << nSlots_ << ' ' << pSession->nSlotBytes;
+            send(rClient.nSocket, oReply.str());
+        }
+        printf("decode daemon: %s shared by %lu clients\n", sUrl.c_str(), (unsigned long)pSession->aClients.size());
+        return;
+    }
+
+    Session *pSession = new Session;
+    std::ostringstream oRing;
+#if defined(__linux__)
+    oRing << "/cudadecode-" << getpid() << '-' << nNextRing_++;
+#else
+    oRing << "/cudadecode-" << nNextRing_++;
+#endif
+    pSession->sKey    = oKey.str();
+    pSession->sUrl    = sUrl;
+    pSession->sRing   = oRing.str();
+    pSession->nWidth  = nWidth;
+    pSession->nHeight = nHeight;
+    pSession->aClients.insert(rClient.nSocket);
+    rClient.aSessions.insert(pSession);
+
+    aSessions_[pSession->sKey] = pSession;
+
+    pSession->oOpener = std::thread(&DecodeDaemon::openSession, this, pSession);
+}
+
+void
+DecodeDaemon::openSession(Session *pSession)
+{
+    std::vector<char> aUrl(pSession->sUrl.begin(), pSession->sUrl.end());
+    aUrl.push_back('\0');
+
+    pSession->oDecoder.setFrameSink(pSession);
+    pSession->oDecoder.setOutputSize(pSession->nWidth, pSession->nHeight);
+
+    bool bResult = pSession->oDecoder.init(&aUrl[0], nGpu_);
+    if (bResult)
+    {
+        pSession->nSlotBytes = SharedFrameWriter::slotBytesFor(pSession->oDecoder.get_frame_w(),
+                                                               pSession->oDecoder.get_frame_h(),
+                                                               pSession->oDecoder.bitDepth());
+
+        SharedFrameWriter *pRing = new SharedFrameWriter(pSession->sRing, nSlots_, pSession->nSlotBytes);
+        if (pRing->isValid())
+        {
+            pSession->pWriter = pRing;
+        }
+        else
+        {
+            delete pRing;
+            bResult = false;
+        }
+    }
+
+    pSession->eState = bResult ? Session_Running : Session_Failed;
+}
+
+void
+DecodeDaemon::pollSessions()
+{
+    std::vector<Session *> aClosing;
+
+    for (std::map<std::string, Session *>::iterator it = aSessions_.begin(); it != aSessions_.end(); ++it)
+    {
+        Session *pSession = it->second;
+        int eState = pSession->eState;
+
+        if (eState == Session_Opening)
+            continue;
+
+        if (!pSession->bAnnounced)
+        {
+            pSession->oOpener.join();
+            pSession->bAnnounced = true;
+
+            std::ostringstream oReply;
+            if (eState == Session_Running)
+                oReply << "OK " << pSession->sRing << ' ' << nSlots_ << ' ' << pSession->nSlotBytes;
+            else
+                oReply << "ERR can't open " << pSession->sUrl;
+            for (std::set<int>::const_iterator client = pSession->aClients.begin();
+                 client != pSession->aClients.end(); ++client)
+                send(*client, oReply.str());
+
+            if (eState == Session_Running)
+                printf("decode daemon: %s on %s\n", pSession->sUrl.c_str(), pSession->sRing.c_str());
+        }
+
+        if (eState == Session_Failed || pSession->aClients.empty())
+        {
+            aClosing.push_back(pSession);
+        }
+        else if (pSession->oDecoder.check_decode_end())
+        {
+            for (std::set<int>::const_iterator client = pSession->aClients.begin();
+                 client != pSession->aClients.end(); ++client)
+                send(*client, "END " + pSession->sRing);
+            aClosing.push_back(pSession);
+        }
+    }
+
+    for (size_t i = 0; i < aClosing.size(); i++)
+        closeSession(aClosing[i]);
+}
+
+void
+DecodeDaemon::detach(Client &rClient, Session *pSession)
+{
+    rClient.aSessions.erase(pSession);
+    pSession->aClients.erase(rClient.nSocket);
+
+    // A session still opening is torn down once its opener is done
+    if (pSession->aClients.empty())
+        closeSession(pSession);
+}
+
+void
+DecodeDaemon::closeSession(Session *pSession)
+{
+    aSessions_.erase(pSession->sKey);
+    for (std::map<int, Client>::iterator client = aClients_.begin(); client != aClients_.end(); ++client)
+        client->second.aSessions.erase(pSession);
+
+    // An open that hangs, or a slow uninit(), must not stall the poll loop
+    {
+        std::lock_guard<std::mutex> oLock(pTeardowns_->oMutex);
+        pTeardowns_->nRunning++;
+    }
+    std::thread(&DecodeDaemon::teardownSession, pSession, pTeardowns_).detach();
+}
+
+void
+DecodeDaemon::teardownSession(Session *pSession, std::shared_ptr<Teardowns> pTeardowns)
+{
+    if (pSession->oOpener.joinable())
+        pSession->oOpener.join();
+
+    // Decoder first: no frame may arrive at the ring being destroyed
+    pSession->oDecoder.uninit();
+    delete pSession->pWriter.load();
+    printf("decode daemon: closed %s\n", pSession->sRing.c_str());
+    delete pSession;
+
+    std::lock_guard<std::mutex> oLock(pTeardowns->oMutex);
+    pTeardowns->nRunning--;
+    pTeardowns->oDone.notify_all();
+}
+
+void
+DecodeDaemon::waitTeardowns(int nTimeoutMs)
+{
+    std::unique_lock<std::mutex> oLock(pTeardowns_->oMutex);
+
+    std::chrono::steady_clock::time_point oDeadline =
+        std::chrono::steady_clock::now() + std::chrono::milliseconds(nTimeoutMs);
+    while (pTeardowns_->nRunning > 0)
+    {
+        if (pTeardowns_->oDone.wait_until(oLock, oDeadline) == std::cv_status::timeout)
+        {
+            printf("decode daemon: %u streams still closing, not waiting for them\n", pTeardowns_->nRunning);
+            return;
+        }
+    }
+}
+
+void
+DecodeDaemon::dropClient(int nSocket)
+{
+    std::map<int, Client>::iterator it = aClients_.find(nSocket);
+    if (it == aClients_.end())
+        return;
+
+    std::set<Session *> aSessions = it->second.aSessions;
+    for (std::set<Session *>::iterator session = aSessions.begin(); session != aSessions.end(); ++session)
+        detach(it->second, *session);
+
+#if defined(__linux__)
+    close(nSocket);
+#endif
+    aClients_.erase(it);
+}
+
+void
+DecodeDaemon::send(int nSocket, const std::string &sLine)
+{
+#if defined(__linux__)
+    std::string sMessage = sLine + "\n";
+
+    // A client that went away is noticed by poll(); no SIGPIPE meanwhile
+    ::send(nSocket, sMessage.data(), sMessage.size(), MSG_NOSIGNAL);
+#endif
+}
@@ -0,0 +1,151 @@
+/*
+* File		: DecodeDaemon.h
+* Time : 2026 - 10 - 19
+*/
+
+#ifndef DECODEDAEMON_H
+#define DECODEDAEMON_H
+
+#include <atomic>
+#include <condition_variable>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <set>
+#include <string>
+#include <thread>
+#include <vector>
+
+class cudaDecode;
+class SharedFrameWriter;
+
+// Decode service for the processes of one machine.
+//  Clients connect to a Unix domain socket and send text lines:
+//
+//      OPEN <width> <height> <url>     width/height 0 0 for the coded size
+//      CLOSE <ring>
+//
+// and get back
+//
+//      OK <ring> <slots> <slot bytes>  frames are published in shared-memory
+//                                      ring <ring>, read it with SharedFrameReader
+//      ERR <reason>
+//      END <ring>                      the stream finished or failed
+//
+// Identical requests (same url and size) share one decode: the first one
+// opens the stream, later ones get the same ring. A stream is closed when
+// its last client closes it or disconnects. Frames are NV12, P016 for
+// high bit depth content (see the slot header).
+//
+// Streams are opened and closed on their own threads, so a slow network
+// source or decoder teardown doesn't hold up the other clients. Linux only.
+class DecodeDaemon
+{
+    public:
+        // Parameters:
+        //      sSocketPath - filesystem path of the socket, replaced if it exists.
+        //      nGpu - device the decoders are created on.
+        //      nSlots - ring slots per stream.
+        DecodeDaemon(const std::string &sSocketPath, int nGpu = 0, unsigned int nSlots = 8);
+
+        // Stops serving and closes every stream. Waits a while for the
+        // streams to be torn down, not for one that hangs.
+        ~DecodeDaemon();
+
+        // Serves until stop(). Returns false if the socket can't be set up.
+        bool
+        run();
+
+        // Makes run() return; callable from any thread.
+        void
+        stop();
+
+    private:
+        enum SessionState
+        {
+            Session_Opening = 0,
+            Session_Running,
+            Session_Failed
+        };
+
+        struct Session;
+
+        // Count of teardown threads; shared with them, as one that hangs
+        // may outlive the daemon
+        struct Teardowns
+        {
+            std::mutex                  oMutex;
+            std::condition_variable     oDone;
+            unsigned int                nRunning;
+
+            Teardowns()
+                : nRunning(0)
+            {
+            }
+        };
+
+        struct Client
+        {
+            int                     nSocket;
+            std::string             sInput;     // partial line
+            std::set<Session *>     aSessions;
+        };
+
+        // Copy constructor. Don't implement.
+        DecodeDaemon(const DecodeDaemon &);
+
+        // Assignment operator. Don't implement.
+        void
+        operator= (const DecodeDaemon &);
+
+        void
+        handleLine(Client &rClient, const std::string &sLine);
+
+        void
+        openStream(Client &rClient, const std::string &sUrl, unsigned int nWidth, unsigned int nHeight);
+
+        // Opener thread: initializes the decoder and creates the ring.
+        void
+        openSession(Session *pSession);
+
+        // Answers the clients of sessions whose opener finished, ends
+        // the streams that stopped.
+        void
+        pollSessions();
+
+        void
+        detach(Client &rClient, Session *pSession);
+
+        // Forgets the session and tears it down on its own thread.
+        void
+        closeSession(Session *pSession);
+
+        // Teardown thread: waits for the opener, stops the decoder and
+        // removes the ring.
+        static
+        void
+        teardownSession(Session *pSession, std::shared_ptr<Teardowns> pTeardowns);
+
+        // Waits at most nTimeoutMs for the teardowns started so far.
+        void
+        waitTeardowns(int nTimeoutMs);
+
+        void
+        dropClient(int nSocket);
+
+        static
+        void
+        send(int nSocket, const std::string &sLine);
+
+        std::string                         sSocketPath_;
+        int                                 nGpu_;
+        unsigned int                        nSlots_;
+        std::atomic<bool>                   bExit_;
+        unsigned int                        nNextRing_;
+
+        std::map<int, Client>               aClients_;          // by socket
+        std::map<std::string, Session *>    aSessions_;         // by request key
+        std::shared_ptr<Teardowns>          pTeardowns_;
+};
+
+#endif // DECODEDAEMON_H
@@ -0,0 +1,384 @@
+/*
+* File		: DecodeScheduler.cpp
+* Time : 2026 - 10 - 19
+*/
+
+#include "DecodeScheduler.h"
+#include "DecodeStats.h"
+
+#include <chrono>
+
+FakeDecodeBackend::FakeDecodeBackend(long long llFrameUs, long long llKeyFrameUs)
+    : nDecoded_(0)
+    , nDiscontinuities_(0)
+{
+    oDefault_.llFrameUs    = llFrameUs;
+    oDefault_.llKeyFrameUs = llKeyFrameUs;
+}
+
+void
+FakeDecodeBackend::setCost(int nStream, long long llFrameUs, long long llKeyFrameUs)
+{
+    if (nStream < 0)
+        return;
+
+    std::lock_guard<std::mutex> oLock(oMutex_);
+    if ((size_t)nStream >= aCosts_.size())
+    {
+        aCosts_.resize(nStream + 1, oDefault_);
+        aHasCost_.resize(nStream + 1, false);
+    }
+    aCosts_[nStream].llFrameUs    = llFrameUs;
+    aCosts_[nStream].llKeyFrameUs = llKeyFrameUs;
+    aHasCost_[nStream] = true;
+}
+
+void
+FakeDecodeBackend::decode(unsigned int nWorker, const DecodeJob &rJob)
+{
+    Cost oCost = oDefault_;
+    {
+        std::lock_guard<std::mutex> oLock(oMutex_);
+        if (rJob.nStream >= 0 && (size_t)rJob.nStream < aCosts_.size() && aHasCost_[rJob.nStream])
+            oCost = aCosts_[rJob.nStream];
+    }
+
+    std::this_thread::sleep_for(std::chrono::microseconds(rJob.bKeyFrame ? oCost.llKeyFrameUs : oCost.llFrameUs));
+    nDecoded_++;
+}
+
+void
+FakeDecodeBackend::discontinuity(int nStream)
+{
+    nDiscontinuities_++;
+}
+
+unsigned long
+FakeDecodeBackend::decoded()
+const
+{
+    return nDecoded_;
+}
+
+unsigned long
+FakeDecodeBackend::discontinuities()
+const
+{
+    return nDiscontinuities_;
+}
+
+DecodeScheduler::DecodeScheduler(DecodeBackend &rBackend, unsigned int nWorkers, unsigned int nMaxQueued)
+    : rBackend_(rBackend)
+    , nMaxQueued_(nMaxQueued > 0 ? nMaxQueued : 1)
+    , nQueued_(0)
+    , nRunning_(0)
+    , bExit_(false)
+{
+    if (nWorkers == 0)
+        nWorkers = 1;
+
+    for (unsigned int i = 0; i < nWorkers; i++)
+        aWorkers_.push_back(std::thread(&DecodeScheduler::workerLoop, this, i));
+}
+
+DecodeScheduler::~DecodeScheduler()
+{
+    {
+        std::lock_guard<std::mutex> oLock(oMutex_);
+        bExit_ = true;
+    }
+    oWork_.notify_all();
+
+    for (size_t i = 0; i < aWorkers_.size(); i++)
+        aWorkers_[i].join();
+}
+
+int
+DecodeScheduler::addStream(const ScheduledStreamParams &rParams)
+{
+    std::lock_guard<std::mutex> oLock(oMutex_);
+
+    Stream oStream;
+    oStream.oParams    = rParams;
+    oStream.bRunning   = false;
+    oStream.bSkipToKey = false;
+    oStream.bResync    = false;
+    oStream.dServedUs  = 0;
+    oStream.dCostUs    = 0;
+
+    if (oStream.oParams.nWeight == 0)
+        oStream.oParams.nWeight = 1;
+    if (oStream.oParams.nMaxQueued == 0)
+        oStream.oParams.nMaxQueued = 1;
+
+    // Start level with the class's least served stream, not at zero: a
+    // newcomer would otherwise have the sessions to itself until it
+    // caught up with streams that ran for hours
+    bool bFirst = true;
+    double dShare = 0;
+    for (size_t i = 0; i < aStreams_.size(); i++)
+    {
+        const Stream &rOther = aStreams_[i];
+        if (rOther.oParams.eClass != rParams.eClass)
+            continue;
+        if (bFirst || rOther.dServedUs / rOther.oParams.nWeight < dShare)
+            dShare = rOther.dServedUs / rOther.oParams.nWeight;
+        bFirst = false;
+    }
+    oStream.dServedUs = dShare * oStream.oParams.nWeight;
+
+    aStreams_.push_back(oStream);
+    return (int)aStreams_.size() - 1;
+}
+
+bool
+DecodeScheduler::submit(int nStream, DecodeJob &rJob)
+{
+    long long llNowUs = steadyClockUs();
+
+    std::lock_guard<std::mutex> oLock(oMutex_);
+
+    if (nStream < 0 || (size_t)nStream >= aStreams_.size())
+        return false;
+
+    Stream &rStream = aStreams_[nStream];
+    DecodeSchedulerStats &rStats = aStats_[rStream.oParams.eClass];
+
+    rStats.nSubmitted++;
+    rJob.nStream = nStream;
+    if (rJob.llArrivalUs == 0)
+        rJob.llArrivalUs = llNowUs;
+    rJob.llDeadlineUs = rStream.oParams.llBudgetUs > 0 ? rJob.llArrivalUs + rStream.oParams.llBudgetUs : -1;
+
+    // Fallen too far behind on its own
+    if (rStream.aJobs.size() >= rStream.oParams.nMaxQueued)
+        shed(nStream);
+
+    if (rStream.bSkipToKey)
+    {
+        if (!rJob.bKeyFrame)
+        {
+            rStats.nShed++;
+            return false;
+        }
+        rStream.bSkipToKey = false;
+    }
+
+    if (nQueued_ >= nMaxQueued_ && !shedForRoom(nStream))
+    {
+        // The frames after the dropped one reference it, so the stream
+        // restarts at its next keyframe submitted, not at one queued
+        // before the gap: the whole queue goes, and the resync is
+        // announced right before that keyframe
+        rStats.nShed += (unsigned long)rStream.aJobs.size() + 1;
+        nQueued_ -= (unsigned int)rStream.aJobs.size();
+        rStream.aJobs.clear();
+        rStream.bSkipToKey = true;
+        rStream.bResync    = true;
+        oIdle_.notify_all();
+        return false;
+    }
+
+    rStream.aJobs.push_back(DecodeJob());
+    rStream.aJobs.back().aData.swap(rJob.aData);
+    rStream.aJobs.back().nStream      = rJob.nStream;
+    rStream.aJobs.back().llTimestamp  = rJob.llTimestamp;
+    rStream.aJobs.back().llArrivalUs  = rJob.llArrivalUs;
+    rStream.aJobs.back().llDeadlineUs = rJob.llDeadlineUs;
+    rStream.aJobs.back().bKeyFrame    = rJob.bKeyFrame;
+    nQueued_++;
+
+    oWork_.notify_one();
+    return true;
+}
+
+void
+DecodeScheduler::drain()
+{
+    std::unique_lock<std::mutex> oLock(oMutex_);
+    while (nQueued_ > 0 || nRunning_ > 0)
+        oIdle_.wait(oLock);
+}
+
+unsigned int
+DecodeScheduler::queued(int nStream)
+{
+    std::lock_guard<std::mutex> oLock(oMutex_);
+
+    if (nStream < 0 || (size_t)nStream >= aStreams_.size())
+        return 0;
+    return (unsigned int)aStreams_[nStream].aJobs.size();
+}
+
+const DecodeSchedulerStats &
+DecodeScheduler::stats(PriorityClass eClass)
+const
+{
+    return aStats_[eClass < PriorityClass_Count ? eClass : PriorityClass_Archive];
+}
+
+void
+DecodeScheduler::shed(int nStream)
+{
+    Stream &rStream = aStreams_[nStream];
+    DecodeSchedulerStats &rStats = aStats_[rStream.oParams.eClass];
+    unsigned long nDropped = 0;
+
+    // The head goes in any case, then everything up to a keyframe the
+    // stream can restart from
+    if (!rStream.aJobs.empty())
+    {
+        rStream.aJobs.pop_front();
+        nDropped++;
+    }
+    while (!rStream.aJobs.empty() && !rStream.aJobs.front().bKeyFrame)
+    {
+        rStream.aJobs.pop_front();
+        nDropped++;
+    }
+
+    rStats.nShed += nDropped;
+    nQueued_ -= nDropped;
+    rStream.bSkipToKey = rStream.aJobs.empty();
+    rStream.bResync    = true;
+
+    oIdle_.notify_all();
+}
+
+bool
+DecodeScheduler::shedForRoom(int nIncoming)
+{
+    PriorityClass eIncoming = aStreams_[nIncoming].oParams.eClass;
+
+    while (nQueued_ >= nMaxQueued_)
+    {
+        // Least urgent class first, the longest backlog within it
+        int nVictim = -1;
+        for (size_t i = 0; i < aStreams_.size(); i++)
+        {
+            const Stream &rStream = aStreams_[i];
+            if (rStream.aJobs.empty())
+                continue;
+            if (nVictim < 0 ||
+                rStream.oParams.eClass > aStreams_[nVictim].oParams.eClass ||
+                (rStream.oParams.eClass == aStreams_[nVictim].oParams.eClass &&
+                 rStream.aJobs.size() > aStreams_[nVictim].aJobs.size()))
+                nVictim = (int)i;
+        }
+
+        if (nVictim < 0 || nVictim == nIncoming || aStreams_[nVictim].oParams.eClass < eIncoming)
+            return false;
+        shed(nVictim);
+    }
+    return true;
+}
+
+int
+DecodeScheduler::pickStream(long long llNowUs)
+{
+    for (unsigned int eClass = 0; eClass < PriorityClass_Count; eClass++)
+    {
+        int nBest = -1;
+
+        for (size_t i = 0; i < aStreams_.size(); i++)
+        {
+            Stream &rStream = aStreams_[i];
+            if (rStream.oParams.eClass != eClass || rStream.bRunning)
+                continue;
+
+            // Late work only delays the frames behind it
+            while (rStream.oParams.bDropLate && !rStream.aJobs.empty() &&
+                   rStream.aJobs.front().llDeadlineUs >= 0 &&
+                   llNowUs + (long long)rStream.dCostUs > rStream.aJobs.front().llDeadlineUs)
+                shed((int)i);
+
+            if (rStream.aJobs.empty())
+                continue;
+            if (nBest < 0)
+            {
+                nBest = (int)i;
+                continue;
+            }
+
+            // Deadlines first, earliest first; then the smallest weighted share
+            const Stream &rBest = aStreams_[nBest];
+            long long llDeadline     = rStream.aJobs.front().llDeadlineUs;
+            long long llBestDeadline = rBest.aJobs.front().llDeadlineUs;
+
+            if (llDeadline >= 0 && llBestDeadline >= 0)
+            {
+                if (llDeadline < llBestDeadline)
+                    nBest = (int)i;
+            }
+            else if (llDeadline >= 0)
+            {
+                nBest = (int)i;
+            }
+            else if (llBestDeadline < 0 &&
+                     rStream.dServedUs / rStream.oParams.nWeight < rBest.dServedUs / rBest.oParams.nWeight)
+            {
+                nBest = (int)i;
+            }
+        }
+
+        if (nBest >= 0)
+            return nBest;
+    }
+    return -1;
+}
+
+void
+DecodeScheduler::workerLoop(unsigned int nWorker)
+{
+    std::unique_lock<std::mutex> oLock(oMutex_);
+
+    for (;;)
+    {
+        int nStream = -1;
+        while (!bExit_ && (nStream = pickStream(steadyClockUs())) < 0)
+            oWork_.wait(oLock);
+        if (bExit_)
+            return;
+
+        Stream &rStream = aStreams_[nStream];
+        DecodeJob oJob;
+        oJob.aData.swap(rStream.aJobs.front().aData);
+        oJob.nStream      = rStream.aJobs.front().nStream;
+        oJob.llTimestamp  = rStream.aJobs.front().llTimestamp;
+        oJob.llArrivalUs  = rStream.aJobs.front().llArrivalUs;
+        oJob.llDeadlineUs = rStream.aJobs.front().llDeadlineUs;
+        oJob.bKeyFrame    = rStream.aJobs.front().bKeyFrame;
+        rStream.aJobs.pop_front();
+        nQueued_--;
+
+        bool bResync = rStream.bResync;
+        rStream.bResync  = false;
+        rStream.bRunning = true;
+        nRunning_++;
+
+        oLock.unlock();
+        if (bResync)
+            rBackend_.discontinuity(nStream);
+        long long llStartUs = steadyClockUs();
+        rBackend_.decode(nWorker, oJob);
+        long long llEndUs = steadyClockUs();
+        oLock.lock();
+
+        double dCostUs = (double)(llEndUs - llStartUs);
+        rStream.dServedUs += dCostUs;
+        rStream.dCostUs    = rStream.dCostUs > 0 ? rStream.dCostUs * 0.9 + dCostUs * 0.1 : dCostUs;
+        rStream.bRunning   = false;
+        nRunning_--;
+
+        DecodeSchedulerStats &rStats = aStats_[rStream.oParams.eClass];
+        unsigned long long llWaitUs = llStartUs > oJob.llArrivalUs ? llStartUs - oJob.llArrivalUs : 0;
+        rStats.nDecoded++;
+        rStats.llWaitUs += llWaitUs;
+        if (llWaitUs > rStats.llMaxWaitUs)
+            rStats.llMaxWaitUs = llWaitUs;
+        if (oJob.llDeadlineUs >= 0 && llEndUs > oJob.llDeadlineUs)
+            rStats.nLate++;
+
+        oIdle_.notify_all();
+    }
+}
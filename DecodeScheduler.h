@@ -0,0 +1,264 @@
+/*
+* File		: DecodeScheduler.h
+* Time : 2026 - 10 - 19
+*/
+
+#ifndef DECODESCHEDULER_H
+#define DECODESCHEDULER_H
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Priority classes, most urgent first. A class only gets a decoder
+// session when no stream of a more urgent class has work, and load is
+// shed from the least urgent class first.
+enum PriorityClass
+{
+    PriorityClass_Alarm = 0,    // cameras whose events someone acts on
+    PriorityClass_Live,         // live viewing and analytics
+    PriorityClass_Archive,      // background jobs, no deadline
+    PriorityClass_Count
+};
+
+struct ScheduledStreamParams
+{
+    PriorityClass   eClass;
+    long long       llBudgetUs;     // arrival to decoded, the job's deadline; 0 for none
+    unsigned int    nWeight;        // share among the class's streams without a deadline
+    unsigned int    nMaxQueued;     // a stream further behind sheds its backlog
+    bool            bDropLate;      // shed work that can't make its deadline any more
+
+    ScheduledStreamParams()
+        : eClass(PriorityClass_Live)
+        , llBudgetUs(200000)
+        , nWeight(1)
+        , nMaxQueued(32)
+        , bDropLate(true)
+    {
+    }
+};
+
+// One access unit of one stream, waiting for a decoder session.
+struct DecodeJob
+{
+    int                         nStream;        // set by submit()
+    std::vector<unsigned char>  aData;          // owned copy; empty for simulated work
+    long long                   llTimestamp;
+    long long                   llArrivalUs;    // steadyClockUs(), set by submit() if 0
+    long long                   llDeadlineUs;   // set by submit(), -1 for none
+    bool                        bKeyFrame;      // decoding can restart here
+
+    DecodeJob()
+        : nStream(-1)
+        , llTimestamp(0)
+        , llArrivalUs(0)
+        , llDeadlineUs(-1)
+        , bKeyFrame(false)
+    {
+    }
+};
+
+// The decode (and post-process) stage the scheduler feeds.
+//  decode() runs on the scheduler's workers, one per decoder session.
+// Jobs of a stream never overlap and come in submission order, minus
+// the ones shed; after shedding the stream restarts at a keyframe, which
+// discontinuity() announces first.
+class DecodeBackend
+{
+    public:
+        virtual
+        ~DecodeBackend() {}
+
+        virtual
+        void
+        decode(unsigned int nWorker, const DecodeJob &rJob) = 0;
+
+        // Work of nStream was dropped; reset what depends on the
+        // previous pictures (parser, reference frames).
+        virtual
+        void
+        discontinuity(int nStream) {}
+};
+
+// Backend for simulating a load without GPUs: every job takes a
+// configured time on its worker and nothing else.
+class FakeDecodeBackend : public DecodeBackend
+{
+    public:
+        // Parameters:
+        //      llFrameUs, llKeyFrameUs - default cost of a job.
+        FakeDecodeBackend(long long llFrameUs = 4000, long long llKeyFrameUs = 10000);
+
+        // Cost of the jobs of one stream, e.g. 4K next to CIF.
+        void
+        setCost(int nStream, long long llFrameUs, long long llKeyFrameUs);
+
+        virtual
+        void
+        decode(unsigned int nWorker, const DecodeJob &rJob);
+
+        virtual
+        void
+        discontinuity(int nStream);
+
+        // Jobs run and restarts, all streams.
+        unsigned long
+        decoded()
+        const;
+
+        unsigned long
+        discontinuities()
+        const;
+
+    private:
+        struct Cost
+        {
+            long long llFrameUs;
+            long long llKeyFrameUs;
+        };
+
+        // Copy constructor. Don't implement.
+        FakeDecodeBackend(const FakeDecodeBackend &);
+
+        // Assignment operator. Don't implement.
+        void
+        operator= (const FakeDecodeBackend &);
+
+        Cost                        oDefault_;
+        std::mutex                  oMutex_;
+        std::vector<Cost>           aCosts_;        // by stream, set ones only
+        std::vector<bool>           aHasCost_;
+        std::atomic<unsigned long>  nDecoded_;
+        std::atomic<unsigned long>  nDiscontinuities_;
+};
+
+// Counters of one priority class; safe to read from any thread.
+struct DecodeSchedulerStats
+{
+    std::atomic<unsigned long>      nSubmitted;
+    std::atomic<unsigned long>      nDecoded;
+    std::atomic<unsigned long>      nLate;          // decoded after the deadline
+    std::atomic<unsigned long>      nShed;          // dropped: overload, lag or deadline
+    std::atomic<unsigned long long> llWaitUs;       // queueing time of the decoded jobs, summed
+    std::atomic<unsigned long long> llMaxWaitUs;
+
+    DecodeSchedulerStats()
+        : nSubmitted(0), nDecoded(0), nLate(0), nShed(0), llWaitUs(0), llMaxWaitUs(0)
+    {
+    }
+
+  private:
+    // Copy constructor. Don't implement.
+    DecodeSchedulerStats(const DecodeSchedulerStats &);
+
+    // Assignment operator. Don't implement.
+    void
+    operator= (const DecodeSchedulerStats &);
+};
+
+// Decides which stream's work a free decoder session takes next.
+//  Sits between demux threads, which submit(), and a fixed set of worker
+// threads, one per decoder session, which run the backend. Each stream
+// has a FIFO and at most one job in a session at a time. A free session
+// takes the most urgent class with work; within it, the stream whose
+// next job has the earliest deadline, then the deadline-free streams in
+// proportion to their weights (least decode time per weight first).
+//
+// Work is only ever dropped at GOP granularity: a stream that sheds
+// loses its queued jobs and everything up to its next keyframe. It
+// sheds when
+//  - the scheduler holds more than nMaxQueued jobs: the stream of the
+//    least urgent class with the longest backlog goes first, the new
+//    job's own stream if that is the least urgent one;
+//  - the stream alone holds more than its nMaxQueued;
+//  - with bDropLate, its next job can no longer finish by its deadline
+//    at the stream's measured decode cost.
+class DecodeScheduler
+{
+    public:
+        // Parameters:
+        //      nWorkers - decoder sessions, one thread each.
+        //      nMaxQueued - jobs queued over all streams.
+        DecodeScheduler(DecodeBackend &rBackend, unsigned int nWorkers, unsigned int nMaxQueued = 256);
+
+        // Stops the workers once their current jobs finish; what is still
+        // queued is dropped.
+        ~DecodeScheduler();
+
+        // Returns the stream's id, counted from 0. Safe while jobs run.
+        int
+        addStream(const ScheduledStreamParams &rParams);
+
+        // Queues a job of nStream, taking over its data. Returns false if
+        // it was shed right away.
+        bool
+        submit(int nStream, DecodeJob &rJob);
+
+        // Blocks until every job submitted so far is decoded or shed.
+        void
+        drain();
+
+        // Jobs of nStream waiting for a session.
+        unsigned int
+        queued(int nStream);
+
+        const DecodeSchedulerStats &
+        stats(PriorityClass eClass)
+        const;
+
+    private:
+        struct Stream
+        {
+            ScheduledStreamParams   oParams;
+            std::deque<DecodeJob>   aJobs;
+            bool                    bRunning;       // a job is in a session
+            bool                    bSkipToKey;     // shed: drop jobs until a keyframe
+            bool                    bResync;        // tell the backend before the next job
+            double                  dServedUs;      // decode time so far, for the weighted share
+            double                  dCostUs;        // moving average of a job's decode time
+        };
+
+        // Copy constructor. Don't implement.
+        DecodeScheduler(const DecodeScheduler &);
+
+        // Assignment operator. Don't implement.
+        void
+        operator= (const DecodeScheduler &);
+
+        void
+        workerLoop(unsigned int nWorker);
+
+        // Picks the stream whose head job runs next, sheds late heads on
+        // the way. Returns -1 if no stream can run. Mutex held.
+        int
+        pickStream(long long llNowUs);
+
+        // Drops the queue of nStream and skips it to its next keyframe.
+        // Mutex held.
+        void
+        shed(int nStream);
+
+        // Frees room when the scheduler is over nMaxQueued. Mutex held.
+        // Returns false if the job of nIncoming should be dropped instead.
+        bool
+        shedForRoom(int nIncoming);
+
+        DecodeBackend                  &rBackend_;
+        unsigned int                    nMaxQueued_;
+        DecodeSchedulerStats            aStats_[PriorityClass_Count];
+
+        std::mutex                      oMutex_;
+        std::condition_variable         oWork_;         // a job was queued, or exit
+        std::condition_variable         oIdle_;         // a job finished or was shed
+        std::deque<Stream>              aStreams_;      // deque: stable addresses while streams are added
+        unsigned int                    nQueued_;
+        unsigned int                    nRunning_;
+        bool                            bExit_;
+        std::vector<std::thread>        aWorkers_;
+};
+
+#endif // DECODESCHEDULER_H
@@ -0,0 +1,62 @@
+/*
+* File		: DecodeStats.h
+* Time : 2026 - 10 - 19
+*/
+
+#ifndef DECODESTATS_H
+#define DECODESTATS_H
+
+#include <atomic>
+#include <chrono>
+
+// Monotonic microseconds, the clock used for latency measurements.
+inline
+long long
+steadyClockUs()
+{
+    return std::chrono::duration_cast<std::chrono::microseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+// Failure and recovery counters of one stream.
+//  Written from the demux/decode thread, safe to read from anywhere.
+struct DecodeStats
+{
+    std::atomic<unsigned long> nCreateErrors;     // cuvidCreateDecoder / cuvidCreateVideoParser
+    std::atomic<unsigned long> nDecodeErrors;     // cuvidDecodePicture
+    std::atomic<unsigned long> nMapErrors;        // cuvidMapVideoFrame
+    std::atomic<unsigned long> nUnmapErrors;      // cuvidUnmapVideoFrame
+    std::atomic<unsigned long> nParseErrors;      // cuvidParseVideoData
+    std::atomic<unsigned long> nDemuxErrors;      // av_read_frame / bitstream filter
+    std::atomic<unsigned long> nFormatChanges;    // sequence header with a different format
+    std::atomic<unsigned long> nRecoveries;       // parser flushed and resynced
+    std::atomic<unsigned long> nDecoderResets;    // decoder destroyed and recreated
+    std::atomic<unsigned long> nPacketsDropped;   // skipped while waiting for a keyframe
+    std::atomic<unsigned long> nPacketsSkipped;   // not decoded by choice (keyframe-only mode)
+    std::atomic<unsigned long> nDecodesSkipped;   // non-reference pictures left undecoded by decimation
+    std::atomic<unsigned long> nFramesDecimated;  // displayed pictures not mapped or output
+    std::atomic<unsigned long> nLossEvents;       // bitstream loss detected (gap, corrupt packet, decode error)
+    std::atomic<unsigned long> nCorruptFrames;    // frames delivered with DecodedFrame_Corrupt
+    std::atomic<unsigned long> nLatencySamples;   // frames whose packet arrival time was known
+    std::atomic<long long>     llLatencySumUs;    // packet arrival to frame available, summed
+    std::atomic<long long>     llLatencyMaxUs;
+
+    DecodeStats()
+        : nCreateErrors(0), nDecodeErrors(0), nMapErrors(0), nUnmapErrors(0)
+        , nParseErrors(0), nDemuxErrors(0), nFormatChanges(0), nRecoveries(0)
+        , nDecoderResets(0), nPacketsDropped(0), nPacketsSkipped(0), nDecodesSkipped(0), nFramesDecimated(0)
+        , nLossEvents(0), nCorruptFrames(0)
+        , nLatencySamples(0), llLatencySumUs(0), llLatencyMaxUs(0)
+    {
+    }
+
+  private:
+    // Copy constructor. Don't implement.
+    DecodeStats(const DecodeStats &);
+
+    // Assignment operator. Don't implement.
+    void
+    operator= (const DecodeStats &);
+};
+
+#endif // DECODESTATS_H
@@ -0,0 +1,215 @@
+/*
+* File		: DecoderCapacity.cpp
+* Time : 2026 - 10 - 19
+*/
+
+#include "DecoderCapacity.h"
+
+#include <stdio.h>
+#include <string.h>
+
+// Key for the per-combination maps: codec, chroma format and bit depth packed together.
+static unsigned int
+capsKey(cudaVideoCodec eCodec, cudaVideoChromaFormat eChromaFormat, unsigned int nBitDepthMinus8)
+{
+    return ((unsigned int)eCodec << 16) | ((unsigned int)eChromaFormat << 8) | (nBitDepthMinus8 & 0xff);
+}
+
+CuvidDecoderCapsSource::CuvidDecoderCapsSource(int nDeviceID, double dDefaultMBPerSecond)
+    : oDevice_(0)
+    , oContext_(0)
+    , dDefaultMBPerSecond_(dDefaultMBPerSecond)
+{
+    cuInit(0);
+
+    if (cuDeviceGet(&oDevice_, nDeviceID) != CUDA_SUCCESS ||
+        cuDevicePrimaryCtxRetain(&oContext_, oDevice_) != CUDA_SUCCESS)
+    {
+        printf("CuvidDecoderCapsSource: can't open device %d\n", nDeviceID);
+        oContext_ = 0;
+    }
+}
+
+CuvidDecoderCapsSource::~CuvidDecoderCapsSource()
+{
+    if (oContext_)
+    {
+        cuDevicePrimaryCtxRelease(oDevice_);
+    }
+}
+
+void
+CuvidDecoderCapsSource::setThroughput(cudaVideoCodec eCodec, unsigned int nBitDepthMinus8, double dMBPerSecond)
+{
+    std::lock_guard<std::mutex> oLock(oMutex_);
+
+    // Throughput doesn't depend on chroma format, key it on 4:2:0
+    oThroughput_[capsKey(eCodec, cudaVideoChromaFormat_420, nBitDepthMinus8)] = dMBPerSecond;
+    oCache_.clear();
+}
+
+bool
+CuvidDecoderCapsSource::queryCaps(cudaVideoCodec eCodec, cudaVideoChromaFormat eChromaFormat,
+                                  unsigned int nBitDepthMinus8, DecoderCaps &rCaps)
+{
+    std::lock_guard<std::mutex> oLock(oMutex_);
+
+    unsigned int nKey = capsKey(eCodec, eChromaFormat, nBitDepthMinus8);
+    std::map<unsigned int, DecoderCaps>::const_iterator it = oCache_.find(nKey);
+
+    if (it != oCache_.end())
+    {
+        rCaps = it->second;
+        return true;
+    }
+
+    if (!oContext_)
+        return false;
+
+    CUVIDDECODECAPS oDecodeCaps;
+    memset(&oDecodeCaps, 0, sizeof(CUVIDDECODECAPS));
+    oDecodeCaps.eCodecType      = eCodec;
+    oDecodeCaps.eChromaFormat   = eChromaFormat;
+    oDecodeCaps.nBitDepthMinus8 = nBitDepthMinus8;
+
+    cuCtxPushCurrent(oContext_);
+    CUresult oResult = cuvidGetDecoderCaps(&oDecodeCaps);
+    cuCtxPopCurrent(NULL);
+
+    if (oResult != CUDA_SUCCESS)
+    {
+        printf("cuvidGetDecoderCaps failed: %d\n", oResult);
+        return false;
+    }
+
+    rCaps.bSupported  = oDecodeCaps.bIsSupported != 0;
+    rCaps.nMinWidth   = oDecodeCaps.nMinWidth;
+    rCaps.nMinHeight  = oDecodeCaps.nMinHeight;
+    rCaps.nMaxWidth   = oDecodeCaps.nMaxWidth;
+    rCaps.nMaxHeight  = oDecodeCaps.nMaxHeight;
+    rCaps.nMaxMBCount = oDecodeCaps.nMaxMBCount;
+
+    std::map<unsigned int, double>::const_iterator itRate =
+        oThroughput_.find(capsKey(eCodec, cudaVideoChromaFormat_420, nBitDepthMinus8));
+    rCaps.dMaxMBPerSecond = itRate != oThroughput_.end() ? itRate->second : dDefaultMBPerSecond_;
+
+    oCache_[nKey] = rCaps;
+    return true;
+}
+
+void
+TableDecoderCapsSource::addCaps(cudaVideoCodec eCodec, cudaVideoChromaFormat eChromaFormat,
+                                unsigned int nBitDepthMinus8, const DecoderCaps &rCaps)
+{
+    oTable_[capsKey(eCodec, eChromaFormat, nBitDepthMinus8)] = rCaps;
+}
+
+bool
+TableDecoderCapsSource::queryCaps(cudaVideoCodec eCodec, cudaVideoChromaFormat eChromaFormat,
+                                  unsigned int nBitDepthMinus8, DecoderCaps &rCaps)
+{
+    std::map<unsigned int, DecoderCaps>::const_iterator it =
+        oTable_.find(capsKey(eCodec, eChromaFormat, nBitDepthMinus8));
+
+    if (it == oTable_.end())
+        return false;
+
+    rCaps = it->second;
+    return true;
+}
+
+DecoderCapacityPlanner::DecoderCapacityPlanner(DecoderCapsSource *pCapsSource, double dHeadroom, bool bCpuFallback)
+    : pCapsSource_(pCapsSource)
+    , dHeadroom_(dHeadroom)
+    , bCpuFallback_(bCpuFallback)
+    , dLoad_(0)
+{
+}
+
+double
+DecoderCapacityPlanner::estimateLoad(const CUVIDEOFORMAT &rFormat)
+{
+    DecoderCaps oCaps;
+
+    if (!pCapsSource_->queryCaps(rFormat.codec, rFormat.chroma_format, rFormat.bit_depth_luma_minus8, oCaps) ||
+        !oCaps.bSupported || oCaps.dMaxMBPerSecond <= 0)
+    {
+        return -1;
+    }
+
+    if (rFormat.coded_width  < oCaps.nMinWidth  || rFormat.coded_width  > oCaps.nMaxWidth ||
+        rFormat.coded_height < oCaps.nMinHeight || rFormat.coded_height > oCaps.nMaxHeight)
+    {
+        return -1;
+    }
+
+    double dMBCount = (double)((rFormat.coded_width + 15) / 16) * ((rFormat.coded_height + 15) / 16);
+
+    if (oCaps.nMaxMBCount && dMBCount > oCaps.nMaxMBCount)
+        return -1;
+
+    // Sources that don't report a frame rate are charged as 30fps
+    double dFrameRate = rFormat.frame_rate.denominator ?
+                        (double)rFormat.frame_rate.numerator / rFormat.frame_rate.denominator : 30.0;
+
+    return dMBCount * dFrameRate / oCaps.dMaxMBPerSecond;
+}
+
+AdmissionDecision
+DecoderCapacityPlanner::reject()
+const
+{
+    return bCpuFallback_ ? Admission_CPU : Admission_Refused;
+}
+
+AdmissionDecision
+DecoderCapacityPlanner::admit(int nStreamID, const CUVIDEOFORMAT &rFormat)
+{
+    double dStreamLoad = estimateLoad(rFormat);
+
+    std::lock_guard<std::mutex> oLock(oMutex_);
+
+    if (dStreamLoad < 0)
+    {
+        printf("DecoderCapacityPlanner: stream %d format not supported by the decoder\n", nStreamID);
+        return reject();
+    }
+
+    // A stream admitted again (format change) gives back its old charge first
+    std::map<int, double>::const_iterator it = oStreams_.find(nStreamID);
+    double dOthers = it != oStreams_.end() ? dLoad_ - it->second : dLoad_;
+
+    if (dOthers + dStreamLoad > dHeadroom_)
+    {
+        printf("DecoderCapacityPlanner: stream %d needs %.3f, only %.3f left\n",
+               nStreamID, dStreamLoad, dHeadroom_ - dOthers);
+        return reject();
+    }
+
+    oStreams_[nStreamID] = dStreamLoad;
+    dLoad_ = dOthers + dStreamLoad;
+
+    return Admission_GPU;
+}
+
+void
+DecoderCapacityPlanner::release(int nStreamID)
+{
+    std::lock_guard<std::mutex> oLock(oMutex_);
+
+    std::map<int, double>::iterator it = oStreams_.find(nStreamID);
+
+    if (it == oStreams_.end())
+        return;
+
+    dLoad_ -= it->second;
+    oStreams_.erase(it);
+}
+
+double
+DecoderCapacityPlanner::load()
+{
+    std::lock_guard<std::mutex> oLock(oMutex_);
+
+    return dLoad_;
+}
@@ -0,0 +1,158 @@
+/*
+* File		: DecoderCapacity.h
+* Time : 2026 - 10 - 19
+*/
+
+#ifndef DECODERCAPACITY_H
+#define DECODERCAPACITY_H
+
+#include <cuda.h>
+#include <nvcuvid.h>
+
+#include <map>
+#include <mutex>
+
+// What the hardware decoder can do for one codec/chroma/bit-depth combination.
+struct DecoderCaps
+{
+    bool         bSupported;
+    unsigned int nMinWidth;
+    unsigned int nMinHeight;
+    unsigned int nMaxWidth;
+    unsigned int nMaxHeight;
+    unsigned int nMaxMBCount;       // macroblocks per frame
+    double       dMaxMBPerSecond;   // sustained macroblock throughput of the engine
+};
+
+// Source of decoder capabilities for DecoderCapacityPlanner.
+//  CuvidDecoderCapsSource asks the driver, TableDecoderCapsSource answers
+// from a canned table (configuration files, tests).
+class DecoderCapsSource
+{
+    public:
+        virtual
+        ~DecoderCapsSource() {}
+
+        // Returns false if nothing is known about the combination.
+        virtual
+        bool
+        queryCaps(cudaVideoCodec eCodec, cudaVideoChromaFormat eChromaFormat,
+                  unsigned int nBitDepthMinus8, DecoderCaps &rCaps) = 0;
+};
+
+// DecoderCapsSource backed by cuvidGetDecoderCaps().
+//  Results are cached per combination. The driver reports size limits
+// only, the macroblock rate comes from setThroughput() (or the default).
+class CuvidDecoderCapsSource : public DecoderCapsSource
+{
+    public:
+        // Parameters:
+        //      nDeviceID - GPU whose decoder is queried.
+        //      dDefaultMBPerSecond - throughput assumed for codecs without
+        //          an explicit setThroughput(); the default is 1080p at
+        //          about 500fps.
+        explicit
+        CuvidDecoderCapsSource(int nDeviceID, double dDefaultMBPerSecond = 8160.0 * 500.0);
+
+        ~CuvidDecoderCapsSource();
+
+        void
+        setThroughput(cudaVideoCodec eCodec, unsigned int nBitDepthMinus8, double dMBPerSecond);
+
+        bool
+        queryCaps(cudaVideoCodec eCodec, cudaVideoChromaFormat eChromaFormat,
+                  unsigned int nBitDepthMinus8, DecoderCaps &rCaps);
+
+    private:
+        // Copy constructor. Don't implement.
+        CuvidDecoderCapsSource(const CuvidDecoderCapsSource &);
+
+        // Assignment operator. Don't implement.
+        void
+        operator= (const CuvidDecoderCapsSource &);
+
+        CUdevice                        oDevice_;
+        CUcontext                       oContext_;
+        double                          dDefaultMBPerSecond_;
+        std::map<unsigned int, double>  oThroughput_;
+        std::map<unsigned int, DecoderCaps> oCache_;
+        std::mutex                      oMutex_;
+};
+
+// DecoderCapsSource answering from a fixed table.
+class TableDecoderCapsSource : public DecoderCapsSource
+{
+    public:
+        void
+        addCaps(cudaVideoCodec eCodec, cudaVideoChromaFormat eChromaFormat,
+                unsigned int nBitDepthMinus8, const DecoderCaps &rCaps);
+
+        bool
+        queryCaps(cudaVideoCodec eCodec, cudaVideoChromaFormat eChromaFormat,
+                  unsigned int nBitDepthMinus8, DecoderCaps &rCaps);
+
+    private:
+        std::map<unsigned int, DecoderCaps> oTable_;
+};
+
+enum AdmissionDecision
+{
+    Admission_GPU = 0,      // decode on the hardware decoder
+    Admission_CPU,          // hardware can't take it, hand it to the CPU backend
+    Admission_Refused       // nobody can take it
+};
+
+// Admission control for one GPU's decode engine.
+//  Every admitted stream is charged (macroblocks per frame * fps) divided
+// by the engine's macroblock rate for its codec. A stream is sent to the
+// CPU backend (or refused, if the planner has no CPU fallback) when the
+// decoder can't handle its format at all or when admitting it would push
+// the summed load past the headroom.
+class DecoderCapacityPlanner
+{
+    public:
+        // Parameters:
+        //      pCapsSource - capability source, must outlive the planner.
+        //      dHeadroom - fraction of the engine the planner hands out.
+        //      bCpuFallback - redirect to CPU instead of refusing.
+        explicit
+        DecoderCapacityPlanner(DecoderCapsSource *pCapsSource, double dHeadroom = 0.9, bool bCpuFallback = true);
+
+        // Decides where stream nStreamID goes. GPU admissions are charged
+        // until release() is called.
+        AdmissionDecision
+        admit(int nStreamID, const CUVIDEOFORMAT &rFormat);
+
+        void
+        release(int nStreamID);
+
+        // Fraction of the engine currently committed.
+        double
+        load();
+
+        // Engine fraction a stream of this format would take, or a
+        // negative value if the decoder can't handle the format.
+        double
+        estimateLoad(const CUVIDEOFORMAT &rFormat);
+
+    private:
+        // Copy constructor. Don't implement.
+        DecoderCapacityPlanner(const DecoderCapacityPlanner &);
+
+        // Assignment operator. Don't implement.
+        void
+        operator= (const DecoderCapacityPlanner &);
+
+        AdmissionDecision
+        reject()
+        const;
+
+        DecoderCapsSource      *pCapsSource_;
+        double                  dHeadroom_;
+        bool                    bCpuFallback_;
+        double                  dLoad_;
+        std::map<int, double>   oStreams_;
+        std::mutex              oMutex_;
+};
+
+#endif // DECODERCAPACITY_H
@@ -0,0 +1,369 @@
+/*
+* File		: DevicePlacement.cpp
+* Time : 2026 - 10 - 19
+*/
+
+#include "DevicePlacement.h"
+
+#include "FrameQueue.h"
+#include "VideoDecoder.h"
+
+#include <stdio.h>
+#include <algorithm>
+
+CudaDeviceCapability::CudaDeviceCapability(double dDecodeCapacity)
+    : dDecodeCapacity_(dDecodeCapacity)
+{
+    int nDevices = 0;
+
+    cuInit(0);
+
+    if (cuDeviceGetCount(&nDevices) != CUDA_SUCCESS)
+    {
+        nDevices = 0;
+    }
+
+    aPrimaryContexts_.assign(nDevices, (CUcontext)0);
+}
+
+CudaDeviceCapability::~CudaDeviceCapability()
+{
+    for (size_t i = 0; i < aPrimaryContexts_.size(); i++)
+    {
+        if (aPrimaryContexts_[i])
+        {
+            CUdevice oDevice;
+            cuDeviceGet(&oDevice, (int)i);
+            cuDevicePrimaryCtxRelease(oDevice);
+        }
+    }
+}
+
+int
+CudaDeviceCapability::deviceCount()
+{
+    return (int)aPrimaryContexts_.size();
+}
+
+bool
+CudaDeviceCapability::queryDevice(int nDevice, DeviceStatus &rStatus)
+{
+    if (nDevice < 0 || nDevice >= deviceCount())
+        return false;
+
+    CUdevice oDevice;
+
+    if (cuDeviceGet(&oDevice, nDevice) != CUDA_SUCCESS)
+        return false;
+
+    size_t nTotalMem = 0;
+    size_t nFreeMem  = 0;
+
+    if (cuDeviceTotalMem(&nTotalMem, oDevice) != CUDA_SUCCESS)
+        return false;
+
+    if (!aPrimaryContexts_[nDevice] &&
+        cuDevicePrimaryCtxRetain(&aPrimaryContexts_[nDevice], oDevice) != CUDA_SUCCESS)
+    {
+        aPrimaryContexts_[nDevice] = 0;
+        return false;
+    }
+
+    if (cuCtxPushCurrent(aPrimaryContexts_[nDevice]) != CUDA_SUCCESS)
+        return false;
+
+    CUresult oResult = cuMemGetInfo(&nFreeMem, &nTotalMem);
+    cuCtxPopCurrent(NULL);
+
+    if (oResult != CUDA_SUCCESS)
+        return false;
+
+    double dCapacity = dDecodeCapacity_;
+
+    if (dCapacity <= 0)
+    {
+        int nMajor = 0, nMinor = 0;
+
+        if (cuDeviceComputeCapability(&nMajor, &nMinor, oDevice) != CUDA_SUCCESS)
+            return false;
+        dCapacity = decodeCapacityFor(nMajor, nMinor);
+    }
+
+    rStatus.nDeviceID       = nDevice;
+    rStatus.nTotalMem       = nTotalMem;
+    rStatus.nFreeMem        = nFreeMem;
+    rStatus.dDecodeCapacity = dCapacity;
+
+    return true;
+}
+
+double
+CudaDeviceCapability::decodeCapacityFor(int nMajor, int nMinor)
+{
+    // 1080p frames per second by generation; parts newer than the table
+    // get its last row
+    double dFps;
+
+    if (nMajor < 5)
+        dFps = 200;     // Kepler
+    else if (nMajor == 5 && nMinor == 0)
+        dFps = 300;     // first Maxwell
+    else if (nMajor == 5)
+        dFps = 400;     // second Maxwell
+    else if (nMajor == 6)
+        dFps = 600;     // Pascal
+    else if (nMajor == 7)
+        dFps = 700;     // Volta, Turing
+    else
+        dFps = 800;     // Ampere and later
+
+    return 1920.0 * 1080.0 * dFps;
+}
+
+FakeDeviceCapability::FakeDeviceCapability()
+{
+}
+
+int
+FakeDeviceCapability::addDevice(double dDecodeCapacity, size_t nTotalMem, size_t nFreeMem)
+{
+    DeviceStatus oStatus;
+    oStatus.nDeviceID       = (int)aDevices_.size();
+    oStatus.nTotalMem       = nTotalMem;
+    oStatus.nFreeMem        = nFreeMem;
+    oStatus.dDecodeCapacity = dDecodeCapacity;
+    aDevices_.push_back(oStatus);
+
+    return oStatus.nDeviceID;
+}
+
+void
+FakeDeviceCapability::setDecodeCapacity(int nDevice, double dDecodeCapacity)
+{
+    if (nDevice >= 0 && nDevice < deviceCount())
+        aDevices_[nDevice].dDecodeCapacity = dDecodeCapacity;
+}
+
+int
+FakeDeviceCapability::deviceCount()
+{
+    return (int)aDevices_.size();
+}
+
+bool
+FakeDeviceCapability::queryDevice(int nDevice, DeviceStatus &rStatus)
+{
+    if (nDevice < 0 || nDevice >= deviceCount())
+        return false;
+
+    rStatus = aDevices_[nDevice];
+    return true;
+}
+
+StreamPlacer::StreamPlacer(DeviceCapability *pCapability, double dSaturation)
+    : pCapability_(pCapability)
+    , dSaturation_(dSaturation)
+    , nNextStreamID_(0)
+{
+}
+
+size_t
+StreamPlacer::estimateMemory(const StreamDemand &rDemand)
+{
+    // Mirrors the surface allocation in VideoDecoder: up to cnMaximumSize
+    // NV12 decode surfaces capped at 16M pixels, plus the output surfaces.
+    size_t nPixels   = (size_t)rDemand.nWidth * rDemand.nHeight;
+    size_t nSurfaces = FrameQueue::cnMaximumSize;
+
+    while (nSurfaces > 1 && nSurfaces * nPixels > 16*1024*1024)
+    {
+        nSurfaces--;
+    }
+
+    return (nSurfaces + MAX_FRAME_COUNT) * nPixels * 3 / 2;
+}
+
+void
+StreamPlacer::refreshDevices()
+{
+    aDevices_.clear();
+
+    int nDevices = pCapability_->deviceCount();
+
+    for (int i = 0; i < nDevices; i++)
+    {
+        DeviceStatus oStatus;
+
+        if (pCapability_->queryDevice(i, oStatus) && oStatus.dDecodeCapacity > 0)
+        {
+            aDevices_.push_back(oStatus);
+            oDeviceBooks_.insert(std::make_pair(oStatus.nDeviceID, DeviceBooks()));
+        }
+    }
+}
+
+int
+StreamPlacer::pickDevice(double dCost, size_t nMemory, int nExcludeDevice)
+{
+    int    nBest      = -1;
+    double dBestLoad  = 0;
+    size_t nBestAvail = 0;
+
+    for (size_t i = 0; i < aDevices_.size(); i++)
+    {
+        const DeviceStatus &rStatus = aDevices_[i];
+
+        if (rStatus.nDeviceID == nExcludeDevice)
+            continue;
+
+        const DeviceBooks &rBooks = oDeviceBooks_[rStatus.nDeviceID];
+        double dLoad = (rBooks.dCost + dCost) / rStatus.dDecodeCapacity;
+
+        if (dLoad > dSaturation_)
+            continue;
+
+        // The driver's free figure lags behind streams placed but not yet
+        // created, our own books lag behind other processes; trust the lower.
+        size_t nBooked = rBooks.nMemory < rStatus.nTotalMem ? rStatus.nTotalMem - rBooks.nMemory : 0;
+        size_t nAvail  = std::min(rStatus.nFreeMem, nBooked);
+
+        if (nMemory > nAvail)
+            continue;
+
+        if (nBest < 0 || dLoad < dBestLoad || (dLoad == dBestLoad && nAvail > nBestAvail))
+        {
+            nBest      = rStatus.nDeviceID;
+            dBestLoad  = dLoad;
+            nBestAvail = nAvail;
+        }
+    }
+
+    return nBest;
+}
+
+int
+StreamPlacer::placeStream(const StreamDemand &rDemand, int &nDeviceID)
+{
+    std::lock_guard<std::mutex> oLock(oMutex_);
+
+    refreshDevices();
+
+    StreamEntry oEntry;
+    oEntry.oDemand = rDemand;
+    oEntry.dCost   = (double)rDemand.nWidth * rDemand.nHeight * rDemand.dFrameRate;
+    oEntry.nMemory = estimateMemory(rDemand);
+
+    nDeviceID = pickDevice(oEntry.dCost, oEntry.nMemory, -1);
+
+    if (nDeviceID < 0)
+    {
+        printf("StreamPlacer: no device can take a %ux%u@%.1f stream\n",
+               rDemand.nWidth, rDemand.nHeight, rDemand.dFrameRate);
+        return -1;
+    }
+
+    oEntry.nDeviceID = nDeviceID;
+    oDeviceBooks_[nDeviceID].dCost   += oEntry.dCost;
+    oDeviceBooks_[nDeviceID].nMemory += oEntry.nMemory;
+
+    int nStreamID = nNextStreamID_++;
+    oStreams_[nStreamID] = oEntry;
+
+    return nStreamID;
+}
+
+void
+StreamPlacer::removeStream(int nStreamID)
+{
+    std::lock_guard<std::mutex> oLock(oMutex_);
+
+    std::map<int, StreamEntry>::iterator it = oStreams_.find(nStreamID);
+
+    if (it == oStreams_.end())
+        return;
+
+    DeviceBooks &rBooks = oDeviceBooks_[it->second.nDeviceID];
+    rBooks.dCost   -= it->second.dCost;
+    rBooks.nMemory -= it->second.nMemory;
+
+    oStreams_.erase(it);
+}
+
+int
+StreamPlacer::deviceOf(int nStreamID)
+{
+    std::lock_guard<std::mutex> oLock(oMutex_);
+
+    std::map<int, StreamEntry>::const_iterator it = oStreams_.find(nStreamID);
+
+    return it == oStreams_.end() ? -1 : it->second.nDeviceID;
+}
+
+double
+StreamPlacer::deviceLoad(int nDeviceID)
+{
+    std::lock_guard<std::mutex> oLock(oMutex_);
+
+    for (size_t i = 0; i < aDevices_.size(); i++)
+    {
+        if (aDevices_[i].nDeviceID == nDeviceID)
+            return oDeviceBooks_[nDeviceID].dCost / aDevices_[i].dDecodeCapacity;
+    }
+
+    return 0;
+}
+
+std::vector<StreamMove>
+StreamPlacer::rebalance()
+{
+    std::lock_guard<std::mutex> oLock(oMutex_);
+    std::vector<StreamMove> aMoves;
+
+    refreshDevices();
+
+    for (size_t i = 0; i < aDevices_.size(); i++)
+    {
+        const DeviceStatus &rStatus = aDevices_[i];
+        DeviceBooks        &rBooks  = oDeviceBooks_[rStatus.nDeviceID];
+
+        if (rBooks.dCost / rStatus.dDecodeCapacity <= dSaturation_)
+            continue;
+
+        // Largest streams first, so the fewest streams get interrupted.
+        std::vector<std::pair<double, int> > aCandidates;
+
+        for (std::map<int, StreamEntry>::const_iterator it = oStreams_.begin(); it != oStreams_.end(); ++it)
+        {
+            if (it->second.nDeviceID == rStatus.nDeviceID)
+                aCandidates.push_back(std::make_pair(-it->second.dCost, it->first));
+        }
+
+        std::sort(aCandidates.begin(), aCandidates.end());
+
+        for (size_t j = 0; j < aCandidates.size(); j++)
+        {
+            if (rBooks.dCost / rStatus.dDecodeCapacity <= dSaturation_)
+                break;
+
+            StreamEntry &rEntry = oStreams_[aCandidates[j].second];
+            int nTarget = pickDevice(rEntry.dCost, rEntry.nMemory, rStatus.nDeviceID);
+
+            if (nTarget < 0)
+                continue;
+
+            rBooks.dCost   -= rEntry.dCost;
+            rBooks.nMemory -= rEntry.nMemory;
+            oDeviceBooks_[nTarget].dCost   += rEntry.dCost;
+            oDeviceBooks_[nTarget].nMemory += rEntry.nMemory;
+            rEntry.nDeviceID = nTarget;
+
+            StreamMove oMove;
+            oMove.nStreamID   = aCandidates[j].second;
+            oMove.nFromDevice = rStatus.nDeviceID;
+            oMove.nToDevice   = nTarget;
+            aMoves.push_back(oMove);
+        }
+    }
+
+    return aMoves;
+}
@@ -0,0 +1,215 @@
+/*
+* File		: DevicePlacement.h
+* Time : 2026 - 10 - 19
+*/
+
+#ifndef DEVICEPLACEMENT_H
+#define DEVICEPLACEMENT_H
+
+#include <cuda.h>
+
+#include <map>
+#include <mutex>
+#include <vector>
+
+// Snapshot of one GPU as seen by the placement layer.
+struct DeviceStatus
+{
+    int     nDeviceID;
+    size_t  nTotalMem;          // bytes
+    size_t  nFreeMem;           // bytes, as reported by the driver right now
+    double  dDecodeCapacity;    // luma samples per second the decode engine sustains
+};
+
+// Source of device information for StreamPlacer.
+//  CudaDeviceCapability asks the driver; a fake returning canned numbers
+// can be plugged in instead to exercise placement without GPUs.
+class DeviceCapability
+{
+    public:
+        virtual
+        ~DeviceCapability() {}
+
+        virtual
+        int
+        deviceCount() = 0;
+
+        // Fills rStatus for device nDevice. Returns false if the device
+        // can't be queried (it is then skipped for placement).
+        virtual
+        bool
+        queryDevice(int nDevice, DeviceStatus &rStatus) = 0;
+};
+
+// DeviceCapability backed by the CUDA driver API.
+//  Free memory is read through each device's primary context, so no
+// extra context is created per query. NVDEC throughput isn't exposed by
+// the driver: each device's decode capacity is estimated from its
+// architecture (see decodeCapacityFor()), so a mixed node is loaded in
+// proportion to what its GPUs can do.
+class CudaDeviceCapability : public DeviceCapability
+{
+    public:
+        // Parameters:
+        //      dDecodeCapacity - luma samples/s to assume for every device
+        //          instead of the estimate, e.g. a measured figure; 0 to
+        //          estimate per device.
+        explicit
+        CudaDeviceCapability(double dDecodeCapacity = 0);
+
+        ~CudaDeviceCapability();
+
+        int
+        deviceCount();
+
+        bool
+        queryDevice(int nDevice, DeviceStatus &rStatus);
+
+        // Luma samples/s of H.264 1080p decode on one chip of compute
+        // capability nMajor.nMinor, rounded down from NVIDIA's published
+        // NVDEC figures.
+        static
+        double
+        decodeCapacityFor(int nMajor, int nMinor);
+
+    private:
+        double                  dDecodeCapacity_;
+        std::vector<CUcontext>  aPrimaryContexts_;
+};
+
+// DeviceCapability returning canned numbers, to exercise placement
+// without GPUs. Devices can be changed between queries, e.g. to make one
+// saturate under a placer. Not thread-safe.
+class FakeDeviceCapability : public DeviceCapability
+{
+    public:
+        FakeDeviceCapability();
+
+        // Adds a device with the next ID.
+        // Returns:
+        //      the device ID.
+        int
+        addDevice(double dDecodeCapacity, size_t nTotalMem, size_t nFreeMem);
+
+        // Decode capacity reported for nDevice from the next query on.
+        void
+        setDecodeCapacity(int nDevice, double dDecodeCapacity);
+
+        int
+        deviceCount();
+
+        bool
+        queryDevice(int nDevice, DeviceStatus &rStatus);
+
+    private:
+        // Copy constructor. Don't implement.
+        FakeDeviceCapability(const FakeDeviceCapability &);
+
+        // Assignment operator. Don't implement.
+        void
+        operator= (const FakeDeviceCapability &);
+
+        std::vector<DeviceStatus>   aDevices_;
+};
+
+// What a stream costs the device it runs on.
+struct StreamDemand
+{
+    unsigned int nWidth;
+    unsigned int nHeight;
+    double       dFrameRate;
+};
+
+// A stream the placer wants moved from one device to another.
+struct StreamMove
+{
+    int nStreamID;
+    int nFromDevice;
+    int nToDevice;
+};
+
+// Spreads decode streams across the GPUs of a node.
+//  Each stream is charged width*height*fps against the device's decode
+// capacity and an estimate of its surface memory against the device's
+// free memory. New streams go to the device with the lowest resulting
+// load, never to one that would go above the saturation threshold. A
+// device can still end up above it, e.g. when its capacity drops;
+// rebalance() then proposes moves off it. The placer only does the
+// bookkeeping, the caller tears down and recreates the moved streams
+// (see cudaDecode::rebalance()).
+class StreamPlacer
+{
+    public:
+        // Parameters:
+        //      pCapability - device information source, must outlive the placer.
+        //      dSaturation - load fraction above which a device is considered full.
+        explicit
+        StreamPlacer(DeviceCapability *pCapability, double dSaturation = 0.9);
+
+        // Picks a device for a new stream.
+        // Returns:
+        //      the stream ID (>= 0) and fills nDeviceID, or
+        //      -1 if no device has room for the stream.
+        int
+        placeStream(const StreamDemand &rDemand, int &nDeviceID);
+
+        void
+        removeStream(int nStreamID);
+
+        // Device the stream currently lives on, -1 if unknown.
+        int
+        deviceOf(int nStreamID);
+
+        // Load fraction (committed cost / capacity) of a device.
+        double
+        deviceLoad(int nDeviceID);
+
+        // Moves streams off saturated devices, largest first, as long as
+        // another device can take them without saturating itself. The
+        // returned moves are already committed to the placer's books.
+        std::vector<StreamMove>
+        rebalance();
+
+        // Surface memory a stream of the given size is expected to pin.
+        static
+        size_t
+        estimateMemory(const StreamDemand &rDemand);
+
+    private:
+        struct StreamEntry
+        {
+            int          nDeviceID;
+            StreamDemand oDemand;
+            double       dCost;
+            size_t       nMemory;
+        };
+
+        struct DeviceBooks
+        {
+            double dCost;
+            size_t nMemory;
+        };
+
+        // Copy constructor. Don't implement.
+        StreamPlacer(const StreamPlacer &);
+
+        // Assignment operator. Don't implement.
+        void
+        operator= (const StreamPlacer &);
+
+        void
+        refreshDevices();
+
+        int
+        pickDevice(double dCost, size_t nMemory, int nExcludeDevice);
+
+        DeviceCapability               *pCapability_;
+        double                          dSaturation_;
+        std::mutex                      oMutex_;
+        std::vector<DeviceStatus>       aDevices_;
+        std::map<int, DeviceBooks>      oDeviceBooks_;
+        std::map<int, StreamEntry>      oStreams_;
+        int                             nNextStreamID_;
+};
+
+#endif // DEVICEPLACEMENT_H
@@ -0,0 +1,266 @@
+/*
+* File		: EsFileReader.cpp
+* Time : 2026 - 10 - 19
+*/
+
+#include "EsFileReader.h"
+
+#include "DecodeStats.h"
+#include "NalIterator.h"
+#include "StartCode.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#if defined(WIN32) || defined(_WIN32) || defined(WIN64) || defined(_WIN64)
+#include <windows.h>
+#else
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+EsFileReader::EsFileReader(const EsFileParams &rParams)
+    : oParams_(rParams)
+    , pData_(NULL)
+    , nSize_(0)
+    , pCursor_(NULL)
+#if defined(WIN32) || defined(_WIN32) || defined(WIN64) || defined(_WIN64)
+    , hFile_(INVALID_HANDLE_VALUE)
+    , hMapping_(NULL)
+#endif
+{
+}
+
+EsFileReader::~EsFileReader()
+{
+    close();
+}
+
+bool
+EsFileReader::open()
+{
+    const char *szFileName = oParams_.sFileName.c_str();
+
+#if defined(WIN32) || defined(_WIN32) || defined(WIN64) || defined(_WIN64)
+    hFile_ = CreateFileA(szFileName, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING,
+                         FILE_FLAG_SEQUENTIAL_SCAN, NULL);
+    if (hFile_ == INVALID_HANDLE_VALUE)
+    {
+        printf("EsFileReader: can't open %s\n", szFileName);
+        return false;
+    }
+
+    LARGE_INTEGER oSize;
+    if (!GetFileSizeEx(hFile_, &oSize) || oSize.QuadPart == 0)
+    {
+        printf("EsFileReader: %s is empty\n", szFileName);
+        close();
+        return false;
+    }
+    nSize_ = (size_t)oSize.QuadPart;
+
+    hMapping_ = CreateFileMappingA(hFile_, NULL, PAGE_READONLY, 0, 0, NULL);
+    pData_ = hMapping_ ? (const unsigned char *)MapViewOfFile(hMapping_, FILE_MAP_READ, 0, 0, 0) : NULL;
+#else
+    int nFile = ::open(szFileName, O_RDONLY);
+    if (nFile < 0)
+    {
+        printf("EsFileReader: can't open %s\n", szFileName);
+        return false;
+    }
+
+    struct stat oStat;
+    if (fstat(nFile, &oStat) != 0 || oStat.st_size == 0)
+    {
+        printf("EsFileReader: %s is empty\n", szFileName);
+        ::close(nFile);
+        return false;
+    }
+    nSize_ = (size_t)oStat.st_size;
+
+    void *pMapping = mmap(NULL, nSize_, PROT_READ, MAP_PRIVATE, nFile, 0);
+    // The mapping keeps the file referenced
+    ::close(nFile);
+
+    if (pMapping != MAP_FAILED)
+    {
+        pData_ = (const unsigned char *)pMapping;
+        // Read ahead aggressively and drop pages behind us
+        madvise(pMapping, nSize_, MADV_SEQUENTIAL);
+        madvise(pMapping, nSize_ < 64 * 1024 * 1024 ? nSize_ : 64 * 1024 * 1024, MADV_WILLNEED);
+    }
+#endif
+
+    if (!pData_)
+    {
+        printf("EsFileReader: can't map %s\n", szFileName);
+        close();
+        return false;
+    }
+
+    rewind();
+    return true;
+}
+
+void
+EsFileReader::close()
+{
+#if defined(WIN32) || defined(_WIN32) || defined(WIN64) || defined(_WIN64)
+    if (pData_)
+        UnmapViewOfFile(pData_);
+    if (hMapping_)
+        CloseHandle(hMapping_);
+    if (hFile_ != INVALID_HANDLE_VALUE)
+        CloseHandle(hFile_);
+    hMapping_ = NULL;
+    hFile_    = INVALID_HANDLE_VALUE;
+#else
+    if (pData_)
+        munmap((void *)pData_, nSize_);
+#endif
+    pData_   = NULL;
+    pCursor_ = NULL;
+    nSize_   = 0;
+}
+
+void
+EsFileReader::rewind()
+{
+    pCursor_ = pData_ ? findStartCode(pData_, pData_ + nSize_) : NULL;
+}
+
+size_t
+EsFileReader::size()
+const
+{
+    return nSize_;
+}
+
+const EsFileParams &
+EsFileReader::params()
+const
+{
+    return oParams_;
+}
+
+bool
+EsFileReader::next(AccessUnit &rUnit)
+{
+    const unsigned char *pEnd = pData_ + nSize_;
+
+    if (!pCursor_ || pCursor_ >= pEnd)
+        return false;
+
+    const unsigned char *pUnit    = pCursor_;
+    NalIterator          oNals(pUnit, (size_t)(pEnd - pUnit), oParams_.eCodec);
+    NalUnit              oNal;
+    bool                 bSeenVcl = false;
+    bool                 bKey     = false;
+
+    pCursor_ = pEnd;
+
+    while (oNals.next(oNal))
+    {
+        if (oNal.nSize == 0)
+            continue;
+
+        bool bVcl = NalIterator::isVcl(oParams_.eCodec, oNal.nType);
+
+        // A picture was seen and this NAL opens the next access unit
+        if (bSeenVcl &&
+            (bVcl ? NalIterator::isFirstSlice(oParams_.eCodec, oNal)
+                  : NalIterator::startsAccessUnit(oParams_.eCodec, oNal.nType)))
+        {
+            pCursor_ = oNal.pStartCode;
+            break;
+        }
+
+        bSeenVcl |= bVcl;
+        bKey     |= bVcl && NalIterator::isKeyFrame(oParams_.eCodec, oNal.nType);
+    }
+
+    rUnit.pData       = pUnit;
+    rUnit.nSize       = (size_t)(pCursor_ - pUnit);
+    rUnit.llTimestamp = -1;
+    rUnit.llArrivalUs = steadyClockUs();
+    rUnit.bKeyFrame   = bKey;
+    rUnit.bLossBefore = false;
+    rUnit.bIncomplete = false;
+
+    return true;
+}
+
+static
+bool
+endsWith(const std::string &s, const char *szSuffix)
+{
+    size_t nLength = strlen(szSuffix);
+    return s.size() >= nLength && s.compare(s.size() - nLength, nLength, szSuffix) == 0;
+}
+
+bool
+EsFileReader::parseUrl(const std::string &sUrl, EsFileParams &rParams)
+{
+    static const char cszScheme[] = "es://";
+    const size_t cnSchemeLength = sizeof(cszScheme) - 1;
+
+    if (sUrl.compare(0, cnSchemeLength, cszScheme) != 0)
+    {
+        if (endsWith(sUrl, ".h264") || endsWith(sUrl, ".264") || endsWith(sUrl, ".avc"))
+            rParams.eCodec = cudaVideoCodec_H264;
+        else if (endsWith(sUrl, ".h265") || endsWith(sUrl, ".265") || endsWith(sUrl, ".hevc"))
+            rParams.eCodec = cudaVideoCodec_HEVC;
+        else
+            return false;
+
+        rParams.sFileName = sUrl;
+        return true;
+    }
+
+    std::string sRest  = sUrl.substr(cnSchemeLength);
+    std::string sQuery;
+    size_t nQuery = sRest.rfind('?');
+
+    if (nQuery != std::string::npos)
+    {
+        sQuery = sRest.substr(nQuery + 1);
+        sRest  = sRest.substr(0, nQuery);
+    }
+
+    rParams.sFileName = sRest;
+    if (endsWith(sRest, ".h265") || endsWith(sRest, ".265") || endsWith(sRest, ".hevc"))
+        rParams.eCodec = cudaVideoCodec_HEVC;
+
+    while (!sQuery.empty())
+    {
+        size_t nAmp = sQuery.find('&');
+        std::string sItem = sQuery.substr(0, nAmp);
+        sQuery = (nAmp == std::string::npos) ? std::string() : sQuery.substr(nAmp + 1);
+
+        size_t nEquals = sItem.find('=');
+        if (nEquals == std::string::npos)
+            continue;
+
+        std::string sKey   = sItem.substr(0, nEquals);
+        std::string sValue = sItem.substr(nEquals + 1);
+
+        if (sKey == "codec")
+        {
+            if (sValue == "hevc" || sValue == "h265")
+                rParams.eCodec = cudaVideoCodec_HEVC;
+            else if (sValue == "h264")
+                rParams.eCodec = cudaVideoCodec_H264;
+            else
+                printf("EsFileReader: unsupported codec %s, using H.264\n", sValue.c_str());
+        }
+        else if (sKey == "width")
+            rParams.nWidth = (unsigned int)atoi(sValue.c_str());
+        else if (sKey == "height")
+            rParams.nHeight = (unsigned int)atoi(sValue.c_str());
+    }
+
+    return !rParams.sFileName.empty();
+}
@@ -0,0 +1,90 @@
+/*
+* File		: EsFileReader.h
+* Time : 2026 - 10 - 19
+*/
+
+#ifndef ESFILEREADER_H
+#define ESFILEREADER_H
+
+#include <nvcuvid.h>
+
+#include "AccessUnit.h"
+
+#include <string>
+
+// What EsFileReader opens.
+struct EsFileParams
+{
+    std::string     sFileName;
+    cudaVideoCodec  eCodec;     // H264 or HEVC
+    unsigned int    nWidth;     // decoder size until the first SPS
+    unsigned int    nHeight;    //  says otherwise
+
+    EsFileParams()
+        : eCodec(cudaVideoCodec_H264), nWidth(1920), nHeight(1080)
+    {
+    }
+};
+
+// Reads a raw H.264/HEVC Annex-B elementary stream by mapping the file.
+//  The mapping is advised for sequential read-ahead and split into access
+// units with the SIMD start-code search; each AccessUnit points straight
+// into the mapping, nothing is copied. Units carry no timestamp.
+class EsFileReader
+{
+    public:
+        explicit
+        EsFileReader(const EsFileParams &rParams);
+
+        ~EsFileReader();
+
+        // Maps the file. Returns false (and prints why) on failure.
+        bool
+        open();
+
+        void
+        close();
+
+        // Next access unit of the file.
+        // Returns:
+        //      false at the end of the file.
+        bool
+        next(AccessUnit &rUnit);
+
+        // Back to the first access unit.
+        void
+        rewind();
+
+        size_t
+        size()
+        const;
+
+        const EsFileParams &
+        params()
+        const;
+
+        // Accepts "es://path[?codec=h264|hevc&width=W&height=H]" and plain
+        // paths ending in .h264, .264, .avc, .h265, .265 or .hevc.
+        static
+        bool
+        parseUrl(const std::string &sUrl, EsFileParams &rParams);
+
+    private:
+        // Copy constructor. Don't implement.
+        EsFileReader(const EsFileReader &);
+
+        // Assignment operator. Don't implement.
+        void
+        operator= (const EsFileReader &);
+
+        EsFileParams            oParams_;
+        const unsigned char    *pData_;
+        size_t                  nSize_;
+        const unsigned char    *pCursor_;   // start code of the next access unit
+#if defined(WIN32) || defined(_WIN32) || defined(WIN64) || defined(_WIN64)
+        void                   *hFile_;
+        void                   *hMapping_;
+#endif
+};
+
+#endif // ESFILEREADER_H
@@ -0,0 +1,449 @@
+/*
+* File		: FrameCache.cpp
+* Time : 2026 - 10 - 19
+*/
+
+#include "FrameCache.h"
+
+#include <string.h>
+
+// Halves a tightly packed NV12/P016 frame with a 2x2 box filter. Output
+// sizes are rounded down to even.
+template <typename T>
+static
+void
+downscaleFrame(const T *pSrc, unsigned int nWidth, unsigned int nHeight, T *pDst)
+{
+    unsigned int nDstWidth  = (nWidth / 2) & ~1u;
+    unsigned int nDstHeight = (nHeight / 2) & ~1u;
+
+    for (unsigned int y = 0; y < nDstHeight; y++)
+    {
+        const T *pRow0 = pSrc + (size_t)(2 * y) * nWidth;
+        const T *pRow1 = pRow0 + nWidth;
+
+        for (unsigned int x = 0; x < nDstWidth; x++)
+            pDst[(size_t)y * nDstWidth + x] = (T)((pRow0[2 * x] + pRow0[2 * x + 1] + pRow1[2 * x] + pRow1[2 * x + 1] + 2) / 4);
+    }
+
+    // Interleaved UV: average each component over 2x2 chroma samples
+    const T *pSrcUV = pSrc + (size_t)nWidth * nHeight;
+    T       *pDstUV = pDst + (size_t)nDstWidth * nDstHeight;
+
+    for (unsigned int y = 0; y < nDstHeight / 2; y++)
+    {
+        const T *pRow0 = pSrcUV + (size_t)(2 * y) * nWidth;
+        const T *pRow1 = pRow0 + nWidth;
+
+        for (unsigned int x = 0; x < nDstWidth / 2; x++)
+        {
+            for (unsigned int c = 0; c < 2; c++)
+            {
+                unsigned int nLeft  = 4 * x + c;
+                unsigned int nRight = nLeft + 2;
+                pDstUV[(size_t)y * nDstWidth + 2 * x + c] =
+                    (T)((pRow0[nLeft] + pRow0[nRight] + pRow1[nLeft] + pRow1[nRight] + 2) / 4);
+            }
+        }
+    }
+}
+
+// 8-bit samples: difference to the row above, then every run of zero
+// differences becomes a 0 byte followed by the run length.
+static
+void
+packDeltaRle(const unsigned char *pData, size_t nSize, size_t nRowBytes, std::vector<unsigned char> &rOut)
+{
+    unsigned int nRun = 0;
+
+    rOut.clear();
+    rOut.reserve(nSize / 2);
+
+    for (size_t i = 0; i < nSize; i++)
+    {
+        unsigned char nDelta = i < nRowBytes ? pData[i] : (unsigned char)(pData[i] - pData[i - nRowBytes]);
+
+        if (nDelta == 0 && nRun < 255)
+        {
+            nRun++;
+            continue;
+        }
+        if (nRun)
+        {
+            rOut.push_back(0);
+            rOut.push_back((unsigned char)nRun);
+            nRun = 0;
+        }
+        if (nDelta == 0)
+            nRun = 1;
+        else
+            rOut.push_back(nDelta);
+
+        // Not worth it, the caller stores the frame as is
+        if (rOut.size() >= nSize)
+            return;
+    }
+    if (nRun)
+    {
+        rOut.push_back(0);
+        rOut.push_back((unsigned char)nRun);
+    }
+}
+
+static
+void
+unpackDeltaRle(const std::vector<unsigned char> &rPacked, size_t nRowBytes, unsigned char *pOut, size_t nSize)
+{
+    size_t nOut = 0;
+
+    for (size_t i = 0; i < rPacked.size() && nOut < nSize; i++)
+    {
+        if (rPacked[i] != 0)
+        {
+            pOut[nOut++] = rPacked[i];
+            continue;
+        }
+
+        size_t nRun = i + 1 < rPacked.size() ? rPacked[++i] : 0;
+        if (nRun > nSize - nOut)
+            nRun = nSize - nOut;
+        memset(pOut + nOut, 0, nRun);
+        nOut += nRun;
+    }
+
+    for (size_t i = nRowBytes; i < nSize; i++)
+        pOut[i] = (unsigned char)(pOut[i] + pOut[i - nRowBytes]);
+}
+
+// 16-bit samples carrying nBitDepth significant bits in the high end (P016):
+// stores just those bits. Returns false if the low bits aren't all zero.
+static
+bool
+packBits(const unsigned short *pData, size_t nCount, unsigned int nBitDepth, std::vector<unsigned char> &rOut)
+{
+    unsigned int       nShift   = 16 - nBitDepth;
+    unsigned short     nLowMask = (unsigned short)((1u << nShift) - 1);
+    unsigned long long llBits   = 0;
+    unsigned int       nBits    = 0;
+
+    rOut.clear();
+    rOut.reserve((nCount * nBitDepth + 7) / 8);
+
+    for (size_t i = 0; i < nCount; i++)
+    {
+        if (pData[i] & nLowMask)
+            return false;
+
+        llBits = (llBits << nBitDepth) | (pData[i] >> nShift);
+        nBits += nBitDepth;
+        while (nBits >= 8)
+        {
+            nBits -= 8;
+            rOut.push_back((unsigned char)(llBits >> nBits));
+        }
+    }
+    if (nBits)
+        rOut.push_back((unsigned char)(llBits << (8 - nBits)));
+
+    return true;
+}
+
+static
+void
+unpackBits(const std::vector<unsigned char> &rPacked, unsigned int nBitDepth, unsigned short *pOut, size_t nCount)
+{
+    unsigned int       nShift = 16 - nBitDepth;
+    unsigned long long llBits = 0;
+    unsigned int       nBits  = 0;
+    size_t             nIn    = 0;
+
+    for (size_t i = 0; i < nCount; i++)
+    {
+        while (nBits < nBitDepth && nIn < rPacked.size())
+        {
+            llBits = (llBits << 8) | rPacked[nIn++];
+            nBits += 8;
+        }
+        nBits -= nBitDepth;
+        pOut[i] = (unsigned short)(((llBits >> nBits) & ((1u << nBitDepth) - 1)) << nShift);
+    }
+}
+
+FrameCache::FrameCache(size_t nBudgetBytes, FrameCacheStorage eStorage)
+    : nBudgetBytes_(nBudgetBytes)
+    , eStorage_(eStorage)
+    , nBytesUsed_(0)
+{
+}
+
+void
+FrameCache::encode(std::vector<unsigned char> &aRaw, Entry &rEntry)
+const
+{
+    CachedFrameInfo &rInfo   = rEntry.oInfo;
+    size_t           nSample = rInfo.nBitDepth > 8 ? 2 : 1;
+
+    rEntry.eEncoding = Encoding_Raw;
+    rEntry.nRawSize  = aRaw.size();
+
+    if (eStorage_ == FrameCache_Downscaled && rInfo.nWidth >= 4 && rInfo.nHeight >= 4)
+    {
+        unsigned int nWidth  = (rInfo.nWidth / 2) & ~1u;
+        unsigned int nHeight = (rInfo.nHeight / 2) & ~1u;
+
+        rEntry.aData.resize((size_t)nWidth * nHeight * 3 / 2 * nSample);
+        if (nSample == 2)
+            downscaleFrame((const unsigned short *)&aRaw[0], rInfo.nWidth, rInfo.nHeight, (unsigned short *)&rEntry.aData[0]);
+        else
+            downscaleFrame(&aRaw[0], rInfo.nWidth, rInfo.nHeight, &rEntry.aData[0]);
+
+        rInfo.nWidth      = nWidth;
+        rInfo.nHeight     = nHeight;
+        rInfo.bDownscaled = true;
+        rEntry.nRawSize   = rEntry.aData.size();
+        return;
+    }
+
+    if (eStorage_ == FrameCache_Packed)
+    {
+        std::vector<unsigned char> aPacked;
+        bool bPacked;
+
+        if (nSample == 1)
+        {
+            packDeltaRle(&aRaw[0], aRaw.size(), rInfo.nWidth, aPacked);
+            bPacked = aPacked.size() < aRaw.size();
+            rEntry.eEncoding = Encoding_DeltaRle;
+        }
+        else
+        {
+            bPacked = rInfo.nBitDepth < 16 &&
+                      packBits((const unsigned short *)&aRaw[0], aRaw.size() / 2, rInfo.nBitDepth, aPacked);
+            rEntry.eEncoding = Encoding_BitPacked;
+        }
+
+        if (bPacked)
+        {
+            rEntry.aData.swap(aPacked);
+            return;
+        }
+        rEntry.eEncoding = Encoding_Raw;
+    }
+
+    rEntry.aData.swap(aRaw);
+}
+
+void
+FrameCache::decode(const Entry &rEntry, std::vector<unsigned char> &rData)
+{
+    const CachedFrameInfo &rInfo = rEntry.oInfo;
+
+    rData.resize(rEntry.nRawSize);
+
+    switch (rEntry.eEncoding)
+    {
+    case Encoding_DeltaRle:
+        unpackDeltaRle(rEntry.aData, rInfo.nWidth, &rData[0], rData.size());
+        break;
+    case Encoding_BitPacked:
+        unpackBits(rEntry.aData, rInfo.nBitDepth, (unsigned short *)&rData[0], rData.size() / 2);
+        break;
+    default:
+        memcpy(&rData[0], &rEntry.aData[0], rData.size());
+        break;
+    }
+}
+
+bool
+FrameCache::insert(unsigned int nSource, unsigned long nFrame, unsigned long nGopStart, const DecodedFrame &rFrame)
+{
+    if (contains(nSource, nFrame))
+        return true;
+
+    size_t nRowBytes = (size_t)rFrame.nWidth * (rFrame.nBitDepth > 8 ? 2 : 1);
+    size_t nRows     = (size_t)rFrame.nHeight * 3 / 2;
+
+    if (!nRowBytes || !nRows)
+        return false;
+
+    // Off the GPU first, the lock only covers the bookkeeping
+    std::vector<unsigned char> aRaw(nRowBytes * nRows);
+
+    CUDA_MEMCPY2D oCopy;
+    memset(&oCopy, 0, sizeof(oCopy));
+    oCopy.srcMemoryType = CU_MEMORYTYPE_DEVICE;
+    oCopy.srcDevice     = rFrame.dpFrame;
+    oCopy.srcPitch      = rFrame.nPitch;
+    oCopy.dstMemoryType = CU_MEMORYTYPE_HOST;
+    oCopy.dstHost       = &aRaw[0];
+    oCopy.dstPitch      = nRowBytes;
+    oCopy.WidthInBytes  = nRowBytes;
+    oCopy.Height        = nRows;
+
+    if (cuMemcpy2D(&oCopy) != CUDA_SUCCESS)
+        return false;
+
+    Entry oEntry;
+    oEntry.oInfo.nWidth      = rFrame.nWidth;
+    oEntry.oInfo.nHeight     = rFrame.nHeight;
+    oEntry.oInfo.nBitDepth   = rFrame.nBitDepth;
+    oEntry.oInfo.eFormat     = rFrame.eFormat;
+    oEntry.oInfo.llTimestamp = rFrame.llTimestamp;
+    oEntry.oInfo.nFlags      = rFrame.nFlags;
+    oEntry.oInfo.bDownscaled = false;
+    encode(aRaw, oEntry);
+
+    Key    oKey(nSource, nFrame);
+    Key    oGopKey(nSource, nGopStart);
+    size_t nBytes = oEntry.aData.size();
+
+    std::lock_guard<std::mutex> oLock(oMutex_);
+
+    if (aIndex_.count(oKey))
+        return true;
+
+    std::map<Key, Gop>::iterator itGop = aGops_.find(oGopKey);
+    if (itGop == aGops_.end())
+    {
+        itGop = aGops_.insert(std::make_pair(oGopKey, Gop())).first;
+        aLru_.push_front(oGopKey);
+        itGop->second.nBytes = 0;
+        itGop->second.itLru  = aLru_.begin();
+    }
+    else
+    {
+        aLru_.splice(aLru_.begin(), aLru_, itGop->second.itLru);
+    }
+
+    Gop &rGop = itGop->second;
+
+    if (rGop.nBytes + nBytes > nBudgetBytes_)
+    {
+        if (rGop.aFrames.empty())
+        {
+            aLru_.erase(rGop.itLru);
+            aGops_.erase(itGop);
+        }
+        return false;
+    }
+
+    // Whole GOPs go, least recently used first; this one is at the front
+    while (nBytesUsed_ + nBytes > nBudgetBytes_)
+    {
+        std::map<Key, Gop>::iterator itOldest = aGops_.find(aLru_.back());
+
+        oStats_.nEvictedGops++;
+        oStats_.nEvictedFrames += (unsigned long)itOldest->second.aFrames.size();
+        dropGop(itOldest);
+    }
+
+    size_t nRawSize = oEntry.nRawSize;
+
+    rGop.aFrames[nFrame] = std::move(oEntry);
+    rGop.nBytes  += nBytes;
+    nBytesUsed_  += nBytes;
+    aIndex_[oKey] = oGopKey;
+
+    oStats_.nInserts++;
+    oStats_.nBytesUsed = nBytesUsed_;
+    oStats_.nBytesHeld += nRawSize;
+    return true;
+}
+
+bool
+FrameCache::lookup(unsigned int nSource, unsigned long nFrame, std::vector<unsigned char> &rData, CachedFrameInfo &rInfo,
+                   bool bCount)
+{
+    std::lock_guard<std::mutex> oLock(oMutex_);
+
+    std::map<Key, Key>::iterator itIndex = aIndex_.find(Key(nSource, nFrame));
+    if (itIndex == aIndex_.end())
+    {
+        if (bCount)
+            oStats_.nMisses++;
+        return false;
+    }
+
+    Gop         &rGop   = aGops_[itIndex->second];
+    const Entry &rEntry = rGop.aFrames[nFrame];
+
+    aLru_.splice(aLru_.begin(), aLru_, rGop.itLru);
+
+    decode(rEntry, rData);
+    rInfo = rEntry.oInfo;
+
+    if (bCount)
+        oStats_.nHits++;
+    return true;
+}
+
+bool
+FrameCache::contains(unsigned int nSource, unsigned long nFrame)
+const
+{
+    std::lock_guard<std::mutex> oLock(oMutex_);
+    return aIndex_.count(Key(nSource, nFrame)) != 0;
+}
+
+void
+FrameCache::dropGop(std::map<Key, Gop>::iterator itGop)
+{
+    unsigned long long nRawSize = 0;
+
+    for (std::map<unsigned long, Entry>::iterator it = itGop->second.aFrames.begin(); it != itGop->second.aFrames.end(); ++it)
+    {
+        aIndex_.erase(Key(itGop->first.first, it->first));
+        nRawSize += it->second.nRawSize;
+    }
+
+    nBytesUsed_ -= itGop->second.nBytes;
+    oStats_.nBytesUsed  = nBytesUsed_;
+    oStats_.nBytesHeld -= nRawSize;
+
+    aLru_.erase(itGop->second.itLru);
+    aGops_.erase(itGop);
+}
+
+void
+FrameCache::erase(unsigned int nSource)
+{
+    std::lock_guard<std::mutex> oLock(oMutex_);
+
+    std::map<Key, Gop>::iterator it = aGops_.lower_bound(Key(nSource, 0));
+    while (it != aGops_.end() && it->first.first == nSource)
+        dropGop(it++);
+}
+
+void
+FrameCache::clear()
+{
+    std::lock_guard<std::mutex> oLock(oMutex_);
+
+    aGops_.clear();
+    aIndex_.clear();
+    aLru_.clear();
+    nBytesUsed_ = 0;
+    oStats_.nBytesUsed = 0;
+    oStats_.nBytesHeld = 0;
+}
+
+size_t
+FrameCache::budget()
+const
+{
+    return nBudgetBytes_;
+}
+
+FrameCacheStorage
+FrameCache::storage()
+const
+{
+    return eStorage_;
+}
+
+const FrameCacheStats &
+FrameCache::stats()
+const
+{
+    return oStats_;
+}
@@ -0,0 +1,182 @@
+/*
+* File		: FrameCache.h
+* Time : 2026 - 10 - 19
+*/
+
+#ifndef FRAMECACHE_H
+#define FRAMECACHE_H
+
+#include "FrameSink.h"
+
+#include <atomic>
+#include <list>
+#include <map>
+#include <mutex>
+#include <utility>
+#include <vector>
+
+// How FrameCache keeps the frames it holds.
+enum FrameCacheStorage
+{
+    // The frame as decoded.
+    FrameCache_Full = 0,
+    // Half width and height, 2x2 averaged: four times as many frames in
+    // the budget, for previews and scrubbing.
+    FrameCache_Downscaled,
+    // Lossless: 8-bit frames are row-delta coded with zero runs collapsed,
+    // 10/12-bit frames are bit-packed to their real depth.
+    FrameCache_Packed
+};
+
+// Cache counters; safe to read from any thread.
+struct FrameCacheStats
+{
+    std::atomic<unsigned long>      nHits;
+    std::atomic<unsigned long>      nMisses;
+    std::atomic<unsigned long>      nInserts;
+    std::atomic<unsigned long>      nEvictedFrames;
+    std::atomic<unsigned long>      nEvictedGops;
+    std::atomic<unsigned long long> nBytesUsed;     // stored, after packing
+    std::atomic<unsigned long long> nBytesHeld;     // the same frames as decoded
+
+    FrameCacheStats()
+        : nHits(0), nMisses(0), nInserts(0), nEvictedFrames(0), nEvictedGops(0), nBytesUsed(0), nBytesHeld(0)
+    {
+    }
+
+  private:
+    // Copy constructor. Don't implement.
+    FrameCacheStats(const FrameCacheStats &);
+
+    // Assignment operator. Don't implement.
+    void
+    operator= (const FrameCacheStats &);
+};
+
+// Description of a frame handed out by FrameCache::lookup().
+struct CachedFrameInfo
+{
+    unsigned int            nWidth;         // of the returned frame, halved when downscaled
+    unsigned int            nHeight;
+    unsigned int            nBitDepth;
+    cudaVideoSurfaceFormat  eFormat;        // NV12 or P016, planes tightly packed
+    long long               llTimestamp;
+    unsigned int            nFlags;         // DecodedFrameFlags
+    bool                    bDownscaled;
+};
+
+// Host-memory LRU cache of decoded frames, keyed by (source, frame number).
+//  Frames are grouped by GOP and the GOP is the unit of recency and
+// eviction: a lookup keeps its whole GOP warm, since decoding any frame
+// of it again means decoding the GOP from its keyframe. The least
+// recently used GOPs are evicted once the stored bytes pass the budget.
+//
+// Sources and frame numbers are the caller's; CachedFrameReader numbers
+// frames from their timestamps. insert() and lookup() may be called from
+// any thread.
+class FrameCache
+{
+    public:
+        // Parameters:
+        //      nBudgetBytes - host memory the stored frames may use.
+        //      eStorage - how frames are stored.
+        FrameCache(size_t nBudgetBytes, FrameCacheStorage eStorage = FrameCache_Full);
+
+        // Copies a mapped frame off the GPU and stores it. Call from
+        // FrameSink::onFrame(), with the decoder's context current.
+        // Parameters:
+        //      nGopStart - frame number of the keyframe starting its GOP.
+        // Returns:
+        //      false if the frame couldn't be stored (copy failed, or its
+        //      GOP alone exceeds the budget).
+        bool
+        insert(unsigned int nSource, unsigned long nFrame, unsigned long nGopStart, const DecodedFrame &rFrame);
+
+        // Copies a cached frame, unpacked, into rData and makes its GOP the
+        // most recently used. Counts a hit or a miss unless bCount is false,
+        // as for fetching a frame that was just decoded after a miss.
+        bool
+        lookup(unsigned int nSource, unsigned long nFrame, std::vector<unsigned char> &rData, CachedFrameInfo &rInfo,
+               bool bCount = true);
+
+        // Presence test that neither counts nor touches the LRU order.
+        bool
+        contains(unsigned int nSource, unsigned long nFrame)
+        const;
+
+        // Drops every frame of a source, e.g. when it is closed.
+        void
+        erase(unsigned int nSource);
+
+        void
+        clear();
+
+        size_t
+        budget()
+        const;
+
+        FrameCacheStorage
+        storage()
+        const;
+
+        const FrameCacheStats &
+        stats()
+        const;
+
+    private:
+        typedef std::pair<unsigned int, unsigned long> Key;     // (source, frame number)
+
+        enum Encoding
+        {
+            Encoding_Raw = 0,
+            Encoding_DeltaRle,      // 8-bit samples
+            Encoding_BitPacked      // 16-bit samples with depth < 16
+        };
+
+        struct Entry
+        {
+            std::vector<unsigned char>  aData;
+            CachedFrameInfo             oInfo;
+            unsigned char               eEncoding;
+            size_t                      nRawSize;
+        };
+
+        struct Gop
+        {
+            std::map<unsigned long, Entry>  aFrames;
+            size_t                          nBytes;
+            std::list<Key>::iterator        itLru;
+        };
+
+        // Copy constructor. Don't implement.
+        FrameCache(const FrameCache &);
+
+        // Assignment operator. Don't implement.
+        void
+        operator= (const FrameCache &);
+
+        // Turns the tightly packed frame in aRaw into a stored entry.
+        void
+        encode(std::vector<unsigned char> &aRaw, Entry &rEntry)
+        const;
+
+        static
+        void
+        decode(const Entry &rEntry, std::vector<unsigned char> &rData);
+
+        // Removes a GOP and its index entries. Call with oMutex_ held.
+        void
+        dropGop(std::map<Key, Gop>::iterator itGop);
+
+        size_t                      nBudgetBytes_;
+        FrameCacheStorage           eStorage_;
+        FrameCacheStats             oStats_;
+
+        mutable std::mutex          oMutex_;
+        std::map<Key, Gop>          aGops_;         // by (source, first frame)
+        std::map<Key, Key>          aIndex_;        // frame -> its GOP
+        std::list<Key>              aLru_;          // GOPs, most recently used first
+        size_t                      nBytesUsed_;
+};
+
+#endif // FRAMECACHE_H
@@ -0,0 +1,115 @@
+/*
+* File		: FrameDecimator.cpp
+* Time : 2026 - 10 - 19
+*/
+
+#include "FrameDecimator.h"
+
+FrameDecimator::FrameDecimator()
+    : dTargetFps_(0)
+    , dSourceFps_(0)
+    , llIntervalUs_(0)
+    , llFrameUs_(0)
+    , llBase_(-1)
+    , llLastDisplayed_(-1)
+    , dCredit_(0)
+{
+}
+
+void
+FrameDecimator::setRates(double dTargetFps, double dSourceFps)
+{
+    dTargetFps_   = dTargetFps > 0 ? dTargetFps : 0;
+    dSourceFps_   = dSourceFps > 0 ? dSourceFps : 0;
+    llIntervalUs_ = dTargetFps_ > 0 ? (long long)(1e6 / dTargetFps_ + 0.5) : 0;
+    llFrameUs_    = dSourceFps_ > 0 ? (long long)(1e6 / dSourceFps_ + 0.5) : 0;
+
+    reset();
+}
+
+bool
+FrameDecimator::enabled()
+const
+{
+    return llIntervalUs_ > 0;
+}
+
+void
+FrameDecimator::reset()
+{
+    llBase_          = -1;
+    llLastDisplayed_ = -1;
+    dCredit_         = 0;
+    if (dSourceFps_ <= 0)
+        llFrameUs_ = 0;
+}
+
+long long
+FrameDecimator::interval(long long llTimestamp)
+const
+{
+    long long llOffset = llTimestamp - llBase_;
+
+    // Floor division; the frame before the base lands in interval -1
+    return llOffset >= 0 ? llOffset / llIntervalUs_ : -((-llOffset + llIntervalUs_ - 1) / llIntervalUs_);
+}
+
+bool
+FrameDecimator::mayKeep(long long llTimestamp)
+const
+{
+    if (!enabled() || llTimestamp < 0 || llBase_ < 0 || llFrameUs_ <= 0)
+        return true;
+
+    // Pictures decoded ahead of the base (B-frames of the first GOP)
+    if (llTimestamp < llBase_)
+        return true;
+
+    return interval(llTimestamp) != interval(llTimestamp - llFrameUs_);
+}
+
+bool
+FrameDecimator::keep(long long llTimestamp)
+{
+    if (!enabled())
+        return true;
+
+    if (llTimestamp < 0)
+    {
+        if (dSourceFps_ <= 0)
+            return true;
+
+        dCredit_ += dTargetFps_ / dSourceFps_;
+        if (dCredit_ < 1)
+            return false;
+        dCredit_ -= 1;
+        return true;
+    }
+
+    // A step back or a jump of more than a few seconds is a new timeline
+    if (llLastDisplayed_ >= 0 &&
+        (llTimestamp <= llLastDisplayed_ - llIntervalUs_ || llTimestamp > llLastDisplayed_ + 10 * 1000000LL))
+    {
+        llBase_ = -1;
+    }
+
+    // Learn the frame duration from display order when the source rate isn't given
+    if (dSourceFps_ <= 0 && llLastDisplayed_ >= 0 && llTimestamp > llLastDisplayed_)
+    {
+        long long llStep = llTimestamp - llLastDisplayed_;
+        if (llFrameUs_ <= 0 || llStep < llFrameUs_)
+            llFrameUs_ = llStep;
+    }
+    llLastDisplayed_ = llTimestamp;
+
+    if (llBase_ < 0)
+    {
+        llBase_ = llTimestamp;
+        return true;
+    }
+
+    if (llFrameUs_ <= 0)
+        return true;
+
+    return interval(llTimestamp) != interval(llTimestamp - llFrameUs_);
+}
@@ -0,0 +1,66 @@
+/*
+* File		: FrameDecimator.h
+* Time : 2026 - 10 - 19
+*/
+
+#ifndef FRAMEDECIMATOR_H
+#define FRAMEDECIMATOR_H
+
+// Picks the frames of a stream that make up a lower output rate.
+//  Selection is a function of the timestamp alone: the output timeline
+// is cut into intervals of 1/target seconds and a frame is kept when an
+// interval starts within its own duration. Decode order and display order
+// therefore agree on every frame, which lets the parser skip decoding a
+// non-reference picture before it is displayed, and the kept frames are
+// evenly spaced whatever the source rate.
+//
+// Frames without timestamps fall back to keeping target/source of them
+// in display order.
+class FrameDecimator
+{
+    public:
+        FrameDecimator();
+
+        // Parameters:
+        //      dTargetFps - output rate, 0 keeps every frame.
+        //      dSourceFps - nominal source rate, 0 if unknown (it is then
+        //          learned from the timestamps).
+        void
+        setRates(double dTargetFps, double dSourceFps);
+
+        bool
+        enabled()
+        const;
+
+        // Decode-time question, timestamp in microseconds (-1 if unknown).
+        // Returns:
+        //      false only if the frame is known not to be kept.
+        bool
+        mayKeep(long long llTimestamp)
+        const;
+
+        // Display-time decision; also learns the frame duration from the
+        // display-order timestamps.
+        bool
+        keep(long long llTimestamp);
+
+        // Starts over after a seek or stream restart.
+        void
+        reset();
+
+    private:
+        // Interval index of llTimestamp on the output timeline.
+        long long
+        interval(long long llTimestamp)
+        const;
+
+        double      dTargetFps_;
+        double      dSourceFps_;
+        long long   llIntervalUs_;
+        long long   llFrameUs_;         // source frame duration, 0 until known
+        long long   llBase_;            // first timestamp seen, -1 before
+        long long   llLastDisplayed_;   // -1 before the first
+        double      dCredit_;           // fallback without timestamps
+};
+
+#endif // FRAMEDECIMATOR_H
@@ -0,0 +1,330 @@
+/*
+* File		: FrameFileWriter.cpp
+* Time : 2026 - 10 - 19
+*/
+
+#include "FrameFileWriter.h"
+#include "ColorConvert.h"
+
+#include <iomanip>
+#include <sstream>
+#include <stdio.h>
+#include <string.h>
+
+#ifdef OPENCV
+#include "opencv2/opencv.hpp"
+#endif
+
+static const char s_szY4mFrame[] = "FRAME\n";
+static const size_t s_nY4mFrameHeader = sizeof(s_szY4mFrame) - 1;
+
+static
+unsigned long
+greatestCommonDivisor(unsigned long a, unsigned long b)
+{
+    while (b)
+    {
+        unsigned long t = a % b;
+        a = b;
+        b = t;
+    }
+    return a;
+}
+
+FrameFileWriter::FrameFileWriter(const std::string &sPath, FrameFileFormat eFormat, double dFrameRate,
+                                 bool bDropWhenBusy, unsigned int nEncodeThreads,
+                                 unsigned int nWriterThreads, unsigned int nBuffers)
+    : sPath_(sPath)
+    , eFormat_(eFormat)
+    , dFrameRate_(dFrameRate > 0 ? dFrameRate : 25.0)
+    , bDropWhenBusy_(bDropWhenBusy)
+    , oWriter_(nWriterThreads, nBuffers)
+    , oPool_(nEncodeThreads > 0 ? nEncodeThreads : 1)
+    , nStream_(-1)
+    , nStreamWidth_(0)
+    , nStreamHeight_(0)
+    , nStreamBitDepth_(0)
+{
+    if (eFormat_ == FrameFileFormat_PNG || eFormat_ == FrameFileFormat_JPEG)
+    {
+#ifndef OPENCV
+        printf("PNG/JPEG output needs a build with OpenCV\n");
+#endif
+        return;
+    }
+    nStream_ = oWriter_.openStream(sPath_);
+}
+
+FrameFileWriter::~FrameFileWriter()
+{
+    flush();
+    if (nStream_ >= 0)
+        oWriter_.closeStream(nStream_);
+}
+
+bool
+FrameFileWriter::isValid()
+const
+{
+    if (eFormat_ == FrameFileFormat_PNG || eFormat_ == FrameFileFormat_JPEG)
+    {
+#ifdef OPENCV
+        return true;
+#else
+        return false;
+#endif
+    }
+    return nStream_ >= 0;
+}
+
+size_t
+FrameFileWriter::streamFrameSize(unsigned int nWidth, unsigned int nHeight, unsigned int nBitDepth)
+const
+{
+    size_t nSample = nBitDepth > 8 ? 2 : 1;
+    size_t nChroma = (size_t)((nWidth + 1) / 2) * ((nHeight + 1) / 2);
+
+    switch (eFormat_)
+    {
+    case FrameFileFormat_NV12:
+        return nSample * nWidth * (nHeight + (nHeight + 1) / 2);
+    case FrameFileFormat_I420:
+        return nSample * ((size_t)nWidth * nHeight + 2 * nChroma);
+    case FrameFileFormat_Y4M:
+        return s_nY4mFrameHeader + nSample * ((size_t)nWidth * nHeight + 2 * nChroma);
+    default:
+        return 0;
+    }
+}
+
+void
+FrameFileWriter::writeHeader(unsigned int nWidth, unsigned int nHeight, unsigned int nBitDepth)
+{
+    unsigned long nRateNum = (unsigned long)(dFrameRate_ * 1000 + 0.5);
+    unsigned long nRateDen = 1000;
+    unsigned long nDivisor = greatestCommonDivisor(nRateNum, nRateDen);
+
+    std::ostringstream oHeader;
+    oHeader << "YUV4MPEG2 W" << nWidth << " H" << nHeight
+            << " F" << nRateNum / nDivisor << ':' << nRateDen / nDivisor << " Ip A1:1";
+    if (nBitDepth > 8)
+        oHeader << " C420p" << nBitDepth << " XYSCSS=420P" << nBitDepth;
+    else
+        oHeader << " C420jpeg XYSCSS=420JPEG";
+    oHeader << '\n';
+
+    std::string sHeader = oHeader.str();
+    WriteBuffer *pBuffer = oWriter_.acquire();
+
+    pBuffer->aData.assign(sHeader.begin(), sHeader.end());
+    oWriter_.writeAt(nStream_, oWriter_.reserve(nStream_, sHeader.size()), pBuffer);
+}
+
+void
+FrameFileWriter::onFrame(const DecodedFrame &rFrame)
+{
+    if (!isValid())
+        return;
+
+    if (nStream_ >= 0)
+    {
+        if (!nStreamWidth_)
+        {
+            nStreamWidth_    = rFrame.nWidth;
+            nStreamHeight_   = rFrame.nHeight;
+            nStreamBitDepth_ = rFrame.nBitDepth;
+            if (eFormat_ == FrameFileFormat_Y4M)
+                writeHeader(nStreamWidth_, nStreamHeight_, nStreamBitDepth_);
+        }
+        else if (rFrame.nWidth != nStreamWidth_ || rFrame.nHeight != nStreamHeight_ ||
+                 (rFrame.nBitDepth > 8) != (nStreamBitDepth_ > 8))
+        {
+            // A raw stream has no way to say the size changed
+            oStats_.nSizeChanges++;
+            return;
+        }
+    }
+
+    bool bConvert = eFormat_ != FrameFileFormat_NV12;
+    WriteBuffer *pRaw = bDropWhenBusy_ ? oWriter_.tryAcquire() : oWriter_.acquire();
+    WriteBuffer *pOut = 0;
+
+    if (pRaw && bConvert)
+    {
+        pOut = bDropWhenBusy_ ? oWriter_.tryAcquire() : oWriter_.acquire();
+        if (!pOut)
+        {
+            oWriter_.release(pRaw);
+            pRaw = 0;
+        }
+    }
+    if (!pRaw)
+    {
+        oStats_.nDropped++;
+        return;
+    }
+
+    size_t nRowBytes = (size_t)rFrame.nWidth * (rFrame.nBitDepth > 8 ? 2 : 1);
+    size_t nRows     = rFrame.nHeight + (rFrame.nHeight + 1) / 2;
+
+    // Conversion reads chroma in pairs; a spare sample keeps an odd width
+    // inside the buffer. NV12 writes the buffer as is, so no slack there.
+    pRaw->aData.resize(nRowBytes * nRows + (bConvert ? 4 : 0));
+
+    CUDA_MEMCPY2D oCopy;
+    memset(&oCopy, 0, sizeof(oCopy));
+    oCopy.srcMemoryType = CU_MEMORYTYPE_DEVICE;
+    oCopy.srcDevice     = rFrame.dpFrame;
+    oCopy.srcPitch      = rFrame.nPitch;
+    oCopy.dstMemoryType = CU_MEMORYTYPE_HOST;
+    oCopy.dstHost       = &pRaw->aData[0];
+    oCopy.dstPitch      = nRowBytes;
+    oCopy.WidthInBytes  = nRowBytes;
+    oCopy.Height        = nRows;
+
+    if (cuMemcpy2D(&oCopy) != CUDA_SUCCESS)
+    {
+        oWriter_.release(pRaw);
+        if (pOut)
+            oWriter_.release(pOut);
+        oStats_.nErrors++;
+        return;
+    }
+
+    HostFrame oFrame;
+    oFrame.pRaw         = pRaw;
+    oFrame.pOut         = pOut;
+    oFrame.nWidth       = rFrame.nWidth;
+    oFrame.nHeight      = rFrame.nHeight;
+    oFrame.nBitDepth    = rFrame.nBitDepth;
+    oFrame.nFrameNumber = rFrame.nFrameNumber;
+    // The range is taken here, on the decode thread, so the frames keep
+    // display order in the file whichever finishes converting first
+    oFrame.llOffset     = nStream_ >= 0 ?
+        oWriter_.reserve(nStream_, streamFrameSize(rFrame.nWidth, rFrame.nHeight, rFrame.nBitDepth)) : 0;
+
+    oStats_.nFrames++;
+    if (bConvert)
+        oPool_.submit(std::bind(&FrameFileWriter::convertFrame, this, oFrame));
+    else
+        oWriter_.writeAt(nStream_, oFrame.llOffset, pRaw);
+}
+
+void
+FrameFileWriter::convertFrame(HostFrame oFrame)
+{
+    const unsigned char *pSrc = &oFrame.pRaw->aData[0];
+    std::vector<unsigned char> &rOut = oFrame.pOut->aData;
+    unsigned int nWidth  = oFrame.nWidth;
+    unsigned int nHeight = oFrame.nHeight;
+    unsigned int nChromaWidth  = (nWidth + 1) / 2;
+    unsigned int nChromaHeight = (nHeight + 1) / 2;
+    bool bHighDepth = oFrame.nBitDepth > 8;
+    size_t nRowBytes = (size_t)nWidth * (bHighDepth ? 2 : 1);
+
+    if (eFormat_ == FrameFileFormat_PNG || eFormat_ == FrameFileFormat_JPEG)
+    {
+#ifdef OPENCV
+        std::vector<unsigned char> aNarrow;
+        const unsigned char *pNV12 = pSrc;
+
+        if (bHighDepth)
+        {
+            aNarrow.resize((size_t)nWidth * (nHeight + nChromaHeight));
+            convertP016ToNV12Host(pSrc, (unsigned int)nRowBytes, &aNarrow[0], nWidth, nWidth, nHeight);
+            pNV12 = &aNarrow[0];
+        }
+
+        cv::Mat oNV12(nHeight * 3 / 2, nWidth, CV_8UC1, (void *)pNV12);
+        cv::Mat oBgr(nHeight, nWidth, CV_8UC3);
+        cv::cvtColor(oNV12, oBgr, cv::COLOR_YUV2BGR_NV12);
+        oWriter_.release(oFrame.pRaw);
+
+        bool bPng = eFormat_ == FrameFileFormat_PNG;
+        std::vector<int> aParams;
+        aParams.push_back(bPng ? cv::IMWRITE_PNG_COMPRESSION : cv::IMWRITE_JPEG_QUALITY);
+        aParams.push_back(bPng ? 1 : 90);      // PNG: favour speed over size
+
+        if (!cv::imencode(bPng ? ".png" : ".jpg", oBgr, rOut, aParams))
+        {
+            oWriter_.release(oFrame.pOut);
+            oStats_.nErrors++;
+            return;
+        }
+
+        std::ostringstream oPath;
+        oPath << sPath_ << '_' << std::setw(6) << std::setfill('0') << oFrame.nFrameNumber
+              << (bPng ? ".png" : ".jpg");
+        oWriter_.write(oPath.str(), oFrame.pOut);
+#endif
+        return;
+    }
+
+    size_t nHeader = eFormat_ == FrameFileFormat_Y4M ? s_nY4mFrameHeader : 0;
+
+    rOut.resize(streamFrameSize(nWidth, nHeight, oFrame.nBitDepth));
+    memcpy(&rOut[0], s_szY4mFrame, nHeader);
+
+    if (bHighDepth)
+    {
+        // Convert at an even offset for the 16-bit stores, then move the
+        // samples behind the header
+        size_t nSamples = (size_t)nWidth * nHeight + 2 * (size_t)nChromaWidth * nChromaHeight;
+        size_t nAligned = (nHeader + 1) & ~(size_t)1;
+
+        rOut.resize(nAligned + 2 * nSamples);
+
+        unsigned short *pY = (unsigned short *)&rOut[nAligned];
+        unsigned short *pU = pY + (size_t)nWidth * nHeight;
+        unsigned short *pV = pU + (size_t)nChromaWidth * nChromaHeight;
+        convertP016ToPlanarHost(pSrc, (unsigned int)nRowBytes, pY, pU, pV, nWidth, nHeight, oFrame.nBitDepth);
+
+        if (nAligned != nHeader)
+            memmove(&rOut[nHeader], &rOut[nAligned], 2 * nSamples);
+        rOut.resize(nHeader + 2 * nSamples);
+    }
+    else
+    {
+        unsigned char *pY = &rOut[nHeader];
+        unsigned char *pU = pY + (size_t)nWidth * nHeight;
+        unsigned char *pV = pU + (size_t)nChromaWidth * nChromaHeight;
+
+        memcpy(pY, pSrc, (size_t)nWidth * nHeight);
+        for (unsigned int y = 0; y < nChromaHeight; y++)
+        {
+            const unsigned char *pRow = pSrc + (nHeight + y) * nRowBytes;
+            unsigned char *pOutU = pU + y * nChromaWidth;
+            unsigned char *pOutV = pV + y * nChromaWidth;
+
+            for (unsigned int x = 0; x < nChromaWidth; x++)
+            {
+                pOutU[x] = pRow[2 * x];
+                pOutV[x] = pRow[2 * x + 1];
+            }
+        }
+    }
+
+    oWriter_.release(oFrame.pRaw);
+    oWriter_.writeAt(nStream_, oFrame.llOffset, oFrame.pOut);
+}
+
+void
+FrameFileWriter::flush()
+{
+    oPool_.wait();
+    oWriter_.flush();
+}
+
+const FrameFileWriterStats &
+FrameFileWriter::stats()
+const
+{
+    return oStats_;
+}
+
+const AsyncFileWriterStats &
+FrameFileWriter::writerStats()
+const
+{
+    return oWriter_.stats();
+}
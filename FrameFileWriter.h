@@ -0,0 +1,141 @@
+/*
+* File		: FrameFileWriter.h
+* Time : 2026 - 10 - 19
+*/
+
+#ifndef FRAMEFILEWRITER_H
+#define FRAMEFILEWRITER_H
+
+#include "AsyncFileWriter.h"
+#include "FrameSink.h"
+#include "WorkStealingPool.h"
+
+#include <atomic>
+#include <string>
+
+enum FrameFileFormat
+{
+    FrameFileFormat_Y4M = 0,    // one .y4m stream, 8-bit or C420p10/p12 with 16-bit samples
+    FrameFileFormat_NV12,       // one raw stream of the decoded planes (P016 for high bit depth)
+    FrameFileFormat_I420,       // one raw planar stream, 16-bit samples for high bit depth
+    FrameFileFormat_PNG,        // a file per frame, needs OpenCV
+    FrameFileFormat_JPEG        // a file per frame, needs OpenCV
+};
+
+// Writer counters; safe to read from any thread.
+struct FrameFileWriterStats
+{
+    std::atomic<unsigned long> nFrames;         // handed to the writer
+    std::atomic<unsigned long> nDropped;        // no free buffer with bDropWhenBusy
+    std::atomic<unsigned long> nSizeChanges;    // frames left out of a stream of another size
+    std::atomic<unsigned long> nErrors;         // readback or encode failed
+
+    FrameFileWriterStats()
+        : nFrames(0), nDropped(0), nSizeChanges(0), nErrors(0)
+    {
+    }
+
+  private:
+    // Copy constructor. Don't implement.
+    FrameFileWriterStats(const FrameFileWriterStats &);
+
+    // Assignment operator. Don't implement.
+    void
+    operator= (const FrameFileWriterStats &);
+};
+
+// Frame sink that puts decoded frames on disk.
+//  The decode thread only copies the frame to a recycled host buffer and,
+// for the stream formats, reserves the frame's range of the output file;
+// conversion (NV12 -> I420, Y4M framing) and PNG/JPEG encoding run on a
+// small pool, and the writes on the AsyncFileWriter threads, so ranges of
+// one stream go to disk in parallel and out of order. Every frame in
+// flight holds two buffers (readback, output; NV12 needs only one).
+// With bDropWhenBusy a frame that finds no free buffer is dropped instead
+// of stalling the decoder.
+//
+// Stream formats go to sPath. PNG and JPEG frames are written as
+// <sPath>_<frame number>.png/.jpg, high bit depth narrowed to 8 bits.
+class FrameFileWriter : public FrameSink
+{
+    public:
+        // Parameters:
+        //      dFrameRate - rate written to the Y4M header, 0 for 25.
+        //      nEncodeThreads - conversion/encode workers.
+        //      nWriterThreads, nBuffers - see AsyncFileWriter.
+        FrameFileWriter(const std::string &sPath, FrameFileFormat eFormat, double dFrameRate = 0,
+                        bool bDropWhenBusy = false, unsigned int nEncodeThreads = 2,
+                        unsigned int nWriterThreads = 4, unsigned int nBuffers = 32);
+
+        // Waits for the frames in flight and closes the output.
+        virtual
+        ~FrameFileWriter();
+
+        // False if the format isn't available in this build.
+        bool
+        isValid()
+        const;
+
+        virtual
+        void
+        onFrame(const DecodedFrame &rFrame);
+
+        // Blocks until every frame handed over so far is on disk.
+        void
+        flush();
+
+        const FrameFileWriterStats &
+        stats()
+        const;
+
+        const AsyncFileWriterStats &
+        writerStats()
+        const;
+
+    private:
+        // Host copy of a frame, planes tightly packed.
+        struct HostFrame
+        {
+            WriteBuffer        *pRaw;
+            WriteBuffer        *pOut;           // 0 for NV12, which writes pRaw
+            unsigned int        nWidth;
+            unsigned int        nHeight;
+            unsigned int        nBitDepth;
+            unsigned long       nFrameNumber;
+            unsigned long long  llOffset;       // in the stream
+        };
+
+        // Copy constructor. Don't implement.
+        FrameFileWriter(const FrameFileWriter &);
+
+        // Assignment operator. Don't implement.
+        void
+        operator= (const FrameFileWriter &);
+
+        // Bytes a frame takes in the output stream, header excluded.
+        size_t
+        streamFrameSize(unsigned int nWidth, unsigned int nHeight, unsigned int nBitDepth)
+        const;
+
+        // Writes the Y4M stream header for the first frame.
+        void
+        writeHeader(unsigned int nWidth, unsigned int nHeight, unsigned int nBitDepth);
+
+        // Pool task: converts or encodes pRaw into pOut and writes it.
+        void
+        convertFrame(HostFrame oFrame);
+
+        std::string                 sPath_;
+        FrameFileFormat             eFormat_;
+        double                      dFrameRate_;
+        bool                        bDropWhenBusy_;
+        FrameFileWriterStats        oStats_;
+        AsyncFileWriter             oWriter_;
+        WorkStealingPool            oPool_;
+        int                         nStream_;           // -1 for per-frame files
+        unsigned int                nStreamWidth_;      // 0 until the first frame
+        unsigned int                nStreamHeight_;
+        unsigned int                nStreamBitDepth_;
+};
+
+#endif // FRAMEFILEWRITER_H
@@ -0,0 +1,92 @@
+/*
+* File		: FrameSink.h
+* Time : 2026 - 10 - 19
+*/
+
+#ifndef FRAMESINK_H
+#define FRAMESINK_H
+
+#include <cuda.h>
+#include <cuviddec.h>
+
+#include <algorithm>
+#include <mutex>
+#include <vector>
+
+// Bits of DecodedFrame::nFlags.
+enum DecodedFrameFlags
+{
+    // The frame may show artifacts: it was decoded from a stretch of the
+    // bitstream with known loss, or the decoder reported an error for it.
+    DecodedFrame_Corrupt = 0x1,
+    // Intra picture. GOPs start here and seeks land on these.
+    DecodedFrame_KeyFrame = 0x2
+};
+
+// A decoded frame as handed to a FrameSink.
+//  dpFrame is a mapped decoder surface and only valid for the duration
+// of FrameSink::onFrame(); sinks that keep the frame must copy it. The
+// decoder's CUDA context is current during the call.
+struct DecodedFrame
+{
+    CUdeviceptr             dpFrame;
+    unsigned int            nPitch;         // bytes, same for the luma and chroma planes
+    unsigned int            nWidth;
+    unsigned int            nHeight;
+    cudaVideoSurfaceFormat  eFormat;        // NV12 or P016
+    unsigned int            nBitDepth;
+    long long               llTimestamp;    // CUVID timestamp (AV_TIME_BASE units for FFmpeg sources)
+    unsigned long           nFrameNumber;   // display order, counted from 0; decimated frames leave gaps
+    unsigned int            nFlags;         // DecodedFrameFlags
+    long long               llLatencyUs;    // packet arrival to frame available, -1 if unknown
+};
+
+// Receives every displayed frame of a stream, on the decode thread.
+class FrameSink
+{
+    public:
+        virtual
+        ~FrameSink() {}
+
+        virtual
+        void
+        onFrame(const DecodedFrame &rFrame) = 0;
+};
+
+// Hands every frame to several sinks, in the order they were added.
+//  Sinks can be added and removed while frames flow; a removed sink
+// gets no more calls once remove() returns. A slow sink holds up the
+// ones after it, so subscribers that must not should buffer on their own
+// (e.g. LatestFrameMailbox).
+class FrameFanout : public FrameSink
+{
+    public:
+        void
+        add(FrameSink *pSink)
+        {
+            std::lock_guard<std::mutex> oLock(oMutex_);
+            aSinks_.push_back(pSink);
+        }
+
+        void
+        remove(FrameSink *pSink)
+        {
+            std::lock_guard<std::mutex> oLock(oMutex_);
+            aSinks_.erase(std::remove(aSinks_.begin(), aSinks_.end(), pSink), aSinks_.end());
+        }
+
+        virtual
+        void
+        onFrame(const DecodedFrame &rFrame)
+        {
+            std::lock_guard<std::mutex> oLock(oMutex_);
+            for (size_t i = 0; i < aSinks_.size(); i++)
+                aSinks_[i]->onFrame(rFrame);
+        }
+
+    private:
+        std::mutex                  oMutex_;
+        std::vector<FrameSink *>    aSinks_;
+};
+
+#endif // FRAMESINK_H
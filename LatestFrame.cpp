@@ -0,0 +1,160 @@
+/*
+* File		: LatestFrame.cpp
+* Time : 2026 - 10 - 19
+*/
+
+#include "LatestFrame.h"
+
+#include <chrono>
+#include <stdio.h>
+#include <string.h>
+
+LatestFrameMailbox::LatestFrameMailbox()
+    : nBack_(0)
+    , nFront_(1)
+    , nMiddle_(2)
+    , oContext_(0)
+    , hStream_(0)
+    , llPublished_(0)
+    , llSkipped_(0)
+    , llTaken_(0)
+{
+    memset(aSlots_, 0, sizeof(aSlots_));
+}
+
+LatestFrameMailbox::~LatestFrameMailbox()
+{
+    if (!oContext_)
+        return;
+
+    cuCtxPushCurrent(oContext_);
+    for (unsigned int i = 0; i < 3; i++)
+    {
+        if (aSlots_[i].dpFrame)
+            cuMemFree(aSlots_[i].dpFrame);
+    }
+    if (hStream_)
+        cuStreamDestroy(hStream_);
+    cuCtxPopCurrent(NULL);
+}
+
+bool
+LatestFrameMailbox::copyFrame(Slot &rSlot, const DecodedFrame &rFrame)
+{
+    unsigned int nRowBytes = rFrame.nWidth * (rFrame.nBitDepth > 8 ? 2 : 1);
+    unsigned int nRows     = rFrame.nHeight * 3 / 2;
+
+    if (!oContext_)
+        cuCtxGetCurrent(&oContext_);
+    // Its own stream: waiting for the copy doesn't wait for the whole context
+    if (!hStream_ && cuStreamCreate(&hStream_, CU_STREAM_NON_BLOCKING) != CUDA_SUCCESS)
+    {
+        printf("LatestFrameMailbox: can't create a copy stream\n");
+        hStream_ = 0;
+        return false;
+    }
+
+    if (rSlot.nRowBytes < nRowBytes || rSlot.nRows < nRows)
+    {
+        if (rSlot.dpFrame)
+            cuMemFree(rSlot.dpFrame);
+        rSlot.dpFrame   = 0;
+        rSlot.nRowBytes = 0;
+        rSlot.nRows     = 0;
+
+        if (cuMemAllocPitch(&rSlot.dpFrame, &rSlot.nPitch, nRowBytes, nRows, 16) != CUDA_SUCCESS)
+        {
+            printf("LatestFrameMailbox: can't allocate a %ux%u frame buffer\n", nRowBytes, nRows);
+            rSlot.dpFrame = 0;
+            return false;
+        }
+        rSlot.nRowBytes = nRowBytes;
+        rSlot.nRows     = nRows;
+    }
+
+    CUDA_MEMCPY2D oCopy;
+    memset(&oCopy, 0, sizeof(oCopy));
+    oCopy.srcMemoryType = CU_MEMORYTYPE_DEVICE;
+    oCopy.srcDevice     = rFrame.dpFrame;
+    oCopy.srcPitch      = rFrame.nPitch;
+    oCopy.dstMemoryType = CU_MEMORYTYPE_DEVICE;
+    oCopy.dstDevice     = rSlot.dpFrame;
+    oCopy.dstPitch      = rSlot.nPitch;
+    oCopy.WidthInBytes  = nRowBytes;
+    oCopy.Height        = nRows;
+
+    if (cuMemcpy2DAsync(&oCopy, hStream_) != CUDA_SUCCESS ||
+        cuStreamSynchronize(hStream_) != CUDA_SUCCESS)
+        return false;
+
+    rSlot.oFrame         = rFrame;
+    rSlot.oFrame.dpFrame = rSlot.dpFrame;
+    rSlot.oFrame.nPitch  = (unsigned int)rSlot.nPitch;
+    return true;
+}
+
+void
+LatestFrameMailbox::onFrame(const DecodedFrame &rFrame)
+{
+    Slot &rBack = aSlots_[nBack_];
+
+    if (!copyFrame(rBack, rFrame))
+        return;
+    rBack.llSeq = ++llPublished_;
+
+    // Publish; whatever was in the middle comes back as the next back
+    // buffer. Had it not been taken, it is lost to the reader.
+    unsigned int nOld = nMiddle_.exchange(nBack_ | cnFresh, std::memory_order_acq_rel);
+    nBack_ = nOld & ~cnFresh;
+
+    {
+        std::lock_guard<std::mutex> oLock(oWaitMutex_);
+    }
+    oWaitCond_.notify_one();
+}
+
+bool
+LatestFrameMailbox::take(DecodedFrame &rFrame, unsigned long &nSkipped, int nTimeoutMs)
+{
+    if (!(nMiddle_.load(std::memory_order_acquire) & cnFresh))
+    {
+        if (nTimeoutMs == 0)
+            return false;
+
+        std::chrono::steady_clock::time_point oDeadline =
+            std::chrono::steady_clock::now() + std::chrono::milliseconds(nTimeoutMs);
+
+        std::unique_lock<std::mutex> oLock(oWaitMutex_);
+        while (!(nMiddle_.load(std::memory_order_acquire) & cnFresh))
+        {
+            if (nTimeoutMs < 0)
+                oWaitCond_.wait(oLock);
+            else if (oWaitCond_.wait_until(oLock, oDeadline) == std::cv_status::timeout &&
+                     !(nMiddle_.load(std::memory_order_acquire) & cnFresh))
+                return false;
+        }
+    }
+
+    nFront_ = nMiddle_.exchange(nFront_, std::memory_order_acq_rel) & ~cnFresh;
+
+    const Slot &rFront = aSlots_[nFront_];
+    nSkipped = (unsigned long)(rFront.llSeq - llTaken_ - 1);
+    llSkipped_ += nSkipped;
+    llTaken_ = rFront.llSeq;
+    rFrame = rFront.oFrame;
+    return true;
+}
+
+unsigned long long
+LatestFrameMailbox::published()
+const
+{
+    return llPublished_;
+}
+
+unsigned long long
+LatestFrameMailbox::skipped()
+const
+{
+    return llSkipped_;
+}
@@ -0,0 +1,102 @@
+/*
+* File		: LatestFrame.h
+* Time : 2026 - 10 - 19
+*/
+
+#ifndef LATESTFRAME_H
+#define LATESTFRAME_H
+
+#include "FrameSink.h"
+
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+
+// Single-slot mailbox holding only the newest frame, for consumers that
+// never want a stale one (tracking, live preview).
+//  Triple buffered in device memory: the decode thread copies every frame
+// into the back buffer and swaps it with the middle one in a single
+// atomic exchange, the reader swaps the middle one with the buffer it
+// holds. Neither side ever waits for the other, so however far the
+// reader lags, the decoder runs at its own pace; frames the reader
+// didn't get to are simply overwritten and counted.
+//
+// One reader per mailbox. Several subscribers each take their own
+// mailbox, attached to the decoder through a FrameFanout.
+class LatestFrameMailbox : public FrameSink
+{
+    public:
+        LatestFrameMailbox();
+
+        // Frees the buffers; the decoder must not deliver any more frames.
+        virtual
+        ~LatestFrameMailbox();
+
+        virtual
+        void
+        onFrame(const DecodedFrame &rFrame);
+
+        // Takes the newest frame published since the last take(), waiting
+        // up to nTimeoutMs (0 doesn't wait, -1 waits forever).
+        // rFrame.dpFrame points at the mailbox's copy and stays valid until
+        // the next take(); nSkipped is the number of frames overwritten
+        // since the previous one.
+        // Returns:
+        //      false if there was no new frame in time.
+        bool
+        take(DecodedFrame &rFrame, unsigned long &nSkipped, int nTimeoutMs = 0);
+
+        // Frames published by the decoder.
+        unsigned long long
+        published()
+        const;
+
+        // Frames overwritten before the reader took them, in total.
+        unsigned long long
+        skipped()
+        const;
+
+    private:
+        struct Slot
+        {
+            CUdeviceptr         dpFrame;
+            size_t              nPitch;
+            unsigned int        nRowBytes;  // allocated size
+            unsigned int        nRows;
+            DecodedFrame        oFrame;     // dpFrame and nPitch point at the slot
+            unsigned long long  llSeq;      // 1-based publish number
+        };
+
+        // Copy constructor. Don't implement.
+        LatestFrameMailbox(const LatestFrameMailbox &);
+
+        // Assignment operator. Don't implement.
+        void
+        operator= (const LatestFrameMailbox &);
+
+        // Copies into the slot, growing it if needed. Returns once the
+        // copy is complete: the decoder reuses its surface right after
+        // onFrame(), and the reader may use the slot as soon as it's out.
+        bool
+        copyFrame(Slot &rSlot, const DecodedFrame &rFrame);
+
+        static const unsigned int cnFresh = 0x4;    // middle slot holds an untaken frame
+
+        Slot                                aSlots_[3];
+        unsigned int                        nBack_;         // decode thread only
+        unsigned int                        nFront_;        // reader only
+        std::atomic<unsigned int>           nMiddle_;       // slot index | cnFresh
+        CUcontext                           oContext_;      // of the buffers, 0 before the first frame
+        CUstream                            hStream_;       // of the copies, in oContext_
+
+        std::atomic<unsigned long long>     llPublished_;
+        std::atomic<unsigned long long>     llSkipped_;
+        unsigned long long                  llTaken_;       // seq of the last frame taken
+
+        // Only held around the reader's check, so a wakeup can't slip in
+        // between it and the wait
+        std::mutex                          oWaitMutex_;
+        std::condition_variable             oWaitCond_;
+};
+
+#endif // LATESTFRAME_H
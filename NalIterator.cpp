@@ -0,0 +1,89 @@
+/*
+* File		: NalIterator.cpp
+* Time : 2026 - 10 - 19
+*/
+
+#include "NalIterator.h"
+
+#include "StartCode.h"
+
+NalIterator::NalIterator(const unsigned char *pData, size_t nSize, cudaVideoCodec eCodec)
+    : pBegin_(pData)
+    , pEnd_(pData + nSize)
+    , pNext_(findStartCode(pData, pData + nSize))
+    , eCodec_(eCodec)
+{
+}
+
+bool
+NalIterator::next(NalUnit &rNal)
+{
+    if (pNext_ >= pEnd_)
+        return false;
+
+    const unsigned char *pHeader = pNext_ + 3;
+    const unsigned char *pFollow = findStartCode(pHeader, pEnd_);
+    const unsigned char *pStop   = pFollow;
+
+    // trailing_zero_8bits, including the leading zero of a four-byte start code
+    while (pStop > pHeader && pStop[-1] == 0)
+        pStop--;
+
+    rNal.pStartCode = (pNext_ > pBegin_ && pNext_[-1] == 0) ? pNext_ - 1 : pNext_;
+    rNal.pData      = pHeader;
+    rNal.nSize      = (size_t)(pStop - pHeader);
+    rNal.nType      = rNal.nSize ? nalType(eCodec_, pHeader) : -1;
+
+    pNext_ = pFollow;
+    return true;
+}
+
+const unsigned char *
+NalIterator::position()
+const
+{
+    return pNext_;
+}
+
+int
+NalIterator::nalType(cudaVideoCodec eCodec, const unsigned char *pHeader)
+{
+    if (eCodec == cudaVideoCodec_HEVC)
+        return (pHeader[0] >> 1) & 0x3F;
+    if (eCodec == cudaVideoCodec_H264)
+        return pHeader[0] & 0x1F;
+    return pHeader[0];
+}
+
+bool
+NalIterator::isVcl(cudaVideoCodec eCodec, int nType)
+{
+    if (eCodec == cudaVideoCodec_HEVC)
+        return nType >= 0 && nType < 32;
+    return nType >= 1 && nType <= 5;
+}
+
+bool
+NalIterator::isKeyFrame(cudaVideoCodec eCodec, int nType)
+{
+    if (eCodec == cudaVideoCodec_HEVC)
+        return nType >= 16 && nType <= 21;
+    return nType == 5;
+}
+
+bool
+NalIterator::startsAccessUnit(cudaVideoCodec eCodec, int nType)
+{
+    if (eCodec == cudaVideoCodec_HEVC)
+        return (nType >= 32 && nType <= 35) || nType == 39;
+    return nType >= 6 && nType <= 9;
+}
+
+bool
+NalIterator::isFirstSlice(cudaVideoCodec eCodec, const NalUnit &rNal)
+{
+    if (eCodec == cudaVideoCodec_HEVC)
+        return rNal.nSize > 2 && (rNal.pData[2] & 0x80) != 0;
+    // first_mb_in_slice is ue(v); 0 is coded as a single 1 bit
+    return rNal.nSize > 1 && (rNal.pData[1] & 0x80) != 0;
+}
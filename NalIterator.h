@@ -0,0 +1,78 @@
+/*
+* File		: NalIterator.h
+* Time : 2026 - 10 - 19
+*/
+
+#ifndef NALITERATOR_H
+#define NALITERATOR_H
+
+#include <nvcuvid.h>
+
+#include <stddef.h>
+
+// One NAL unit of an Annex-B buffer, pointing into that buffer.
+struct NalUnit
+{
+    const unsigned char *pStartCode;    // first byte of the 00 00 01 / 00 00 00 01 prefix
+    const unsigned char *pData;         // NAL header
+    size_t               nSize;         // header + payload, trailing zero bytes excluded
+    int                  nType;         // nal_unit_type of the codec
+};
+
+// Walks the NAL units of an Annex-B buffer without copying.
+//  Boundaries come from findStartCode(), so the SIMD search does the
+// heavy lifting. Works for H.264 and HEVC (nType and the helpers below
+// depend on the codec); for other codecs nType is the raw first byte.
+//
+//  NalIterator oNals(pData, nSize, cudaVideoCodec_H264);
+//  NalUnit oNal;
+//  while (oNals.next(oNal)) ...
+class NalIterator
+{
+    public:
+        NalIterator(const unsigned char *pData, size_t nSize, cudaVideoCodec eCodec);
+
+        // Returns false after the last NAL unit.
+        bool
+        next(NalUnit &rNal);
+
+        // Bytes consumed so far; the start code of the next NAL unit.
+        const unsigned char *
+        position()
+        const;
+
+        // nal_unit_type from the header at pHeader.
+        static
+        int
+        nalType(cudaVideoCodec eCodec, const unsigned char *pHeader);
+
+        // Slice data (H.264 types 1-5, HEVC types 0-31).
+        static
+        bool
+        isVcl(cudaVideoCodec eCodec, int nType);
+
+        // Decoding can start here: H.264 IDR, HEVC BLA/IDR/CRA.
+        static
+        bool
+        isKeyFrame(cudaVideoCodec eCodec, int nType);
+
+        // AUD, parameter sets and prefix SEI: open an access unit when
+        // they follow a picture.
+        static
+        bool
+        startsAccessUnit(cudaVideoCodec eCodec, int nType);
+
+        // True for a slice that begins a new picture (first_mb_in_slice == 0,
+        // first_slice_segment_in_pic_flag). rNal must be a VCL NAL unit.
+        static
+        bool
+        isFirstSlice(cudaVideoCodec eCodec, const NalUnit &rNal);
+
+    private:
+        const unsigned char *pBegin_;
+        const unsigned char *pEnd_;
+        const unsigned char *pNext_;    // start code of the next NAL unit, pEnd_ if none
+        cudaVideoCodec       eCodec_;
+};
+
+#endif // NALITERATOR_H
@@ -0,0 +1,571 @@
+/*
+* File		: RtpReceiver.cpp
+* Time : 2026 - 10 - 19
+*/
+
+#include "RtpReceiver.h"
+
+#include "DecodeStats.h"
+#include "NalIterator.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+static const unsigned char caStartCode[4] = { 0, 0, 0, 1 };
+
+RtpReceiver::RtpReceiver(const RtpReceiverParams &rParams)
+    : oParams_(rParams)
+    , nSlotsUsed_(0)
+    , bHaveSeq_(false)
+    , nNextSeq_(0)
+    , nHighestSeq_(0)
+    , nScratchSize_(0)
+    , llScratchArrivalUs_(0)
+    , bPending_(false)
+    , bUnitOpen_(false)
+    , nUnitTimestamp_(0)
+    , llUnitArrivalUs_(0)
+    , bUnitKey_(false)
+    , bUnitLossBefore_(false)
+    , bUnitIncomplete_(false)
+    , bInFragment_(false)
+    , bLossPending_(false)
+    , bHaveTimestamp_(false)
+    , nLastTimestamp_(0)
+    , llExtTimestamp_(0)
+{
+    if (oParams_.nJitterDepth < 2)
+        oParams_.nJitterDepth = 2;
+    // Sequence distances are compared as signed 16-bit numbers
+    if (oParams_.nJitterDepth > 16384)
+        oParams_.nJitterDepth = 16384;
+    // Slots are indexed nSeq % depth: only a power of two divides 65536,
+    // so that the index doesn't jump where the sequence number wraps
+    unsigned int nDepth = 2;
+    while (nDepth < oParams_.nJitterDepth)
+        nDepth *= 2;
+    oParams_.nJitterDepth = nDepth;
+
+    aSlots_.resize(oParams_.nJitterDepth);
+    for (size_t i = 0; i < aSlots_.size(); i++)
+        aSlots_[i].bUsed = false;
+
+    // A 4K intra picture rarely exceeds this; the buffers grow once if it does
+    aUnit_.reserve(2 * 1024 * 1024);
+    aReady_.reserve(2 * 1024 * 1024);
+    memset(&oReady_, 0, sizeof(oReady_));
+}
+
+RtpReceiver::~RtpReceiver()
+{
+    close();
+}
+
+bool
+RtpReceiver::open()
+{
+    return oSocket_.open(oParams_.sBindAddress, oParams_.nPort, oParams_.nSocketBufferSize);
+}
+
+void
+RtpReceiver::close()
+{
+    oSocket_.close();
+}
+
+const RtpReceiverStats &
+RtpReceiver::stats()
+const
+{
+    return oStats_;
+}
+
+const RtpReceiverParams &
+RtpReceiver::params()
+const
+{
+    return oParams_;
+}
+
+bool
+RtpReceiver::receive(AccessUnit &rUnit, int nTimeoutMs)
+{
+    long long llDeadline = steadyClockUs() + (long long)nTimeoutMs * 1000;
+
+    for (;;)
+    {
+        bool bForce = false;
+
+        if (bPending_)
+        {
+            if (storePacket())
+                bPending_ = false;
+            else
+                bForce = true;
+        }
+
+        if (drain(bForce))
+        {
+            rUnit = oReady_;
+            return true;
+        }
+
+        // Still doesn't fit: keep giving up the head until it does
+        if (bPending_)
+            continue;
+
+        long long llNow  = steadyClockUs();
+        long long llWait = llDeadline - llNow;
+
+        if (llWait <= 0)
+            return false;
+
+        // Wake up in time to give up on a missing packet
+        long long llOldest = oldestArrival();
+        if (llOldest >= 0)
+        {
+            long long llGapWait = llOldest + (long long)oParams_.nJitterDelayMs * 1000 - llNow;
+            if (llGapWait < llWait)
+                llWait = llGapWait > 0 ? llGapWait : 0;
+        }
+
+        readPacket((int)((llWait + 999) / 1000));
+    }
+}
+
+bool
+RtpReceiver::readPacket(int nTimeoutMs)
+{
+    int nSize = oSocket_.receive(aScratch_, cnMaxPacketSize, nTimeoutMs);
+    if (nSize <= 0)
+        return false;
+
+    nScratchSize_       = nSize;
+    llScratchArrivalUs_ = steadyClockUs();
+    bPending_           = true;
+
+    return true;
+}
+
+bool
+RtpReceiver::storePacket()
+{
+    const unsigned char *p = aScratch_;
+    int nSize = nScratchSize_;
+
+    // RFC 3550 fixed header
+    if (nSize < 12 || (p[0] >> 6) != 2)
+    {
+        oStats_.nMalformed++;
+        return true;
+    }
+
+    int  nPayloadType = p[1] & 0x7F;
+    bool bMarker      = (p[1] & 0x80) != 0;
+    unsigned short nSeq = (unsigned short)((p[2] << 8) | p[3]);
+    unsigned int nTimestamp = ((unsigned int)p[4] << 24) | (p[5] << 16) | (p[6] << 8) | p[7];
+
+    int nOffset = 12 + 4 * (p[0] & 0x0F);
+
+    if (p[0] & 0x10)
+    {
+        if (nOffset + 4 > nSize)
+        {
+            oStats_.nMalformed++;
+            return true;
+        }
+        nOffset += 4 + 4 * ((p[nOffset + 2] << 8) | p[nOffset + 3]);
+    }
+
+    // The last padding byte counts the padding, itself included
+    if (p[0] & 0x20)
+    {
+        if (p[nSize - 1] == 0 || p[nSize - 1] > nSize - 12)
+        {
+            oStats_.nMalformed++;
+            return true;
+        }
+        nSize -= p[nSize - 1];
+    }
+
+    if (nOffset >= nSize)
+    {
+        oStats_.nMalformed++;
+        return true;
+    }
+
+    // RTCP on the same port and other payloads are ignored
+    if (oParams_.nPayloadType >= 0 && nPayloadType != oParams_.nPayloadType)
+        return true;
+
+    if (!bHaveSeq_)
+    {
+        bHaveSeq_    = true;
+        nNextSeq_    = nSeq;
+        nHighestSeq_ = nSeq;
+    }
+
+    int nDepth = (int)aSlots_.size();
+    int nDiff  = (short)(nSeq - nNextSeq_);
+
+    if (nDiff < 0)
+    {
+        // A sender restart looks like a large jump back; start over from it
+        if (nDiff < -nDepth && nSlotsUsed_ == 0)
+        {
+            nNextSeq_    = nSeq;
+            nHighestSeq_ = nSeq;
+            nDiff        = 0;
+            bLossPending_ = true;
+        }
+        else
+        {
+            oStats_.nLate++;
+            return true;
+        }
+    }
+
+    if (nDiff >= nDepth)
+    {
+        if (nSlotsUsed_ > 0)
+            return false;
+
+        // Nothing buffered to give up: everything up to this packet is gone
+        oStats_.nLost += nDiff;
+        nNextSeq_     = nSeq;
+        nHighestSeq_  = nSeq;
+        bLossPending_ = true;
+        bInFragment_  = false;
+        if (bUnitOpen_)
+            bUnitIncomplete_ = true;
+    }
+
+    Slot &rSlot = aSlots_[nSeq % nDepth];
+
+    if (rSlot.bUsed)
+    {
+        // duplicate
+        return true;
+    }
+
+    if ((short)(nSeq - nHighestSeq_) < 0)
+        oStats_.nReordered++;
+    else
+        nHighestSeq_ = nSeq;
+
+    memcpy(rSlot.aData, aScratch_, nSize);
+    rSlot.bUsed          = true;
+    rSlot.bMarker        = bMarker;
+    rSlot.nSeq           = nSeq;
+    rSlot.nTimestamp     = nTimestamp;
+    rSlot.llArrivalUs    = llScratchArrivalUs_;
+    rSlot.nPayloadOffset = nOffset;
+    rSlot.nPayloadSize   = nSize - nOffset;
+    nSlotsUsed_++;
+    oStats_.nPackets++;
+
+    return true;
+}
+
+long long
+RtpReceiver::oldestArrival()
+const
+{
+    if (nSlotsUsed_ == 0)
+        return -1;
+
+    long long llOldest = -1;
+
+    for (size_t i = 0; i < aSlots_.size(); i++)
+    {
+        if (aSlots_[i].bUsed && (llOldest < 0 || aSlots_[i].llArrivalUs < llOldest))
+            llOldest = aSlots_[i].llArrivalUs;
+    }
+
+    return llOldest;
+}
+
+bool
+RtpReceiver::drain(bool bForce)
+{
+    int nDepth = (int)aSlots_.size();
+
+    while (nSlotsUsed_ > 0)
+    {
+        Slot &rSlot = aSlots_[nNextSeq_ % nDepth];
+
+        if (!rSlot.bUsed)
+        {
+            bool bGiveUp = bForce || nSlotsUsed_ >= (unsigned int)nDepth - 1 ||
+                           steadyClockUs() - oldestArrival() >= (long long)oParams_.nJitterDelayMs * 1000;
+
+            if (!bGiveUp)
+                return false;
+
+            oStats_.nLost++;
+            nNextSeq_++;
+            bLossPending_ = true;
+            bInFragment_  = false;
+            if (bUnitOpen_)
+                bUnitIncomplete_ = true;
+            continue;
+        }
+
+        // A new timestamp ends the previous access unit even if its marker
+        // packet was lost; leave this packet for the next call
+        if (bUnitOpen_ && rSlot.nTimestamp != nUnitTimestamp_)
+        {
+            if (bInFragment_)
+                bUnitIncomplete_ = true;
+            if (finishUnit())
+                return true;
+        }
+
+        if (!bUnitOpen_)
+            beginUnit(rSlot.nTimestamp, rSlot.llArrivalUs);
+
+        depacketize(rSlot.aData + rSlot.nPayloadOffset, rSlot.nPayloadSize);
+
+        bool bMarker = rSlot.bMarker;
+        rSlot.bUsed = false;
+        nSlotsUsed_--;
+        nNextSeq_++;
+
+        if (bMarker && finishUnit())
+            return true;
+    }
+
+    return false;
+}
+
+void
+RtpReceiver::beginUnit(unsigned int nTimestamp, long long llArrivalUs)
+{
+    aUnit_.clear();
+    bUnitOpen_       = true;
+    nUnitTimestamp_  = nTimestamp;
+    llUnitArrivalUs_ = llArrivalUs;
+    bUnitKey_        = false;
+    bUnitIncomplete_ = false;
+    bUnitLossBefore_ = bLossPending_;
+    bLossPending_    = false;
+    bInFragment_     = false;
+
+    // 32-bit 90kHz clock, unwrapped so it keeps increasing
+    if (!bHaveTimestamp_)
+    {
+        bHaveTimestamp_ = true;
+        llExtTimestamp_ = nTimestamp;
+    }
+    else
+    {
+        llExtTimestamp_ += (int)(nTimestamp - nLastTimestamp_);
+    }
+    nLastTimestamp_ = nTimestamp;
+}
+
+bool
+RtpReceiver::finishUnit()
+{
+    bUnitOpen_ = false;
+
+    if (aUnit_.empty())
+        return false;
+
+    // Double buffering: the caller reads aReady_ while aUnit_ fills again
+    aReady_.swap(aUnit_);
+    aUnit_.clear();
+
+    oReady_.pData       = &aReady_[0];
+    oReady_.nSize       = aReady_.size();
+    oReady_.llTimestamp = llExtTimestamp_ * 100 / 9;
+    oReady_.llArrivalUs = llUnitArrivalUs_;
+    oReady_.bKeyFrame   = bUnitKey_;
+    oReady_.bLossBefore = bUnitLossBefore_;
+    oReady_.bIncomplete = bUnitIncomplete_;
+    oStats_.nAccessUnits++;
+
+    return true;
+}
+
+void
+RtpReceiver::appendNal(const unsigned char *pHeader, int nHeaderSize, const unsigned char *pBody, int nBodySize)
+{
+    aUnit_.insert(aUnit_.end(), caStartCode, caStartCode + 4);
+    aUnit_.insert(aUnit_.end(), pHeader, pHeader + nHeaderSize);
+    if (nBodySize > 0)
+        aUnit_.insert(aUnit_.end(), pBody, pBody + nBodySize);
+
+    noteNalType(pHeader);
+}
+
+void
+RtpReceiver::noteNalType(const unsigned char *pHeader)
+{
+    if (NalIterator::isKeyFrame(oParams_.eCodec, NalIterator::nalType(oParams_.eCodec, pHeader)))
+        bUnitKey_ = true;
+}
+
+void
+RtpReceiver::depacketize(const unsigned char *p, int nSize)
+{
+    bool bHevc        = (oParams_.eCodec == cudaVideoCodec_HEVC);
+    int  nHeaderSize  = bHevc ? 2 : 1;
+
+    if (nSize < nHeaderSize)
+    {
+        oStats_.nMalformed++;
+        return;
+    }
+
+    int nType       = bHevc ? ((p[0] >> 1) & 0x3F) : (p[0] & 0x1F);
+    int nAggregate  = bHevc ? 48 : 24;      // STAP-A / AP
+    int nFragment   = bHevc ? 49 : 28;      // FU-A / FU
+    bool bSingle    = bHevc ? (nType < 48) : (nType >= 1 && nType <= 23);
+
+    if (bSingle)
+    {
+        bInFragment_ = false;
+        appendNal(p, nSize, NULL, 0);
+    }
+    else if (nType == nAggregate)
+    {
+        bInFragment_ = false;
+        int nOffset = nHeaderSize;
+
+        while (nOffset + 2 <= nSize)
+        {
+            int nNalSize = (p[nOffset] << 8) | p[nOffset + 1];
+            nOffset += 2;
+
+            if (nNalSize < nHeaderSize || nOffset + nNalSize > nSize)
+            {
+                oStats_.nMalformed++;
+                bUnitIncomplete_ = true;
+                return;
+            }
+
+            appendNal(p + nOffset, nNalSize, NULL, 0);
+            nOffset += nNalSize;
+        }
+    }
+    else if (nType == nFragment)
+    {
+        if (nSize < nHeaderSize + 2)
+        {
+            oStats_.nMalformed++;
+            return;
+        }
+
+        unsigned char nFuHeader = p[nHeaderSize];
+        bool bStart = (nFuHeader & 0x80) != 0;
+        bool bEnd   = (nFuHeader & 0x40) != 0;
+        const unsigned char *pBody = p + nHeaderSize + 1;
+        int nBodySize = nSize - nHeaderSize - 1;
+
+        if (bStart)
+        {
+            // Rebuild the NAL header from the indicator and the FU header
+            unsigned char aHeader[2];
+            if (bHevc)
+            {
+                aHeader[0] = (unsigned char)((p[0] & 0x81) | ((nFuHeader & 0x3F) << 1));
+                aHeader[1] = p[1];
+            }
+            else
+            {
+                aHeader[0] = (unsigned char)((p[0] & 0xE0) | (nFuHeader & 0x1F));
+            }
+            appendNal(aHeader, nHeaderSize, pBody, nBodySize);
+            bInFragment_ = !bEnd;
+        }
+        else if (bInFragment_)
+        {
+            aUnit_.insert(aUnit_.end(), pBody, pBody + nBodySize);
+            bInFragment_ = !bEnd;
+        }
+        else
+        {
+            // The start of this NAL unit was lost
+            bUnitIncomplete_ = true;
+        }
+    }
+    else
+    {
+        // STAP-B, MTAP, FU-B and PACI need interleaved mode, not supported
+        oStats_.nMalformed++;
+    }
+}
+
+bool
+RtpReceiver::parseUrl(const std::string &sUrl, RtpReceiverParams &rParams)
+{
+    static const char cszScheme[] = "rtp+native://";
+    const size_t cnSchemeLength = sizeof(cszScheme) - 1;
+
+    if (sUrl.compare(0, cnSchemeLength, cszScheme) != 0)
+        return false;
+
+    std::string sRest  = sUrl.substr(cnSchemeLength);
+    std::string sQuery;
+    size_t nQuery = sRest.find('?');
+
+    if (nQuery != std::string::npos)
+    {
+        sQuery = sRest.substr(nQuery + 1);
+        sRest  = sRest.substr(0, nQuery);
+    }
+
+    // FFmpeg style "@" for "listen on"
+    if (!sRest.empty() && sRest[0] == '@')
+        sRest = sRest.substr(1);
+
+    size_t nColon = sRest.rfind(':');
+    if (nColon == std::string::npos)
+    {
+        printf("RtpReceiver: no port in %s\n", sUrl.c_str());
+        return false;
+    }
+
+    rParams.sBindAddress = sRest.substr(0, nColon);
+    rParams.nPort        = (unsigned short)atoi(sRest.c_str() + nColon + 1);
+
+    while (!sQuery.empty())
+    {
+        size_t nAmp = sQuery.find('&');
+        std::string sItem = sQuery.substr(0, nAmp);
+        sQuery = (nAmp == std::string::npos) ? std::string() : sQuery.substr(nAmp + 1);
+
+        size_t nEquals = sItem.find('=');
+        if (nEquals == std::string::npos)
+            continue;
+
+        std::string sKey   = sItem.substr(0, nEquals);
+        std::string sValue = sItem.substr(nEquals + 1);
+
+        if (sKey == "codec")
+        {
+            if (sValue == "hevc" || sValue == "h265")
+                rParams.eCodec = cudaVideoCodec_HEVC;
+            else if (sValue == "h264")
+                rParams.eCodec = cudaVideoCodec_H264;
+            else
+                printf("RtpReceiver: unsupported codec %s, using H.264\n", sValue.c_str());
+        }
+        else if (sKey == "pt")
+            rParams.nPayloadType = atoi(sValue.c_str());
+        else if (sKey == "jitter")
+            rParams.nJitterDepth = (unsigned int)atoi(sValue.c_str());
+        else if (sKey == "delay")
+            rParams.nJitterDelayMs = (unsigned int)atoi(sValue.c_str());
+        else if (sKey == "width")
+            rParams.nWidth = (unsigned int)atoi(sValue.c_str());
+        else if (sKey == "height")
+            rParams.nHeight = (unsigned int)atoi(sValue.c_str());
+        else if (sKey == "buffer")
+            rParams.nSocketBufferSize = atoi(sValue.c_str());
+    }
+
+    return rParams.nPort != 0;
+}
@@ -0,0 +1,204 @@
+/*
+* File		: RtpReceiver.h
+* Time : 2026 - 10 - 19
+*/
+
+#ifndef RTPRECEIVER_H
+#define RTPRECEIVER_H
+
+#include <nvcuvid.h>
+
+#include "AccessUnit.h"
+#include "UdpSocket.h"
+
+#include <atomic>
+#include <string>
+#include <vector>
+
+// Where and what RtpReceiver listens for.
+struct RtpReceiverParams
+{
+    std::string     sBindAddress;       // local or multicast address, empty for any
+    unsigned short  nPort;
+    cudaVideoCodec  eCodec;             // H264 or HEVC
+    int             nPayloadType;       // -1 accepts any payload type
+    unsigned int    nJitterDepth;       // packets held for reordering, rounded up to a power of two
+    unsigned int    nJitterDelayMs;     // longest wait for a missing packet
+    unsigned int    nWidth;             // decoder size until the first SPS
+    unsigned int    nHeight;            //  says otherwise
+    int             nSocketBufferSize;  // SO_RCVBUF, bytes
+
+    RtpReceiverParams()
+        : nPort(5004), eCodec(cudaVideoCodec_H264), nPayloadType(-1)
+        , nJitterDepth(256), nJitterDelayMs(40)
+        , nWidth(1920), nHeight(1080), nSocketBufferSize(4 * 1024 * 1024)
+    {
+    }
+};
+
+// Packet counters of a receiver; safe to read from any thread.
+struct RtpReceiverStats
+{
+    std::atomic<unsigned long> nPackets;        // RTP packets accepted
+    std::atomic<unsigned long> nLost;           // sequence numbers never received
+    std::atomic<unsigned long> nReordered;      // arrived after a later packet
+    std::atomic<unsigned long> nLate;           // arrived after their slot was given up, dropped
+    std::atomic<unsigned long> nMalformed;      // bad header or payload, dropped
+    std::atomic<unsigned long> nAccessUnits;
+
+    RtpReceiverStats()
+        : nPackets(0), nLost(0), nReordered(0), nLate(0), nMalformed(0), nAccessUnits(0)
+    {
+    }
+
+  private:
+    // Copy constructor. Don't implement.
+    RtpReceiverStats(const RtpReceiverStats &);
+
+    // Assignment operator. Don't implement.
+    void
+    operator= (const RtpReceiverStats &);
+};
+
+// Receives H.264 (RFC 6184) or HEVC (RFC 7798) over plain RTP/UDP and
+// reassembles access units for the CUDA video parser.
+//  Single NAL unit packets, STAP-A/AP aggregates and FU-A/FU fragments
+// are supported (non-interleaved mode, no DONL). Packets go through a
+// jitter buffer of nJitterDepth preallocated slots indexed by sequence
+// number; a missing packet is waited for at most nJitterDelayMs, or until
+// the buffer fills up, and then reported as lost. No memory is allocated
+// per packet: slots and the access-unit buffer are reused.
+//
+// All methods except stats() must be called from one thread.
+class RtpReceiver
+{
+    public:
+        // Largest RTP packet accepted; anything bigger is dropped.
+        static const int cnMaxPacketSize = 2048;
+
+        explicit
+        RtpReceiver(const RtpReceiverParams &rParams);
+
+        ~RtpReceiver();
+
+        // Binds the UDP socket (joining the group for a multicast address).
+        // Returns false (and prints why) on failure.
+        bool
+        open();
+
+        void
+        close();
+
+        // Waits up to nTimeoutMs for the next complete access unit. The
+        // timestamp is the unwrapped RTP timestamp in microseconds and
+        // bKeyFrame is set for IDR (H.264) or IRAP (HEVC) pictures.
+        // Returns:
+        //      true and fills rUnit if one is ready, false on timeout.
+        bool
+        receive(AccessUnit &rUnit, int nTimeoutMs);
+
+        const RtpReceiverStats &
+        stats()
+        const;
+
+        const RtpReceiverParams &
+        params()
+        const;
+
+        // Parses "rtp+native://[address]:port[?codec=h264|hevc&pt=N&jitter=PACKETS
+        // &delay=MS&width=W&height=H]". Plain rtp:// is left to FFmpeg.
+        static
+        bool
+        parseUrl(const std::string &sUrl, RtpReceiverParams &rParams);
+
+    private:
+        struct Slot
+        {
+            bool            bUsed;
+            bool            bMarker;
+            unsigned short  nSeq;
+            unsigned int    nTimestamp;
+            long long       llArrivalUs;
+            int             nPayloadOffset;
+            int             nPayloadSize;
+            unsigned char   aData[cnMaxPacketSize];
+        };
+
+        // Copy constructor. Don't implement.
+        RtpReceiver(const RtpReceiver &);
+
+        // Assignment operator. Don't implement.
+        void
+        operator= (const RtpReceiver &);
+
+        // Reads one datagram into the scratch buffer. Returns false on timeout.
+        bool
+        readPacket(int nTimeoutMs);
+
+        // Moves the scratch packet into its jitter buffer slot. Returns false
+        // if it is too far ahead to fit; the head of the buffer must be
+        // given up first.
+        bool
+        storePacket();
+
+        // Arrival time of the oldest buffered packet, -1 if none.
+        long long
+        oldestArrival()
+        const;
+
+        // Moves in-order packets out of the jitter buffer into the access
+        // unit, skipping over gaps that waited long enough. Returns true
+        // once an access unit is complete.
+        bool
+        drain(bool bForce);
+
+        // Appends one RTP payload to the access unit being built.
+        void
+        depacketize(const unsigned char *pPayload, int nSize);
+
+        void
+        appendNal(const unsigned char *pHeader, int nHeaderSize, const unsigned char *pBody, int nBodySize);
+
+        void
+        noteNalType(const unsigned char *pHeader);
+
+        // Starts a new access unit for a packet with nTimestamp.
+        void
+        beginUnit(unsigned int nTimestamp, long long llArrivalUs);
+
+        bool
+        finishUnit();
+
+        RtpReceiverParams           oParams_;
+        RtpReceiverStats            oStats_;
+        UdpSocket                   oSocket_;
+
+        std::vector<Slot>           aSlots_;
+        unsigned int                nSlotsUsed_;
+        bool                        bHaveSeq_;
+        unsigned short              nNextSeq_;
+        unsigned short              nHighestSeq_;
+
+        unsigned char               aScratch_[cnMaxPacketSize];
+        int                         nScratchSize_;
+        long long                   llScratchArrivalUs_;
+        bool                        bPending_;      // aScratch_ holds a packet not stored yet
+
+        std::vector<unsigned char>  aUnit_;         // access unit being built, reused
+        std::vector<unsigned char>  aReady_;        // last completed access unit, reused
+        AccessUnit                  oReady_;
+        bool                        bUnitOpen_;
+        unsigned int                nUnitTimestamp_;
+        long long                   llUnitArrivalUs_;
+        bool                        bUnitKey_;
+        bool                        bUnitLossBefore_;
+        bool                        bUnitIncomplete_;
+        bool                        bInFragment_;
+        bool                        bLossPending_;
+
+        bool                        bHaveTimestamp_;
+        unsigned int                nLastTimestamp_;
+        long long                   llExtTimestamp_;
+};
+
+#endif // RTPRECEIVER_H
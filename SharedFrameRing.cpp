@@ -0,0 +1,396 @@
+/*
+* File		: SharedFrameRing.cpp
+* Time : 2026 - 10 - 19
+*/
+
+#include "SharedFrameRing.h"
+
+#include <chrono>
+#include <new>
+#include <stdio.h>
+#include <string.h>
+
+#if defined(__linux__)
+#include <errno.h>
+#include <fcntl.h>
+#include <linux/futex.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <time.h>
+#include <unistd.h>
+#endif
+
+static_assert(sizeof(SharedRingHeader) == 64, "ring header layout is shared with other processes");
+static_assert(sizeof(SharedSlotHeader) == 64, "slot header layout is shared with other processes");
+
+static const uint32_t cnSharedRingVersion = 1;
+static const size_t   cnPageBytes         = 4096;
+
+static
+size_t
+roundToPage(size_t nBytes)
+{
+    return (nBytes + cnPageBytes - 1) / cnPageBytes * cnPageBytes;
+}
+
+#if defined(__linux__)
+// Not FUTEX_PRIVATE: the word is shared between processes.
+static
+void
+futexWait(std::atomic<uint32_t> *pWord, uint32_t nValue, int nTimeoutMs)
+{
+    struct timespec oTimeout;
+    oTimeout.tv_sec  = nTimeoutMs / 1000;
+    oTimeout.tv_nsec = (nTimeoutMs % 1000) * 1000000L;
+
+    syscall(SYS_futex, (uint32_t *)pWord, FUTEX_WAIT, nValue, nTimeoutMs >= 0 ? &oTimeout : NULL, NULL, 0);
+}
+
+static
+void
+futexWakeAll(std::atomic<uint32_t> *pWord)
+{
+    syscall(SYS_futex, (uint32_t *)pWord, FUTEX_WAKE, 0x7fffffff, NULL, NULL, 0);
+}
+#endif
+
+SharedFrameWriter::SharedFrameWriter(const std::string &sName, unsigned int nSlots, size_t nSlotBytes)
+    : sName_(sName)
+    , pBase_(0)
+    , nBytes_(0)
+    , pHeader_(0)
+    , bRegistered_(false)
+    , nOversized_(0)
+{
+#if defined(__linux__)
+    std::atomic<uint64_t> oProbe(0);
+    if (!oProbe.is_lock_free() || nSlots == 0)
+    {
+        printf("shared frame ring %s: unsupported\n", sName_.c_str());
+        return;
+    }
+
+    size_t nStride = roundToPage(sizeof(SharedSlotHeader) + nSlotBytes);
+    nBytes_ = cnPageBytes + nStride * nSlots;
+
+    // A stale ring of a crashed writer may have another size
+    shm_unlink(sName_.c_str());
+    int fd = shm_open(sName_.c_str(), O_CREAT | O_EXCL | O_RDWR, 0666);
+    if (fd < 0)
+    {
+        printf("shared frame ring %s: shm_open failed (%d)\n", sName_.c_str(), errno);
+        return;
+    }
+    if (ftruncate(fd, (off_t)nBytes_) != 0)
+    {
+        printf("shared frame ring %s: can't size to %lu bytes\n", sName_.c_str(), (unsigned long)nBytes_);
+        close(fd);
+        shm_unlink(sName_.c_str());
+        return;
+    }
+
+    void *pMap = mmap(NULL, nBytes_, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if (pMap == MAP_FAILED)
+    {
+        printf("shared frame ring %s: mmap failed (%d)\n", sName_.c_str(), errno);
+        shm_unlink(sName_.c_str());
+        return;
+    }
+    pBase_ = (unsigned char *)pMap;
+
+    // ftruncate() zeroed the slots, so every llSeq reads as "never written"
+    pHeader_ = new (pBase_) SharedRingHeader;
+    pHeader_->nVersion     = cnSharedRingVersion;
+    pHeader_->nSlots       = nSlots;
+    pHeader_->nHeaderBytes = (uint32_t)cnPageBytes;
+    pHeader_->nSlotStride  = nStride;
+    pHeader_->nSlotBytes   = nStride - sizeof(SharedSlotHeader);
+    pHeader_->llWriteSeq.store(0);
+    pHeader_->nFutex.store(0);
+    pHeader_->nWaiters.store(0);
+    for (unsigned int i = 0; i < nSlots; i++)
+        new (pBase_ + cnPageBytes + i * nStride) SharedSlotHeader;
+
+    // Readers check the magic last
+    std::atomic_thread_fence(std::memory_order_release);
+    pHeader_->nMagic = cnSharedRingMagic;
+#else
+    printf("shared frame ring %s: needs Linux\n", sName_.c_str());
+#endif
+}
+
+SharedFrameWriter::~SharedFrameWriter()
+{
+#if defined(__linux__)
+    if (!pBase_)
+        return;
+
+    // Fails harmlessly when the context is already gone, which dropped
+    // the registration with it
+    if (bRegistered_)
+        cuMemHostUnregister(pBase_);
+    munmap(pBase_, nBytes_);
+    shm_unlink(sName_.c_str());
+#endif
+}
+
+bool
+SharedFrameWriter::isValid()
+const
+{
+    return pHeader_ != 0;
+}
+
+size_t
+SharedFrameWriter::slotBytesFor(unsigned int nWidth, unsigned int nHeight, unsigned int nBitDepth)
+{
+    return (size_t)nWidth * (nBitDepth > 8 ? 2 : 1) * (nHeight + (nHeight + 1) / 2);
+}
+
+void
+SharedFrameWriter::onFrame(const DecodedFrame &rFrame)
+{
+    if (!pHeader_)
+        return;
+
+    size_t nRowBytes = (size_t)rFrame.nWidth * (rFrame.nBitDepth > 8 ? 2 : 1);
+    size_t nRows     = rFrame.nHeight + (rFrame.nHeight + 1) / 2;
+
+    if (nRowBytes * nRows > pHeader_->nSlotBytes)
+    {
+        nOversized_++;
+        return;
+    }
+
+    // First frame: a context is current now, page-lock the mapping so
+    // the readback below is a straight DMA into shared memory
+    if (!bRegistered_)
+        bRegistered_ = cuMemHostRegister(pBase_, nBytes_, CU_MEMHOSTREGISTER_PORTABLE) == CUDA_SUCCESS;
+
+    uint64_t llSeq = pHeader_->llWriteSeq.load(std::memory_order_relaxed);
+    unsigned char *pSlot = pBase_ + pHeader_->nHeaderBytes + (llSeq % pHeader_->nSlots) * pHeader_->nSlotStride;
+    SharedSlotHeader *pSlotHeader = (SharedSlotHeader *)pSlot;
+
+    pSlotHeader->llSeq.store(2 * llSeq + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+
+    CUDA_MEMCPY2D oCopy;
+    memset(&oCopy, 0, sizeof(oCopy));
+    oCopy.srcMemoryType = CU_MEMORYTYPE_DEVICE;
+    oCopy.srcDevice     = rFrame.dpFrame;
+    oCopy.srcPitch      = rFrame.nPitch;
+    oCopy.dstMemoryType = CU_MEMORYTYPE_HOST;
+    oCopy.dstHost       = pSlot + sizeof(SharedSlotHeader);
+    oCopy.dstPitch      = nRowBytes;
+    oCopy.WidthInBytes  = nRowBytes;
+    oCopy.Height        = nRows;
+
+    if (cuMemcpy2D(&oCopy) != CUDA_SUCCESS)
+    {
+        // Leave the slot marked as being written; readers skip it
+        return;
+    }
+
+    pSlotHeader->llTimestamp  = rFrame.llTimestamp;
+    pSlotHeader->nFrameNumber = rFrame.nFrameNumber;
+    pSlotHeader->nWidth       = rFrame.nWidth;
+    pSlotHeader->nHeight      = rFrame.nHeight;
+    pSlotHeader->nPitch       = (uint32_t)nRowBytes;
+    pSlotHeader->nBitDepth    = rFrame.nBitDepth;
+    pSlotHeader->eFormat      = (uint32_t)rFrame.eFormat;
+    pSlotHeader->nFlags       = rFrame.nFlags;
+    pSlotHeader->nBytes       = nRowBytes * nRows;
+
+    pSlotHeader->llSeq.store(2 * llSeq + 2, std::memory_order_release);
+    pHeader_->llWriteSeq.store(llSeq + 1, std::memory_order_release);
+    // Sequentially consistent, so the waiter check below can't move ahead of it
+    pHeader_->nFutex.fetch_add(1);
+
+#if defined(__linux__)
+    if (pHeader_->nWaiters.load() != 0)
+        futexWakeAll(&pHeader_->nFutex);
+#endif
+}
+
+unsigned long
+SharedFrameWriter::oversized()
+const
+{
+    return nOversized_;
+}
+
+SharedFrameReader::SharedFrameReader(const std::string &sName)
+    : pBase_(0)
+    , nBytes_(0)
+    , pHeader_(0)
+    , llNext_(0)
+    , llLost_(0)
+{
+#if defined(__linux__)
+    // Read-write: waiting readers register in nWaiters
+    int fd = shm_open(sName.c_str(), O_RDWR, 0);
+    if (fd < 0)
+    {
+        printf("shared frame ring %s: no such ring\n", sName.c_str());
+        return;
+    }
+
+    struct stat oStat;
+    if (fstat(fd, &oStat) != 0 || (size_t)oStat.st_size < cnPageBytes)
+    {
+        close(fd);
+        return;
+    }
+
+    void *pMap = mmap(NULL, (size_t)oStat.st_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if (pMap == MAP_FAILED)
+        return;
+
+    pBase_  = (unsigned char *)pMap;
+    nBytes_ = (size_t)oStat.st_size;
+
+    SharedRingHeader *pHeader = (SharedRingHeader *)pBase_;
+    if (pHeader->nMagic != cnSharedRingMagic || pHeader->nVersion != cnSharedRingVersion)
+    {
+        printf("shared frame ring %s: not initialized or wrong version\n", sName.c_str());
+        return;
+    }
+    std::atomic_thread_fence(std::memory_order_acquire);
+    pHeader_ = pHeader;
+
+    // Start with the next frame published
+    llNext_ = pHeader_->llWriteSeq.load(std::memory_order_acquire);
+#else
+    printf("shared frame ring %s: needs Linux\n", sName.c_str());
+#endif
+}
+
+SharedFrameReader::~SharedFrameReader()
+{
+#if defined(__linux__)
+    if (pBase_)
+        munmap(pBase_, nBytes_);
+#endif
+}
+
+bool
+SharedFrameReader::isValid()
+const
+{
+    return pHeader_ != 0;
+}
+
+const SharedSlotHeader *
+SharedFrameReader::slot(uint64_t llSeq)
+const
+{
+    return (const SharedSlotHeader *)(pBase_ + pHeader_->nHeaderBytes +
+                                      (llSeq % pHeader_->nSlots) * pHeader_->nSlotStride);
+}
+
+bool
+SharedFrameReader::next(SharedFrame &rFrame, int nTimeoutMs)
+{
+    if (!pHeader_)
+        return false;
+
+    std::chrono::steady_clock::time_point oDeadline =
+        std::chrono::steady_clock::now() + std::chrono::milliseconds(nTimeoutMs > 0 ? nTimeoutMs : 0);
+
+    for (;;)
+    {
+        uint32_t nFutex      = pHeader_->nFutex.load(std::memory_order_acquire);
+        uint64_t llPublished = pHeader_->llWriteSeq.load(std::memory_order_acquire);
+
+        if (llNext_ < llPublished)
+        {
+            // Lapped: the oldest slot is the one the writer fills next, skip it too
+            if (llPublished - llNext_ >= pHeader_->nSlots)
+            {
+                uint64_t llOldest = llPublished - pHeader_->nSlots + 1;
+                llLost_ += llOldest - llNext_;
+                llNext_ = llOldest;
+            }
+
+            const SharedSlotHeader *pSlot = slot(llNext_);
+            uint64_t llSeq = llNext_++;
+
+            if (pSlot->llSeq.load(std::memory_order_acquire) != 2 * llSeq + 2)
+            {
+                llLost_++;
+                continue;
+            }
+
+            rFrame.pData        = (const unsigned char *)pSlot + sizeof(SharedSlotHeader);
+            rFrame.llSeq        = llSeq;
+            rFrame.llTimestamp  = pSlot->llTimestamp;
+            rFrame.nFrameNumber = pSlot->nFrameNumber;
+            rFrame.nWidth       = pSlot->nWidth;
+            rFrame.nHeight      = pSlot->nHeight;
+            rFrame.nPitch       = pSlot->nPitch;
+            rFrame.nBitDepth    = pSlot->nBitDepth;
+            rFrame.eFormat      = pSlot->eFormat;
+            rFrame.nFlags       = pSlot->nFlags;
+            rFrame.nBytes       = (size_t)pSlot->nBytes;
+
+            // The header fields must come from the same frame
+            if (!stillValid(rFrame))
+            {
+                llLost_++;
+                continue;
+            }
+            return true;
+        }
+
+        int nWaitMs = -1;
+        if (nTimeoutMs >= 0)
+        {
+            nWaitMs = (int)std::chrono::duration_cast<std::chrono::milliseconds>(
+                oDeadline - std::chrono::steady_clock::now()).count();
+            if (nWaitMs <= 0)
+                return false;
+        }
+
+#if defined(__linux__)
+        // Returns at once if a frame was published since nFutex was read
+        pHeader_->nWaiters.fetch_add(1);
+        futexWait(&pHeader_->nFutex, nFutex, nWaitMs);
+        pHeader_->nWaiters.fetch_sub(1);
+#else
+        (void)nFutex;
+        return false;
+#endif
+    }
+}
+
+void
+SharedFrameReader::skipToLatest()
+{
+    if (!pHeader_)
+        return;
+
+    uint64_t llPublished = pHeader_->llWriteSeq.load(std::memory_order_acquire);
+    if (llPublished > llNext_ + 1)
+        llNext_ = llPublished - 1;
+}
+
+bool
+SharedFrameReader::stillValid(const SharedFrame &rFrame)
+const
+{
+    if (!pHeader_)
+        return false;
+
+    std::atomic_thread_fence(std::memory_order_acquire);
+    return slot(rFrame.llSeq)->llSeq.load(std::memory_order_relaxed) == 2 * rFrame.llSeq + 2;
+}
+
+unsigned long long
+SharedFrameReader::lost()
+const
+{
+    return llLost_;
+}
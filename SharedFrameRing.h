@@ -0,0 +1,183 @@
+/*
+* File		: SharedFrameRing.h
+* Time : 2026 - 10 - 19
+*/
+
+#ifndef SHAREDFRAMERING_H
+#define SHAREDFRAMERING_H
+
+#include "FrameSink.h"
+
+#include <atomic>
+#include <stdint.h>
+#include <string>
+
+// Layout of a ring in shared memory (/dev/shm/<name>), little endian,
+// for readers that map it themselves (e.g. Python's mmap + struct):
+//
+//  offset 0, ring header (SharedRingHeader), nHeaderBytes long
+//  offset nHeaderBytes + i * nSlotStride, slot i:
+//      SharedSlotHeader (64 bytes), then the frame, planes tightly packed
+//      (NV12, or P016 for high bit depth: nPitch bytes per row, nHeight
+//      luma rows followed by (nHeight + 1) / 2 chroma rows).
+//
+// Frame seq (counted from 0) goes to slot seq % nSlots. Its llSeq is
+// 2 * seq + 1 while the writer fills it and 2 * seq + 2 once complete.
+// A reader checks llSeq before and after using a slot; any other value
+// means the writer has lapped it. The writer never waits for readers.
+struct SharedRingHeader
+{
+    uint32_t                nMagic;         // cnSharedRingMagic
+    uint32_t                nVersion;
+    uint32_t                nSlots;
+    uint32_t                nHeaderBytes;
+    uint64_t                nSlotStride;
+    uint64_t                nSlotBytes;     // frame capacity of a slot
+    std::atomic<uint64_t>   llWriteSeq;     // frames published
+    std::atomic<uint32_t>   nFutex;         // bumped on every publish
+    std::atomic<uint32_t>   nWaiters;       // readers in futex wait
+    uint8_t                 aReserved[16];
+};
+
+struct SharedSlotHeader
+{
+    std::atomic<uint64_t>   llSeq;
+    int64_t                 llTimestamp;    // as DecodedFrame::llTimestamp
+    uint64_t                nFrameNumber;
+    uint32_t                nWidth;
+    uint32_t                nHeight;
+    uint32_t                nPitch;
+    uint32_t                nBitDepth;
+    uint32_t                eFormat;        // cudaVideoSurfaceFormat
+    uint32_t                nFlags;         // DecodedFrameFlags
+    uint64_t                nBytes;
+    uint8_t                 aReserved[8];
+};
+
+static const uint32_t cnSharedRingMagic = 0x52464443;    // "CDFR"
+
+// Writes every frame of a stream into a shared-memory ring.
+//  The frame is read back from the GPU straight into its slot (the
+// mapping is page-locked for the DMA once a context is current), so the
+// readback is the only copy: readers in other processes use the slot in
+// place. Readers are woken through a futex in the header; the writer
+// only makes the system call when someone waits.
+//
+// Linux only; elsewhere isValid() is false.
+class SharedFrameWriter : public FrameSink
+{
+    public:
+        // Creates (or replaces) the ring sName ("/name" style, see
+        // shm_open()) with nSlots slots of nSlotBytes each.
+        SharedFrameWriter(const std::string &sName, unsigned int nSlots, size_t nSlotBytes);
+
+        // Unmaps and removes the ring; readers keep their mappings.
+        virtual
+        ~SharedFrameWriter();
+
+        bool
+        isValid()
+        const;
+
+        virtual
+        void
+        onFrame(const DecodedFrame &rFrame);
+
+        // Frames too big for a slot, not published.
+        unsigned long
+        oversized()
+        const;
+
+        // Slot size for frames of the given size.
+        static
+        size_t
+        slotBytesFor(unsigned int nWidth, unsigned int nHeight, unsigned int nBitDepth);
+
+    private:
+        // Copy constructor. Don't implement.
+        SharedFrameWriter(const SharedFrameWriter &);
+
+        // Assignment operator. Don't implement.
+        void
+        operator= (const SharedFrameWriter &);
+
+        std::string                 sName_;
+        unsigned char              *pBase_;
+        size_t                      nBytes_;
+        SharedRingHeader           *pHeader_;
+        bool                        bRegistered_;   // page-locked for the CUDA copy
+        std::atomic<unsigned long>  nOversized_;
+};
+
+// A frame in the ring, valid in place until the writer laps it.
+struct SharedFrame
+{
+    const unsigned char    *pData;
+    uint64_t                llSeq;          // frame sequence number
+    int64_t                 llTimestamp;
+    uint64_t                nFrameNumber;
+    unsigned int            nWidth;
+    unsigned int            nHeight;
+    unsigned int            nPitch;
+    unsigned int            nBitDepth;
+    unsigned int            eFormat;
+    unsigned int            nFlags;
+    size_t                  nBytes;
+};
+
+// Reads a ring created by SharedFrameWriter, in this or another process.
+//  Any number of readers can follow one ring, each at its own pace. A
+// reader that falls more than a ring behind skips ahead to the oldest
+// frame still there and counts the frames it lost.
+class SharedFrameReader
+{
+    public:
+        explicit
+        SharedFrameReader(const std::string &sName);
+
+        ~SharedFrameReader();
+
+        bool
+        isValid()
+        const;
+
+        // Next frame in sequence, waiting up to nTimeoutMs (-1 forever).
+        // Returns false on timeout.
+        bool
+        next(SharedFrame &rFrame, int nTimeoutMs = -1);
+
+        // Skips to the newest published frame on the next next().
+        void
+        skipToLatest();
+
+        // The frame wasn't overwritten while it was used; check after
+        // reading the data in place.
+        bool
+        stillValid(const SharedFrame &rFrame)
+        const;
+
+        // Frames overwritten before this reader got to them.
+        unsigned long long
+        lost()
+        const;
+
+    private:
+        // Copy constructor. Don't implement.
+        SharedFrameReader(const SharedFrameReader &);
+
+        // Assignment operator. Don't implement.
+        void
+        operator= (const SharedFrameReader &);
+
+        const SharedSlotHeader *
+        slot(uint64_t llSeq)
+        const;
+
+        unsigned char          *pBase_;
+        size_t                  nBytes_;
+        SharedRingHeader       *pHeader_;
+        uint64_t                llNext_;
+        unsigned long long      llLost_;
+};
+
+#endif // SHAREDFRAMERING_H
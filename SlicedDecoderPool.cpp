@@ -0,0 +1,471 @@
+/*
+* File		: SlicedDecoderPool.cpp
+* Time : 2026 - 10 - 19
+*/
+
+#include "SlicedDecoderPool.h"
+#include "DecodeStats.h"
+#include "FrameQueue.h"
+#include "VideoDecoder.h"
+#include "VideoParser.h"
+
+#include <algorithm>
+#include <chrono>
+#include <stdio.h>
+#include <string.h>
+
+// A decoder session and the stream whose turn it is.
+//  It is the parser's frame sink for every stream: frames are numbered
+// per stream and passed on to the stream's own sink.
+struct SlicedDecoderPool::Session : public FrameSink
+{
+    CUvideoctxlock      oCtxLock;
+    FrameQueue          oQueue;
+    VideoDecoder       *pDecoder;           // 0 until the first turn
+    VideoParser        *pParser;
+    DecodeStats         oStats;
+    int                 nStream;            // -1 before the first turn
+    Stream             *pStream;
+
+    Session()
+        : oCtxLock(0)
+        , pDecoder(0)
+        , pParser(0)
+        , nStream(-1)
+        , pStream(0)
+    {
+    }
+
+    virtual
+    void
+    onFrame(const DecodedFrame &rFrame)
+    {
+        DecodedFrame oFrame = rFrame;
+        oFrame.nFrameNumber = pStream->nFrameNumber++;
+        // Display order: with B-frames the last frame out isn't the newest
+        if (rFrame.llTimestamp > pStream->llDelivered)
+            pStream->llDelivered = rFrame.llTimestamp;
+
+        if (pStream->pSink)
+            pStream->pSink->onFrame(oFrame);
+    }
+};
+
+// The decoder can take the stream as it is.
+static
+bool
+sameFormat(const VideoDecoder &rDecoder, const CUVIDEOFORMAT &rFormat)
+{
+    return rDecoder.codec()          == rFormat.codec &&
+           rDecoder.frameWidth()     == rFormat.coded_width &&
+           rDecoder.frameHeight()    == rFormat.coded_height &&
+           rDecoder.chromaFormat()   == rFormat.chroma_format &&
+           rDecoder.bitDepthMinus8() == rFormat.bit_depth_luma_minus8;
+}
+
+SlicedDecoderPool::SlicedDecoderPool(int nGpu, unsigned int nSessions, long long llMaxDelayUs,
+                                     unsigned int nMaxQueued)
+    : oDevice_(0)
+    , oContext_(0)
+    , llMaxDelayUs_(llMaxDelayUs)
+    , pScheduler_(0)
+    , bExit_(false)
+{
+    cuInit(0);
+
+    if (cuDeviceGet(&oDevice_, nGpu) != CUDA_SUCCESS ||
+        cuDevicePrimaryCtxRetain(&oContext_, oDevice_) != CUDA_SUCCESS)
+    {
+        printf("SlicedDecoderPool: can't open device %d\n", nGpu);
+        oContext_ = 0;
+        return;
+    }
+
+    if (nSessions == 0)
+        nSessions = 1;
+
+    for (unsigned int i = 0; i < nSessions; i++)
+    {
+        Session *pSession = new Session;
+        if (cuvidCtxLockCreate(&pSession->oCtxLock, oContext_) != CUDA_SUCCESS)
+        {
+            printf("SlicedDecoderPool: cuvidCtxLockCreate failed\n");
+            pSession->oCtxLock = 0;
+        }
+        aSessions_.push_back(pSession);
+    }
+
+    pScheduler_ = new DecodeScheduler(*this, nSessions, nMaxQueued);
+    oTimer_ = std::thread(&SlicedDecoderPool::timer_thread_entry, this);
+}
+
+SlicedDecoderPool::~SlicedDecoderPool()
+{
+    {
+        std::lock_guard<std::mutex> oLock(oMutex_);
+        bExit_ = true;
+        oTimerCond_.notify_all();
+    }
+    if (oTimer_.joinable())
+        oTimer_.join();
+
+    delete pScheduler_;
+
+    for (size_t i = 0; i < aSessions_.size(); i++)
+    {
+        Session *pSession = aSessions_[i];
+
+        delete pSession->pParser;
+        if (pSession->pDecoder)
+        {
+            cuCtxPushCurrent(oContext_);
+            delete pSession->pDecoder;
+            cuCtxPopCurrent(NULL);
+        }
+        if (pSession->oCtxLock)
+            cuvidCtxLockDestroy(pSession->oCtxLock);
+        delete pSession;
+    }
+
+    if (oContext_)
+        cuDevicePrimaryCtxRelease(oDevice_);
+}
+
+bool
+SlicedDecoderPool::isValid()
+const
+{
+    return pScheduler_ != 0;
+}
+
+int
+SlicedDecoderPool::addStream(const CUVIDEOFORMAT &rFormat, FrameSink *pSink,
+                             const ScheduledStreamParams &rParams)
+{
+    if (!pScheduler_)
+        return -1;
+
+    std::lock_guard<std::mutex> oLock(oMutex_);
+
+    Stream oStream;
+    oStream.oFormat      = rFormat;
+    oStream.pSink        = pSink;
+    oStream.nDelivered   = 0;
+    oStream.llDelivered  = -1;
+    oStream.bWaitKey     = true;        // joined mid-stream
+    oStream.nFrameNumber = 0;
+    aStreams_.push_back(oStream);
+
+    // A turn's cost is that of a whole burst: measured against a frame's
+    // budget, every later turn would look late and the stream starve
+    ScheduledStreamParams oParams = rParams;
+    oParams.bDropLate = false;
+
+    // Only the pool adds streams to its scheduler, the ids match
+    return pScheduler_->addStream(oParams);
+}
+
+void
+SlicedDecoderPool::submit(int nStream, const AccessUnit &rUnit)
+{
+    if (!pScheduler_)
+        return;
+
+    long long llNowUs = steadyClockUs();
+    bool bTurn = false;
+    {
+        std::lock_guard<std::mutex> oLock(oMutex_);
+
+        if (nStream < 0 || (size_t)nStream >= aStreams_.size())
+            return;
+
+        Stream &rStream = aStreams_[nStream];
+        oStats_.nPackets++;
+
+        // After loss, go on from the next intact keyframe; what was
+        // buffered before the loss still decodes
+        if (rUnit.bIncomplete || (rUnit.bLossBefore && !rUnit.bKeyFrame))
+            rStream.bWaitKey = true;
+        if (rStream.bWaitKey && (!rUnit.bKeyFrame || rUnit.bIncomplete))
+        {
+            oStats_.nDropped++;
+            return;
+        }
+        rStream.bWaitKey = false;
+
+        // Everything decoded: start over at this keyframe
+        if (rUnit.bKeyFrame && rStream.nDelivered == rStream.aPackets.size())
+        {
+            rStream.aPackets.clear();
+            rStream.nDelivered = 0;
+        }
+        bool bGopDone = rUnit.bKeyFrame && rStream.aPackets.size() > rStream.nDelivered;
+
+        rStream.aPackets.push_back(Packet());
+        Packet &rPacket = rStream.aPackets.back();
+        rPacket.aData.assign(rUnit.pData, rUnit.pData + rUnit.nSize);
+        rPacket.llTimestamp = rUnit.llTimestamp;
+        rPacket.llArrivalUs = rUnit.llArrivalUs > 0 ? rUnit.llArrivalUs : llNowUs;
+        rPacket.bKeyFrame   = rUnit.bKeyFrame;
+
+        bTurn = bGopDone || llNowUs - rStream.aPackets[rStream.nDelivered].llArrivalUs >= llMaxDelayUs_;
+    }
+
+    if (bTurn)
+        requestTurn(nStream);
+}
+
+void
+SlicedDecoderPool::requestTurn(int nStream)
+{
+    // A waiting turn takes whatever is buffered when it runs
+    if (pScheduler_->queued(nStream) > 0)
+        return;
+
+    // A turn stands for everything buffered: the scheduler may drop it
+    // whole, never in parts
+    DecodeJob oJob;
+    oJob.bKeyFrame = true;
+    pScheduler_->submit(nStream, oJob);
+}
+
+void
+SlicedDecoderPool::timer_thread_entry()
+{
+    // submit() only sees the age when the next unit arrives
+    long long llPeriodUs = std::max(llMaxDelayUs_ / 4, 5000LL);
+    std::vector<int> aDue;
+    std::unique_lock<std::mutex> oLock(oMutex_);
+
+    while (!bExit_)
+    {
+        oTimerCond_.wait_for(oLock, std::chrono::microseconds(llPeriodUs));
+        if (bExit_)
+            break;
+
+        long long llNowUs = steadyClockUs();
+        aDue.clear();
+        for (size_t i = 0; i < aStreams_.size(); i++)
+        {
+            const Stream &rStream = aStreams_[i];
+
+            if (rStream.nDelivered < rStream.aPackets.size() &&
+                llNowUs - rStream.aPackets[rStream.nDelivered].llArrivalUs >= llMaxDelayUs_)
+                aDue.push_back((int)i);
+        }
+
+        oLock.unlock();
+        for (size_t i = 0; i < aDue.size(); i++)
+            requestTurn(aDue[i]);
+        oLock.lock();
+    }
+}
+
+void
+SlicedDecoderPool::drain()
+{
+    if (!pScheduler_)
+        return;
+
+    std::vector<int> aPending;
+    {
+        std::lock_guard<std::mutex> oLock(oMutex_);
+        for (size_t i = 0; i < aStreams_.size(); i++)
+        {
+            if (aStreams_[i].nDelivered < aStreams_[i].aPackets.size())
+                aPending.push_back((int)i);
+        }
+    }
+
+    for (size_t i = 0; i < aPending.size(); i++)
+        requestTurn(aPending[i]);
+    pScheduler_->drain();
+}
+
+const SlicedDecoderStats &
+SlicedDecoderPool::stats()
+const
+{
+    return oStats_;
+}
+
+void
+SlicedDecoderPool::decode(unsigned int nWorker, const DecodeJob &rJob)
+{
+    Session &rSession = *aSessions_[nWorker];
+    int nStream = rJob.nStream;
+    std::vector<Packet> aBurst;
+    long long llSkipBefore = -1;
+    {
+        std::lock_guard<std::mutex> oLock(oMutex_);
+
+        Stream &rStream = aStreams_[nStream];
+        if (rStream.nDelivered >= rStream.aPackets.size())
+            return;
+
+        // Continuing a GOP: decode again from its keyframe, the frames out
+        // already left out (needs timestamps to tell them apart). Frames
+        // come out in display order, so that is everything up to the
+        // newest one delivered, not up to the next packet's timestamp
+        size_t nKey = rStream.nDelivered;
+        while (nKey > 0 && !rStream.aPackets[nKey].bKeyFrame)
+            nKey--;
+        if (nKey < rStream.nDelivered)
+        {
+            if (rStream.llDelivered >= 0)
+                llSkipBefore = rStream.llDelivered + 1;
+            oStats_.nReplayed += (unsigned long)(rStream.nDelivered - nKey);
+        }
+        else
+        {
+            rStream.llDelivered = -1;
+        }
+
+        aBurst.assign(rStream.aPackets.begin() + nKey, rStream.aPackets.end());
+        rStream.nDelivered = rStream.aPackets.size();
+
+        // GOPs before the newest keyframe are done with
+        size_t nLastKey = rStream.aPackets.size() - 1;
+        while (nLastKey > 0 && !rStream.aPackets[nLastKey].bKeyFrame)
+            nLastKey--;
+        rStream.aPackets.erase(rStream.aPackets.begin(), rStream.aPackets.begin() + nLastKey);
+        rStream.nDelivered -= nLastKey;
+    }
+
+    oStats_.nBursts++;
+    if (!decodeBurst(rSession, nStream, aBurst, llSkipBefore))
+    {
+        oStats_.nErrors++;
+
+        // The rest of the GOP can't follow a failed burst
+        std::lock_guard<std::mutex> oLock(oMutex_);
+        aStreams_[nStream].bWaitKey = true;
+    }
+}
+
+void
+SlicedDecoderPool::discontinuity(int nStream)
+{
+    std::lock_guard<std::mutex> oLock(oMutex_);
+
+    // A shed turn: go on from the newest keyframe buffered
+    Stream &rStream = aStreams_[nStream];
+    if (rStream.aPackets.empty())
+        return;
+
+    size_t nLastKey = rStream.aPackets.size() - 1;
+    while (nLastKey > 0 && !rStream.aPackets[nLastKey].bKeyFrame)
+        nLastKey--;
+
+    if (nLastKey > rStream.nDelivered)
+        oStats_.nDropped += (unsigned long)(nLastKey - rStream.nDelivered);
+    rStream.aPackets.erase(rStream.aPackets.begin(), rStream.aPackets.begin() + nLastKey);
+    rStream.nDelivered = rStream.nDelivered > nLastKey ? rStream.nDelivered - nLastKey : 0;
+}
+
+bool
+SlicedDecoderPool::decodeBurst(Session &rSession, int nStream, const std::vector<Packet> &aBurst, long long llSkipBefore)
+{
+    Stream *pStream;
+    {
+        std::lock_guard<std::mutex> oLock(oMutex_);
+        pStream = &aStreams_[nStream];
+    }
+
+    if (!rSession.pDecoder)
+    {
+        cuCtxPushCurrent(oContext_);
+        rSession.pDecoder = new VideoDecoder(pStream->oFormat, oContext_, cudaVideoCreate_PreferCUVID, rSession.oCtxLock);
+        cuCtxPopCurrent(NULL);
+
+        // Display delay 0: the burst is flushed at its end anyway
+        rSession.pParser = new VideoParser(rSession.pDecoder, &rSession.oQueue, &oContext_, &rSession.oStats, 0);
+    }
+    else if (!sameFormat(*rSession.pDecoder, pStream->oFormat) || rSession.pDecoder->status() != CUDA_SUCCESS)
+    {
+        // Also when creating it failed on an earlier turn, e.g. while the
+        // hardware sessions had run out: setFormat() took the format then
+        rSession.pDecoder->reset(&pStream->oFormat);
+        oStats_.nDecoderResets++;
+    }
+
+    if (rSession.pDecoder->status() != CUDA_SUCCESS)
+    {
+        printf("SlicedDecoderPool: no decoder for stream %d (%d)\n", nStream, rSession.pDecoder->status());
+        return false;
+    }
+
+    if (rSession.nStream != nStream)
+    {
+        if (rSession.nStream >= 0)
+            oStats_.nSwitches++;
+        rSession.nStream = nStream;
+    }
+    rSession.pStream = pStream;
+
+    for (int nTry = 0; nTry < 2; nTry++)
+    {
+        if (rSession.pParser->reset() != CUDA_SUCCESS)
+            return false;
+        rSession.pParser->setSkipBefore(llSkipBefore);
+        rSession.pParser->setFrameSink(&rSession);
+
+        bool bOk = true;
+        CUVIDSOURCEDATAPACKET oPacket;
+
+        for (size_t i = 0; i < aBurst.size() && bOk; i++)
+        {
+            const Packet &rPacket = aBurst[i];
+
+            memset(&oPacket, 0, sizeof(oPacket));
+            oPacket.payload_size = (unsigned long)rPacket.aData.size();
+            oPacket.payload      = rPacket.aData.empty() ? NULL : &rPacket.aData[0];
+            oPacket.flags        = CUVID_PKT_ENDOFPICTURE;
+            if (i == 0)
+                oPacket.flags |= CUVID_PKT_DISCONTINUITY;
+            if (rPacket.llTimestamp >= 0)
+            {
+                oPacket.flags    |= CUVID_PKT_TIMESTAMP;
+                oPacket.timestamp = rPacket.llTimestamp;
+                rSession.pParser->notePacketArrival(rPacket.llTimestamp, rPacket.llArrivalUs);
+            }
+            rSession.pParser->notePacketTimestamp(rPacket.llTimestamp);
+
+            bOk = rSession.pParser->parse(&oPacket) == CUDA_SUCCESS && !rSession.pParser->failed();
+        }
+
+        // Out with every frame before the next stream's turn
+        if (bOk)
+        {
+            memset(&oPacket, 0, sizeof(oPacket));
+            oPacket.flags = CUVID_PKT_ENDOFSTREAM;
+            bOk = rSession.pParser->parse(&oPacket) == CUDA_SUCCESS && !rSession.pParser->failed();
+        }
+        rSession.pParser->setFrameSink(NULL);
+
+        if (bOk)
+        {
+            // Remember what the stream really is, so the next turn on
+            // this session doesn't reset the decoder back
+            if (nTry > 0)
+            {
+                pStream->oFormat.codec                 = rSession.pDecoder->codec();
+                pStream->oFormat.coded_width           = (unsigned int)rSession.pDecoder->frameWidth();
+                pStream->oFormat.coded_height          = (unsigned int)rSession.pDecoder->frameHeight();
+                pStream->oFormat.chroma_format         = rSession.pDecoder->chromaFormat();
+                pStream->oFormat.bit_depth_luma_minus8 = (unsigned char)rSession.pDecoder->bitDepthMinus8();
+            }
+            return true;
+        }
+
+        // Typically a sequence header other than announced: recover()
+        // rebuilds the decoder for it, then once more without the frames
+        // that are out
+        rSession.oStats.nParseErrors++;
+        if (rSession.pParser->recover() != CUDA_SUCCESS)
+            break;
+        if (pStream->llDelivered >= 0)
+            llSkipBefore = pStream->llDelivered + 1;
+    }
+    return false;
+}
@@ -0,0 +1,184 @@
+/*
+* File		: SlicedDecoderPool.h
+* Time : 2026 - 10 - 19
+*/
+
+#ifndef SLICEDDECODERPOOL_H
+#define SLICEDDECODERPOOL_H
+
+#include "AccessUnit.h"
+#include "DecodeScheduler.h"
+#include "FrameSink.h"
+
+#include <nvcuvid.h>
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Pool counters; safe to read from any thread.
+struct SlicedDecoderStats
+{
+    std::atomic<unsigned long> nPackets;        // handed to submit()
+    std::atomic<unsigned long> nBursts;         // decoded in one go on a session
+    std::atomic<unsigned long> nSwitches;       // a session moved to another stream
+    std::atomic<unsigned long> nDecoderResets;  // another format, or retrying a failed create
+    std::atomic<unsigned long> nReplayed;       // decoded again to continue a GOP
+    std::atomic<unsigned long> nDropped;        // lost or shed, up to the next keyframe
+    std::atomic<unsigned long> nErrors;         // a burst failed to parse or decode
+
+    SlicedDecoderStats()
+        : nPackets(0), nBursts(0), nSwitches(0), nDecoderResets(0), nReplayed(0), nDropped(0), nErrors(0)
+    {
+    }
+
+  private:
+    // Copy constructor. Don't implement.
+    SlicedDecoderStats(const SlicedDecoderStats &);
+
+    // Assignment operator. Don't implement.
+    void
+    operator= (const SlicedDecoderStats &);
+};
+
+// Decodes many streams on a few decoder sessions by taking turns.
+//  Meant for idle low frame rate cameras (1 fps and the like), where a
+// hardware session per stream would mostly sit unused. Each stream
+// buffers its compressed access units; once it has a complete GOP, or
+// its oldest undecoded unit is llMaxDelayUs old, it asks the
+// DecodeScheduler for a turn. The age is checked as units arrive and by a
+// timer thread every quarter of llMaxDelayUs, so a stream that stops
+// sending still gets its last units decoded. A session then switches to
+// the stream (fresh parser, decoder rebuilt only if the format differs),
+// decodes everything the stream has buffered in one burst and flushes
+// the parser, so every frame is out before the next stream's turn.
+//
+// A turn that ends in the middle of a GOP is continued in the next
+// turn by decoding again from the GOP's keyframe, the frames that were
+// already delivered left out (see VideoParser::setSkipBefore()). The
+// delay bound thus costs decode work on streams with long GOPs; with
+// the bound at least a GOP long, nothing is decoded twice.
+//
+// Turns are scheduled by the streams' classes and deadlines (see
+// addStream()). A turn the scheduler sheds drops the
+// stream's frames up to its newest keyframe. Frames reach each stream's
+// sink on a session thread, numbered per stream.
+class SlicedDecoderPool : public DecodeBackend
+{
+    public:
+        // Parameters:
+        //      nGpu - device of the sessions (its primary context).
+        //      nSessions - decoders, each with its own thread.
+        //      llMaxDelayUs - longest an access unit waits for its turn
+        //          to be requested, give or take a quarter of it.
+        //      nMaxQueued - turns waiting over all streams, see
+        //          DecodeScheduler.
+        SlicedDecoderPool(int nGpu, unsigned int nSessions, long long llMaxDelayUs = 2000000,
+                          unsigned int nMaxQueued = 1024);
+
+        // Stops the sessions once their current bursts are done.
+        virtual
+        ~SlicedDecoderPool();
+
+        bool
+        isValid()
+        const;
+
+        // Adds a stream with the format its units have (e.g. from the SDP
+        // or a probe) and returns its id, -1 if the pool isn't valid.
+        // rParams schedule the stream's turns; the budget counts from the
+        // turn's request and orders the turns, but a late turn is still
+        // decoded (bDropLate is ignored: a turn's cost is a whole burst).
+        // Turns are only shed when too many are waiting. pSink must
+        // outlive the pool.
+        int
+        addStream(const CUVIDEOFORMAT &rFormat, FrameSink *pSink,
+                  const ScheduledStreamParams &rParams = ScheduledStreamParams());
+
+        // Demux thread of the stream: buffers a copy of the unit.
+        void
+        submit(int nStream, const AccessUnit &rUnit);
+
+        // Requests a turn for everything buffered and waits until it is
+        // decoded, e.g. before shutting down.
+        void
+        drain();
+
+        const SlicedDecoderStats &
+        stats()
+        const;
+
+        // DecodeBackend, called by the scheduler's threads.
+        virtual
+        void
+        decode(unsigned int nWorker, const DecodeJob &rJob);
+
+        virtual
+        void
+        discontinuity(int nStream);
+
+    private:
+        struct Session;
+
+        struct Packet
+        {
+            std::vector<unsigned char>  aData;
+            long long                   llTimestamp;
+            long long                   llArrivalUs;
+            bool                        bKeyFrame;
+        };
+
+        struct Stream
+        {
+            CUVIDEOFORMAT               oFormat;
+            FrameSink                  *pSink;
+            std::vector<Packet>         aPackets;       // from the keyframe of the oldest GOP still in use
+            size_t                      nDelivered;     // packets decoded in earlier turns
+            long long                   llDelivered;    // newest timestamp out of them, -1 for none; the session's thread only
+            bool                        bWaitKey;       // nothing usable buffered
+            unsigned long               nFrameNumber;   // frames delivered; the session's thread only
+        };
+
+        // Copy constructor. Don't implement.
+        SlicedDecoderPool(const SlicedDecoderPool &);
+
+        // Assignment operator. Don't implement.
+        void
+        operator= (const SlicedDecoderPool &);
+
+        // Asks the scheduler for a turn of nStream unless one is pending.
+        // Called without the mutex.
+        void
+        requestTurn(int nStream);
+
+        // Requests the turns of streams whose oldest undecoded unit has
+        // waited llMaxDelayUs, for streams that went quiet.
+        void
+        timer_thread_entry();
+
+        // Decodes aBurst on rSession for nStream. Returns false on failure.
+        bool
+        decodeBurst(Session &rSession, int nStream, const std::vector<Packet> &aBurst, long long llSkipBefore);
+
+        CUdevice                        oDevice_;
+        CUcontext                       oContext_;
+        long long                       llMaxDelayUs_;
+        SlicedDecoderStats              oStats_;
+
+        std::mutex                      oMutex_;
+        std::deque<Stream>              aStreams_;      // deque: stable addresses while streams are added
+        std::vector<Session *>          aSessions_;     // by scheduler worker
+
+        // Created after and deleted before the sessions its workers use
+        DecodeScheduler                *pScheduler_;
+
+        // Started after and stopped before the scheduler it submits to
+        std::condition_variable         oTimerCond_;    // exit
+        bool                            bExit_;
+        std::thread                     oTimer_;
+};
+
+#endif // SLICEDDECODERPOOL_H
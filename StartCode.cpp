@@ -0,0 +1,119 @@
+/*
+* File		: StartCode.cpp
+* Time : 2026 - 10 - 19
+*/
+
+#include "StartCode.h"
+#include "CpuFeatures.h"
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define STARTCODE_SSE2 1
+#endif
+
+#if defined(_MSC_VER)
+#include <intrin.h>
+static inline int
+lowestBit(unsigned int nMask)
+{
+    unsigned long nIndex;
+    _BitScanForward(&nIndex, nMask);
+    return (int)nIndex;
+}
+#else
+static inline int
+lowestBit(unsigned int nMask)
+{
+    return __builtin_ctz(nMask);
+}
+#endif
+
+const unsigned char *
+findStartCodeScalar(const unsigned char *pBegin, const unsigned char *pEnd)
+{
+    const unsigned char *p = pBegin;
+
+    while (p + 3 <= pEnd)
+    {
+        // Skip ahead by what the byte at p + 2 rules out
+        if (p[2] > 1)
+            p += 3;
+        else if (p[2] == 0)
+            p += 1;
+        else if (p[0] == 0 && p[1] == 0)
+            return p;
+        else
+            p += 3;
+    }
+
+    return pEnd;
+}
+
+#if defined(CPUFEATURES_AVX2)
+static const bool cbAvx2 = cpuHasAvx2();
+
+// AVX2 part of findStartCode(): scans 32 bytes at a time from p.
+// Returns the match, or 0 with p moved to where the scan stopped.
+CPUFEATURES_AVX2_TARGET
+static const unsigned char *
+findStartCodeAvx2(const unsigned char *&p, const unsigned char *pEnd)
+{
+    const __m256i vZero = _mm256_setzero_si256();
+    const __m256i vOne  = _mm256_set1_epi8(1);
+
+    for (; p + 34 <= pEnd; p += 32)
+    {
+        __m256i v0 = _mm256_loadu_si256((const __m256i *)p);
+        __m256i v1 = _mm256_loadu_si256((const __m256i *)(p + 1));
+        __m256i v2 = _mm256_loadu_si256((const __m256i *)(p + 2));
+
+        __m256i vMatch = _mm256_and_si256(_mm256_and_si256(_mm256_cmpeq_epi8(v0, vZero),
+                                                           _mm256_cmpeq_epi8(v1, vZero)),
+                                          _mm256_cmpeq_epi8(v2, vOne));
+
+        unsigned int nMask = (unsigned int)_mm256_movemask_epi8(vMatch);
+        if (nMask)
+            return p + lowestBit(nMask);
+    }
+
+    return 0;
+}
+#endif
+
+const unsigned char *
+findStartCode(const unsigned char *pBegin, const unsigned char *pEnd)
+{
+    const unsigned char *p = pBegin;
+
+    // Bytes i, i+1 and i+2 of the prefix are compared with three unaligned
+    // loads, so a match never depends on the block boundaries
+#if defined(CPUFEATURES_AVX2)
+    if (cbAvx2)
+    {
+        const unsigned char *pFound = findStartCodeAvx2(p, pEnd);
+        if (pFound)
+            return pFound;
+    }
+#endif
+#if defined(STARTCODE_SSE2)
+    const __m128i vZero = _mm_setzero_si128();
+    const __m128i vOne  = _mm_set1_epi8(1);
+
+    for (; p + 18 <= pEnd; p += 16)
+    {
+        __m128i v0 = _mm_loadu_si128((const __m128i *)p);
+        __m128i v1 = _mm_loadu_si128((const __m128i *)(p + 1));
+        __m128i v2 = _mm_loadu_si128((const __m128i *)(p + 2));
+
+        __m128i vMatch = _mm_and_si128(_mm_and_si128(_mm_cmpeq_epi8(v0, vZero),
+                                                     _mm_cmpeq_epi8(v1, vZero)),
+                                       _mm_cmpeq_epi8(v2, vOne));
+
+        unsigned int nMask = (unsigned int)_mm_movemask_epi8(vMatch);
+        if (nMask)
+            return p + lowestBit(nMask);
+    }
+#endif
+
+    return findStartCodeScalar(p, pEnd);
+}
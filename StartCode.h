@@ -0,0 +1,22 @@
+/*
+* File		: StartCode.h
+* Time : 2026 - 10 - 19
+*/
+
+#ifndef STARTCODE_H
+#define STARTCODE_H
+
+// Finds the next Annex-B start code prefix (00 00 01) in [pBegin, pEnd).
+//  Uses AVX2 when the CPU has it (see CpuFeatures.h), SSE2 when the
+// build targets it, a byte loop otherwise.
+// Returns:
+//      pointer to the first 00 of the prefix, or pEnd if there is none.
+//      A four-byte start code (00 00 00 01) is found at its second 00.
+const unsigned char *
+findStartCode(const unsigned char *pBegin, const unsigned char *pEnd);
+
+// Same search without SIMD, for checking and benchmarking the fast path.
+const unsigned char *
+findStartCodeScalar(const unsigned char *pBegin, const unsigned char *pEnd);
+
+#endif // STARTCODE_H
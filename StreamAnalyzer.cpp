@@ -0,0 +1,368 @@
+/*
+* File		: StreamAnalyzer.cpp
+* Time : 2026 - 10 - 19
+*/
+
+#include "StreamAnalyzer.h"
+
+#include "NalIterator.h"
+#include "StartCode.h"
+
+#include <math.h>
+#include <string.h>
+#include <algorithm>
+
+// Reads the first bits of a NAL unit, emulation prevention bytes removed.
+// Headers past the first cnMaxBytes read as zeros, which ends a ue(v)
+// with an error instead of walking off the buffer.
+class HeaderBits
+{
+    public:
+        static const int cnMaxBytes = 24;
+
+        HeaderBits(const unsigned char *pData, size_t nSize)
+            : nBytes_(0)
+            , nBit_(0)
+        {
+            int nZeros = 0;
+
+            for (size_t i = 0; i < nSize && nBytes_ < cnMaxBytes; i++)
+            {
+                if (nZeros >= 2 && pData[i] == 3)
+                {
+                    nZeros = 0;
+                    continue;
+                }
+                nZeros = pData[i] ? 0 : nZeros + 1;
+                aData_[nBytes_++] = pData[i];
+            }
+        }
+
+        unsigned int
+        bits(int nCount)
+        {
+            unsigned int nValue = 0;
+
+            while (nCount-- > 0)
+            {
+                unsigned int nBit = 0;
+                if (nBit_ < nBytes_ * 8)
+                    nBit = (aData_[nBit_ >> 3] >> (7 - (nBit_ & 7))) & 1;
+                nBit_++;
+                nValue = (nValue << 1) | nBit;
+            }
+
+            return nValue;
+        }
+
+        // Exp-Golomb ue(v). Returns false for a code longer than 31 bits.
+        bool
+        ue(unsigned int &nValue)
+        {
+            int nZeros = 0;
+
+            while (bits(1) == 0)
+            {
+                if (++nZeros > 31)
+                    return false;
+            }
+
+            nValue = (1u << nZeros) - 1 + bits(nZeros);
+            return true;
+        }
+
+    private:
+        unsigned char   aData_[cnMaxBytes];
+        int             nBytes_;
+        int             nBit_;
+};
+
+StreamAnalyzer::StreamAnalyzer(cudaVideoCodec eCodec, unsigned int nWindow)
+    : eCodec_(eCodec)
+    , aWindow_(nWindow > 1 ? nWindow : 2)
+    , nHead_(0)
+    , nCount_(0)
+    , llLastTimestamp_(-1)
+    , nTotalFrames_(0)
+    , nTotalBytes_(0)
+    , nLossEvents_(0)
+    , nDiscontinuities_(0)
+{
+    memset(aPpsExtraBits_, 0, sizeof(aPpsExtraBits_));
+}
+
+void
+StreamAnalyzer::reset()
+{
+    std::lock_guard<std::mutex> oLock(oMutex_);
+
+    nHead_            = 0;
+    nCount_           = 0;
+    llLastTimestamp_  = -1;
+    nTotalFrames_     = 0;
+    nTotalBytes_      = 0;
+    nLossEvents_      = 0;
+    nDiscontinuities_ = 0;
+}
+
+void
+StreamAnalyzer::parseHevcPps(const unsigned char *pData, size_t nSize)
+{
+    HeaderBits oBits(pData + 2, nSize - 2);
+    unsigned int nPpsId;
+    unsigned int nSpsId;
+
+    if (!oBits.ue(nPpsId) || !oBits.ue(nSpsId) || nPpsId >= 64)
+        return;
+
+    oBits.bits(1);      // dependent_slice_segments_enabled_flag
+    oBits.bits(1);      // output_flag_present_flag
+    aPpsExtraBits_[nPpsId] = (unsigned char)oBits.bits(3);
+}
+
+PictureType
+StreamAnalyzer::classify(const unsigned char *pData, size_t nSize)
+{
+    PictureType eType = PictureType_Unknown;
+
+    if (eCodec_ == cudaVideoCodec_MPEG1 || eCodec_ == cudaVideoCodec_MPEG2)
+    {
+        const unsigned char *pEnd = pData + nSize;
+
+        for (const unsigned char *p = findStartCode(pData, pEnd); p + 5 < pEnd; p = findStartCode(p + 3, pEnd))
+        {
+            if (p[3] != 0x00)
+                continue;
+
+            // picture_coding_type after the 10-bit temporal_reference
+            switch ((p[5] >> 3) & 0x07)
+            {
+            case 1:  return PictureType_I;
+            case 2:  return PictureType_P;
+            case 3:  return PictureType_B;
+            default: return PictureType_Unknown;
+            }
+        }
+
+        return PictureType_Unknown;
+    }
+
+    if (eCodec_ != cudaVideoCodec_H264 && eCodec_ != cudaVideoCodec_HEVC)
+        return PictureType_Unknown;
+
+    NalIterator oNals(pData, nSize, eCodec_);
+    NalUnit     oNal;
+
+    // A picture is as "predicted" as its most predicted slice
+    while (oNals.next(oNal))
+    {
+        if (eCodec_ == cudaVideoCodec_HEVC)
+        {
+            if (oNal.nSize < 3)
+                continue;
+
+            if (oNal.nType == 34)
+            {
+                parseHevcPps(oNal.pData, oNal.nSize);
+                continue;
+            }
+
+            // Later slice segments need the SPS to skip slice_segment_address;
+            // the first one is enough in practice
+            if (!NalIterator::isVcl(eCodec_, oNal.nType) || !NalIterator::isFirstSlice(eCodec_, oNal))
+                continue;
+
+            HeaderBits oBits(oNal.pData + 2, oNal.nSize - 2);
+            unsigned int nPpsId;
+            unsigned int nSliceType;
+
+            oBits.bits(1);                          // first_slice_segment_in_pic_flag
+            if (oNal.nType >= 16 && oNal.nType <= 23)
+                oBits.bits(1);                      // no_output_of_prior_pics_flag
+            if (!oBits.ue(nPpsId) || nPpsId >= 64)
+                continue;
+            oBits.bits(aPpsExtraBits_[nPpsId]);     // slice_reserved_flag
+            if (!oBits.ue(nSliceType))
+                continue;
+
+            // 0 B, 1 P, 2 I
+            if (nSliceType == 0)
+                return PictureType_B;
+            if (nSliceType == 1)
+                eType = PictureType_P;
+            else if (nSliceType == 2 && eType == PictureType_Unknown)
+                eType = PictureType_I;
+        }
+        else
+        {
+            if (oNal.nSize < 2 || !NalIterator::isVcl(eCodec_, oNal.nType))
+                continue;
+
+            HeaderBits oBits(oNal.pData + 1, oNal.nSize - 1);
+            unsigned int nFirstMb;
+            unsigned int nSliceType;
+
+            if (!oBits.ue(nFirstMb) || !oBits.ue(nSliceType))
+                continue;
+
+            // 0 P, 1 B, 2 I, 3 SP, 4 SI; +5 when all slices of the picture agree
+            switch (nSliceType % 5)
+            {
+            case 1:
+                return PictureType_B;
+            case 0:
+            case 3:
+                eType = PictureType_P;
+                break;
+            default:
+                if (eType == PictureType_Unknown)
+                    eType = PictureType_I;
+                break;
+            }
+        }
+    }
+
+    return eType;
+}
+
+void
+StreamAnalyzer::analyze(const AccessUnit &rUnit)
+{
+    FrameRecord oRecord;
+
+    oRecord.llTimestamp = rUnit.llTimestamp;
+    oRecord.llArrivalUs = rUnit.llArrivalUs;
+    oRecord.nSize       = (unsigned int)rUnit.nSize;
+    oRecord.bKeyFrame   = rUnit.bKeyFrame;
+    oRecord.eType       = (unsigned char)classify(rUnit.pData, rUnit.nSize);
+
+    if (oRecord.eType == PictureType_Unknown && rUnit.bKeyFrame)
+        oRecord.eType = PictureType_I;
+
+    std::lock_guard<std::mutex> oLock(oMutex_);
+
+    if (rUnit.bLossBefore || rUnit.bIncomplete)
+        nLossEvents_++;
+
+    // A restarted or spliced stream would turn the whole window into jitter
+    if (rUnit.llTimestamp >= 0 && llLastTimestamp_ >= 0 &&
+        (rUnit.llTimestamp - llLastTimestamp_ > cllMaxTimestampStep ||
+         llLastTimestamp_ - rUnit.llTimestamp > cllMaxTimestampStep))
+    {
+        nDiscontinuities_++;
+        nCount_ = 0;
+    }
+    if (rUnit.llTimestamp >= 0)
+        llLastTimestamp_ = rUnit.llTimestamp;
+
+    aWindow_[nHead_] = oRecord;
+    nHead_ = (nHead_ + 1) % aWindow_.size();
+    if (nCount_ < aWindow_.size())
+        nCount_++;
+
+    nTotalFrames_++;
+    nTotalBytes_ += rUnit.nSize;
+}
+
+// Standard deviation of the gaps between consecutive values, in ms.
+static
+double
+spacingJitterMs(const std::vector<long long> &rValues)
+{
+    if (rValues.size() < 3)
+        return 0;
+
+    double dSum   = 0;
+    double dSumSq = 0;
+
+    for (size_t i = 1; i < rValues.size(); i++)
+    {
+        double dGap = (double)(rValues[i] - rValues[i - 1]);
+        dSum   += dGap;
+        dSumSq += dGap * dGap;
+    }
+
+    double dCount    = (double)(rValues.size() - 1);
+    double dMean     = dSum / dCount;
+    double dVariance = dSumSq / dCount - dMean * dMean;
+
+    return dVariance > 0 ? sqrt(dVariance) / 1000.0 : 0;
+}
+
+StreamAnalysis
+StreamAnalyzer::snapshot()
+const
+{
+    StreamAnalysis oResult;
+    memset(&oResult, 0, sizeof(oResult));
+
+    std::vector<long long> aTimestamps;
+    std::vector<long long> aArrivals;
+    unsigned long long     nBytes        = 0;
+    int                    nFirstKey     = -1;
+    int                    nLastKey      = -1;
+    int                    nPreviousKey  = -1;
+
+    {
+        std::lock_guard<std::mutex> oLock(oMutex_);
+
+        oResult.nTotalFrames     = nTotalFrames_;
+        oResult.nTotalBytes      = nTotalBytes_;
+        oResult.nLossEvents      = nLossEvents_;
+        oResult.nDiscontinuities = nDiscontinuities_;
+        oResult.nFrames          = nCount_;
+
+        aTimestamps.reserve(nCount_);
+        aArrivals.reserve(nCount_);
+
+        size_t nSlots = aWindow_.size();
+
+        for (unsigned int i = 0; i < nCount_; i++)
+        {
+            const FrameRecord &rRecord = aWindow_[(nHead_ + nSlots - nCount_ + i) % nSlots];
+
+            nBytes += rRecord.nSize;
+            if (rRecord.eType == PictureType_I)
+                oResult.nIFrames++;
+            else if (rRecord.eType == PictureType_P)
+                oResult.nPFrames++;
+            else if (rRecord.eType == PictureType_B)
+                oResult.nBFrames++;
+
+            if (rRecord.bKeyFrame)
+            {
+                oResult.nKeyFrames++;
+                if (nFirstKey < 0)
+                    nFirstKey = (int)i;
+                nPreviousKey = nLastKey;
+                nLastKey     = (int)i;
+            }
+
+            if (rRecord.llTimestamp >= 0)
+                aTimestamps.push_back(rRecord.llTimestamp);
+            aArrivals.push_back(rRecord.llArrivalUs);
+        }
+    }
+
+    if (oResult.nKeyFrames >= 2)
+    {
+        oResult.dGopLength     = (double)(nLastKey - nFirstKey) / (oResult.nKeyFrames - 1);
+        oResult.nLastGopLength = (unsigned int)(nLastKey - nPreviousKey);
+    }
+
+    // Timestamps are in presentation order only after sorting (B-frames)
+    std::sort(aTimestamps.begin(), aTimestamps.end());
+    oResult.dTimestampJitterMs = spacingJitterMs(aTimestamps);
+    oResult.dArrivalJitterMs   = spacingJitterMs(aArrivals);
+
+    // Prefer media time; inputs without timestamps fall back to arrival time
+    const std::vector<long long> &rClock = aTimestamps.size() >= 2 ? aTimestamps : aArrivals;
+
+    if (rClock.size() >= 2 && rClock.back() > rClock.front())
+    {
+        oResult.dFrameRate = (rClock.size() - 1) / ((rClock.back() - rClock.front()) / 1e6);
+        oResult.dBitrate   = nBytes * 8.0 * oResult.dFrameRate / oResult.nFrames;
+    }
+
+    return oResult;
+}
@@ -0,0 +1,119 @@
+/*
+* File		: StreamAnalyzer.h
+* Time : 2026 - 10 - 19
+*/
+
+#ifndef STREAMANALYZER_H
+#define STREAMANALYZER_H
+
+#include <nvcuvid.h>
+
+#include "AccessUnit.h"
+
+#include <mutex>
+#include <vector>
+
+enum PictureType
+{
+    PictureType_Unknown = 0,    // codec without slice-header parsing, or header unreadable
+    PictureType_I,
+    PictureType_P,
+    PictureType_B
+};
+
+// Rolling statistics of one stream over the analyzer's window.
+struct StreamAnalysis
+{
+    unsigned int        nFrames;            // frames in the window
+    unsigned int        nIFrames;
+    unsigned int        nPFrames;
+    unsigned int        nBFrames;
+    unsigned int        nKeyFrames;         // IDR / IRAP / random access points
+    double              dGopLength;         // average frames between keyframes, 0 with fewer than two
+    unsigned int        nLastGopLength;     // frames between the last two keyframes, 0 if unknown
+    double              dBitrate;           // bits per second
+    double              dFrameRate;
+    double              dTimestampJitterMs; // std deviation of the timestamp spacing
+    double              dArrivalJitterMs;   // std deviation of the arrival spacing
+
+    unsigned long long  nTotalFrames;       // since the analyzer was created
+    unsigned long long  nTotalBytes;
+    unsigned long       nLossEvents;        // units flagged with loss by the input
+    unsigned long       nDiscontinuities;   // timestamp jumps that restarted the window
+};
+
+// Stream health statistics straight from the bitstream: no parser, no
+// decoder.
+//  Each access unit is classified from its slice headers (H.264 slice_type,
+// HEVC slice_type of the first slice segment, MPEG-1/2 picture_coding_type)
+// and recorded in a window of the last nWindow frames; snapshot() derives
+// the frame-type mix, GOP length, bitrate, frame rate and jitter from it.
+// Only a few header bytes per NAL unit are read and nothing is allocated
+// per frame, so one core keeps up with hundreds of streams.
+//
+// analyze() is called from the stream's demux thread (VideoSource::setAnalyzer),
+// snapshot() from any thread.
+class StreamAnalyzer
+{
+    public:
+        // Parameters:
+        //      eCodec - codec of the stream, see VideoSource::format().
+        //      nWindow - frames the rolling statistics cover.
+        explicit
+        StreamAnalyzer(cudaVideoCodec eCodec, unsigned int nWindow = 300);
+
+        void
+        analyze(const AccessUnit &rUnit);
+
+        StreamAnalysis
+        snapshot()
+        const;
+
+        // Forgets the window and the totals.
+        void
+        reset();
+
+        // Picture type from the slice headers of one access unit. HEVC needs
+        // the picture parameter sets seen so far, hence not static.
+        PictureType
+        classify(const unsigned char *pData, size_t nSize);
+
+        // Timestamp jump, in microseconds, treated as a discontinuity.
+        static const long long cllMaxTimestampStep = 10 * 1000000LL;
+
+    private:
+        struct FrameRecord
+        {
+            long long       llTimestamp;    // -1 if none
+            long long       llArrivalUs;
+            unsigned int    nSize;
+            unsigned char   eType;          // PictureType
+            bool            bKeyFrame;
+        };
+
+        // Copy constructor. Don't implement.
+        StreamAnalyzer(const StreamAnalyzer &);
+
+        // Assignment operator. Don't implement.
+        void
+        operator= (const StreamAnalyzer &);
+
+        // Remembers the HEVC PPS fields needed to reach slice_type.
+        void
+        parseHevcPps(const unsigned char *pData, size_t nSize);
+
+        cudaVideoCodec              eCodec_;
+        mutable std::mutex          oMutex_;
+        std::vector<FrameRecord>    aWindow_;       // ring, nCount_ records ending before nHead_
+        unsigned int                nHead_;
+        unsigned int                nCount_;
+        long long                   llLastTimestamp_;
+        unsigned char               aPpsExtraBits_[64]; // num_extra_slice_header_bits per pps_id
+
+        unsigned long long          nTotalFrames_;
+        unsigned long long          nTotalBytes_;
+        unsigned long               nLossEvents_;
+        unsigned long               nDiscontinuities_;
+};
+
+#endif // STREAMANALYZER_H
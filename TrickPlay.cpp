@@ -0,0 +1,428 @@
+/*
+* File		: TrickPlay.cpp
+* Time : 2026 - 10 - 19
+*/
+
+#include "TrickPlay.h"
+
+#include <chrono>
+
+TrickPlayer::TrickPlayer(cudaDecode &rDecoder, unsigned int nSegmentFrames, double dKeyFrameOnlySpeed)
+    : rDecoder_(rDecoder)
+    , nSegmentFrames_(nSegmentFrames > 0 ? nSegmentFrames : 1)
+    , dKeyFrameOnlySpeed_(dKeyFrameOnlySpeed)
+    , oContext_(0)
+    , aSlots_(2 * nSegmentFrames_ + 1)
+    , pHeld_(0)
+    , eMode_(TrickPlay_Stopped)
+    , nGeneration_(0)
+    , llSegmentEnd_(0)
+    , bCollecting_(false)
+    , bSegmentDone_(false)
+    , bFinished_(false)
+    , bThreadExit_(false)
+{
+    for (size_t i = 0; i < aSlots_.size(); i++)
+    {
+        aSlots_[i].dpFrame   = 0;
+        aSlots_[i].nPitch    = 0;
+        aSlots_[i].nRowBytes = 0;
+        aSlots_[i].nRows     = 0;
+        aFree_.push_back(&aSlots_[i]);
+    }
+
+    rDecoder_.setFrameSink(this);
+    rDecoder_.setHoldAtEnd(true);
+
+    oThread_ = std::thread(&TrickPlayer::segment_thread_entry, this);
+}
+
+TrickPlayer::~TrickPlayer()
+{
+    stop();
+
+    {
+        std::lock_guard<std::mutex> oLock(oMutex_);
+        bThreadExit_ = true;
+        oCond_.notify_all();
+    }
+    if (oThread_.joinable())
+        oThread_.join();
+
+    if (oContext_)
+    {
+        cuCtxPushCurrent(oContext_);
+        for (size_t i = 0; i < aSlots_.size(); i++)
+        {
+            if (aSlots_[i].dpFrame)
+                cuMemFree(aSlots_[i].dpFrame);
+        }
+        cuCtxPopCurrent(NULL);
+    }
+}
+
+void
+TrickPlayer::halt()
+{
+    nGeneration_++;
+    eMode_        = TrickPlay_Stopped;
+    bCollecting_  = false;
+    bSegmentDone_ = false;
+    bFinished_    = false;
+
+    aFree_.insert(aFree_.end(), aReady_.begin(), aReady_.end());
+    aFree_.insert(aFree_.end(), aSegment_.begin(), aSegment_.end());
+    aReady_.clear();
+    aSegment_.clear();
+
+    oCond_.notify_all();
+}
+
+bool
+TrickPlayer::playForward(double dSpeed, long long llTimestamp)
+{
+    std::lock_guard<std::mutex> oControl(oControlMutex_);
+
+    {
+        std::lock_guard<std::mutex> oLock(oMutex_);
+        halt();
+    }
+    if (!rDecoder_.pause())
+        return false;
+
+    double dFps = rDecoder_.frameRate();
+
+    if (dSpeed >= dKeyFrameOnlySpeed_)
+    {
+        rDecoder_.setTargetFrameRate(0);
+        rDecoder_.setKeyFrameOnly(true, dFps > 0 ? dSpeed / dFps : 0);
+    }
+    else
+    {
+        rDecoder_.setKeyFrameOnly(false);
+        rDecoder_.setTargetFrameRate(dSpeed > 1 && dFps > 0 ? dFps / dSpeed : 0);
+    }
+
+    {
+        std::lock_guard<std::mutex> oLock(oMutex_);
+        eMode_ = TrickPlay_Forward;
+    }
+
+    rDecoder_.seek(llTimestamp > 0 ? llTimestamp : 0);
+    rDecoder_.resume();
+    return true;
+}
+
+bool
+TrickPlayer::playReverse(long long llTimestamp)
+{
+    std::lock_guard<std::mutex> oControl(oControlMutex_);
+
+    {
+        std::lock_guard<std::mutex> oLock(oMutex_);
+        halt();
+    }
+    if (!rDecoder_.pause())
+        return false;
+
+    // Every frame of a segment is shown
+    rDecoder_.setKeyFrameOnly(false);
+    rDecoder_.setTargetFrameRate(0);
+
+    // Seek first: until then atEnd() may still report the previous end
+    rDecoder_.seek(llTimestamp > 0 ? llTimestamp : 0);
+
+    {
+        std::lock_guard<std::mutex> oLock(oMutex_);
+        eMode_        = TrickPlay_Reverse;
+        llSegmentEnd_ = llTimestamp;
+        bCollecting_  = true;
+    }
+
+    rDecoder_.resume();
+    return true;
+}
+
+void
+TrickPlayer::stop()
+{
+    std::lock_guard<std::mutex> oControl(oControlMutex_);
+
+    {
+        std::lock_guard<std::mutex> oLock(oMutex_);
+        halt();
+    }
+    rDecoder_.pause();
+}
+
+void
+TrickPlayer::startSegment(long long llEnd, unsigned long nGeneration)
+{
+    std::lock_guard<std::mutex> oControl(oControlMutex_);
+
+    {
+        std::lock_guard<std::mutex> oLock(oMutex_);
+        if (nGeneration_ != nGeneration)
+            return;
+    }
+
+    rDecoder_.pause();
+
+    // The keyframe at or before the end starts the segment, so segments
+    // are GOPs; before the first frame nothing is collected and playback
+    // has reached the start
+    rDecoder_.seek(llEnd > 0 ? llEnd : 0);
+
+    {
+        std::lock_guard<std::mutex> oLock(oMutex_);
+        if (nGeneration_ != nGeneration)
+            return;
+        llSegmentEnd_ = llEnd;
+        bCollecting_  = true;
+        bSegmentDone_ = false;
+    }
+
+    rDecoder_.resume();
+}
+
+void
+TrickPlayer::segment_thread_entry()
+{
+    std::unique_lock<std::mutex> oLock(oMutex_);
+
+    while (!bThreadExit_)
+    {
+        if (eMode_ != TrickPlay_Reverse || !bCollecting_)
+        {
+            oCond_.wait(oLock);
+            continue;
+        }
+
+        // The end of the stream ends a segment too, and the source doesn't
+        // tell about it
+        if (!bSegmentDone_ && rDecoder_.atEnd())
+            bSegmentDone_ = true;
+        if (!bSegmentDone_)
+        {
+            oCond_.wait_for(oLock, std::chrono::milliseconds(10));
+            continue;
+        }
+
+        unsigned long nGeneration = nGeneration_;
+        bCollecting_ = false;
+
+        // Nothing past the segment's end is wanted: don't decode on while
+        // the previous segment is being shown. startSegment() resumes
+        oLock.unlock();
+        {
+            std::lock_guard<std::mutex> oControl(oControlMutex_);
+            bool bCurrent;
+            {
+                std::lock_guard<std::mutex> oCheck(oMutex_);
+                bCurrent = nGeneration_ == nGeneration;
+            }
+            if (bCurrent)
+                rDecoder_.pause();
+        }
+        oLock.lock();
+        if (nGeneration_ != nGeneration || bThreadExit_)
+            continue;
+
+        if (aSegment_.empty())
+        {
+            bFinished_ = true;
+            oCond_.notify_all();
+            continue;
+        }
+
+        // Double buffering: one segment handed out, one being decoded
+        while (!aReady_.empty() && nGeneration_ == nGeneration && !bThreadExit_)
+            oCond_.wait(oLock);
+        if (nGeneration_ != nGeneration || bThreadExit_)
+            continue;
+
+        long long llFirst = aSegment_.front()->oFrame.llTimestamp;
+
+        aReady_.insert(aReady_.end(), aSegment_.rbegin(), aSegment_.rend());
+        aSegment_.clear();
+        oCond_.notify_all();
+
+        oLock.unlock();
+        startSegment(llFirst - 1, nGeneration);
+        oLock.lock();
+    }
+}
+
+bool
+TrickPlayer::copyFrame(Slot *pSlot, const DecodedFrame &rFrame)
+{
+    unsigned int nRowBytes = rFrame.nWidth * (rFrame.nBitDepth > 8 ? 2 : 1);
+    unsigned int nRows     = rFrame.nHeight * 3 / 2;
+
+    if (!oContext_)
+        cuCtxGetCurrent(&oContext_);
+
+    if (pSlot->nRowBytes < nRowBytes || pSlot->nRows < nRows)
+    {
+        if (pSlot->dpFrame)
+            cuMemFree(pSlot->dpFrame);
+        pSlot->dpFrame   = 0;
+        pSlot->nRowBytes = 0;
+        pSlot->nRows     = 0;
+
+        if (cuMemAllocPitch(&pSlot->dpFrame, &pSlot->nPitch, nRowBytes, nRows, 16) != CUDA_SUCCESS)
+        {
+            printf("TrickPlayer: can't allocate a %ux%u frame buffer\n", nRowBytes, nRows);
+            pSlot->dpFrame = 0;
+            return false;
+        }
+        pSlot->nRowBytes = nRowBytes;
+        pSlot->nRows     = nRows;
+    }
+
+    CUDA_MEMCPY2D oCopy;
+    memset(&oCopy, 0, sizeof(oCopy));
+    oCopy.srcMemoryType = CU_MEMORYTYPE_DEVICE;
+    oCopy.srcDevice     = rFrame.dpFrame;
+    oCopy.srcPitch      = rFrame.nPitch;
+    oCopy.dstMemoryType = CU_MEMORYTYPE_DEVICE;
+    oCopy.dstDevice     = pSlot->dpFrame;
+    oCopy.dstPitch      = pSlot->nPitch;
+    oCopy.WidthInBytes  = nRowBytes;
+    oCopy.Height        = nRows;
+
+    if (cuMemcpy2D(&oCopy) != CUDA_SUCCESS)
+        return false;
+
+    pSlot->oFrame         = rFrame;
+    pSlot->oFrame.dpFrame = pSlot->dpFrame;
+    pSlot->oFrame.nPitch  = (unsigned int)pSlot->nPitch;
+    return true;
+}
+
+void
+TrickPlayer::onFrame(const DecodedFrame &rFrame)
+{
+    std::unique_lock<std::mutex> oLock(oMutex_);
+    unsigned long nGeneration = nGeneration_;
+    Slot *pSlot = 0;
+
+    if (eMode_ == TrickPlay_Forward)
+    {
+        // Holding the decode back is what keeps fast-forward from running
+        // ahead of the display
+        while (aFree_.empty() && nGeneration_ == nGeneration && !bThreadExit_)
+            oCond_.wait(oLock);
+        if (nGeneration_ != nGeneration || bThreadExit_)
+            return;
+
+        pSlot = aFree_.back();
+        aFree_.pop_back();
+    }
+    else if (eMode_ == TrickPlay_Reverse && bCollecting_ && !bSegmentDone_)
+    {
+        if (rFrame.llTimestamp > llSegmentEnd_)
+        {
+            bSegmentDone_ = true;
+            oCond_.notify_all();
+            return;
+        }
+
+        // The decode started at the GOP's keyframe: the whole GOP up to the
+        // end is kept, unless it is longer than the cache
+        if (aSegment_.size() >= nSegmentFrames_)
+        {
+            pSlot = aSegment_.front();
+            aSegment_.pop_front();
+        }
+        else if (!aFree_.empty())
+        {
+            pSlot = aFree_.back();
+            aFree_.pop_back();
+        }
+        else
+        {
+            return;
+        }
+    }
+    else
+    {
+        return;
+    }
+
+    oLock.unlock();
+    bool bCopied = copyFrame(pSlot, rFrame);
+    oLock.lock();
+
+    if (!bCopied || nGeneration_ != nGeneration)
+    {
+        aFree_.push_back(pSlot);
+        oCond_.notify_all();
+        return;
+    }
+
+    if (eMode_ == TrickPlay_Forward)
+        aReady_.push_back(pSlot);
+    else
+        aSegment_.push_back(pSlot);
+    oCond_.notify_all();
+}
+
+bool
+TrickPlayer::nextFrame(DecodedFrame &rFrame, int nTimeoutMs)
+{
+    std::chrono::steady_clock::time_point oDeadline =
+        std::chrono::steady_clock::now() + std::chrono::milliseconds(nTimeoutMs);
+    std::unique_lock<std::mutex> oLock(oMutex_);
+
+    if (pHeld_)
+    {
+        aFree_.push_back(pHeld_);
+        pHeld_ = 0;
+        oCond_.notify_all();
+    }
+
+    while (aReady_.empty())
+    {
+        if (eMode_ == TrickPlay_Stopped || bFinished_)
+            return false;
+        // Hold-at-end parks the source only after the parser was flushed,
+        // so by then every frame has gone through onFrame()
+        if (eMode_ == TrickPlay_Forward && rDecoder_.atEnd())
+            return false;
+
+        std::chrono::steady_clock::time_point oNow = std::chrono::steady_clock::now();
+        if (oNow >= oDeadline)
+            return false;
+
+        // The end of the stream isn't signalled, poll for it
+        std::chrono::steady_clock::time_point oPoll = oNow + std::chrono::milliseconds(10);
+        oCond_.wait_until(oLock, oPoll < oDeadline ? oPoll : oDeadline);
+    }
+
+    pHeld_ = aReady_.front();
+    aReady_.pop_front();
+    oCond_.notify_all();
+
+    rFrame = pHeld_->oFrame;
+    return true;
+}
+
+bool
+TrickPlayer::finished()
+{
+    std::lock_guard<std::mutex> oLock(oMutex_);
+
+    if (!aReady_.empty())
+        return false;
+    if (eMode_ == TrickPlay_Reverse)
+        return bFinished_;
+    return eMode_ == TrickPlay_Forward && rDecoder_.atEnd();
+}
+
+TrickPlayMode
+TrickPlayer::mode()
+{
+    std::lock_guard<std::mutex> oLock(oMutex_);
+    return eMode_;
+}
@@ -0,0 +1,159 @@
+/*
+* File		: TrickPlay.h
+* Time : 2026 - 10 - 19
+*/
+
+#ifndef TRICKPLAY_H
+#define TRICKPLAY_H
+
+#include "cudaDecode.h"
+#include "FrameSink.h"
+
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+enum TrickPlayMode
+{
+    TrickPlay_Stopped = 0,
+    TrickPlay_Forward,
+    TrickPlay_Reverse
+};
+
+// Fast-forward and reverse playback of a file source.
+//  Fast-forward below dKeyFrameOnlySpeed decimates the decode to
+// source fps / speed, so frames nobody will see aren't decoded; at higher
+// speeds only keyframes, one per speed / fps seconds of media, are sent
+// to the decoder at all.
+//  Reverse playback can't decode backwards, so it works a GOP at a time:
+// seek to the keyframe at or before the segment's end, decode forward
+// to the end and keep every frame, then hand them out newest first. The
+// next segment ends right before that keyframe, i.e. it is the previous
+// GOP, so each GOP is decoded once; the decoder is paused from a
+// segment's end until the next segment starts. While one GOP is handed
+// out the previous one is already being decoded. nSegmentFrames bounds
+// the cache: of a GOP longer than that only the last nSegmentFrames
+// frames are kept, and its head is decoded again for the next segment.
+//
+// Frames are copied to a pool of 2 * nSegmentFrames + 1 device buffers,
+// allocated on first use; nothing is allocated while playing. Output is
+// not paced: the caller shows the frames at its display rate, which is
+// what turns the decimation into speed.
+//
+// Create before cudaDecode::init() (the player becomes the frame sink and
+// makes the source hold at the end of the stream) and destroy before
+// cudaDecode::uninit(). Timestamps are CUVID timestamps, microseconds for
+// FFmpeg sources; reverse playback needs them on every frame.
+class TrickPlayer : public FrameSink
+{
+    public:
+        // Parameters:
+        //      rDecoder - decoder of the stream, must outlive the player.
+        //      nSegmentFrames - most frames kept of a GOP in reverse; the
+        //          default holds 2 s GOPs up to 30 fps.
+        //      dKeyFrameOnlySpeed - speed from which fast-forward decodes
+        //          keyframes only.
+        TrickPlayer(cudaDecode &rDecoder, unsigned int nSegmentFrames = 60, double dKeyFrameOnlySpeed = 16);
+
+        virtual
+        ~TrickPlayer();
+
+        // Plays forward from the keyframe at or before llTimestamp at dSpeed
+        // times the normal rate (1 or less plays every frame).
+        // Returns:
+        //      false if the source can't seek.
+        bool
+        playForward(double dSpeed, long long llTimestamp);
+
+        // Plays backwards from llTimestamp to the start of the stream.
+        bool
+        playReverse(long long llTimestamp);
+
+        // Parks the source and drops the frames not handed out yet.
+        void
+        stop();
+
+        // Next frame in playback order. rFrame.dpFrame stays valid until the
+        // next call, the pitch and flags are those of the player's copy.
+        // Returns:
+        //      false on timeout or once playback has nothing more to show,
+        //      see finished().
+        bool
+        nextFrame(DecodedFrame &rFrame, int nTimeoutMs);
+
+        // True once forward playback reached the end or reverse playback
+        // the start of the stream, and every frame was handed out.
+        bool
+        finished();
+
+        TrickPlayMode
+        mode();
+
+        virtual
+        void
+        onFrame(const DecodedFrame &rFrame);
+
+    private:
+        struct Slot
+        {
+            CUdeviceptr     dpFrame;
+            size_t          nPitch;
+            unsigned int    nRowBytes;      // allocated size
+            unsigned int    nRows;
+            DecodedFrame    oFrame;         // dpFrame and nPitch point at the slot
+        };
+
+        // Copy constructor. Don't implement.
+        TrickPlayer(const TrickPlayer &);
+
+        // Assignment operator. Don't implement.
+        void
+        operator= (const TrickPlayer &);
+
+        // Ends the current mode: a blocked onFrame() returns and every queued
+        // frame goes back to the pool. Call with oMutex_ held.
+        void
+        halt();
+
+        // Copies a mapped frame into the slot, growing it if needed. Runs on
+        // the demux thread with the decoder's context current.
+        bool
+        copyFrame(Slot *pSlot, const DecodedFrame &rFrame);
+
+        // Reverse playback: decodes the stretch ending at llEnd, unless
+        // nGeneration is no longer current.
+        void
+        startSegment(long long llEnd, unsigned long nGeneration);
+
+        // Hands out completed reverse segments and starts the next ones.
+        void
+        segment_thread_entry();
+
+        cudaDecode                 &rDecoder_;
+        unsigned int                nSegmentFrames_;
+        double                      dKeyFrameOnlySpeed_;
+        CUcontext                   oContext_;      // of the buffers, 0 before the first frame
+
+        // Serializes the pause/seek/resume sequences against each other
+        std::mutex                  oControlMutex_;
+
+        std::mutex                  oMutex_;
+        std::condition_variable     oCond_;
+        std::vector<Slot>           aSlots_;
+        std::vector<Slot *>         aFree_;
+        std::deque<Slot *>          aReady_;        // in playback order
+        std::deque<Slot *>          aSegment_;      // reverse segment being decoded, in stream order
+        Slot                       *pHeld_;         // handed out by the last nextFrame()
+        TrickPlayMode               eMode_;
+        unsigned long               nGeneration_;   // bumped whenever the mode changes
+        long long                   llSegmentEnd_;
+        bool                        bCollecting_;
+        bool                        bSegmentDone_;
+        bool                        bFinished_;     // reverse playback reached the start
+        bool                        bThreadExit_;
+        std::thread                 oThread_;
+};
+
+#endif // TRICKPLAY_H
@@ -0,0 +1,534 @@
+/*
+* File		: TsDemuxer.cpp
+* Time : 2026 - 10 - 19
+*/
+
+#include "TsDemuxer.h"
+
+#include "NalIterator.h"
+#include "StartCode.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+TsDemuxer::TsDemuxer(int nVideoPid)
+    : nVideoPid_(nVideoPid)
+    , bFixedPid_(nVideoPid >= 0)
+    , nPmtPid_(-1)
+    , nPcrPid_(-1)
+    , eCodec_(cudaVideoCodec_NumCodecs)
+    , nLastCC_(-1)
+    , llPcr_(-1)
+    , pInput_(NULL)
+    , nInputSize_(0)
+    , llArrivalUs_(0)
+    , nCarry_(0)
+    , bSyncLost_(false)
+    , bPesOpen_(false)
+    , nPesExpected_(0)
+    , llPesPts_(-1)
+    , llPesArrivalUs_(0)
+    , bPesRandomAccess_(false)
+    , bPesLossBefore_(false)
+    , bPesIncomplete_(false)
+    , bLossPending_(false)
+    , llLastPts_(-1)
+    , llPtsOffset_(0)
+{
+    // Large enough for a 4K intra picture; the buffers grow once if not
+    aPes_.reserve(2 * 1024 * 1024);
+    aReady_.reserve(2 * 1024 * 1024);
+    memset(&oReady_, 0, sizeof(oReady_));
+}
+
+cudaVideoCodec
+TsDemuxer::codec()
+const
+{
+    return eCodec_;
+}
+
+int
+TsDemuxer::videoPid()
+const
+{
+    return nVideoPid_;
+}
+
+long long
+TsDemuxer::pcr()
+const
+{
+    return llPcr_;
+}
+
+const TsDemuxStats &
+TsDemuxer::stats()
+const
+{
+    return oStats_;
+}
+
+void
+TsDemuxer::feed(const unsigned char *pData, size_t nSize, long long llArrivalUs)
+{
+    pInput_      = pData;
+    nInputSize_  = nSize;
+    llArrivalUs_ = llArrivalUs;
+}
+
+bool
+TsDemuxer::next(AccessUnit &rUnit)
+{
+    // Finish a packet split across the previous chunk and this one
+    if (nCarry_ > 0 && nInputSize_ > 0)
+    {
+        size_t nTake = cnPacketSize - nCarry_;
+        if (nTake > nInputSize_)
+            nTake = nInputSize_;
+
+        memcpy(aCarry_ + nCarry_, pInput_, nTake);
+        nCarry_     += (int)nTake;
+        pInput_     += nTake;
+        nInputSize_ -= nTake;
+
+        if (nCarry_ < cnPacketSize)
+            return false;
+
+        nCarry_ = 0;
+        if (processPacket(aCarry_))
+        {
+            rUnit = oReady_;
+            return true;
+        }
+    }
+
+    while (nInputSize_ >= (size_t)cnPacketSize)
+    {
+        if (pInput_[0] != 0x47)
+        {
+            // Counted once per loss, not per byte skipped to get back
+            if (!bSyncLost_)
+            {
+                bSyncLost_ = true;
+                oStats_.nSyncLosses++;
+                markLoss();
+            }
+            pInput_++;
+            nInputSize_--;
+            continue;
+        }
+        bSyncLost_ = false;
+
+        const unsigned char *p = pInput_;
+        pInput_     += cnPacketSize;
+        nInputSize_ -= cnPacketSize;
+
+        if (processPacket(p))
+        {
+            rUnit = oReady_;
+            return true;
+        }
+    }
+
+    if (nInputSize_ > 0)
+    {
+        if (pInput_[0] == 0x47)
+        {
+            memcpy(aCarry_, pInput_, nInputSize_);
+            nCarry_    = (int)nInputSize_;
+            bSyncLost_ = false;
+        }
+        else if (!bSyncLost_)
+        {
+            bSyncLost_ = true;
+            oStats_.nSyncLosses++;
+            markLoss();
+        }
+        nInputSize_ = 0;
+    }
+
+    return false;
+}
+
+bool
+TsDemuxer::finish(AccessUnit &rUnit)
+{
+    if (bPesOpen_ && finishPes())
+    {
+        rUnit = oReady_;
+        return true;
+    }
+
+    return false;
+}
+
+void
+TsDemuxer::markLoss()
+{
+    if (bPesOpen_)
+        bPesIncomplete_ = true;
+    bLossPending_ = true;
+}
+
+bool
+TsDemuxer::processPacket(const unsigned char *p)
+{
+    oStats_.nPackets++;
+
+    int nPid = ((p[1] & 0x1F) << 8) | p[2];
+
+    // The PID itself can't be trusted; count it against the video stream
+    if (p[1] & 0x80)
+    {
+        oStats_.nTransportErrors++;
+        markLoss();
+        return false;
+    }
+
+    bool bUnitStart     = (p[1] & 0x40) != 0;
+    int  nAdaptation    = (p[3] >> 4) & 0x3;
+    int  nCC            = p[3] & 0x0F;
+    int  nOffset        = 4;
+    bool bRandomAccess  = false;
+    bool bDiscontinuity = false;
+
+    if (nAdaptation & 0x2)
+    {
+        int nLength = p[4];
+        if (nLength > cnPacketSize - 5)
+            return false;
+
+        if (nLength > 0)
+        {
+            bDiscontinuity = (p[5] & 0x80) != 0;
+            bRandomAccess  = (p[5] & 0x40) != 0;
+
+            if ((p[5] & 0x10) && nLength >= 7 && nPid == nPcrPid_)
+            {
+                long long llBase = ((long long)p[6] << 25) | (p[7] << 17) | (p[8] << 9) | (p[9] << 1) | (p[10] >> 7);
+                llPcr_ = llBase * 100 / 9;
+            }
+        }
+        nOffset = 5 + nLength;
+    }
+
+    if (!(nAdaptation & 0x1) || nOffset >= cnPacketSize)
+        return false;
+
+    const unsigned char *pPayload = p + nOffset;
+    int nPayloadSize = cnPacketSize - nOffset;
+
+    if (nPid == 0)
+    {
+        if (bUnitStart)
+            parsePat(pPayload, nPayloadSize);
+        return false;
+    }
+
+    if (nPid == nPmtPid_)
+    {
+        if (bUnitStart)
+            parsePmt(pPayload, nPayloadSize);
+        return false;
+    }
+
+    if (nPid != nVideoPid_)
+        return false;
+
+    if (nLastCC_ >= 0)
+    {
+        // A repeated counter is a duplicate packet, allowed once by the spec
+        if (nCC == nLastCC_)
+            return false;
+
+        if (nCC != ((nLastCC_ + 1) & 0x0F) && !bDiscontinuity)
+        {
+            oStats_.nContinuityErrors++;
+            markLoss();
+        }
+    }
+    nLastCC_ = nCC;
+
+    bool bDone = false;
+
+    if (bUnitStart)
+    {
+        if (bPesOpen_)
+            bDone = finishPes();
+
+        beginPes(pPayload, nPayloadSize, bRandomAccess);
+    }
+    else if (bPesOpen_)
+    {
+        aPes_.insert(aPes_.end(), pPayload, pPayload + nPayloadSize);
+    }
+    // else: the start of this PES was lost, wait for the next one
+
+    // A bounded PES can go out without waiting for the next start
+    if (!bDone && bPesOpen_ && nPesExpected_ && aPes_.size() >= nPesExpected_)
+        bDone = finishPes();
+
+    return bDone;
+}
+
+void
+TsDemuxer::parsePat(const unsigned char *p, int nSize)
+{
+    int nPointer = p[0];
+    const unsigned char *s = p + 1 + nPointer;
+    int nAvail = nSize - 1 - nPointer;
+
+    if (nAvail < 8 || s[0] != 0x00)
+        return;
+
+    int nSectionLength = ((s[1] & 0x0F) << 8) | s[2];
+    int nEnd = 3 + nSectionLength - 4;      // without the CRC
+
+    if (nEnd > nAvail)
+        nEnd = nAvail;
+
+    for (int i = 8; i + 4 <= nEnd; i += 4)
+    {
+        int nProgram = (s[i] << 8) | s[i + 1];
+        int nPid     = ((s[i + 2] & 0x1F) << 8) | s[i + 3];
+
+        // program 0 points at the NIT
+        if (nProgram != 0)
+        {
+            nPmtPid_ = nPid;
+            return;
+        }
+    }
+}
+
+void
+TsDemuxer::parsePmt(const unsigned char *p, int nSize)
+{
+    int nPointer = p[0];
+    const unsigned char *s = p + 1 + nPointer;
+    int nAvail = nSize - 1 - nPointer;
+
+    if (nAvail < 12 || s[0] != 0x02)
+        return;
+
+    int nSectionLength = ((s[1] & 0x0F) << 8) | s[2];
+    int nEnd = 3 + nSectionLength - 4;
+
+    if (nEnd > nAvail)
+        nEnd = nAvail;
+
+    nPcrPid_ = ((s[8] & 0x1F) << 8) | s[9];
+
+    int nProgramInfoLength = ((s[10] & 0x0F) << 8) | s[11];
+
+    for (int i = 12 + nProgramInfoLength; i + 5 <= nEnd; )
+    {
+        int nStreamType = s[i];
+        int nPid        = ((s[i + 1] & 0x1F) << 8) | s[i + 2];
+        int nInfoLength = ((s[i + 3] & 0x0F) << 8) | s[i + 4];
+
+        cudaVideoCodec eCodec = cudaVideoCodec_NumCodecs;
+
+        switch (nStreamType)
+        {
+        case 0x01: eCodec = cudaVideoCodec_MPEG1; break;
+        case 0x02: eCodec = cudaVideoCodec_MPEG2; break;
+        case 0x10: eCodec = cudaVideoCodec_MPEG4; break;
+        case 0x1B: eCodec = cudaVideoCodec_H264;  break;
+        case 0x24: eCodec = cudaVideoCodec_HEVC;  break;
+        case 0xEA: eCodec = cudaVideoCodec_VC1;   break;
+        default: break;
+        }
+
+        if (eCodec != cudaVideoCodec_NumCodecs)
+        {
+            if (nVideoPid_ < 0)
+                nVideoPid_ = nPid;
+
+            if (nPid == nVideoPid_)
+            {
+                eCodec_ = eCodec;
+                return;
+            }
+        }
+
+        i += 5 + nInfoLength;
+    }
+
+    if (bFixedPid_ && eCodec_ == cudaVideoCodec_NumCodecs)
+        printf("TsDemuxer: PID %d is not a video stream of the program\n", nVideoPid_);
+}
+
+long long
+TsDemuxer::readTimestamp(const unsigned char *p)
+{
+    return ((long long)((p[0] >> 1) & 0x07) << 30) | (p[1] << 22) | ((p[2] >> 1) << 15) | (p[3] << 7) | (p[4] >> 1);
+}
+
+void
+TsDemuxer::beginPes(const unsigned char *p, int nSize, bool bRandomAccess)
+{
+    aPes_.clear();
+    bPesOpen_ = false;
+
+    if (nSize < 9 || p[0] != 0 || p[1] != 0 || p[2] != 1)
+    {
+        markLoss();
+        return;
+    }
+
+    int nHeaderLength = 9 + p[8];
+    if (nHeaderLength > nSize)
+    {
+        markLoss();
+        return;
+    }
+
+    int nPacketLength = (p[4] << 8) | p[5];
+    nPesExpected_ = nPacketLength ? (size_t)(nPacketLength + 6 - nHeaderLength) : 0;
+
+    llPesPts_ = -1;
+    if ((p[7] & 0x80) && p[8] >= 5)
+    {
+        // 33-bit 90kHz clock, unwrapped so it keeps increasing
+        long long llPts = readTimestamp(p + 9);
+        if (llLastPts_ >= 0 && llPts + (1LL << 32) < llLastPts_)
+            llPtsOffset_ += 1LL << 33;
+        llLastPts_ = llPts;
+        llPesPts_  = (llPts + llPtsOffset_) * 100 / 9;
+    }
+
+    bPesOpen_         = true;
+    llPesArrivalUs_   = llArrivalUs_;
+    bPesRandomAccess_ = bRandomAccess;
+    bPesLossBefore_   = bLossPending_;
+    bPesIncomplete_   = false;
+    bLossPending_     = false;
+
+    aPes_.insert(aPes_.end(), p + nHeaderLength, p + nSize);
+}
+
+bool
+TsDemuxer::containsKeyFrame()
+const
+{
+    if (aPes_.empty())
+        return false;
+
+    const unsigned char *p    = &aPes_[0];
+    const unsigned char *pEnd = p + aPes_.size();
+
+    // Only up to the first picture data: all slices of a picture agree
+    if (eCodec_ == cudaVideoCodec_H264 || eCodec_ == cudaVideoCodec_HEVC)
+    {
+        NalIterator oNals(p, aPes_.size(), eCodec_);
+        NalUnit     oNal;
+
+        while (oNals.next(oNal))
+        {
+            if (oNal.nSize > 0 && NalIterator::isVcl(eCodec_, oNal.nType))
+                return NalIterator::isKeyFrame(eCodec_, oNal.nType);
+        }
+
+        return false;
+    }
+
+    if (eCodec_ != cudaVideoCodec_MPEG1 && eCodec_ != cudaVideoCodec_MPEG2)
+        return false;
+
+    for (p = findStartCode(p, pEnd); p + 5 < pEnd; p = findStartCode(p + 3, pEnd))
+    {
+        // picture_start_code, picture_coding_type 1 is an I picture
+        if (p[3] == 0x00)
+            return ((p[5] >> 3) & 0x07) == 1;
+    }
+
+    return false;
+}
+
+bool
+TsDemuxer::finishPes()
+{
+    bPesOpen_ = false;
+
+    if (aPes_.empty())
+        return false;
+
+    bool bKeyFrame = bPesRandomAccess_ || containsKeyFrame();
+
+    // Double buffering: the caller reads aReady_ while aPes_ fills again
+    aReady_.swap(aPes_);
+    aPes_.clear();
+
+    oReady_.pData       = &aReady_[0];
+    oReady_.nSize       = aReady_.size();
+    oReady_.llTimestamp = llPesPts_;
+    oReady_.llArrivalUs = llPesArrivalUs_;
+    oReady_.bKeyFrame   = bKeyFrame;
+    oReady_.bLossBefore = bPesLossBefore_;
+    oReady_.bIncomplete = bPesIncomplete_ || (nPesExpected_ && aReady_.size() < nPesExpected_);
+    oStats_.nPesPackets++;
+
+    return true;
+}
+
+bool
+TsDemuxer::parseUrl(const std::string &sUrl, TsInputParams &rParams)
+{
+    static const char cszScheme[] = "udp+ts://";
+    const size_t cnSchemeLength = sizeof(cszScheme) - 1;
+
+    if (sUrl.compare(0, cnSchemeLength, cszScheme) != 0)
+        return false;
+
+    std::string sRest  = sUrl.substr(cnSchemeLength);
+    std::string sQuery;
+    size_t nQuery = sRest.find('?');
+
+    if (nQuery != std::string::npos)
+    {
+        sQuery = sRest.substr(nQuery + 1);
+        sRest  = sRest.substr(0, nQuery);
+    }
+
+    // FFmpeg style "@" for "listen on"
+    if (!sRest.empty() && sRest[0] == '@')
+        sRest = sRest.substr(1);
+
+    size_t nColon = sRest.rfind(':');
+    if (nColon == std::string::npos)
+    {
+        printf("TsDemuxer: no port in %s\n", sUrl.c_str());
+        return false;
+    }
+
+    rParams.sAddress = sRest.substr(0, nColon);
+    rParams.nPort    = (unsigned short)atoi(sRest.c_str() + nColon + 1);
+
+    while (!sQuery.empty())
+    {
+        size_t nAmp = sQuery.find('&');
+        std::string sItem = sQuery.substr(0, nAmp);
+        sQuery = (nAmp == std::string::npos) ? std::string() : sQuery.substr(nAmp + 1);
+
+        size_t nEquals = sItem.find('=');
+        if (nEquals == std::string::npos)
+            continue;
+
+        std::string sKey   = sItem.substr(0, nEquals);
+        std::string sValue = sItem.substr(nEquals + 1);
+
+        if (sKey == "pid")
+            rParams.nVideoPid = atoi(sValue.c_str());
+        else if (sKey == "width")
+            rParams.nWidth = (unsigned int)atoi(sValue.c_str());
+        else if (sKey == "height")
+            rParams.nHeight = (unsigned int)atoi(sValue.c_str());
+        else if (sKey == "buffer")
+            rParams.nSocketBufferSize = atoi(sValue.c_str());
+    }
+
+    return rParams.nPort != 0;
+}
@@ -0,0 +1,185 @@
+/*
+* File		: TsDemuxer.h
+* Time : 2026 - 10 - 19
+*/
+
+#ifndef TSDEMUXER_H
+#define TSDEMUXER_H
+
+#include <nvcuvid.h>
+
+#include "AccessUnit.h"
+
+#include <atomic>
+#include <string>
+#include <vector>
+
+// Where the native TS input listens and which stream it takes.
+struct TsInputParams
+{
+    std::string     sAddress;           // multicast group or local address, empty for any
+    unsigned short  nPort;
+    int             nVideoPid;          // -1 takes the first video stream of the first program
+    unsigned int    nWidth;             // decoder size until the first sequence header
+    unsigned int    nHeight;            //  says otherwise
+    int             nSocketBufferSize;  // SO_RCVBUF, bytes
+
+    TsInputParams()
+        : nPort(1234), nVideoPid(-1), nWidth(1920), nHeight(1080), nSocketBufferSize(8 * 1024 * 1024)
+    {
+    }
+};
+
+// Transport stream counters; safe to read from any thread.
+struct TsDemuxStats
+{
+    std::atomic<unsigned long> nPackets;            // 188-byte packets seen
+    std::atomic<unsigned long> nSyncLosses;         // times 0x47 was missing and bytes were skipped to resync
+    std::atomic<unsigned long> nContinuityErrors;   // CC jumps on the video PID
+    std::atomic<unsigned long> nTransportErrors;    // transport_error_indicator set
+    std::atomic<unsigned long> nPesPackets;         // video PES packets delivered
+
+    TsDemuxStats()
+        : nPackets(0), nSyncLosses(0), nContinuityErrors(0), nTransportErrors(0), nPesPackets(0)
+    {
+    }
+
+  private:
+    // Copy constructor. Don't implement.
+    TsDemuxStats(const TsDemuxStats &);
+
+    // Assignment operator. Don't implement.
+    void
+    operator= (const TsDemuxStats &);
+};
+
+// Lightweight MPEG-2 transport stream demuxer for one video stream.
+//  Parses PAT and PMT to find the video PID (sections are expected to
+// fit in one TS packet, as broadcast muxers emit them), reassembles that
+// PID's PES packets and hands each one out as an AccessUnit with its PTS.
+// Continuity-counter jumps and transport errors mark the PES they hit
+// (bIncomplete) and the next one (bLossBefore). PCR is tracked for clock
+// recovery. PES payloads are assembled in two reused buffers, nothing
+// is allocated per packet.
+//
+// Usage: feed() a buffer, then call next() until it returns false.
+class TsDemuxer
+{
+    public:
+        static const int cnPacketSize = 188;
+
+        // Parameters:
+        //      nVideoPid - PID to take, -1 to pick the first video stream from the PMT.
+        explicit
+        TsDemuxer(int nVideoPid = -1);
+
+        // Hands the demuxer the next chunk of the stream. The chunk must stay
+        // valid until next() returns false. A packet split across chunks is
+        // carried over.
+        void
+        feed(const unsigned char *pData, size_t nSize, long long llArrivalUs);
+
+        // Demuxes from the current chunk until a video PES is complete.
+        // Returns:
+        //      true and fills rUnit, or false once the chunk is used up.
+        bool
+        next(AccessUnit &rUnit);
+
+        // Hands out the PES still being assembled at the end of the stream.
+        bool
+        finish(AccessUnit &rUnit);
+
+        // Codec of the video stream, cudaVideoCodec_NumCodecs until the PMT was seen.
+        cudaVideoCodec
+        codec()
+        const;
+
+        int
+        videoPid()
+        const;
+
+        // Last program clock reference in microseconds, -1 if none yet.
+        long long
+        pcr()
+        const;
+
+        const TsDemuxStats &
+        stats()
+        const;
+
+        // Parses "udp+ts://[address]:port[?pid=N&width=W&height=H&buffer=BYTES]".
+        // Plain udp:// is left to FFmpeg.
+        static
+        bool
+        parseUrl(const std::string &sUrl, TsInputParams &rParams);
+
+    private:
+        // Copy constructor. Don't implement.
+        TsDemuxer(const TsDemuxer &);
+
+        // Assignment operator. Don't implement.
+        void
+        operator= (const TsDemuxer &);
+
+        // Returns true if the packet completed a video PES.
+        bool
+        processPacket(const unsigned char *p);
+
+        void
+        parsePat(const unsigned char *p, int nSize);
+
+        void
+        parsePmt(const unsigned char *p, int nSize);
+
+        // Marks the PES being assembled and the next one as hit by loss.
+        void
+        markLoss();
+
+        // Starts a PES from the payload of a packet with payload_unit_start_indicator.
+        void
+        beginPes(const unsigned char *p, int nSize, bool bRandomAccess);
+
+        bool
+        finishPes();
+
+        // Scans the PES payload for IDR / IRAP NAL units.
+        bool
+        containsKeyFrame()
+        const;
+
+        static
+        long long
+        readTimestamp(const unsigned char *p);
+
+        int                         nVideoPid_;
+        bool                        bFixedPid_;
+        int                         nPmtPid_;
+        int                         nPcrPid_;
+        cudaVideoCodec              eCodec_;
+        int                         nLastCC_;
+        long long                   llPcr_;
+        TsDemuxStats                oStats_;
+
+        const unsigned char        *pInput_;
+        size_t                      nInputSize_;
+        long long                   llArrivalUs_;
+        unsigned char               aCarry_[cnPacketSize];
+        int                         nCarry_;
+        bool                        bSyncLost_;     // skipping bytes until the next 0x47
+
+        std::vector<unsigned char>  aPes_;          // PES being assembled, reused
+        std::vector<unsigned char>  aReady_;        // last completed PES, reused
+        AccessUnit                  oReady_;
+        bool                        bPesOpen_;
+        size_t                      nPesExpected_;  // payload bytes from PES_packet_length, 0 if unbounded
+        long long                   llPesPts_;
+        long long                   llPesArrivalUs_;
+        bool                        bPesRandomAccess_;
+        bool                        bPesLossBefore_;
+        bool                        bPesIncomplete_;
+        bool                        bLossPending_;
+        long long                   llLastPts_;     // raw 33-bit value, for unwrapping
+        long long                   llPtsOffset_;
+};
+
+#endif // TSDEMUXER_H
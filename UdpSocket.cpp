@@ -0,0 +1,144 @@
+/*
+* File		: UdpSocket.cpp
+* Time : 2026 - 10 - 19
+*/
+
+#include "UdpSocket.h"
+
+#include <stdio.h>
+#include <string.h>
+
+#if defined(WIN32) || defined(_WIN32) || defined(WIN64) || defined(_WIN64)
+#include <winsock2.h>
+#include <ws2tcpip.h>
+#pragma comment(lib, "ws2_32.lib")
+#define CLOSESOCKET closesocket
+#else
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <sys/select.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include <unistd.h>
+#define CLOSESOCKET ::close
+#endif
+
+UdpSocket::UdpSocket()
+    : nSocket_(-1)
+{
+}
+
+UdpSocket::~UdpSocket()
+{
+    close();
+}
+
+bool
+UdpSocket::open(const std::string &sAddress, unsigned short nPort, int nBufferSize)
+{
+#if defined(WIN32) || defined(_WIN32) || defined(WIN64) || defined(_WIN64)
+    static bool bWinsockReady = false;
+    if (!bWinsockReady)
+    {
+        WSADATA oWsaData;
+        if (WSAStartup(MAKEWORD(2, 2), &oWsaData) != 0)
+        {
+            printf("UdpSocket: WSAStartup failed\n");
+            return false;
+        }
+        bWinsockReady = true;
+    }
+#endif
+
+    struct in_addr oAddress;
+    oAddress.s_addr = htonl(INADDR_ANY);
+
+    if (!sAddress.empty() && inet_pton(AF_INET, sAddress.c_str(), &oAddress) != 1)
+    {
+        printf("UdpSocket: bad address %s\n", sAddress.c_str());
+        return false;
+    }
+
+    bool bMulticast = (ntohl(oAddress.s_addr) >> 28) == 0xE;
+
+    nSocket_ = (int)socket(AF_INET, SOCK_DGRAM, IPPROTO_UDP);
+    if (nSocket_ < 0)
+    {
+        printf("UdpSocket: socket() failed\n");
+        return false;
+    }
+
+    // Bursts of a large intra picture arrive faster than the decode thread
+    // drains them; the kernel buffer has to hold a whole one
+    setsockopt(nSocket_, SOL_SOCKET, SO_RCVBUF, (const char *)&nBufferSize, sizeof(nBufferSize));
+
+    // Several monitors may listen to the same multicast feed
+    int nReuse = 1;
+    setsockopt(nSocket_, SOL_SOCKET, SO_REUSEADDR, (const char *)&nReuse, sizeof(nReuse));
+
+    struct sockaddr_in oBind;
+    memset(&oBind, 0, sizeof(oBind));
+    oBind.sin_family = AF_INET;
+    oBind.sin_port   = htons(nPort);
+    oBind.sin_addr   = oAddress;
+
+#if defined(WIN32) || defined(_WIN32) || defined(WIN64) || defined(_WIN64)
+    // Windows can't bind to a group address
+    if (bMulticast)
+        oBind.sin_addr.s_addr = htonl(INADDR_ANY);
+#endif
+
+    if (bind(nSocket_, (struct sockaddr *)&oBind, sizeof(oBind)) != 0)
+    {
+        printf("UdpSocket: can't bind UDP port %u\n", (unsigned int)nPort);
+        close();
+        return false;
+    }
+
+    if (bMulticast)
+    {
+        struct ip_mreq oMembership;
+        oMembership.imr_multiaddr        = oAddress;
+        oMembership.imr_interface.s_addr = htonl(INADDR_ANY);
+
+        if (setsockopt(nSocket_, IPPROTO_IP, IP_ADD_MEMBERSHIP, (const char *)&oMembership, sizeof(oMembership)) != 0)
+        {
+            printf("UdpSocket: can't join multicast group %s\n", sAddress.c_str());
+            close();
+            return false;
+        }
+    }
+
+    return true;
+}
+
+void
+UdpSocket::close()
+{
+    if (nSocket_ >= 0)
+    {
+        CLOSESOCKET(nSocket_);
+        nSocket_ = -1;
+    }
+}
+
+int
+UdpSocket::receive(unsigned char *pBuffer, int nBufferSize, int nTimeoutMs)
+{
+    if (nSocket_ < 0)
+        return -1;
+
+    fd_set oReadSet;
+    FD_ZERO(&oReadSet);
+    FD_SET(nSocket_, &oReadSet);
+
+    struct timeval oTimeout;
+    oTimeout.tv_sec  = nTimeoutMs / 1000;
+    oTimeout.tv_usec = (nTimeoutMs % 1000) * 1000;
+
+    int nReady = select(nSocket_ + 1, &oReadSet, NULL, NULL, &oTimeout);
+    if (nReady <= 0)
+        return nReady;
+
+    return (int)recv(nSocket_, (char *)pBuffer, nBufferSize, 0);
+}
@@ -0,0 +1,49 @@
+/*
+* File		: UdpSocket.h
+* Time : 2026 - 10 - 19
+*/
+
+#ifndef UDPSOCKET_H
+#define UDPSOCKET_H
+
+#include <string>
+
+// Minimal blocking UDP receive socket for the native network inputs.
+//  A multicast group address (224.0.0.0/4) is joined on the default
+// interface; any other address is bound to directly.
+class UdpSocket
+{
+    public:
+        UdpSocket();
+
+        ~UdpSocket();
+
+        // Parameters:
+        //      sAddress - local or multicast address, empty for any.
+        //      nPort - UDP port.
+        //      nBufferSize - SO_RCVBUF in bytes.
+        // Returns false (and prints why) on failure.
+        bool
+        open(const std::string &sAddress, unsigned short nPort, int nBufferSize);
+
+        void
+        close();
+
+        // Waits up to nTimeoutMs for a datagram.
+        // Returns:
+        //      its size, 0 on timeout, -1 on error.
+        int
+        receive(unsigned char *pBuffer, int nBufferSize, int nTimeoutMs);
+
+    private:
+        // Copy constructor. Don't implement.
+        UdpSocket(const UdpSocket &);
+
+        // Assignment operator. Don't implement.
+        void
+        operator= (const UdpSocket &);
+
+        int nSocket_;
+};
+
+#endif // UDPSOCKET_H
@@ -20,8 +20,12 @@
 VideoDecoder::VideoDecoder(const CUVIDEOFORMAT &rVideoFormat,
                            CUcontext &rContext,
                            cudaVideoCreateFlags eCreateFlags,
-                           CUvideoctxlock &vidCtxLock)
+                           CUvideoctxlock &vidCtxLock,
+                           unsigned long nTargetWidth,
+                           unsigned long nTargetHeight)
     : m_VidCtxLock(vidCtxLock)
+    , m_nTargetWidth(nTargetWidth)
+    , m_nTargetHeight(nTargetHeight)
 {
     // get a copy of the CUDA context
     m_Context          = rContext;
@@ -54,23 +58,48 @@ VideoDecoder::VideoDecoder(const CUVIDEOFORMAT &rVideoFormat,
 
     printf("\n");
 
+    oDecoder_ = 0;
+    m_Status  = setFormat(rVideoFormat);
+
+    if (CUDA_SUCCESS == m_Status)
+    {
+        m_Status = create();
+    }
+}
+
+CUresult
+VideoDecoder::setFormat(const CUVIDEOFORMAT &rVideoFormat)
+{
     // Validate video format.  These are the currently supported formats via NVCUVID
-    assert(cudaVideoCodec_MPEG1 == rVideoFormat.codec ||
-           cudaVideoCodec_MPEG2 == rVideoFormat.codec ||
-           cudaVideoCodec_MPEG4 == rVideoFormat.codec ||
-           cudaVideoCodec_VC1   == rVideoFormat.codec ||
-           cudaVideoCodec_H264  == rVideoFormat.codec ||
-           cudaVideoCodec_JPEG  == rVideoFormat.codec ||
-           cudaVideoCodec_YUV420== rVideoFormat.codec ||
-           cudaVideoCodec_YV12  == rVideoFormat.codec ||
-           cudaVideoCodec_NV12  == rVideoFormat.codec ||
-           cudaVideoCodec_YUYV  == rVideoFormat.codec ||
-           cudaVideoCodec_UYVY  == rVideoFormat.codec);
-
-    assert(cudaVideoChromaFormat_Monochrome == rVideoFormat.chroma_format ||
-           cudaVideoChromaFormat_420        == rVideoFormat.chroma_format ||
-           cudaVideoChromaFormat_422        == rVideoFormat.chroma_format ||
-           cudaVideoChromaFormat_444        == rVideoFormat.chroma_format);
+    if (!(cudaVideoCodec_MPEG1 == rVideoFormat.codec ||
+          cudaVideoCodec_MPEG2 == rVideoFormat.codec ||
+          cudaVideoCodec_MPEG4 == rVideoFormat.codec ||
+          cudaVideoCodec_VC1   == rVideoFormat.codec ||
+          cudaVideoCodec_H264  == rVideoFormat.codec ||
+          cudaVideoCodec_HEVC  == rVideoFormat.codec ||
+          cudaVideoCodec_VP8   == rVideoFormat.codec ||
+          cudaVideoCodec_VP9   == rVideoFormat.codec ||
+          cudaVideoCodec_AV1   == rVideoFormat.codec ||
+          cudaVideoCodec_JPEG  == rVideoFormat.codec ||
+          cudaVideoCodec_YUV420== rVideoFormat.codec ||
+          cudaVideoCodec_YV12  == rVideoFormat.codec ||
+          cudaVideoCodec_NV12  == rVideoFormat.codec ||
+          cudaVideoCodec_YUYV  == rVideoFormat.codec ||
+          cudaVideoCodec_UYVY  == rVideoFormat.codec))
+    {
+        printf("VideoDecoder: unsupported codec %d\n", (int)rVideoFormat.codec);
+        return CUDA_ERROR_NOT_SUPPORTED;
+    }
+
+    // Output surfaces are NV12 or P016, 4:2:0 only; every frame consumer
+    // assumes height * 3 / 2 rows
+    if (!(cudaVideoChromaFormat_Monochrome == rVideoFormat.chroma_format ||
+          cudaVideoChromaFormat_420        == rVideoFormat.chroma_format))
+    {
+        printf("VideoDecoder: unsupported chroma format %d, only 4:2:0 and monochrome are decoded\n",
+               (int)rVideoFormat.chroma_format);
+        return CUDA_ERROR_NOT_SUPPORTED;
+    }
 
     // Fill the decoder-create-info struct from the given video-format struct.
     memset(&oVideoDecodeCreateInfo_, 0, sizeof(CUVIDDECODECREATEINFO));
@@ -80,30 +109,83 @@ VideoDecoder::VideoDecoder(const CUVIDEOFORMAT &rVideoFormat,
     oVideoDecodeCreateInfo_.ulHeight            = rVideoFormat.coded_height;
     oVideoDecodeCreateInfo_.ulNumDecodeSurfaces = FrameQueue::cnMaximumSize;
 
-    // Limit decode memory to 24MB (16M pixels at 4:2:0 = 24M bytes)
-    while (oVideoDecodeCreateInfo_.ulNumDecodeSurfaces * rVideoFormat.coded_width * rVideoFormat.coded_height > 16*1024*1024)
+    // Limit decode memory to 24MB (16M pixels at 4:2:0 = 24M bytes), 16-bit surfaces count double
+    unsigned long nBytesPerSample = rVideoFormat.bit_depth_luma_minus8 ? 2 : 1;
+    while (oVideoDecodeCreateInfo_.ulNumDecodeSurfaces * rVideoFormat.coded_width * rVideoFormat.coded_height * nBytesPerSample > 16*1024*1024)
     {
         oVideoDecodeCreateInfo_.ulNumDecodeSurfaces--;
     }
 
     oVideoDecodeCreateInfo_.ChromaFormat        = rVideoFormat.chroma_format;
-    oVideoDecodeCreateInfo_.OutputFormat        = cudaVideoSurfaceFormat_NV12;
+    oVideoDecodeCreateInfo_.bitDepthMinus8      = rVideoFormat.bit_depth_luma_minus8;
+    // High bit-depth content (HEVC Main10/12, VP9/AV1 profile 2) is output as 16-bit P016
+    oVideoDecodeCreateInfo_.OutputFormat        = rVideoFormat.bit_depth_luma_minus8 ? cudaVideoSurfaceFormat_P016
+                                                                                     : cudaVideoSurfaceFormat_NV12;
     oVideoDecodeCreateInfo_.DeinterlaceMode     = cudaVideoDeinterlaceMode_Adaptive;
 
-    // No scaling
-    oVideoDecodeCreateInfo_.ulTargetWidth       = oVideoDecodeCreateInfo_.ulWidth;
-    oVideoDecodeCreateInfo_.ulTargetHeight      = oVideoDecodeCreateInfo_.ulHeight;
+    // Scaled by the decoder if a target was given; 4:2:0 needs even sizes
+    oVideoDecodeCreateInfo_.ulTargetWidth       = m_nTargetWidth  ? (m_nTargetWidth  + 1) & ~1UL : oVideoDecodeCreateInfo_.ulWidth;
+    oVideoDecodeCreateInfo_.ulTargetHeight      = m_nTargetHeight ? (m_nTargetHeight + 1) & ~1UL : oVideoDecodeCreateInfo_.ulHeight;
     oVideoDecodeCreateInfo_.ulNumOutputSurfaces = MAX_FRAME_COUNT;  // We won't simultaneously map more than 8 surfaces
     oVideoDecodeCreateInfo_.ulCreationFlags     = m_VideoCreateFlags;
-    oVideoDecodeCreateInfo_.vidLock             = vidCtxLock;
+    oVideoDecodeCreateInfo_.vidLock             = m_VidCtxLock;
+
+    return CUDA_SUCCESS;
+}
+
+CUresult
+VideoDecoder::create()
+{
     // create the decoder
     CUresult oResult = cuvidCreateDecoder(&oDecoder_, &oVideoDecodeCreateInfo_);
-    assert(CUDA_SUCCESS == oResult);
+
+    if (CUDA_SUCCESS != oResult)
+    {
+        printf("cuvidCreateDecoder failed: %d\n", oResult);
+        oDecoder_ = 0;
+    }
+
+    return oResult;
+}
+
+CUresult
+VideoDecoder::status()
+const
+{
+    return m_Status;
+}
+
+CUresult
+VideoDecoder::reset(const CUVIDEOFORMAT *pNewFormat)
+{
+    CUresult oResult = cuCtxPushCurrent(m_Context);
+
+    if (CUDA_SUCCESS != oResult)
+        return oResult;
+
+    if (oDecoder_)
+    {
+        cuvidDestroyDecoder(oDecoder_);
+        oDecoder_ = 0;
+    }
+
+    m_Status = pNewFormat ? setFormat(*pNewFormat) : CUDA_SUCCESS;
+
+    if (CUDA_SUCCESS == m_Status)
+    {
+        m_Status = create();
+    }
+
+    cuCtxPopCurrent(NULL);
+    return m_Status;
 }
 
 VideoDecoder::~VideoDecoder()
 {
-    cuvidDestroyDecoder(oDecoder_);
+    if (oDecoder_)
+    {
+        cuvidDestroyDecoder(oDecoder_);
+    }
 }
 
 cudaVideoCodec
@@ -120,6 +202,20 @@ const
     return oVideoDecodeCreateInfo_.ChromaFormat;
 }
 
+unsigned long
+VideoDecoder::bitDepthMinus8()
+const
+{
+    return oVideoDecodeCreateInfo_.bitDepthMinus8;
+}
+
+cudaVideoSurfaceFormat
+VideoDecoder::outputFormat()
+const
+{
+    return oVideoDecodeCreateInfo_.OutputFormat;
+}
+
 unsigned long
 VideoDecoder::maxDecodeSurfaces()
 const
@@ -155,30 +251,56 @@ const
     return oVideoDecodeCreateInfo_.ulTargetHeight;
 }
 
-void
+CUresult
 VideoDecoder::decodePicture(CUVIDPICPARAMS *pPictureParameters, CUcontext *pContext)
 {
+    if (!oDecoder_)
+        return CUDA_ERROR_INVALID_HANDLE;
+
     // Handle CUDA picture decode (this actually calls the hardware VP/CUDA to decode video frames)
-    CUresult oResult = cuvidDecodePicture(oDecoder_, pPictureParameters);
-    assert(CUDA_SUCCESS == oResult);
+    return cuvidDecodePicture(oDecoder_, pPictureParameters);
 }
 
-void
+CUresult
 VideoDecoder::mapFrame(int iPictureIndex, CUdeviceptr *ppDevice, unsigned int *pPitch, CUVIDPROCPARAMS *pVideoProcessingParameters)
 {
+    if (!oDecoder_)
+        return CUDA_ERROR_INVALID_HANDLE;
+
     CUresult oResult = cuvidMapVideoFrame(oDecoder_,
                                           iPictureIndex,
                                           ppDevice,
                                           pPitch, pVideoProcessingParameters);
-    assert(CUDA_SUCCESS == oResult);
-    assert(0 != *ppDevice);
-    assert(0 != *pPitch);
+
+    if (CUDA_SUCCESS == oResult && (0 == *ppDevice || 0 == *pPitch))
+    {
+        oResult = CUDA_ERROR_MAP_FAILED;
+    }
+
+    return oResult;
 }
 
-void
+CUresult
 VideoDecoder::unmapFrame(CUdeviceptr pDevice)
 {
-    CUresult oResult = cuvidUnmapVideoFrame(oDecoder_, pDevice);
-    assert(CUDA_SUCCESS == oResult);
+    if (!oDecoder_)
+        return CUDA_ERROR_INVALID_HANDLE;
+
+    return cuvidUnmapVideoFrame(oDecoder_, pDevice);
+}
+
+CUresult
+VideoDecoder::decodeStatus(int iPictureIndex, cuvidDecodeStatus *peStatus)
+{
+    if (!oDecoder_)
+        return CUDA_ERROR_INVALID_HANDLE;
+
+    CUVIDGETDECODESTATUS oDecodeStatus;
+    memset(&oDecodeStatus, 0, sizeof(CUVIDGETDECODESTATUS));
+
+    CUresult oResult = cuvidGetDecodeStatus(oDecoder_, iPictureIndex, &oDecodeStatus);
+    *peStatus = oDecodeStatus.decodeStatus;
+
+    return oResult;
 }
 
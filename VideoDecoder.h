@@ -19,16 +19,34 @@
 #define MAX_FRAME_COUNT 2
 
 // Wrapper class around the CUDA Video Decoding API.
+//  Errors are reported as CUresult instead of asserted, so a failing
+// stream can be recovered without taking the process down. Check
+// status() after construction.
 //
 class VideoDecoder
 {
     public:
+        // nTargetWidth/nTargetHeight scale the output surfaces, 0 keeps the
+        // coded size. The target is kept across reset().
         explicit
         VideoDecoder(const CUVIDEOFORMAT &rVideoFormat, CUcontext &rContext,
-                     cudaVideoCreateFlags eCreateFlags, CUvideoctxlock &ctx);
+                     cudaVideoCreateFlags eCreateFlags, CUvideoctxlock &ctx,
+                     unsigned long nTargetWidth = 0, unsigned long nTargetHeight = 0);
 
         ~VideoDecoder();
 
+        // Result of the last decoder creation. Anything but CUDA_SUCCESS
+        // means there is no usable decoder.
+        CUresult
+        status()
+        const;
+
+        // Destroys and recreates the hardware decoder, optionally for a new
+        // format (sequence change). Pushes the decoder's context itself, so
+        // it can be called from the demux thread.
+        CUresult
+        reset(const CUVIDEOFORMAT *pNewFormat = NULL);
+
         // Get the code-type currently used.
         cudaVideoCodec
         codec()
@@ -38,6 +56,15 @@ class VideoDecoder
         chromaFormat()
         const;
 
+        unsigned long
+        bitDepthMinus8()
+        const;
+
+        // NV12 for 8-bit content, P016 (MSB aligned 16-bit samples) otherwise.
+        cudaVideoSurfaceFormat
+        outputFormat()
+        const;
+
         // Maximum number of decode surfaces used by decoder.
         unsigned long
         maxDecodeSurfaces()
@@ -59,15 +86,19 @@ class VideoDecoder
         targetHeight()
         const;
 
-        void
+        CUresult
         decodePicture(CUVIDPICPARAMS *pPictureParameters, CUcontext *pContext = NULL);
 
-        void
+        CUresult
         mapFrame(int iPictureIndex, CUdeviceptr *ppDevice, unsigned int *nPitch, CUVIDPROCPARAMS *pVideoProcessingParameters);
 
-        void
+        CUresult
         unmapFrame(CUdeviceptr pDevice);
 
+        // Decode status of a picture (error / concealed error / success).
+        CUresult
+        decodeStatus(int iPictureIndex, cuvidDecodeStatus *peStatus);
+
     private:
         // Default constructor. Don't implement.
         VideoDecoder();
@@ -79,11 +110,22 @@ class VideoDecoder
         void
         operator= (const VideoDecoder &);
 
+        // Fills oVideoDecodeCreateInfo_ from a format. Returns
+        // CUDA_ERROR_NOT_SUPPORTED for codecs/chroma formats NVCUVID can't do.
+        CUresult
+        setFormat(const CUVIDEOFORMAT &rVideoFormat);
+
+        CUresult
+        create();
+
         CUVIDDECODECREATEINFO   oVideoDecodeCreateInfo_;
         CUvideodecoder          oDecoder_;
         cudaVideoCreateFlags    m_VideoCreateFlags;
         CUcontext               m_Context;
         CUvideoctxlock          m_VidCtxLock;
+        CUresult                m_Status;
+        unsigned long           m_nTargetWidth;
+        unsigned long           m_nTargetHeight;
 };
 
 #endif // NV_VIDEODECODER_H
@@ -13,36 +13,241 @@
 
 #include "VideoDecoder.h"
 #include "FrameQueue.h"
+#include "ColorConvert.h"
 #include "cuda_runtime.h"
 #include <cstring>
 #include <cassert>
 
 //#include "opencv2/opencv.hpp"
-#define DISPLAY
+// DISPLAY (make SHOW=1) shows every decoded frame in a HighGUI window, for
+// debugging a single stream only: it costs a synchronous copy and a 5 ms
+// waitKey per frame, and HighGUI is not safe from many decode threads.
 
 #ifdef DISPLAY
 #include "opencv2/opencv.hpp"
 #endif
 
-VideoParser::VideoParser(VideoDecoder *pVideoDecoder, FrameQueue *pFrameQueue, CUcontext *pCudaContext): hParser_(0)
+VideoParser::VideoParser(VideoDecoder *pVideoDecoder, FrameQueue *pFrameQueue, CUcontext *pCudaContext,
+                         DecodeStats *pStats, unsigned int nMaxDisplayDelay)
+    : hParser_(0)
+    , nMaxDisplayDelay_(nMaxDisplayDelay)
 {
     assert(0 != pFrameQueue);
     oParserData_.pFrameQueue   = pFrameQueue;
     assert(0 != pVideoDecoder);
     oParserData_.pVideoDecoder = pVideoDecoder;
     oParserData_.pContext      = pCudaContext;
+    oParserData_.pStats        = pStats ? pStats : &oOwnStats_;
+    oParserData_.eFailure      = Failure_None;
+    oParserData_.pFrameSink    = NULL;
+    oParserData_.bSuspect      = false;
+    oParserData_.bCorruptionSeen = false;
+    oParserData_.nFrameNumber  = 0;
+    memset(oParserData_.aSurfaceFlags, 0, sizeof(oParserData_.aSurfaceFlags));
+    memset(oParserData_.aArrivals, 0, sizeof(oParserData_.aArrivals));
+    oParserData_.nArrivalHead  = 0;
+    oParserData_.llPacketTimestamp = -1;
+    oParserData_.llSkipBefore      = -1;
+    oParserData_.llLastOutput      = -1;
+#ifdef DISPLAY
+    oParserData_.pDisplayNV12      = NULL;
+    oParserData_.nDisplayNV12Bytes = 0;
+#endif
+
+    oStatus_ = createParser();
+}
+
+VideoParser::~VideoParser()
+{
+    if (hParser_)
+    {
+        cuvidDestroyVideoParser(hParser_);
+    }
+#ifdef DISPLAY
+    if (oParserData_.pDisplayNV12)
+    {
+        if (oParserData_.pContext)
+            cuCtxPushCurrent(*oParserData_.pContext);
+        cudaFree(oParserData_.pDisplayNV12);
+        if (oParserData_.pContext)
+            cuCtxPopCurrent(NULL);
+    }
+#endif
+}
+
+CUresult
+VideoParser::status()
+const
+{
+    return oStatus_;
+}
+
+CUresult
+VideoParser::createParser()
+{
+    VideoDecoder *pVideoDecoder = oParserData_.pVideoDecoder;
 
     CUVIDPARSERPARAMS oVideoParserParameters;
     memset(&oVideoParserParameters, 0, sizeof(CUVIDPARSERPARAMS));
     oVideoParserParameters.CodecType              = pVideoDecoder->codec();
     oVideoParserParameters.ulMaxNumDecodeSurfaces = pVideoDecoder->maxDecodeSurfaces();
-    oVideoParserParameters.ulMaxDisplayDelay      = 1;  // this flag is needed so the parser will push frames out to the decoder as quickly as it can
+    oVideoParserParameters.ulMaxDisplayDelay      = nMaxDisplayDelay_;  // 1 lets decode run one picture ahead of display, 0 displays right after decode
     oVideoParserParameters.pUserData              = &oParserData_;
     oVideoParserParameters.pfnSequenceCallback    = HandleVideoSequence;    // Called before decoding frames and/or whenever there is a format change
     oVideoParserParameters.pfnDecodePicture       = HandlePictureDecode;    // Called when a picture is ready to be decoded (decode order)
     oVideoParserParameters.pfnDisplayPicture      = HandlePictureDisplay;   // Called whenever a picture is ready to be displayed (display order)
     CUresult oResult = cuvidCreateVideoParser(&hParser_, &oVideoParserParameters);
-    assert(CUDA_SUCCESS == oResult);
+
+    if (CUDA_SUCCESS != oResult)
+    {
+        printf("cuvidCreateVideoParser failed: %d\n", oResult);
+        oParserData_.pStats->nCreateErrors++;
+        hParser_ = 0;
+    }
+
+    return oResult;
+}
+
+bool
+VideoParser::failed()
+const
+{
+    return oParserData_.eFailure != Failure_None;
+}
+
+void
+VideoParser::setFrameSink(FrameSink *pSink)
+{
+    oParserData_.pFrameSink = pSink;
+}
+
+void
+VideoParser::setSuspect(bool bSuspect)
+{
+    oParserData_.bSuspect = bSuspect;
+}
+
+bool
+VideoParser::takeCorruption()
+{
+    bool bSeen = oParserData_.bCorruptionSeen;
+    oParserData_.bCorruptionSeen = false;
+    return bSeen;
+}
+
+void
+VideoParser::notePacketArrival(long long llTimestamp, long long llArrivalUs)
+{
+    PacketArrival &rArrival = oParserData_.aArrivals[oParserData_.nArrivalHead % cnArrivalHistory];
+    rArrival.llTimestamp = llTimestamp;
+    rArrival.llArrivalUs = llArrivalUs;
+    oParserData_.nArrivalHead++;
+}
+
+void
+VideoParser::setTargetFrameRate(double dTargetFps, double dSourceFps)
+{
+    oParserData_.oDecimator.setRates(dTargetFps, dSourceFps);
+}
+
+bool
+VideoParser::decimating()
+const
+{
+    return oParserData_.oDecimator.enabled() || oParserData_.llSkipBefore >= 0;
+}
+
+void
+VideoParser::setSkipBefore(long long llTimestamp)
+{
+    oParserData_.llSkipBefore = llTimestamp;
+}
+
+long long
+VideoParser::lastOutputTimestamp()
+const
+{
+    return oParserData_.llLastOutput;
+}
+
+void
+VideoParser::notePacketTimestamp(long long llTimestamp)
+{
+    oParserData_.llPacketTimestamp = llTimestamp;
+}
+
+CUresult
+VideoParser::recover()
+{
+    DecodeStats *pStats = oParserData_.pStats;
+    CUresult oResult = CUDA_SUCCESS;
+
+    // A failed decode/map may have left the hardware decoder in a bad state,
+    // a format change needs a decoder of the new size anyway
+    if (oParserData_.eFailure == Failure_Format)
+    {
+        oResult = oParserData_.pVideoDecoder->reset(&oParserData_.oNewFormat);
+        pStats->nDecoderResets++;
+    }
+    else if (oParserData_.eFailure != Failure_None || oParserData_.pVideoDecoder->status() != CUDA_SUCCESS)
+    {
+        oResult = oParserData_.pVideoDecoder->reset();
+        pStats->nDecoderResets++;
+    }
+
+    oParserData_.eFailure = Failure_None;
+
+    if (CUDA_SUCCESS != oResult)
+    {
+        pStats->nCreateErrors++;
+        return oResult;
+    }
+
+    // Throw away whatever the parser had buffered, it belongs to the broken stretch
+    if (hParser_)
+    {
+        cuvidDestroyVideoParser(hParser_);
+        hParser_ = 0;
+    }
+
+    oStatus_ = createParser();
+
+    if (CUDA_SUCCESS == oStatus_)
+    {
+        pStats->nRecoveries++;
+    }
+
+    return oStatus_;
+}
+
+CUresult
+VideoParser::reset()
+{
+    if (hParser_)
+    {
+        cuvidDestroyVideoParser(hParser_);
+        hParser_ = 0;
+    }
+
+    oParserData_.oDecimator.reset();
+    oParserData_.llPacketTimestamp = -1;
+
+    oStatus_ = createParser();
+    return oStatus_;
+}
+
+CUresult
+VideoParser::parse(CUVIDSOURCEDATAPACKET *pPacket)
+{
+    if (!hParser_)
+        return CUDA_ERROR_NOT_INITIALIZED;
+    return cuvidParseVideoData(hParser_, pPacket);
+}
+
+void
+VideoParser::setMaxDisplayDelay(unsigned int nMaxDisplayDelay)
+{
+    nMaxDisplayDelay_ = nMaxDisplayDelay;
 }
 
 int
@@ -54,9 +259,13 @@ VideoParser::HandleVideoSequence(void *pUserData, CUVIDEOFORMAT *pFormat)
     if ((pFormat->codec         != pParserData->pVideoDecoder->codec())         // codec-type
         || (pFormat->coded_width   != pParserData->pVideoDecoder->frameWidth())
         || (pFormat->coded_height  != pParserData->pVideoDecoder->frameHeight())
-        || (pFormat->chroma_format != pParserData->pVideoDecoder->chromaFormat()))
+        || (pFormat->chroma_format != pParserData->pVideoDecoder->chromaFormat())
+        || (pFormat->bit_depth_luma_minus8 != pParserData->pVideoDecoder->bitDepthMinus8()))
     {
-        // We don't deal with dynamic changes in video format
+        // Can't switch formats inside the callback; remember it and let recover() rebuild the decoder
+        pParserData->eFailure   = Failure_Format;
+        pParserData->oNewFormat = *pFormat;
+        pParserData->pStats->nFormatChanges++;
         return 0;
     }
 
@@ -69,12 +278,41 @@ VideoParser::HandlePictureDecode(void *pUserData, CUVIDPICPARAMS *pPicParams)
 {
     VideoParserData *pParserData = reinterpret_cast<VideoParserData *>(pUserData);
 
+    // A non-reference picture that won't be output needn't be decoded at all;
+    // the second field follows the first
+    bool bSkip = pPicParams->second_field
+                 ? (pParserData->aSurfaceFlags[pPicParams->CurrPicIdx] & cnSurfaceNotDecoded) != 0
+                 : !pPicParams->ref_pic_flag &&
+                   (!pParserData->oDecimator.mayKeep(pParserData->llPacketTimestamp) ||
+                    (pParserData->llPacketTimestamp >= 0 && pParserData->llPacketTimestamp < pParserData->llSkipBefore));
+    if (bSkip)
+    {
+        pParserData->aSurfaceFlags[pPicParams->CurrPicIdx] = cnSurfaceNotDecoded;
+        if (!pPicParams->second_field)
+            pParserData->pStats->nDecodesSkipped++;
+        return true;
+    }
+
     bool bFrameAvailable = pParserData->pFrameQueue->waitUntilFrameAvailable(pPicParams->CurrPicIdx);
 
     if (!bFrameAvailable)
         return false;
 
-    pParserData->pVideoDecoder->decodePicture(pPicParams, pParserData->pContext);
+    // Second fields inherit whatever the first field of the frame got
+    unsigned int nFlags = pParserData->bSuspect ? DecodedFrame_Corrupt : 0;
+    if (pPicParams->second_field)
+        pParserData->aSurfaceFlags[pPicParams->CurrPicIdx] |= nFlags;
+    else
+        pParserData->aSurfaceFlags[pPicParams->CurrPicIdx] = nFlags | (pPicParams->intra_pic_flag ? DecodedFrame_KeyFrame : 0);
+
+    CUresult oResult = pParserData->pVideoDecoder->decodePicture(pPicParams, pParserData->pContext);
+
+    if (CUDA_SUCCESS != oResult)
+    {
+        pParserData->eFailure = Failure_Decode;
+        pParserData->pStats->nDecodeErrors++;
+        return false;
+    }
 
     return true;
 }
@@ -87,7 +325,26 @@ VideoParser::HandlePictureDisplay(void *pUserData, CUVIDPARSERDISPINFO *pPicPara
 
     VideoParserData *pParserData = reinterpret_cast<VideoParserData *>(pUserData);
 	//printf("frame = %d\n", frame_num++);
-	char * temp_gpu = NULL;
+
+	// Lead-in after a seek: decoded only where later pictures reference it, never output
+	if (pParserData->llSkipBefore >= 0 && (long long)pPicParams->timestamp < pParserData->llSkipBefore)
+	{
+		pParserData->nFrameNumber++;
+		return 1;
+	}
+
+	// Decimation: unwanted frames are never mapped, so they cost no copy or readback
+	if (pParserData->oDecimator.enabled())
+	{
+		long long llTimestamp = pParserData->llPacketTimestamp >= 0 ? pPicParams->timestamp : -1;
+		bool bKeep = pParserData->oDecimator.keep(llTimestamp);
+		if (!bKeep || (pParserData->aSurfaceFlags[pPicParams->picture_index] & cnSurfaceNotDecoded))
+		{
+			pParserData->pStats->nFramesDecimated++;
+			pParserData->nFrameNumber++;
+			return 1;
+		}
+	}
 
 
 	CUVIDPROCPARAMS oVideoProcessingParameters;	CUdeviceptr		pSrc = 0;
@@ -97,18 +354,111 @@ VideoParser::HandlePictureDisplay(void *pUserData, CUVIDPARSERDISPINFO *pPicPara
 	oVideoProcessingParameters.second_field = 0;
 	oVideoProcessingParameters.top_field_first = pPicParams->top_field_first;
 	oVideoProcessingParameters.unpaired_field = (pPicParams->progressive_frame == 1);
-	pParserData->pVideoDecoder->mapFrame(pPicParams->picture_index, &pSrc, &nPitch, &oVideoProcessingParameters);
+	CUresult oResult = pParserData->pVideoDecoder->mapFrame(pPicParams->picture_index, &pSrc, &nPitch, &oVideoProcessingParameters);
+	if (CUDA_SUCCESS != oResult)
+	{
+		pParserData->eFailure = Failure_Map;
+		pParserData->pStats->nMapErrors++;
+		return 0;
+	}
+
+	unsigned int nFlags = pParserData->aSurfaceFlags[pPicParams->picture_index];
+	cuvidDecodeStatus eDecodeStatus = cuvidDecodeStatus_Success;
+	if (CUDA_SUCCESS == pParserData->pVideoDecoder->decodeStatus(pPicParams->picture_index, &eDecodeStatus) &&
+		(eDecodeStatus == cuvidDecodeStatus_Error || eDecodeStatus == cuvidDecodeStatus_Error_Concealed))
+	{
+		nFlags |= DecodedFrame_Corrupt;
+		pParserData->bCorruptionSeen = true;
+	}
+	if (nFlags & DecodedFrame_Corrupt)
+	{
+		pParserData->pStats->nCorruptFrames++;
+	}
+
+	// Newest first: a timestamp may repeat after a stream restart
+	long long llLatencyUs = -1;
+	for (unsigned int i = 1; i <= cnArrivalHistory && i <= pParserData->nArrivalHead; i++)
+	{
+		const PacketArrival &rArrival = pParserData->aArrivals[(pParserData->nArrivalHead - i) % cnArrivalHistory];
+		if (rArrival.llTimestamp == pPicParams->timestamp)
+		{
+			llLatencyUs = steadyClockUs() - rArrival.llArrivalUs;
+			break;
+		}
+	}
+	if (llLatencyUs >= 0)
+	{
+		DecodeStats *pStats = pParserData->pStats;
+		pStats->nLatencySamples++;
+		pStats->llLatencySumUs += llLatencyUs;
+		if (llLatencyUs > pStats->llLatencyMaxUs)
+			pStats->llLatencyMaxUs = llLatencyUs;
+	}
+
+	if (pParserData->pFrameSink)
+	{
+		DecodedFrame oFrame;
+		oFrame.dpFrame      = pSrc;
+		oFrame.nPitch       = nPitch;
+		oFrame.nWidth       = (unsigned int)pParserData->pVideoDecoder->targetWidth();
+		oFrame.nHeight      = (unsigned int)pParserData->pVideoDecoder->targetHeight();
+		oFrame.eFormat      = pParserData->pVideoDecoder->outputFormat();
+		oFrame.nBitDepth    = 8 + (unsigned int)pParserData->pVideoDecoder->bitDepthMinus8();
+		oFrame.llTimestamp  = pPicParams->timestamp;
+		oFrame.nFrameNumber = pParserData->nFrameNumber;
+		oFrame.nFlags       = nFlags;
+		oFrame.llLatencyUs  = llLatencyUs;
+
+		if (pParserData->pContext)
+			cuCtxPushCurrent(*pParserData->pContext);
+		pParserData->pFrameSink->onFrame(oFrame);
+		if (pParserData->pContext)
+			cuCtxPopCurrent(NULL);
+	}
+	pParserData->nFrameNumber++;
+	pParserData->llLastOutput = pPicParams->timestamp;
 #ifdef DISPLAY	
-	cv::Mat imageNV12(cv::Size(1536, 720 * 3 / 2), CV_8UC1);
-	cv::Mat imageRgb(cv::Size(1536, 720), CV_8UC3);
-	cudaMemcpy(imageNV12.data, (uchar*)pSrc, 1536 * 720 * 3 / 2, cudaMemcpyDeviceToHost);
-	cv::cvtColor(imageNV12, imageRgb, cv::COLOR_YUV2RGB_NV21);
-	cv::imshow("1", imageRgb);
-	cv::waitKey(5);
+	CUdeviceptr		pSrc_nv12 = pSrc;
+	unsigned int	nPitch_nv12 = nPitch;
+	int nWidth = (int)pParserData->pVideoDecoder->targetWidth();
+	int nHeight = (int)pParserData->pVideoDecoder->targetHeight();
+	if (pParserData->pVideoDecoder->outputFormat() == cudaVideoSurfaceFormat_P016)
+	{
+		// 10/12-bit surface: narrow to NV12 on the GPU before the readback,
+		// into a buffer that only grows if a later sequence is larger
+		size_t nBytes = (size_t)nWidth * nHeight * 3 / 2;
+		if (pParserData->nDisplayNV12Bytes < nBytes)
+		{
+			cudaFree(pParserData->pDisplayNV12);
+			pParserData->pDisplayNV12 = NULL;
+			pParserData->nDisplayNV12Bytes = 0;
+			if (cudaMalloc(&pParserData->pDisplayNV12, nBytes) == cudaSuccess)
+				pParserData->nDisplayNV12Bytes = nBytes;
+			else
+				pParserData->pDisplayNV12 = NULL;
+		}
+		// Not shown without the buffer
+		pSrc_nv12 = (CUdeviceptr)pParserData->pDisplayNV12;
+		nPitch_nv12 = nWidth;
+		if (pSrc_nv12)
+			convertP016ToNV12(pSrc, nPitch, pSrc_nv12, nWidth, nWidth, nHeight);
+	}
+	if (pSrc_nv12)
+	{
+		cv::Mat imageNV12(cv::Size(nWidth, nHeight * 3 / 2), CV_8UC1);
+		cv::Mat imageRgb(cv::Size(nWidth, nHeight), CV_8UC3);
+		cudaMemcpy2D(imageNV12.data, nWidth, (uchar*)pSrc_nv12, nPitch_nv12, nWidth, nHeight * 3 / 2, cudaMemcpyDeviceToHost);
+		cv::cvtColor(imageNV12, imageRgb, cv::COLOR_YUV2BGR_NV12);
+		cv::imshow("1", imageRgb);
+		cv::waitKey(5);
+	}
 #endif
-	pParserData->pVideoDecoder->unmapFrame(pSrc);
+	if (CUDA_SUCCESS != pParserData->pVideoDecoder->unmapFrame(pSrc))
+	{
+		// The frame itself was fine; a leaked mapping shows up as map errors later
+		pParserData->pStats->nUnmapErrors++;
+	}
     //pParserData->pFrameQueue->enqueue(pPicParams);
-	cudaFree(temp_gpu);
     return 1;
 }
 
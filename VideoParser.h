@@ -17,6 +17,11 @@
 
 #include <iostream>
 
+#include "DecodeStats.h"
+#include "FrameDecimator.h"
+#include "FrameQueue.h"
+#include "FrameSink.h"
+
 class FrameQueue;
 class VideoDecoder;
 
@@ -40,15 +45,148 @@ class VideoParser
         //          is used in the parser-callbacks to decode video-frames.
         //      pFrameQueue - pointer to a valid FrameQueue object. The FrameQueue is used
         //          by  the parser-callbacks to store decoded frames in it.
-        VideoParser(VideoDecoder *pVideoDecoder, FrameQueue *pFrameQueue, CUcontext *pCudaContext = NULL);
+        //      pStats - failure counters of the stream, may be NULL.
+        //      nMaxDisplayDelay - pictures the parser may hold back for reordering
+        //          before display. 0 hands each picture out as soon as it can be
+        //          displayed (lowest latency, no decode/display overlap).
+        VideoParser(VideoDecoder *pVideoDecoder, FrameQueue *pFrameQueue, CUcontext *pCudaContext = NULL,
+                    DecodeStats *pStats = NULL, unsigned int nMaxDisplayDelay = 1);
+
+        ~VideoParser();
+
+        // Result of the last parser creation.
+        CUresult
+        status()
+        const;
+
+        // Brings the stream back after cuvidParseVideoData failed: recreates
+        // the decoder if it failed (or for the new format after a sequence
+        // change) and starts over with a fresh parser. The caller has to
+        // resync the bitstream at the next keyframe.
+        CUresult
+        recover();
+
+        // Starts over with a fresh parser and decimation timeline, e.g. after
+        // a seek. Unlike recover() the decoder is kept and nothing is counted.
+        CUresult
+        reset();
+
+        // Feeds a packet to the parser, for owners that demux on their own
+        // instead of through a VideoSource.
+        CUresult
+        parse(CUVIDSOURCEDATAPACKET *pPacket);
+
+        // Display delay of the parsers created from now on (the next reset()
+        // or recover()), see the constructor.
+        void
+        setMaxDisplayDelay(unsigned int nMaxDisplayDelay);
+
+        // True if a callback failed since the last recover(). The parser
+        // doesn't always turn a failed callback into an error result.
+        bool
+        failed()
+        const;
+
+        // Every displayed frame is handed to pSink (NULL to stop).
+        void
+        setFrameSink(FrameSink *pSink);
+
+        // While set, pictures sent to the decoder are flagged
+        // DecodedFrame_Corrupt when they are displayed.
+        void
+        setSuspect(bool bSuspect);
+
+        // True (once) if the decoder reported an error for a displayed
+        // picture since the last call; the source should resync.
+        bool
+        takeCorruption();
+
+        // Records when the packet carrying llTimestamp arrived, so the
+        // latency of the frame it produces can be measured. Call on the
+        // demux thread before the packet is parsed.
+        void
+        notePacketArrival(long long llTimestamp, long long llArrivalUs);
+
+        // Outputs only dTargetFps frames per second (0 outputs all), evenly
+        // spaced by timestamp; see FrameDecimator. Non-reference pictures
+        // that won't be output are not decoded, unwanted reference pictures
+        // are decoded but never mapped. dSourceFps is the nominal stream rate,
+        // 0 if unknown. Call before the first packet.
+        void
+        setTargetFrameRate(double dTargetFps, double dSourceFps);
+
+        // Leaves out every picture timestamped before llTimestamp, -1 for
+        // none: after a seek, the pictures between the keyframe and the
+        // wanted position. They are skipped like decimated pictures.
+        // Call while no packet is being parsed.
+        void
+        setSkipBefore(long long llTimestamp);
+
+        // True while pictures are being left out by setTargetFrameRate() or
+        // setSkipBefore(); each packet then has to be a complete picture.
+        bool
+        decimating()
+        const;
+
+        // Timestamp of the last picture output (mapped and handed on), -1
+        // if none yet.
+        long long
+        lastOutputTimestamp()
+        const;
+
+        // Timestamp of the packet about to be parsed, -1 if it has none.
+        // Decode-time decimation needs it, so while decimating every packet
+        // must be a complete picture (CUVID_PKT_ENDOFPICTURE).
+        void
+        notePacketTimestamp(long long llTimestamp);
 
     private:
+        // Packets whose arrival time is remembered; must cover the parser's
+        // reorder window.
+        static const int cnArrivalHistory = 32;
+
+        // aSurfaceFlags bit of a picture decimation left undecoded.
+        static const unsigned int cnSurfaceNotDecoded = 0x80000000u;
+
+        struct PacketArrival
+        {
+            long long llTimestamp;
+            long long llArrivalUs;
+        };
+
+        // Which callback made the last cuvidParseVideoData call fail.
+        enum Failure
+        {
+            Failure_None = 0,
+            Failure_Decode,
+            Failure_Map,
+            Failure_Format
+        };
+
         // Struct containing user-data to be passed by parser-callbacks.
         struct VideoParserData
         {
             VideoDecoder *pVideoDecoder;
             FrameQueue    *pFrameQueue;
             CUcontext     *pContext;
+            DecodeStats   *pStats;
+            Failure        eFailure;
+            CUVIDEOFORMAT  oNewFormat;  // valid when eFailure == Failure_Format
+            FrameSink     *pFrameSink;
+            volatile bool  bSuspect;
+            volatile bool  bCorruptionSeen;
+            unsigned long  nFrameNumber;
+            unsigned int   aSurfaceFlags[FrameQueue::cnMaximumSize];    // DecodedFrameFlags per decode surface
+            PacketArrival  aArrivals[cnArrivalHistory];                 // ring, written by notePacketArrival()
+            unsigned int   nArrivalHead;
+            FrameDecimator oDecimator;
+            long long      llPacketTimestamp;   // set by notePacketTimestamp(), -1 if none
+            long long      llSkipBefore;        // set by setSkipBefore(), -1 if none
+            long long      llLastOutput;        // timestamp of the last picture output, -1 if none
+#ifdef DISPLAY
+            void          *pDisplayNV12;        // P016 frames narrowed for display, kept for the parser's life
+            size_t         nDisplayNV12Bytes;
+#endif
         };
 
         // Default constructor. Don't implement.
@@ -62,9 +200,13 @@ class VideoParser
         void
         operator= (const VideoParser &);
 
+        CUresult
+        createParser();
+
         // Called when the decoder encounters a video format change (or initial sequence header)
         // This particular implementation of the callback returns 0 in case the video format changes
-        // to something different than the original format. Returning 0 causes a stop of the app.
+        // to something different than the original format. Returning 0 fails the current
+        // cuvidParseVideoData call; recover() then recreates the decoder for the new format.
         static
         int
         CUDAAPI
@@ -88,6 +230,9 @@ class VideoParser
 
         VideoParserData oParserData_;   // instance of the user-data we have passed into the parser-callbacks.
         CUvideoparser   hParser_;       // handle to the CUDA video-parser
+        CUresult        oStatus_;       // result of the last parser creation
+        unsigned int    nMaxDisplayDelay_;
+        DecodeStats     oOwnStats_;     // used when the owner doesn't pass counters in
 
         friend class VideoSource;
 };
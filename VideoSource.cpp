@@ -13,6 +13,11 @@
 
 #include "FrameQueue.h"
 #include "VideoParser.h"
+#include "RtpReceiver.h"
+#include "TsDemuxer.h"
+#include "UdpSocket.h"
+#include "EsFileReader.h"
+#include "StreamAnalyzer.h"
 
 #include <assert.h>
 extern "C"
@@ -23,11 +28,8 @@ extern "C"
 #include "libavutil/imgutils.h"
 }
 
-AVFormatContext* pFormatCtx;
-int videoindex;
-AVCodecContext* pCodecCtx;
-CUVIDEOFORMAT g_stFormat;
-AVBitStreamFilterContext *h264bsfc;
+//av_register_all()和网络初始化整个进程只做一次，多路流并行open时不能重入
+static std::once_flag g_oFFmpegInit;
 
 bool VideoSource::init(const std::string sFileName, FrameQueue *pFrameQueue)
 {
@@ -38,35 +40,56 @@ bool VideoSource::init(const std::string sFileName, FrameQueue *pFrameQueue)
 	int                i;
 	AVCodec            *pCodec;
 
-	av_register_all();
-	avformat_network_init();
-	pFormatCtx = avformat_alloc_context();
+	std::call_once(g_oFFmpegInit, []() {
+		av_register_all();
+		avformat_network_init();
+	});
+	pFormatCtx_ = avformat_alloc_context();
 
-	if (avformat_open_input(&pFormatCtx, sFileName.c_str(), NULL, NULL) != 0){
+	AVDictionary *pOptions = NULL;
+	if (eProfile_ == StreamProfile_LowLatency)
+	{
+		//不要在demux里攒包，探测也尽量少读
+		av_dict_set(&pOptions, "fflags", "nobuffer", 0);
+		av_dict_set(&pOptions, "flags", "low_delay", 0);
+		av_dict_set(&pOptions, "probesize", "32768", 0);
+		av_dict_set(&pOptions, "analyzeduration", "100000", 0);
+		//rtsp的乱序缓冲，UDP比TCP少一次重传等待
+		av_dict_set(&pOptions, "max_delay", "0", 0);
+		av_dict_set(&pOptions, "rtsp_transport", "udp", 0);
+	}
+	int nOpen = avformat_open_input(&pFormatCtx_, sFileName.c_str(), NULL, &pOptions);
+	av_dict_free(&pOptions);
+	if (nOpen != 0){
 		printf("Couldn't open input stream.\n");
 		return false;
 	}
-	if (avformat_find_stream_info(pFormatCtx, NULL) < 0){
+	if (avformat_find_stream_info(pFormatCtx_, NULL) < 0){
 		printf("Couldn't find stream information.\n");
 		return false;
 	}
-	videoindex = -1;
-	for (i = 0; i < pFormatCtx->nb_streams; i++)
-		if (pFormatCtx->streams[i]->codec->codec_type == AVMEDIA_TYPE_VIDEO){
-			videoindex = i;
+	nVideoIndex_ = -1;
+	for (i = 0; i < pFormatCtx_->nb_streams; i++)
+		if (pFormatCtx_->streams[i]->codec->codec_type == AVMEDIA_TYPE_VIDEO){
+			nVideoIndex_ = i;
 			break;
 		}
 
-	if (videoindex == -1){
+	if (nVideoIndex_ == -1){
 		printf("Didn't find a video stream.\n");
 		return false;
 	}
 
-	pCodecCtx = pFormatCtx->streams[videoindex]->codec;
+	pCodecCtx_ = pFormatCtx_->streams[nVideoIndex_]->codec;
+	if (eProfile_ == StreamProfile_LowLatency && pCodecCtx_->has_b_frames)
+	{
+		//有B帧的流显示顺序和解码顺序不同，parser仍然要等参考帧，延迟降不到一帧
+		printf("low latency: stream has B-frames, display is delayed by reordering\n");
+	}
 
 
 
-	pCodec = avcodec_find_decoder(pCodecCtx->codec_id);
+	pCodec = avcodec_find_decoder(pCodecCtx_->codec_id);
 	if (pCodec == NULL){
 		printf("Codec not found.\n");
 		return false;
@@ -74,114 +97,179 @@ bool VideoSource::init(const std::string sFileName, FrameQueue *pFrameQueue)
 
 	//Output Info-----------------------------
 	printf("--------------- File Information ----------------\n");
-	av_dump_format(pFormatCtx, 0, sFileName.c_str(), 0);
+	av_dump_format(pFormatCtx_, 0, sFileName.c_str(), 0);
 	
 	printf("-------------------------------------------------\n");
 
-	memset(&g_stFormat, 0, sizeof(CUVIDEOFORMAT));
+	memset(&oFormat_, 0, sizeof(CUVIDEOFORMAT));
 
-	switch (pCodecCtx->codec_id) {
+	switch (pCodecCtx_->codec_id) {
 	case AV_CODEC_ID_H263:
-		g_stFormat.codec = cudaVideoCodec_MPEG4;
+		oFormat_.codec = cudaVideoCodec_MPEG4;
 		break;
 
 	case AV_CODEC_ID_H264:
-		g_stFormat.codec = cudaVideoCodec_H264;
+		oFormat_.codec = cudaVideoCodec_H264;
 		break;
 
 	case AV_CODEC_ID_HEVC:
-		g_stFormat.codec = cudaVideoCodec_HEVC;
+		oFormat_.codec = cudaVideoCodec_HEVC;
 		break;
 
 	case AV_CODEC_ID_MJPEG:
-		g_stFormat.codec = cudaVideoCodec_JPEG;
+		oFormat_.codec = cudaVideoCodec_JPEG;
 		break;
 
 	case AV_CODEC_ID_MPEG1VIDEO:
-		g_stFormat.codec = cudaVideoCodec_MPEG1;
+		oFormat_.codec = cudaVideoCodec_MPEG1;
 		break;
 
 	case AV_CODEC_ID_MPEG2VIDEO:
-		g_stFormat.codec = cudaVideoCodec_MPEG2;
+		oFormat_.codec = cudaVideoCodec_MPEG2;
 		break;
 
 	case AV_CODEC_ID_MPEG4:
-		g_stFormat.codec = cudaVideoCodec_MPEG4;
+		oFormat_.codec = cudaVideoCodec_MPEG4;
 		break;
 
-		/*case AV_CODEC_ID_VP8:
-			g_stFormat.codec = cudaVideoCodec_VP8;
-			break;
+	case AV_CODEC_ID_VP8:
+		oFormat_.codec = cudaVideoCodec_VP8;
+		break;
 
-			case AV_CODEC_ID_VP9:
-			g_stFormat.codec = cudaVideoCodec_VP9;
-			break;*/
+	case AV_CODEC_ID_VP9:
+		oFormat_.codec = cudaVideoCodec_VP9;
+		break;
+
+	case AV_CODEC_ID_AV1:
+		oFormat_.codec = cudaVideoCodec_AV1;
+		break;
 
 	case AV_CODEC_ID_VC1:
-		g_stFormat.codec = cudaVideoCodec_VC1;
+		oFormat_.codec = cudaVideoCodec_VC1;
 		break;
 	default:
 		return false;
 	}
 
 	//这个地方的FFmoeg与cuvid的对应关系不是很确定，不过用这个参数似乎最靠谱
-	switch (pCodecCtx->sw_pix_fmt)
+	switch (pCodecCtx_->sw_pix_fmt)
 	{
 	case AV_PIX_FMT_YUV420P:
-		g_stFormat.chroma_format = cudaVideoChromaFormat_420;
+		oFormat_.chroma_format = cudaVideoChromaFormat_420;
 		break;
 	case AV_PIX_FMT_YUV422P:
-		g_stFormat.chroma_format = cudaVideoChromaFormat_422;
+		oFormat_.chroma_format = cudaVideoChromaFormat_422;
 		break;
 	case AV_PIX_FMT_YUV444P:
-		g_stFormat.chroma_format = cudaVideoChromaFormat_444;
+		oFormat_.chroma_format = cudaVideoChromaFormat_444;
+		break;
+	case AV_PIX_FMT_YUV420P10LE:
+		oFormat_.chroma_format = cudaVideoChromaFormat_420;
+		oFormat_.bit_depth_luma_minus8 = 2;
+		break;
+	case AV_PIX_FMT_YUV420P12LE:
+		oFormat_.chroma_format = cudaVideoChromaFormat_420;
+		oFormat_.bit_depth_luma_minus8 = 4;
+		break;
+	case AV_PIX_FMT_YUV422P10LE:
+		oFormat_.chroma_format = cudaVideoChromaFormat_422;
+		oFormat_.bit_depth_luma_minus8 = 2;
+		break;
+	case AV_PIX_FMT_YUV444P10LE:
+		oFormat_.chroma_format = cudaVideoChromaFormat_444;
+		oFormat_.bit_depth_luma_minus8 = 2;
 		break;
 	default:
-		g_stFormat.chroma_format = cudaVideoChromaFormat_420;
+		oFormat_.chroma_format = cudaVideoChromaFormat_420;
 		break;
 	}
+	//sw_pix_fmt不一定可靠(rtsp常常是NONE)，再用bits_per_raw_sample兜底
+	if (oFormat_.bit_depth_luma_minus8 == 0 && pCodecCtx_->bits_per_raw_sample > 8)
+	{
+		oFormat_.bit_depth_luma_minus8 = pCodecCtx_->bits_per_raw_sample - 8;
+	}
+	oFormat_.bit_depth_chroma_minus8 = oFormat_.bit_depth_luma_minus8;
+	//输出只有NV12/P016这两种4:2:0格式，4:2:2和4:4:4会被当成4:2:0读错，直接拒绝
+	if (oFormat_.chroma_format == cudaVideoChromaFormat_422 || oFormat_.chroma_format == cudaVideoChromaFormat_444)
+	{
+		printf("%s: %s chroma is not supported, only 4:2:0 (NV12/P016 output)\n", sFileName.c_str(),
+			oFormat_.chroma_format == cudaVideoChromaFormat_422 ? "4:2:2" : "4:4:4");
+		return false;
+	}
 
 	//找了好久，总算是找到了FFmpeg中标识场格式和帧格式的标识位
 	//场格式是隔行扫描的，需要做去隔行处理
-	switch (pCodecCtx->field_order)
+	switch (pCodecCtx_->field_order)
 	{
 	case AV_FIELD_PROGRESSIVE:
 	case AV_FIELD_UNKNOWN:
-		g_stFormat.progressive_sequence = true;
+		oFormat_.progressive_sequence = true;
 		break;
 	default:
-		g_stFormat.progressive_sequence = false;
+		oFormat_.progressive_sequence = false;
 		break;
 	}
 
-	pCodecCtx->thread_safe_callbacks = 1;
+	pCodecCtx_->thread_safe_callbacks = 1;
+
+	oFormat_.coded_width = pCodecCtx_->coded_width;
+	oFormat_.coded_height = pCodecCtx_->coded_height;
 
-	g_stFormat.coded_width = pCodecCtx->coded_width;
-	g_stFormat.coded_height = pCodecCtx->coded_height;
+	oFormat_.display_area.right = pCodecCtx_->width;
+	oFormat_.display_area.left = 0;
+	oFormat_.display_area.bottom = pCodecCtx_->height;
+	oFormat_.display_area.top = 0;
 
-	g_stFormat.display_area.right = pCodecCtx->width;
-	g_stFormat.display_area.left = 0;
-	g_stFormat.display_area.bottom = pCodecCtx->height;
-	g_stFormat.display_area.top = 0;
-	if (pCodecCtx->codec_id == AV_CODEC_ID_H264 || pCodecCtx->codec_id == AV_CODEC_ID_HEVC) {
-		if (pCodecCtx->codec_id == AV_CODEC_ID_H264)
-			h264bsfc = av_bitstream_filter_init("h264_mp4toannexb");
+	AVRational oFrameRate = pFormatCtx_->streams[nVideoIndex_]->avg_frame_rate;
+	if (oFrameRate.num > 0 && oFrameRate.den > 0)
+	{
+		oFormat_.frame_rate.numerator = oFrameRate.num;
+		oFormat_.frame_rate.denominator = oFrameRate.den;
+	}
+	if (pCodecCtx_->codec_id == AV_CODEC_ID_H264 || pCodecCtx_->codec_id == AV_CODEC_ID_HEVC) {
+		if (pCodecCtx_->codec_id == AV_CODEC_ID_H264)
+			pBitstreamFilter_ = av_bitstream_filter_init("h264_mp4toannexb");
 		else
-			h264bsfc = av_bitstream_filter_init("hevc_mp4toannexb");
+			pBitstreamFilter_ = av_bitstream_filter_init("hevc_mp4toannexb");
 	}
 	if (strcmp("rtsp", sFileName.c_str()) <= 0)
 	{
-		h264bsfc = 0;
+		pBitstreamFilter_ = 0;
 	}
-	//printf("code id = %d ,h264=%ld,w=%d,h=%d\n", pCodecCtx->codec_id, h264bsfc, g_stFormat.coded_width, g_stFormat.coded_height);
+	//printf("code id = %d ,h264=%ld,w=%d,h=%d\n", pCodecCtx_->codec_id, pBitstreamFilter_, oFormat_.coded_width, oFormat_.coded_height);
 	//FILE* fp = fopen("temp.data", "rb");
-	//fread(pCodecCtx->extradata, 1,51, fp);
+	//fread(pCodecCtx_->extradata, 1,51, fp);
 	//fclose(fp);
-	//printf("size=%d\n", pCodecCtx->extradata_size);
+	//printf("size=%d\n", pCodecCtx_->extradata_size);
 	//exit(1);
 	return true;
 }
 
+//FFmpeg的pts换算成微秒，和native输入的AccessUnit时间戳一致
+static long long packetTimestamp(const AVPacket *pPacket, const AVCodecContext *pCodecCtx)
+{
+	if (pCodecCtx->pkt_timebase.num && pCodecCtx->pkt_timebase.den)
+	{
+		AVRational tb;
+		tb.num = 1;
+		tb.den = AV_TIME_BASE;
+		return av_rescale_q(pPacket->pts, pCodecCtx->pkt_timebase, tb);
+	}
+	return pPacket->pts;
+}
+
+//过完bitstream filter的FFmpeg包包装成AccessUnit，给StreamAnalyzer用
+static void packetToUnit(const AVPacket *pPacket, const AVCodecContext *pCodecCtx, long long llArrivalUs, AccessUnit &rUnit)
+{
+	rUnit.pData = pPacket->data;
+	rUnit.nSize = (size_t)pPacket->size;
+	rUnit.llTimestamp = pPacket->pts != AV_NOPTS_VALUE ? packetTimestamp(pPacket, pCodecCtx) : -1;
+	rUnit.llArrivalUs = llArrivalUs;
+	rUnit.bKeyFrame = (pPacket->flags & AV_PKT_FLAG_KEY) != 0;
+	rUnit.bLossBefore = false;
+	rUnit.bIncomplete = (pPacket->flags & AV_PKT_FLAG_CORRUPT) != 0;
+}
+
 #if 0
 void VideoSource::internal_thread_entry()
 {
@@ -192,21 +280,21 @@ void VideoSource::internal_thread_entry()
 	CUresult oResult;
 	bool first = true;
 	printf("start thread\n");
-	while (av_read_frame(pFormatCtx, avpkt) >= 0){
+	while (av_read_frame(pFormatCtx_, avpkt) >= 0){
 		//if (bThreadExit){
 			//break;
 		//}
 		//bStarted = true;
 		//if (first)
 		printf("111\n");
-		if (avpkt->stream_index == videoindex){
+		if (avpkt->stream_index == nVideoIndex_){
 
 			//cuCtxPushCurrent(g_oContext);
 
 			if (avpkt && avpkt->size) {
-				if (h264bsfc)
+				if (pBitstreamFilter_)
 				{
-					av_bitstream_filter_filter(h264bsfc, pFormatCtx->streams[videoindex]->codec, NULL, &avpkt->data, &avpkt->size, avpkt->data, avpkt->size, 0);
+					av_bitstream_filter_filter(pBitstreamFilter_, pFormatCtx_->streams[nVideoIndex_]->codec, NULL, &avpkt->data, &avpkt->size, avpkt->data, avpkt->size, 0);
 
 				}
 				printf("222-1\n");
@@ -215,11 +303,11 @@ void VideoSource::internal_thread_entry()
 
 				if (avpkt->pts != AV_NOPTS_VALUE) {
 					cupkt.flags = CUVID_PKT_TIMESTAMP;
-					if (pCodecCtx->pkt_timebase.num && pCodecCtx->pkt_timebase.den){
+					if (pCodecCtx_->pkt_timebase.num && pCodecCtx_->pkt_timebase.den){
 						AVRational tb;
 						tb.num = 1;
 						tb.den = AV_TIME_BASE;
-						cupkt.timestamp = av_rescale_q(avpkt->pts, pCodecCtx->pkt_timebase, tb);
+						cupkt.timestamp = av_rescale_q(avpkt->pts, pCodecCtx_->pkt_timebase, tb);
 						printf("222-2\n");
 					}
 					else
@@ -246,8 +334,8 @@ void VideoSource::internal_thread_entry()
 
 	oSourceData_.pFrameQueue->endDecode();
 	//bStarted = false;
-	if (pCodecCtx->codec_id == AV_CODEC_ID_H264 || pCodecCtx->codec_id == AV_CODEC_ID_HEVC) {
-		av_bitstream_filter_close(h264bsfc);
+	if (pCodecCtx_->codec_id == AV_CODEC_ID_H264 || pCodecCtx_->codec_id == AV_CODEC_ID_HEVC) {
+		av_bitstream_filter_close(pBitstreamFilter_);
 	}
 }
 #endif
@@ -258,37 +346,82 @@ void VideoSource::internal_thread_entry()
 	avpkt = (AVPacket *)av_malloc(sizeof(AVPacket));
 	CUVIDSOURCEDATAPACKET cupkt;
 	CUresult oResult;
-	bool first = true;
-	while (av_read_frame(pFormatCtx, avpkt) >= 0){
-	LOOP0:
-		/*if (bThreadExit){
+	bool bWaitForKeyFrame = false;
+	bool bResync = false;
+	bool bSentEOS = false;
+	DecodeStats *pStats = pVideoParser_->oParserData_.pStats;
+	int nRead = 0;
+	bool bSeeked = false;
+	bStarted = true;
+	while ((nRead = readPacket(avpkt, bSeeked)) >= 0){
+		long long llArrivalUs = steadyClockUs();
+		if (bThreadExit){
+			av_free_packet(avpkt);
 			break;
-		}*/
+		}
+		//seek之后从关键帧开始，之前的丢包状态也作废
+		if (bSeeked)
+		{
+			bWaitForKeyFrame = true;
+			bResync = false;
+			pVideoParser_->setSuspect(false);
+		}
 		
-		if (avpkt->stream_index == videoindex)
+		if (avpkt->stream_index == nVideoIndex_)
 		{
-			AVPacket new_pkt = *avpkt;
-			if (avpkt && avpkt->size)
+			//丢包检测：传输层报告的序号断档、FFmpeg标记的损坏包、解码器报告的错误
+			bool bCorrupt = (avpkt->flags & AV_PKT_FLAG_CORRUPT) != 0;
+			if (bLossReported_.exchange(false) | bCorrupt | pVideoParser_->takeCorruption())
+			{
+				pStats->nLossEvents++;
+				bResync = true;
+				if (bSkipOnLoss_)
+					bWaitForKeyFrame = true;
+				else
+					pVideoParser_->setSuspect(true);
+			}
+
+			//恢复之后丢掉关键帧之前的包，否则解出来的都是花屏
+			if ((bCorrupt && bSkipOnLoss_) ||
+				(bWaitForKeyFrame && !(avpkt->flags & AV_PKT_FLAG_KEY)))
 			{
-				if (h264bsfc){
+				pStats->nPacketsDropped++;
+				av_free_packet(avpkt);
+				continue;
+			}
+			bWaitForKeyFrame = false;
 
-					int a = av_bitstream_filter_filter(h264bsfc, pFormatCtx->streams[videoindex]->codec, NULL,
+			//只解关键帧：其余的包在bitstream filter之前就丢掉
+			if (bKeyFrameOnly_ && !keepKeyFrame((avpkt->flags & AV_PKT_FLAG_KEY) != 0,
+				avpkt->pts != AV_NOPTS_VALUE ? packetTimestamp(avpkt, pCodecCtx_) : -1))
+			{
+				pStats->nPacketsSkipped++;
+				av_free_packet(avpkt);
+				continue;
+			}
+
+			bool bFiltered = false;
+			memset(&cupkt, 0, sizeof(CUVIDSOURCEDATAPACKET));
+			if (avpkt->size)
+			{
+				if (pBitstreamFilter_){
+					AVPacket new_pkt = *avpkt;
+					int a = av_bitstream_filter_filter(pBitstreamFilter_, pFormatCtx_->streams[nVideoIndex_]->codec, NULL,
 						&new_pkt.data, &new_pkt.size,
 						avpkt->data, avpkt->size,
 						avpkt->flags & AV_PKT_FLAG_KEY);
-					if (a > 0){
-						if (new_pkt.data != avpkt->data)//-added this
-						{
-							av_free_packet(avpkt);
-
-							avpkt->data = new_pkt.data;
-							avpkt->size = new_pkt.size;
-						}
+					if (a < 0){
+						pStats->nDemuxErrors++;
+						pStats->nPacketsDropped++;
+						av_free_packet(avpkt);
+						bWaitForKeyFrame = true;
+						continue;
 					}
-					else if (a < 0){
-						goto LOOP0;
+					if (a > 0 && new_pkt.data != avpkt->data)
+					{
+						av_free_packet(avpkt);
+						bFiltered = true;
 					}
-
 					*avpkt = new_pkt;
 				}
 
@@ -298,15 +431,35 @@ void VideoSource::internal_thread_entry()
 				if (avpkt->pts != AV_NOPTS_VALUE)
 				{
 					cupkt.flags = CUVID_PKT_TIMESTAMP;
-					if (pCodecCtx->pkt_timebase.num && pCodecCtx->pkt_timebase.den)
-					{
-						AVRational tb;
-						tb.num = 1;
-						tb.den = AV_TIME_BASE;
-						cupkt.timestamp = av_rescale_q(avpkt->pts, pCodecCtx->pkt_timebase, tb);
-					}
-					else
-						cupkt.timestamp = avpkt->pts;
+					cupkt.timestamp = packetTimestamp(avpkt, pCodecCtx_);
+				}
+
+				//断档之后的第一个关键帧：通知parser不要拿之前的参考帧
+				if (bResync && (avpkt->flags & AV_PKT_FLAG_KEY) && !bCorrupt)
+				{
+					cupkt.flags |= CUVID_PKT_DISCONTINUITY;
+					pVideoParser_->setSuspect(false);
+					bResync = false;
+				}
+
+				//FFmpeg的包就是一整帧，告诉parser不用等下一个起始码再解码
+				//抽帧时也要这样，解码回调里才知道当前这一帧的时间戳
+				if (eProfile_ == StreamProfile_LowLatency || pVideoParser_->decimating())
+					cupkt.flags |= CUVID_PKT_ENDOFPICTURE;
+
+				//每个关键帧单独成帧：前面的参考帧都没送，按断档处理
+				if (bKeyFrameOnly_)
+					cupkt.flags |= CUVID_PKT_ENDOFPICTURE | CUVID_PKT_DISCONTINUITY;
+
+				if (cupkt.flags & CUVID_PKT_TIMESTAMP)
+					pVideoParser_->notePacketArrival(cupkt.timestamp, llArrivalUs);
+				pVideoParser_->notePacketTimestamp((cupkt.flags & CUVID_PKT_TIMESTAMP) ? (long long)cupkt.timestamp : -1);
+
+				if (pAnalyzer_)
+				{
+					AccessUnit oUnit;
+					packetToUnit(avpkt, pCodecCtx_, llArrivalUs, oUnit);
+					pAnalyzer_->analyze(oUnit);
 				}
 			}
 			else
@@ -315,34 +468,647 @@ void VideoSource::internal_thread_entry()
 			}
 
 			oResult = cuvidParseVideoData(oSourceData_.hVideoParser, &cupkt);
-			if ((cupkt.flags & CUVID_PKT_ENDOFSTREAM) || (oResult != CUDA_SUCCESS))
+
+			if (bFiltered)
+				av_free(avpkt->data);
+			else
+				av_free_packet(avpkt);
+
+			if (oResult != CUDA_SUCCESS || pVideoParser_->failed())
 			{
-				printf("handle = %d ,break =%d,%d\n", oSourceData_.hVideoParser, cupkt.flags, oResult);
-				break;
+				pStats->nParseErrors++;
+				if (!recoverStream())
+				{
+					printf("stream failed %d times in a row, giving up (%d)\n", nConsecutiveFailures_, oResult);
+					break;
+				}
+				bWaitForKeyFrame = true;
+				bResync = false;
+				pVideoParser_->setSuspect(false);
+				continue;
 			}
+			nConsecutiveFailures_ = 0;
 
-			av_free(new_pkt.data);
+			if (cupkt.flags & CUVID_PKT_ENDOFSTREAM)
+			{
+				bSentEOS = true;
+				break;
+			}
 		}
 		else
 			av_free_packet(avpkt);
 	}
+	if (nRead < 0 && nRead != AVERROR_EOF && nRead != AVERROR_EXIT)
+	{
+		pStats->nDemuxErrors++;
+	}
+	//把parser里缓存的帧冲出来
+	if (!bSentEOS && oSourceData_.hVideoParser)
+	{
+		memset(&cupkt, 0, sizeof(CUVIDSOURCEDATAPACKET));
+		cupkt.flags = CUVID_PKT_ENDOFSTREAM;
+		cuvidParseVideoData(oSourceData_.hVideoParser, &cupkt);
+	}
+
+	av_free(avpkt);
 	oSourceData_.pFrameQueue->endDecode();
-	//bStarted = false;
+	bStarted = false;
 	printf("moon decode over!\n");
 	
-	if (pCodecCtx->codec_id == AV_CODEC_ID_H264 || pCodecCtx->codec_id == AV_CODEC_ID_HEVC) {
-		av_bitstream_filter_close(h264bsfc);
+	if (pCodecCtx_->codec_id == AV_CODEC_ID_H264 || pCodecCtx_->codec_id == AV_CODEC_ID_HEVC) {
+		av_bitstream_filter_close(pBitstreamFilter_);
 	}
 	oSourceData_.pFrameQueue->isDecodeFinished();
 }
-#endif
-VideoSource::VideoSource() : hVideoSource_(0)
+
+int VideoSource::readPacket(AVPacket *pPacket, bool &bSeeked)
+{
+	bSeeked = false;
+	for (;;)
+	{
+		bool bSeek = false;
+		long long llTarget = 0;
+		{
+			std::unique_lock<std::mutex> oLock(oControlMutex_);
+			while ((bPauseRequested_ || (bAtEnd_ && !bSeekPending_)) && !bThreadExit)
+			{
+				bParked_ = true;
+				oControlCond_.notify_all();
+				oControlCond_.wait(oLock);
+			}
+			bParked_ = false;
+			if (bThreadExit)
+				return AVERROR_EXIT;
+			if (bSeekPending_)
+			{
+				bSeek = true;
+				llTarget = llSeekTarget_;
+				bSeekPending_ = false;
+				bAtEnd_ = false;
+			}
+		}
+		if (bSeek)
+		{
+			seekTo(llTarget);
+			bSeeked = true;
+		}
+
+		int nRead = av_read_frame(pFormatCtx_, pPacket);
+		if (nRead >= 0 || !bHoldAtEnd_)
+			return nRead;
+
+		//保持模式：读到结尾先把parser里的帧冲出来，然后停下来等下一次seek
+		flushParser();
+		std::lock_guard<std::mutex> oLock(oControlMutex_);
+		bAtEnd_ = true;
+		oControlCond_.notify_all();
+	}
+}
+
+void VideoSource::seekTo(long long llTimestamp)
+{
+	//时间戳和packetTimestamp()一样是微秒，换回流的time_base
+	int64_t llStreamTimestamp = llTimestamp;
+	if (pCodecCtx_->pkt_timebase.num && pCodecCtx_->pkt_timebase.den)
+	{
+		AVRational tb;
+		tb.num = 1;
+		tb.den = AV_TIME_BASE;
+		llStreamTimestamp = av_rescale_q(llTimestamp, tb, pCodecCtx_->pkt_timebase);
+	}
+	if (av_seek_frame(pFormatCtx_, nVideoIndex_, llStreamTimestamp, AVSEEK_FLAG_BACKWARD) < 0)
+	{
+		printf("seek to %lld failed\n", llTimestamp);
+		pVideoParser_->oParserData_.pStats->nDemuxErrors++;
+	}
+
+	//parser里还是旧位置的帧和参考帧，整个重建
+	pVideoParser_->reset();
+	oSourceData_.hVideoParser = pVideoParser_->hParser_;
+	llNextKeyFrameUs_ = -1;
+}
+
+bool VideoSource::controllable()
+const
+{
+	return !pRtpReceiver_ && !pTsDemuxer_ && !pEsReader_ && pVideoParser_;
+}
+
+void VideoSource::analysis_thread_entry()
+{
+	AVPacket *avpkt;
+	avpkt = (AVPacket *)av_malloc(sizeof(AVPacket));
+	bStarted = true;
+	while (!bThreadExit && av_read_frame(pFormatCtx_, avpkt) >= 0)
+	{
+		long long llArrivalUs = steadyClockUs();
+		if (avpkt->stream_index != nVideoIndex_ || avpkt->size == 0 || !pAnalyzer_)
+		{
+			av_free_packet(avpkt);
+			continue;
+		}
+
+		//slice头要Annex-B格式才能找起始码，和解码路径一样先过bitstream filter
+		AVPacket new_pkt = *avpkt;
+		bool bFiltered = false;
+		if (pBitstreamFilter_)
+		{
+			int a = av_bitstream_filter_filter(pBitstreamFilter_, pFormatCtx_->streams[nVideoIndex_]->codec, NULL,
+				&new_pkt.data, &new_pkt.size,
+				avpkt->data, avpkt->size,
+				avpkt->flags & AV_PKT_FLAG_KEY);
+			if (a < 0)
+			{
+				av_free_packet(avpkt);
+				continue;
+			}
+			bFiltered = a > 0 && new_pkt.data != avpkt->data;
+		}
+
+		AccessUnit oUnit;
+		packetToUnit(&new_pkt, pCodecCtx_, llArrivalUs, oUnit);
+		pAnalyzer_->analyze(oUnit);
+
+		if (bFiltered)
+			av_free(new_pkt.data);
+		av_free_packet(avpkt);
+	}
+
+	av_free(avpkt);
+	if (pCodecCtx_->codec_id == AV_CODEC_ID_H264 || pCodecCtx_->codec_id == AV_CODEC_ID_HEVC) {
+		av_bitstream_filter_close(pBitstreamFilter_);
+	}
+	oSourceData_.pFrameQueue->endDecode();
+	bStarted = false;
+}
+
+bool VideoSource::recoverStream()
+{
+	if (++nConsecutiveFailures_ > cnMaxConsecutiveFailures)
+	{
+		return false;
+	}
+
+	CUresult oResult = pVideoParser_->recover();
+	oSourceData_.hVideoParser = pVideoParser_->hParser_;
+	if (oResult != CUDA_SUCCESS)
+	{
+		//下一个关键帧再试，连续失败太多次才放弃
+		printf("stream recovery failed: %d\n", oResult);
+	}
+	return true;
+}
+
+bool VideoSource::submitUnit(const AccessUnit &rUnit)
+{
+	CUVIDSOURCEDATAPACKET cupkt;
+	CUresult oResult;
+	//分析模式：没有parser，只统计码流
+	if (!pVideoParser_)
+	{
+		if (pAnalyzer_)
+			pAnalyzer_->analyze(rUnit);
+		return true;
+	}
+
+	DecodeStats *pStats = pVideoParser_->oParserData_.pStats;
+
+	bool bCorrupt = rUnit.bIncomplete;
+	if (rUnit.bLossBefore | bCorrupt | bLossReported_.exchange(false) | pVideoParser_->takeCorruption())
+	{
+		pStats->nLossEvents++;
+		bUnitResync_ = true;
+		if (bSkipOnLoss_)
+			bUnitWaitForKeyFrame_ = true;
+		else
+			pVideoParser_->setSuspect(true);
+	}
+
+	if ((bCorrupt && bSkipOnLoss_) || (bUnitWaitForKeyFrame_ && !rUnit.bKeyFrame))
+	{
+		pStats->nPacketsDropped++;
+		return true;
+	}
+	bUnitWaitForKeyFrame_ = false;
+
+	if (bKeyFrameOnly_ && !keepKeyFrame(rUnit.bKeyFrame, rUnit.llTimestamp))
+	{
+		pStats->nPacketsSkipped++;
+		return true;
+	}
+
+	if (pAnalyzer_)
+		pAnalyzer_->analyze(rUnit);
+
+	//收齐的是一整个access unit，parser可以马上解码
+	memset(&cupkt, 0, sizeof(CUVIDSOURCEDATAPACKET));
+	cupkt.payload_size = (unsigned long)rUnit.nSize;
+	cupkt.payload = rUnit.pData;
+	cupkt.flags = CUVID_PKT_ENDOFPICTURE;
+	if (rUnit.llTimestamp >= 0)
+	{
+		cupkt.flags |= CUVID_PKT_TIMESTAMP;
+		cupkt.timestamp = rUnit.llTimestamp;
+		pVideoParser_->notePacketArrival(cupkt.timestamp, rUnit.llArrivalUs);
+	}
+	pVideoParser_->notePacketTimestamp(rUnit.llTimestamp);
+	if (bUnitResync_ && rUnit.bKeyFrame && !bCorrupt)
+	{
+		cupkt.flags |= CUVID_PKT_DISCONTINUITY;
+		pVideoParser_->setSuspect(false);
+		bUnitResync_ = false;
+	}
+	if (bKeyFrameOnly_)
+		cupkt.flags |= CUVID_PKT_DISCONTINUITY;
+
+	for (int nTry = 0; nTry < 2; nTry++)
+	{
+		oResult = cuvidParseVideoData(oSourceData_.hVideoParser, &cupkt);
+		if (oResult == CUDA_SUCCESS && !pVideoParser_->failed())
+		{
+			nConsecutiveFailures_ = 0;
+			break;
+		}
+		pStats->nParseErrors++;
+		if (!recoverStream())
+		{
+			printf("stream failed %d times in a row, giving up (%d)\n", nConsecutiveFailures_, oResult);
+			return false;
+		}
+		bUnitWaitForKeyFrame_ = true;
+		bUnitResync_ = false;
+		pVideoParser_->setSuspect(false);
+		//没有SDP/SPS之前尺寸只是猜的，第一个序列头到了decoder才按真实格式重建，
+		//这个关键帧要再送一次，不然要白等一个GOP
+		if (!rUnit.bKeyFrame)
+			break;
+		cupkt.flags &= ~CUVID_PKT_DISCONTINUITY;
+		bUnitWaitForKeyFrame_ = false;
+	}
+	return true;
+}
+
+bool VideoSource::keepKeyFrame(bool bKeyFrame, long long llTimestamp)
+{
+	if (!bKeyFrame)
+		return false;
+	if (llKeyFrameStrideUs_ <= 0 || llTimestamp < 0)
+		return true;
+
+	//时间戳回退(文件循环、重连)就重新计时
+	if (llNextKeyFrameUs_ >= 0 && llTimestamp < llNextKeyFrameUs_ - 2 * llKeyFrameStrideUs_)
+		llNextKeyFrameUs_ = -1;
+	if (llNextKeyFrameUs_ >= 0 && llTimestamp < llNextKeyFrameUs_)
+		return false;
+
+	//按固定步长往后排，GOP长度不整除步长时间隔也不会越拖越长
+	if (llNextKeyFrameUs_ < 0 || llTimestamp >= llNextKeyFrameUs_ + llKeyFrameStrideUs_)
+		llNextKeyFrameUs_ = llTimestamp + llKeyFrameStrideUs_;
+	else
+		llNextKeyFrameUs_ += llKeyFrameStrideUs_;
+	return true;
+}
+
+void VideoSource::flushParser()
+{
+	//把parser里缓存的帧冲出来
+	if (oSourceData_.hVideoParser)
+	{
+		CUVIDSOURCEDATAPACKET cupkt;
+		memset(&cupkt, 0, sizeof(CUVIDSOURCEDATAPACKET));
+		cupkt.flags = CUVID_PKT_ENDOFSTREAM;
+		cuvidParseVideoData(oSourceData_.hVideoParser, &cupkt);
+	}
+}
+
+void VideoSource::rtp_thread_entry()
+{
+	AccessUnit oUnit;
+	//中途加入的流，从第一个关键帧开始解
+	bUnitWaitForKeyFrame_ = true;
+	bUnitResync_ = false;
+	bStarted = true;
+	while (!bThreadExit)
+	{
+		//超时只是为了能响应stop()
+		if (!pRtpReceiver_->receive(oUnit, 100))
+			continue;
+		if (!submitUnit(oUnit))
+			break;
+	}
+	flushParser();
+
+	const RtpReceiverStats &rRtpStats = pRtpReceiver_->stats();
+	printf("rtp: %lu packets, %lu lost, %lu reordered, %lu late, %lu malformed, %lu access units\n",
+		rRtpStats.nPackets.load(), rRtpStats.nLost.load(), rRtpStats.nReordered.load(),
+		rRtpStats.nLate.load(), rRtpStats.nMalformed.load(), rRtpStats.nAccessUnits.load());
+
+	oSourceData_.pFrameQueue->endDecode();
+	bStarted = false;
+}
+
+void VideoSource::ts_thread_entry()
 {
+	AccessUnit oUnit;
+	bool bGiveUp = false;
+	bUnitWaitForKeyFrame_ = true;
+	bUnitResync_ = false;
+	bStarted = true;
+	while (!bThreadExit && !bGiveUp)
+	{
+		int nSize = pTsSocket_->receive(&aTsBuffer_[0], (int)aTsBuffer_.size(), 100);
+		if (nSize <= 0)
+			continue;
+		pTsDemuxer_->feed(&aTsBuffer_[0], nSize, steadyClockUs());
+		while (!bGiveUp && pTsDemuxer_->next(oUnit))
+			bGiveUp = !submitUnit(oUnit);
+	}
+	flushParser();
+
+	const TsDemuxStats &rTsStats = pTsDemuxer_->stats();
+	printf("ts: %lu packets, %lu continuity errors, %lu transport errors, %lu sync losses, %lu PES\n",
+		rTsStats.nPackets.load(), rTsStats.nContinuityErrors.load(), rTsStats.nTransportErrors.load(),
+		rTsStats.nSyncLosses.load(), rTsStats.nPesPackets.load());
+
+	oSourceData_.pFrameQueue->endDecode();
+	bStarted = false;
+}
 
+void VideoSource::es_thread_entry()
+{
+	AccessUnit oUnit;
+	unsigned long nUnits = 0;
+	bUnitWaitForKeyFrame_ = true;
+	bUnitResync_ = false;
+	bStarted = true;
+	long long llStartUs = steadyClockUs();
+	while (!bThreadExit && pEsReader_->next(oUnit))
+	{
+		nUnits++;
+		if (!submitUnit(oUnit))
+			break;
+	}
+	flushParser();
+
+	double dSeconds = (steadyClockUs() - llStartUs) / 1e6;
+	printf("es: %lu access units, %.1f MB in %.2f s\n",
+		nUnits, pEsReader_->size() / (1024.0 * 1024.0), dSeconds);
+
+	oSourceData_.pFrameQueue->endDecode();
+	bStarted = false;
+}
+
+void VideoSource::start_internal_thread()
+{
+	bThreadExit = false;
+	if (pRtpReceiver_)
+		oThread_ = std::thread(&VideoSource::rtp_thread_entry, this);
+	else if (pTsDemuxer_)
+		oThread_ = std::thread(&VideoSource::ts_thread_entry, this);
+	else if (pEsReader_)
+		oThread_ = std::thread(&VideoSource::es_thread_entry, this);
+	else if (!pVideoParser_)
+		oThread_ = std::thread(&VideoSource::analysis_thread_entry, this);
+	else
+		oThread_ = std::thread(&VideoSource::internal_thread_entry, this);
+}
+#endif
+VideoSource::VideoSource(const std::string sFileName, FrameQueue *pFrameQueue, StreamProfile eProfile)
+	: hVideoSource_(0)
+	, pVideoParser_(0)
+	, pAnalyzer_(0)
+	, pRtpReceiver_(0)
+	, pTsDemuxer_(0)
+	, pTsSocket_(0)
+	, pEsReader_(0)
+	, pFormatCtx_(0)
+	, pCodecCtx_(0)
+	, nVideoIndex_(-1)
+	, pBitstreamFilter_(0)
+	, bUnitWaitForKeyFrame_(true)
+	, bUnitResync_(false)
+	, bThreadExit(false)
+	, bStarted(false)
+	, nConsecutiveFailures_(0)
+	, bLossReported_(false)
+	, bSkipOnLoss_(true)
+	, eProfile_(eProfile)
+	, bKeyFrameOnly_(false)
+	, llKeyFrameStrideUs_(0)
+	, llNextKeyFrameUs_(-1)
+	, bPauseRequested_(false)
+	, bParked_(false)
+	, bSeekPending_(false)
+	, llSeekTarget_(0)
+	, bHoldAtEnd_(false)
+	, bAtEnd_(false)
+{
+	RtpReceiverParams oRtpParams;
+	TsInputParams oTsParams;
+	EsFileParams oEsParams;
+	memset(&oFormat_, 0, sizeof(oFormat_));
+	if (RtpReceiver::parseUrl(sFileName, oRtpParams))
+		bValid_ = init_rtp(oRtpParams, pFrameQueue);
+	else if (TsDemuxer::parseUrl(sFileName, oTsParams))
+		bValid_ = init_ts(oTsParams, pFrameQueue);
+	else if (EsFileReader::parseUrl(sFileName, oEsParams))
+		bValid_ = init_es(oEsParams, pFrameQueue);
+	else
+		bValid_ = init(sFileName, pFrameQueue);
 }
 VideoSource::~VideoSource()
 {
-	uninit_cuvid();
+	stop();
+	if (hVideoSource_)
+		uninit_cuvid();
+	delete pRtpReceiver_;
+	delete pTsDemuxer_;
+	delete pTsSocket_;
+	delete pEsReader_;
+	if (pFormatCtx_)
+		avformat_close_input(&pFormatCtx_);
+}
+
+bool VideoSource::init_rtp(const RtpReceiverParams &rParams, FrameQueue *pFrameQueue)
+{
+	assert(0 != pFrameQueue);
+	oSourceData_.hVideoParser = 0;
+	oSourceData_.pFrameQueue = pFrameQueue;
+
+	if (rParams.eCodec != cudaVideoCodec_H264 && rParams.eCodec != cudaVideoCodec_HEVC)
+	{
+		printf("native RTP input supports H.264 and HEVC only\n");
+		return false;
+	}
+
+	pRtpReceiver_ = new RtpReceiver(rParams);
+	if (!pRtpReceiver_->open())
+	{
+		return false;
+	}
+	printf("native RTP input on port %u, jitter buffer %u packets / %u ms\n",
+		(unsigned int)rParams.nPort, rParams.nJitterDepth, rParams.nJitterDelayMs);
+
+	//没有SDP，格式先按URL参数填，SPS到了以后parser会发现不一致并重建decoder
+	memset(&oFormat_, 0, sizeof(CUVIDEOFORMAT));
+	oFormat_.codec = rParams.eCodec;
+	oFormat_.chroma_format = cudaVideoChromaFormat_420;
+	oFormat_.progressive_sequence = true;
+	oFormat_.coded_width = rParams.nWidth;
+	oFormat_.coded_height = rParams.nHeight;
+	oFormat_.display_area.right = rParams.nWidth;
+	oFormat_.display_area.bottom = rParams.nHeight;
+	return true;
+}
+
+bool VideoSource::init_es(const EsFileParams &rParams, FrameQueue *pFrameQueue)
+{
+	assert(0 != pFrameQueue);
+	oSourceData_.hVideoParser = 0;
+	oSourceData_.pFrameQueue = pFrameQueue;
+
+	pEsReader_ = new EsFileReader(rParams);
+	if (!pEsReader_->open())
+	{
+		return false;
+	}
+
+	//裸码流没有容器信息，尺寸先按参数填，SPS到了以后decoder按真实格式重建
+	memset(&oFormat_, 0, sizeof(CUVIDEOFORMAT));
+	oFormat_.codec = rParams.eCodec;
+	oFormat_.chroma_format = cudaVideoChromaFormat_420;
+	oFormat_.progressive_sequence = true;
+	oFormat_.coded_width = rParams.nWidth;
+	oFormat_.coded_height = rParams.nHeight;
+	oFormat_.display_area.right = rParams.nWidth;
+	oFormat_.display_area.bottom = rParams.nHeight;
+	return true;
+}
+
+bool VideoSource::init_ts(const TsInputParams &rParams, FrameQueue *pFrameQueue)
+{
+	assert(0 != pFrameQueue);
+	oSourceData_.hVideoParser = 0;
+	oSourceData_.pFrameQueue = pFrameQueue;
+
+	pTsSocket_ = new UdpSocket;
+	if (!pTsSocket_->open(rParams.sAddress, rParams.nPort, rParams.nSocketBufferSize))
+	{
+		return false;
+	}
+	pTsDemuxer_ = new TsDemuxer(rParams.nVideoPid);
+	//一个UDP包最多64K，通常是7个TS包
+	aTsBuffer_.resize(65536);
+
+	//编码格式只能从PMT里拿，等PMT到了再建decoder；之前的PES反正也解不了
+	AccessUnit oUnit;
+	long long llGiveUpUs = steadyClockUs() + 3000000;
+	while (pTsDemuxer_->codec() == cudaVideoCodec_NumCodecs && steadyClockUs() < llGiveUpUs)
+	{
+		int nSize = pTsSocket_->receive(&aTsBuffer_[0], (int)aTsBuffer_.size(), 100);
+		if (nSize <= 0)
+			continue;
+		pTsDemuxer_->feed(&aTsBuffer_[0], nSize, steadyClockUs());
+		while (pTsDemuxer_->next(oUnit))
+			;
+	}
+	if (pTsDemuxer_->codec() == cudaVideoCodec_NumCodecs)
+	{
+		printf("no PMT with a video stream on %s:%u\n", rParams.sAddress.c_str(), (unsigned int)rParams.nPort);
+		return false;
+	}
+	printf("native TS input on port %u, video PID %d\n", (unsigned int)rParams.nPort, pTsDemuxer_->videoPid());
+
+	memset(&oFormat_, 0, sizeof(CUVIDEOFORMAT));
+	oFormat_.codec = pTsDemuxer_->codec();
+	oFormat_.chroma_format = cudaVideoChromaFormat_420;
+	oFormat_.progressive_sequence = true;
+	oFormat_.coded_width = rParams.nWidth;
+	oFormat_.coded_height = rParams.nHeight;
+	oFormat_.display_area.right = rParams.nWidth;
+	oFormat_.display_area.bottom = rParams.nHeight;
+	return true;
+}
+
+bool
+VideoSource::isValid()
+const
+{
+	return bValid_;
+}
+
+void
+VideoSource::reportLoss()
+{
+	bLossReported_ = true;
+}
+
+void
+VideoSource::setSkipToKeyFrameOnLoss(bool bSkip)
+{
+	bSkipOnLoss_ = bSkip;
+}
+
+void
+VideoSource::setAnalyzer(StreamAnalyzer *pAnalyzer)
+{
+	pAnalyzer_ = pAnalyzer;
+}
+
+bool
+VideoSource::pause()
+{
+	if (!controllable())
+		return false;
+
+	std::unique_lock<std::mutex> oLock(oControlMutex_);
+	bPauseRequested_ = true;
+	//线程可能卡在av_read_frame里，不能只等通知
+	while (!bParked_ && bStarted && !bThreadExit)
+		oControlCond_.wait_for(oLock, std::chrono::milliseconds(10));
+	return true;
+}
+
+void
+VideoSource::resume()
+{
+	std::lock_guard<std::mutex> oLock(oControlMutex_);
+	bPauseRequested_ = false;
+	oControlCond_.notify_all();
+}
+
+bool
+VideoSource::seek(long long llTimestamp)
+{
+	if (!controllable())
+		return false;
+
+	std::lock_guard<std::mutex> oLock(oControlMutex_);
+	llSeekTarget_ = llTimestamp;
+	bSeekPending_ = true;
+	oControlCond_.notify_all();
+	return true;
+}
+
+void
+VideoSource::setHoldAtEnd(bool bHold)
+{
+	bHoldAtEnd_ = bHold;
+}
+
+bool
+VideoSource::atEnd()
+{
+	std::lock_guard<std::mutex> oLock(oControlMutex_);
+	return bAtEnd_ && !bSeekPending_;
+}
+
+void
+VideoSource::setKeyFrameOnly(bool bEnable, long long llStrideUs)
+{
+	bKeyFrameOnly_ = bEnable;
+	llKeyFrameStrideUs_ = llStrideUs;
+	llNextKeyFrameUs_ = -1;
 }
 
 void VideoSource::init_cuvid(const std::string sFileName, FrameQueue *pFrameQueue)
@@ -365,8 +1131,8 @@ void VideoSource::init_cuvid(const std::string sFileName, FrameQueue *pFrameQueu
 	if (oResult != CUDA_SUCCESS)
 	{
 		printf("result=%d\n", oResult);
+		hVideoSource_ = 0;
 	}
-	assert(CUDA_SUCCESS == oResult);
 }
 
 
@@ -384,7 +1150,8 @@ VideoSource::ReloadVideo(const std::string sFileName, FrameQueue *pFrameQueue, V
     oSourceData_.hVideoParser = pVideoParser->hParser_;
     oSourceData_.pFrameQueue  = pFrameQueue;
 
-    cuvidDestroyVideoSource(hVideoSource_);
+    if (hVideoSource_)
+        cuvidDestroyVideoSource(hVideoSource_);
 
     CUVIDSOURCEPARAMS oVideoSourceParameters;
     // Fill parameter struct
@@ -394,7 +1161,11 @@ VideoSource::ReloadVideo(const std::string sFileName, FrameQueue *pFrameQueue, V
     oVideoSourceParameters.pfnAudioDataHandler = 0;
     // now create the actual source
     CUresult oResult = cuvidCreateVideoSource(&hVideoSource_, sFileName.c_str(), &oVideoSourceParameters);
-    assert(CUDA_SUCCESS == oResult);
+    if (oResult != CUDA_SUCCESS)
+    {
+        printf("cuvidCreateVideoSource failed: %d\n", oResult);
+        hVideoSource_ = 0;
+    }
 }
 
 
@@ -405,10 +1176,82 @@ const
     CUVIDEOFORMAT oFormat;
     //CUresult oResult = cuvidGetSourceVideoFormat(hVideoSource_, &oFormat, 0);
    // assert(CUDA_SUCCESS == oResult);
-	return g_stFormat;
+	return oFormat_;
     //return oFormat;
 }
 
+long long
+VideoSource::startTimestamp()
+const
+{
+	if (pRtpReceiver_ || pTsDemuxer_ || pEsReader_ || !pFormatCtx_)
+		return 0;
+
+	//和packetTimestamp()一样换成微秒
+	AVStream *pStream = pFormatCtx_->streams[nVideoIndex_];
+	if (pStream->start_time != AV_NOPTS_VALUE)
+	{
+		AVRational tb;
+		tb.num = 1;
+		tb.den = AV_TIME_BASE;
+		return av_rescale_q(pStream->start_time, pStream->time_base, tb);
+	}
+	return pFormatCtx_->start_time != AV_NOPTS_VALUE ? pFormatCtx_->start_time : 0;
+}
+
+long long
+VideoSource::duration()
+const
+{
+	if (pRtpReceiver_ || pTsDemuxer_ || pEsReader_ || !pFormatCtx_)
+		return -1;
+
+	AVStream *pStream = pFormatCtx_->streams[nVideoIndex_];
+	if (pStream->duration != AV_NOPTS_VALUE && pStream->duration > 0)
+	{
+		AVRational tb;
+		tb.num = 1;
+		tb.den = AV_TIME_BASE;
+		return av_rescale_q(pStream->duration, pStream->time_base, tb);
+	}
+	//有些容器只在文件头里给总长
+	return pFormatCtx_->duration != AV_NOPTS_VALUE && pFormatCtx_->duration > 0 ? pFormatCtx_->duration : -1;
+}
+
+//公历日期到1970-01-01的天数，不依赖timegm(VS没有)
+static long long daysFromCivil(int nYear, int nMonth, int nDay)
+{
+	nYear -= nMonth <= 2;
+	long long llEra = (nYear >= 0 ? nYear : nYear - 399) / 400;
+	int nYearOfEra = nYear - (int)(llEra * 400);
+	int nDayOfYear = (153 * (nMonth + (nMonth > 2 ? -3 : 9)) + 2) / 5 + nDay - 1;
+	int nDayOfEra = nYearOfEra * 365 + nYearOfEra / 4 - nYearOfEra / 100 + nDayOfYear;
+	return llEra * 146097 + nDayOfEra - 719468;
+}
+
+long long
+VideoSource::creationTime()
+const
+{
+	if (pRtpReceiver_ || pTsDemuxer_ || pEsReader_ || !pFormatCtx_)
+		return -1;
+
+	AVDictionaryEntry *pEntry = av_dict_get(pFormatCtx_->metadata, "creation_time", NULL, 0);
+	if (!pEntry)
+		pEntry = av_dict_get(pFormatCtx_->streams[nVideoIndex_]->metadata, "creation_time", NULL, 0);
+	if (!pEntry)
+		return -1;
+
+	//ISO 8601，例如 2024-03-05T14:03:10.000000Z，按UTC算
+	int nYear, nMonth, nDay, nHour, nMinute;
+	double dSecond = 0;
+	if (sscanf(pEntry->value, "%d-%d-%d%*[T ]%d:%d:%lf", &nYear, &nMonth, &nDay, &nHour, &nMinute, &dSecond) < 5)
+		return -1;
+
+	long long llSeconds = daysFromCivil(nYear, nMonth, nDay) * 86400LL + nHour * 3600LL + nMinute * 60LL;
+	return llSeconds * 1000000LL + (long long)(dSecond * 1e6 + 0.5);
+}
+
 void
 VideoSource::getSourceDimensions(unsigned int &width, unsigned int &height)
 {
@@ -416,8 +1259,8 @@ VideoSource::getSourceDimensions(unsigned int &width, unsigned int &height)
 
     //width  = rCudaVideoFormat.coded_width;
     //height = rCudaVideoFormat.coded_height;
-	width = g_stFormat.coded_width;
-	height = g_stFormat.coded_height;
+	width = oFormat_.coded_width;
+	height = oFormat_.coded_height;
 }
 
 void
@@ -440,6 +1283,7 @@ void
 VideoSource::setParser(VideoParser &rVideoParser)
 {
     oSourceData_.hVideoParser = rVideoParser.hParser_;
+    pVideoParser_ = &rVideoParser;
 	//printf("set handle = %d\n",oSourceData_.hVideoParser);
 }
 
@@ -454,14 +1298,19 @@ VideoSource::start()
 void
 VideoSource::stop()
 {
-    CUresult oResult = cuvidSetVideoSourceState(hVideoSource_, cudaVideoState_Stopped);
-    assert(CUDA_SUCCESS == oResult);
+	{
+		std::lock_guard<std::mutex> oLock(oControlMutex_);
+		bThreadExit = true;
+		oControlCond_.notify_all();
+	}
+	if (oThread_.joinable())
+		oThread_.join();
 }
 
 bool
 VideoSource::isStarted()
 {
-    return (cuvidGetVideoSourceState(hVideoSource_) == cudaVideoState_Started);
+    return bStarted;
 }
 
 int
@@ -486,17 +1335,21 @@ operator << (std::ostream &rOutputStream, const CUVIDEOFORMAT &rCudaVideoFormat)
 {
     rOutputStream << "\tVideoCodec      : ";
 
-    if ((rCudaVideoFormat.codec <= cudaVideoCodec_UYVY) &&
-        (rCudaVideoFormat.codec >= cudaVideoCodec_MPEG1) &&
-        (rCudaVideoFormat.codec != cudaVideoCodec_NumCodecs))
-    {
-        rOutputStream << eVideoFormats[rCudaVideoFormat.codec].name << "\n";
-    }
-    else
+    // The raw formats are FOURCCs, so the table is searched rather than indexed
+    const char *pCodecName = "unknown";
+
+    for (int i = 0; eVideoFormats[i].codecs != -1; i++)
     {
-        rOutputStream << "unknown\n";
+        if (eVideoFormats[i].codecs == rCudaVideoFormat.codec &&
+            eVideoFormats[i].codecs != cudaVideoCodec_NumCodecs)
+        {
+            pCodecName = eVideoFormats[i].name;
+            break;
+        }
     }
 
+    rOutputStream << pCodecName << "\n";
+
     rOutputStream << "\tFrame rate      : " << rCudaVideoFormat.frame_rate.numerator << "/" << rCudaVideoFormat.frame_rate.denominator;
     rOutputStream << "fps ~ " << rCudaVideoFormat.frame_rate.numerator/static_cast<float>(rCudaVideoFormat.frame_rate.denominator) << "fps\n";
     rOutputStream << "\tSequence format : ";
@@ -509,6 +1362,7 @@ operator << (std::ostream &rOutputStream, const CUVIDEOFORMAT &rCudaVideoFormat)
     rOutputStream << "\tCoded frame size: [" << rCudaVideoFormat.coded_width << ", " << rCudaVideoFormat.coded_height << "]\n";
     rOutputStream << "\tDisplay area    : [" << rCudaVideoFormat.display_area.left << ", " << rCudaVideoFormat.display_area.top;
     rOutputStream << ", " << rCudaVideoFormat.display_area.right << ", " << rCudaVideoFormat.display_area.bottom << "]\n";
+    rOutputStream << "\tBit depth       : " << 8 + rCudaVideoFormat.bit_depth_luma_minus8 << "\n";
     rOutputStream << "\tChroma format   : ";
 
     switch (rCudaVideoFormat.chroma_format)
@@ -15,6 +15,11 @@
 
 #include <nvcuvid.h>
 #include <string>
+#include <thread>
+#include <atomic>
+#include <mutex>
+#include <condition_variable>
+#include <vector>
 
 typedef struct
 {
@@ -30,6 +35,12 @@ static _sVideoFormats eVideoFormats[] =
     { cudaVideoCodec_VC1,   "VC-1/WMV" },
     { cudaVideoCodec_H264,  "AVC/H.264" },
     { cudaVideoCodec_JPEG,  "M-JPEG" },
+    { cudaVideoCodec_H264_SVC, "H.264/SVC" },
+    { cudaVideoCodec_H264_MVC, "H.264/MVC" },
+    { cudaVideoCodec_HEVC,  "H.265/HEVC" },
+    { cudaVideoCodec_VP8,   "VP8" },
+    { cudaVideoCodec_VP9,   "VP9" },
+    { cudaVideoCodec_AV1,   "AV1" },
     { cudaVideoCodec_NumCodecs,  "Invalid" },
     { cudaVideoCodec_YUV420,"YUV  4:2:0" },
     { cudaVideoCodec_YV12,  "YV12 4:2:0" },
@@ -39,9 +50,32 @@ static _sVideoFormats eVideoFormats[] =
     {                  -1 , "Unknown" },
 };
 
+// How a stream trades latency against robustness.
+enum StreamProfile
+{
+    // FFmpeg's default probing and buffering, parser display delay 1.
+    StreamProfile_Default = 0,
+    // For live control loops: no demuxer buffering, minimal probing,
+    // display delay 0 and every packet submitted as a complete picture.
+    StreamProfile_LowLatency
+};
+
 // forward declarations
 class FrameQueue;
 class VideoParser;
+class RtpReceiver;
+struct RtpReceiverParams;
+class TsDemuxer;
+struct TsInputParams;
+class UdpSocket;
+class EsFileReader;
+struct EsFileParams;
+struct AccessUnit;
+class StreamAnalyzer;
+struct AVPacket;
+struct AVFormatContext;
+struct AVCodecContext;
+struct AVBitStreamFilterContext;
 
 
 // A wrapper class around the CUvideosource entity and API.
@@ -53,15 +87,39 @@ class VideoParser;
 // The video-source spawns its own thread for processing the stream.
 // The user can register call-back methods for handling chucks of demuxed
 // audio and video data.
+//
+// Streams are demuxed with FFmpeg on the source's own thread. When the
+// parser or decoder fails on a packet, the stream is recovered in place
+// (parser flushed, decoder recreated if needed) and packets are dropped
+// until the next keyframe; only repeated failures end the stream.
+//
+// "rtp+native://" URLs (see RtpReceiver::parseUrl) and "udp+ts://" URLs
+// (see TsDemuxer::parseUrl) bypass FFmpeg: RTP or MPEG-TS is received
+// and demuxed in-house and whole access units go straight to the parser.
+// Raw .h264/.h265 files (see EsFileReader::parseUrl) are memory-mapped
+// and handed to the parser in place.
+//
+// With a StreamAnalyzer and no parser (see setAnalyzer) the source only
+// demuxes: packets go to the analyzer and nothing is decoded.
 class VideoSource
 {
     public:
+        // Consecutive failed recoveries after which the stream is given up.
+        static const int cnMaxConsecutiveFailures = 8;
+
         // Default constructor.
         // Parameters:
         //      pFrameQueue - A frame queue object that the decoding
         //          thread and the main render thread use to exchange
         //          decoded frames.
-        VideoSource(const std::string sFileName, FrameQueue *pFrameQueue);
+        //      eProfile - demux settings, see StreamProfile.
+        VideoSource(const std::string sFileName, FrameQueue *pFrameQueue,
+                    StreamProfile eProfile = StreamProfile_Default);
+
+        // False if the stream couldn't be opened or its codec isn't supported.
+        bool
+        isValid()
+        const;
 
         // Destructor
         ~VideoSource();
@@ -73,6 +131,24 @@ class VideoSource
         format()
         const;
 
+        // Timestamp of the first video frame (CUVID timestamp units), 0 if
+        // unknown or not an FFmpeg input.
+        long long
+        startTimestamp()
+        const;
+
+        // Length of the video stream in CUVID timestamp units, -1 if unknown
+        // or not an FFmpeg input.
+        long long
+        duration()
+        const;
+
+        // Wall-clock time the recording started, microseconds since the Unix
+        // epoch, from the container's creation_time; -1 if it has none.
+        long long
+        creationTime()
+        const;
+
         // In order to process video-frames, we need to hook up a video-parser
         // object to this source.
         // Internally we set the CUvideoparser wrapped in rVideoParser on the
@@ -103,6 +179,62 @@ class VideoSource
         // Retrieve information about the video (is this progressive?)
         void getProgressive(bool &progressive);
 
+        // Tells the demux loop that bitstream data was lost (e.g. an RTP
+        // sequence gap seen by the transport). Safe from any thread.
+        void
+        reportLoss();
+
+        // On loss, stop feeding pictures until the next keyframe (default),
+        // or keep decoding and flag the frames up to it as corrupt.
+        void
+        setSkipToKeyFrameOnLoss(bool bSkip);
+
+        // Hands each video packet to pAnalyzer on the demux thread, just
+        // before it is parsed (packets dropped while resyncing after loss are
+        // not seen). Without setParser() the source runs in analysis mode:
+        // every packet is analyzed, no decoder is involved and pFrameQueue
+        // only reports the end of the stream. Call before start().
+        void
+        setAnalyzer(StreamAnalyzer *pAnalyzer);
+
+        // Forwards only keyframe access units (IDR/IRAP, random access
+        // points) to the parser, each sent as a complete picture after a
+        // discontinuity so it decodes on its own. With llStrideUs > 0 at most
+        // one keyframe per stride of media time is kept, e.g. 10 s for
+        // thumbnails. Pair with a parser display delay of 0. Call before start()
+        // or while paused.
+        void
+        setKeyFrameOnly(bool bEnable, long long llStrideUs = 0);
+
+        // Playback control for inputs demuxed by FFmpeg (files; live inputs
+        // accept the calls but fail to seek). The demux thread acts on them
+        // between packets.
+        //
+        // Parks the demux thread and returns once it is parked, at end of
+        // stream or not started yet; parser settings may be changed then.
+        // Returns false for inputs that can't be controlled.
+        bool
+        pause();
+
+        void
+        resume();
+
+        // Continues at the keyframe at or before llTimestamp (CUVID timestamp
+        // units) once running. What the parser holds is dropped. Returns false
+        // for inputs that can't be controlled.
+        bool
+        seek(long long llTimestamp);
+
+        // With hold set, the demux thread parks at the end of the stream
+        // (after flushing the parser) instead of ending, so seek() keeps
+        // working. Call before start().
+        void
+        setHoldAtEnd(bool bHold);
+
+        // True while parked at the end of the stream with no seek pending.
+        bool
+        atEnd();
+
     private:
         // This struct contains the data we need inside the source's
         // video callback in order to processes the video data.
@@ -112,6 +244,88 @@ class VideoSource
             FrameQueue   *pFrameQueue;			
         };
 
+        // Opens the stream with FFmpeg and fills in the CUVIDEOFORMAT.
+        bool
+        init(const std::string sFileName, FrameQueue *pFrameQueue);
+
+        // CUvideosource based demuxing, as in the original sample.
+        void
+        init_cuvid(const std::string sFileName, FrameQueue *pFrameQueue);
+
+        // Binds the native RTP receiver; the format comes from the URL until
+        // the stream's first sequence header corrects it.
+        bool
+        init_rtp(const RtpReceiverParams &rParams, FrameQueue *pFrameQueue);
+
+        // Binds the TS socket and waits for the PMT to learn the codec.
+        bool
+        init_ts(const TsInputParams &rParams, FrameQueue *pFrameQueue);
+
+        // Maps a raw elementary stream file.
+        bool
+        init_es(const EsFileParams &rParams, FrameQueue *pFrameQueue);
+
+        void
+        uninit_cuvid();
+
+        // Demux loop, runs on oThread_.
+        void
+        internal_thread_entry();
+
+        // av_read_frame() for internal_thread_entry(), serving pause(),
+        // seek() and hold-at-end first. bSeeked is set when the read
+        // follows a seek.
+        int
+        readPacket(AVPacket *pPacket, bool &bSeeked);
+
+        // Carries out a seek on the demux thread.
+        void
+        seekTo(long long llTimestamp);
+
+        // True for the FFmpeg path, which is the only one pause()/seek() serve.
+        bool
+        controllable()
+        const;
+
+        // FFmpeg demux loop of analysis mode, runs on oThread_.
+        void
+        analysis_thread_entry();
+
+        // Receive loop of the native RTP input, runs on oThread_.
+        void
+        rtp_thread_entry();
+
+        // Receive loop of the native TS input, runs on oThread_.
+        void
+        ts_thread_entry();
+
+        // Read loop of the mapped elementary stream input, runs on oThread_.
+        void
+        es_thread_entry();
+
+        // Feeds one access unit from a native input to the parser, resyncing
+        // at the next keyframe after loss. Returns false once the stream is
+        // given up.
+        bool
+        submitUnit(const AccessUnit &rUnit);
+
+        // Keyframe-only mode: decides whether a packet is decoded and moves
+        // the stride window forward when it is.
+        bool
+        keepKeyFrame(bool bKeyFrame, long long llTimestamp);
+
+        // Sends end-of-stream so the parser displays what it still holds.
+        void
+        flushParser();
+
+        void
+        start_internal_thread();
+
+        // Called after cuvidParseVideoData failed. Returns false once the
+        // stream has failed too often in a row to keep trying.
+        bool
+        recoverStream();
+
 
         // Callback for handling packages of demuxed video data.
         //
@@ -140,6 +354,41 @@ class VideoSource
 
         VideoSourceData oSourceData_;       // Instance of the user-data struct we use in the video-data handle callback.
         CUvideosource   hVideoSource_;      // Handle to the CUDA video-source object.
+        VideoParser    *pVideoParser_;      // Parser hooked up by setParser(), used for recovery.
+        StreamAnalyzer *pAnalyzer_;         // Optional, see setAnalyzer().
+        RtpReceiver    *pRtpReceiver_;      // Native RTP input, NULL when FFmpeg demuxes.
+        TsDemuxer      *pTsDemuxer_;        // Native TS input, NULL when FFmpeg demuxes.
+        UdpSocket      *pTsSocket_;
+        std::vector<unsigned char> aTsBuffer_;
+        EsFileReader   *pEsReader_;         // Mapped elementary stream, NULL when FFmpeg demuxes.
+        AVFormatContext *pFormatCtx_;       // FFmpeg demuxing, per source so streams can run side by side.
+        AVCodecContext  *pCodecCtx_;
+        int              nVideoIndex_;
+        AVBitStreamFilterContext *pBitstreamFilter_;    // mp4toannexb, NULL if not needed.
+        CUVIDEOFORMAT   oFormat_;           // What format() reports, filled by the init functions.
+        bool            bUnitWaitForKeyFrame_;  // submitUnit() state
+        bool            bUnitResync_;
+
+        std::thread     oThread_;
+        volatile bool   bThreadExit;
+        volatile bool   bStarted;
+        bool            bValid_;
+        int             nConsecutiveFailures_;
+        std::atomic<bool> bLossReported_;
+        volatile bool   bSkipOnLoss_;
+        StreamProfile   eProfile_;
+        bool            bKeyFrameOnly_;
+        long long       llKeyFrameStrideUs_;
+        long long       llNextKeyFrameUs_;  // earliest timestamp the stride lets through, -1 for any
+
+        std::mutex              oControlMutex_;     // guards the playback control below
+        std::condition_variable oControlCond_;
+        bool            bPauseRequested_;
+        bool            bParked_;
+        bool            bSeekPending_;
+        long long       llSeekTarget_;
+        bool            bHoldAtEnd_;
+        bool            bAtEnd_;
 };
 
 std::ostream &
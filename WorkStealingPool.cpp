@@ -0,0 +1,185 @@
+/*
+* File		: WorkStealingPool.cpp
+* Time : 2026 - 10 - 19
+*/
+
+#include "WorkStealingPool.h"
+
+// Index of the pool worker running on this thread, -1 elsewhere. Set per
+// thread from worker_thread_entry(); one pool per worker thread.
+static std::mutex                               g_oWorkerMapMutex;
+static std::vector<std::pair<std::thread::id, std::pair<const void *, unsigned int> > > g_aWorkerMap;
+
+static
+int
+currentWorker(const void *pPool)
+{
+    std::lock_guard<std::mutex> oLock(g_oWorkerMapMutex);
+    std::thread::id oSelf = std::this_thread::get_id();
+
+    for (size_t i = 0; i < g_aWorkerMap.size(); i++)
+    {
+        if (g_aWorkerMap[i].first == oSelf && g_aWorkerMap[i].second.first == pPool)
+            return (int)g_aWorkerMap[i].second.second;
+    }
+    return -1;
+}
+
+WorkStealingPool::WorkStealingPool(unsigned int nThreads)
+    : nQueued_(0)
+    , nPending_(0)
+    , nSteals_(0)
+    , nNext_(0)
+    , bExit_(false)
+{
+    if (nThreads == 0)
+        nThreads = std::thread::hardware_concurrency();
+    if (nThreads == 0)
+        nThreads = 1;
+
+    for (unsigned int i = 0; i < nThreads; i++)
+        aWorkers_.push_back(new Worker);
+    for (unsigned int i = 0; i < nThreads; i++)
+        aThreads_.push_back(std::thread(&WorkStealingPool::worker_thread_entry, this, i));
+}
+
+WorkStealingPool::~WorkStealingPool()
+{
+    wait();
+
+    {
+        std::lock_guard<std::mutex> oLock(oMutex_);
+        bExit_ = true;
+        oWorkCond_.notify_all();
+    }
+    for (size_t i = 0; i < aThreads_.size(); i++)
+        aThreads_[i].join();
+
+    {
+        std::lock_guard<std::mutex> oLock(g_oWorkerMapMutex);
+        for (size_t i = g_aWorkerMap.size(); i-- > 0;)
+        {
+            if (g_aWorkerMap[i].second.first == this)
+                g_aWorkerMap.erase(g_aWorkerMap.begin() + i);
+        }
+    }
+
+    for (size_t i = 0; i < aWorkers_.size(); i++)
+        delete aWorkers_[i];
+}
+
+void
+WorkStealingPool::submit(const Task &rTask)
+{
+    int nSelf = currentWorker(this);
+    unsigned int nTarget;
+
+    {
+        std::lock_guard<std::mutex> oLock(oMutex_);
+        nTarget = nSelf >= 0 ? (unsigned int)nSelf : nNext_++ % aWorkers_.size();
+        nPending_++;
+    }
+    {
+        std::lock_guard<std::mutex> oLock(aWorkers_[nTarget]->oMutex);
+        aWorkers_[nTarget]->aTasks.push_back(rTask);
+    }
+    {
+        std::lock_guard<std::mutex> oLock(oMutex_);
+        nQueued_++;
+        oWorkCond_.notify_all();
+    }
+}
+
+bool
+WorkStealingPool::takeTask(unsigned int nIndex, Task &rTask)
+{
+    {
+        Worker *pOwn = aWorkers_[nIndex];
+        std::lock_guard<std::mutex> oLock(pOwn->oMutex);
+        if (!pOwn->aTasks.empty())
+        {
+            rTask = pOwn->aTasks.back();
+            pOwn->aTasks.pop_back();
+            return true;
+        }
+    }
+
+    for (size_t i = 1; i < aWorkers_.size(); i++)
+    {
+        Worker *pVictim = aWorkers_[(nIndex + i) % aWorkers_.size()];
+        std::lock_guard<std::mutex> oLock(pVictim->oMutex);
+        if (!pVictim->aTasks.empty())
+        {
+            rTask = pVictim->aTasks.front();
+            pVictim->aTasks.pop_front();
+
+            std::lock_guard<std::mutex> oCount(oMutex_);
+            nSteals_++;
+            return true;
+        }
+    }
+
+    return false;
+}
+
+void
+WorkStealingPool::worker_thread_entry(unsigned int nIndex)
+{
+    {
+        std::lock_guard<std::mutex> oLock(g_oWorkerMapMutex);
+        g_aWorkerMap.push_back(std::make_pair(std::this_thread::get_id(), std::make_pair((const void *)this, nIndex)));
+    }
+
+    for (;;)
+    {
+        {
+            std::unique_lock<std::mutex> oLock(oMutex_);
+            while (nQueued_ == 0 && !bExit_)
+                oWorkCond_.wait(oLock);
+            if (bExit_ && nQueued_ == 0)
+                return;
+        }
+
+        Task oTask;
+        if (!takeTask(nIndex, oTask))
+        {
+            // Another worker got there first
+            std::this_thread::yield();
+            continue;
+        }
+
+        {
+            std::lock_guard<std::mutex> oLock(oMutex_);
+            nQueued_--;
+        }
+
+        oTask();
+
+        std::lock_guard<std::mutex> oLock(oMutex_);
+        if (--nPending_ == 0)
+            oIdleCond_.notify_all();
+    }
+}
+
+void
+WorkStealingPool::wait()
+{
+    std::unique_lock<std::mutex> oLock(oMutex_);
+    while (nPending_ != 0)
+        oIdleCond_.wait(oLock);
+}
+
+unsigned int
+WorkStealingPool::threadCount()
+const
+{
+    return (unsigned int)aWorkers_.size();
+}
+
+unsigned long
+WorkStealingPool::steals()
+const
+{
+    std::lock_guard<std::mutex> oLock(oMutex_);
+    return nSteals_;
+}
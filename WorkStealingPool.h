@@ -0,0 +1,87 @@
+/*
+* File		: WorkStealingPool.h
+* Time : 2026 - 10 - 19
+*/
+
+#ifndef WORKSTEALINGPOOL_H
+#define WORKSTEALINGPOOL_H
+
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Fixed set of worker threads with a task deque each.
+//  A worker runs its own tasks newest first and, once out of work,
+// steals the oldest task of another worker. Tasks submitted from outside
+// the pool are dealt round-robin; tasks submitted by a task go to its
+// own worker, so a job that splits itself keeps its pieces local until
+// someone is idle. Meant for coarse tasks (a file, a segment of one):
+// each deque has its own lock, there is no lock-free fast path.
+class WorkStealingPool
+{
+    public:
+        typedef std::function<void()> Task;
+
+        // Parameters:
+        //      nThreads - workers, 0 for one per hardware thread.
+        explicit
+        WorkStealingPool(unsigned int nThreads = 0);
+
+        // Waits for the queued tasks, then stops the workers.
+        ~WorkStealingPool();
+
+        void
+        submit(const Task &rTask);
+
+        // Blocks until every task submitted so far, and every task those
+        // submitted, has finished.
+        void
+        wait();
+
+        unsigned int
+        threadCount()
+        const;
+
+        // Tasks taken from another worker's deque.
+        unsigned long
+        steals()
+        const;
+
+    private:
+        struct Worker
+        {
+            std::mutex          oMutex;
+            std::deque<Task>    aTasks;
+        };
+
+        // Copy constructor. Don't implement.
+        WorkStealingPool(const WorkStealingPool &);
+
+        // Assignment operator. Don't implement.
+        void
+        operator= (const WorkStealingPool &);
+
+        void
+        worker_thread_entry(unsigned int nIndex);
+
+        // Own deque from the back, then the others from the front.
+        bool
+        takeTask(unsigned int nIndex, Task &rTask);
+
+        std::vector<Worker *>       aWorkers_;
+        std::vector<std::thread>    aThreads_;
+
+        mutable std::mutex          oMutex_;        // guards the counters below
+        std::condition_variable     oWorkCond_;     // a task was queued, or exit
+        std::condition_variable     oIdleCond_;     // nPending_ dropped to 0
+        unsigned long               nQueued_;       // in some deque
+        unsigned long               nPending_;      // queued or running
+        unsigned long               nSteals_;
+        unsigned int                nNext_;         // round-robin for outside submits
+        bool                        bExit_;
+};
+
+#endif // WORKSTEALINGPOOL_H
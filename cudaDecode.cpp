@@ -15,6 +15,13 @@
  */
 
 #include "cudaDecode.h"
+#include "BatchRunner.h"
+#include "DecodeDaemon.h"
+
+#ifdef TEST_TIME
+#include "Benchmark.h"
+#include "EsFileReader.h"
+#endif
 
 #if !defined(WIN32) && !defined(_WIN32) && !defined(WIN64) && !defined(_WIN64)
 typedef unsigned char BYTE;
@@ -63,40 +70,50 @@ bool cudaDecode::initCudaResources(int gpuID)
 {
 
 
-    CUdevice cuda_device;
+	// Failures end this stream's init() only: batch runs and the daemon
+	// keep their other streams going
 	CUdevice Device = 0;
-	cuda_device = findCudaDeviceDRV(gpuID);
-	checkCudaErrors(cuDeviceGet(&Device, cuda_device));
+	CUresult result = cuDeviceGet(&Device, gpuID);
+	if (result != CUDA_SUCCESS)
+	{
+		printf("cuDeviceGet(%d): %d\n", gpuID, result);
+		return false;
+	}
     // get compute capabilities and the devicename
-    int major, minor;
-    size_t totalGlobalMem;
+    int major = 0, minor = 0;
+    size_t totalGlobalMem = 0;
 
-    char deviceName[256];
-	checkCudaErrors(cuDeviceComputeCapability(&major, &minor, Device));
-	checkCudaErrors(cuDeviceGetName(deviceName, 256, Device));
+    char deviceName[256] = "";
+	cuDeviceComputeCapability(&major, &minor, Device);
+	cuDeviceGetName(deviceName, 256, Device);
     printf("> Using GPU Device: %s has SM %d.%d compute capability\n", deviceName, major, minor);
 
-	checkCudaErrors(cuDeviceTotalMem(&totalGlobalMem, Device));
+	cuDeviceTotalMem(&totalGlobalMem, Device);
     printf("  Total amount of global memory:     %4.4f MB\n", (float)totalGlobalMem/(1024*1024));
 
-	
-	checkCudaErrors(cuCtxCreate(&m_oContext, CU_CTX_BLOCKING_SYNC, Device));
+	result = cuCtxCreate(&m_oContext, CU_CTX_BLOCKING_SYNC, Device);
+	if (result != CUDA_SUCCESS)
+	{
+		printf("cuCtxCreate on GPU %d: %d\n", gpuID, result);
+		m_oContext = NULL;
+		return false;
+	}
     // Now we create the CUDA resources and the CUDA decoder context
-    initCudaVideo();
+    bool bVideoReady = initCudaVideo();
 
 
 
     CUcontext cuCurrent = NULL;
-    CUresult result = cuCtxPopCurrent(&cuCurrent);
+    result = cuCtxPopCurrent(&cuCurrent);
 
     if (result != CUDA_SUCCESS)
     {
         printf("cuCtxPopCurrent: %d\n", result);
-        assert(0);
+        return false;
     }
 
     /////////////////////////////////////////
-    return (m_pVideoDecoder? true : false);
+    return bVideoReady;
 }
 
 
@@ -124,10 +141,149 @@ void cudaDecode::parseCommandLineArguments(char* filename, int gpuID)
 	printf(" input file: <%s>\n",  m_sFileName.c_str());
 }
 
-void cudaDecode::init(char *filename, int gpuID)
+bool cudaDecode::init(char *filename, int gpuID)
 {
 	parseCommandLineArguments(filename, gpuID);
 	loadVideoSource(m_sFileName.c_str(), m_nVideoWidth, m_nVideoHeight);
+	if (!startDecode(gpuID))
+	{
+		// nothing will be decoded, let check_decode_end() report it
+		m_pFrameQueue->endDecode();
+		return false;
+	}
+	return true;
+}
+
+bool cudaDecode::init(char *filename, StreamPlacer &placer)
+{
+	parseCommandLineArguments(filename, -1);
+	loadVideoSource(m_sFileName.c_str(), m_nVideoWidth, m_nVideoHeight);
+
+	CUVIDEOFORMAT format = m_pVideoSource->format();
+	StreamDemand demand;
+	demand.nWidth = m_nVideoWidth;
+	demand.nHeight = m_nVideoHeight;
+	// Sources that don't report a frame rate are charged as 25fps
+	demand.dFrameRate = format.frame_rate.denominator ?
+		(double)format.frame_rate.numerator / format.frame_rate.denominator : 25.0;
+
+	int gpuID = -1;
+	m_nPlacementID = placer.placeStream(demand, gpuID);
+	if (m_nPlacementID < 0)
+	{
+		m_pFrameQueue->endDecode();
+		return false;
+	}
+	m_pStreamPlacer = &placer;
+	m_DeviceID = gpuID;
+	printf(" placed on GPU %d (load %.2f)\n", gpuID, placer.deviceLoad(gpuID));
+
+	if (!startDecode(gpuID))
+	{
+		m_pFrameQueue->endDecode();
+		placer.removeStream(m_nPlacementID);
+		m_pStreamPlacer = 0;
+		m_nPlacementID = -1;
+		return false;
+	}
+	return true;
+}
+
+bool cudaDecode::migrate()
+{
+	if (!m_pStreamPlacer)
+	{
+		return false;
+	}
+	int gpuID = m_pStreamPlacer->deviceOf(m_nPlacementID);
+	if (gpuID < 0)
+	{
+		return false;
+	}
+	if (gpuID == m_DeviceID)
+	{
+		return true;
+	}
+	printf(" moving <%s> from GPU %d to GPU %d\n", m_sFileName.c_str(), m_DeviceID, gpuID);
+
+	long long resumeAfter = m_pVideoParser ? m_pVideoParser->lastOutputTimestamp() : -1;
+	m_pVideoSource->stop();
+	cleanup(true);
+	if (m_pCapacityPlanner)
+	{
+		m_pCapacityPlanner->release(m_nStreamID);
+	}
+
+	m_DeviceID = gpuID;
+	loadVideoSource(m_sFileName.c_str(), m_nVideoWidth, m_nVideoHeight);
+	// Parked from the start, so nothing before the resume point is output
+	bool seekable = resumeAfter >= 0 && m_pVideoSource->pause();
+	if (!startDecode(gpuID))
+	{
+		// The placement stays until uninit()
+		m_pFrameQueue->endDecode();
+		return false;
+	}
+	if (seekable)
+	{
+		pause();
+		setSkipBefore(resumeAfter + 1);
+		seek(resumeAfter + 1);
+		resume();
+	}
+	return true;
+}
+
+unsigned int cudaDecode::rebalance(StreamPlacer &placer, const std::vector<cudaDecode *> &decoders)
+{
+	std::vector<StreamMove> moves = placer.rebalance();
+	unsigned int moved = 0;
+
+	for (size_t i = 0; i < moves.size(); i++)
+	{
+		for (size_t j = 0; j < decoders.size(); j++)
+		{
+			if (decoders[j]->m_pStreamPlacer == &placer && decoders[j]->m_nPlacementID == moves[i].nStreamID)
+			{
+				if (decoders[j]->migrate())
+				{
+					moved++;
+				}
+				break;
+			}
+		}
+	}
+	return moved;
+}
+
+void cudaDecode::setCapacityPlanner(DecoderCapacityPlanner *planner)
+{
+	m_pCapacityPlanner = planner;
+}
+
+bool cudaDecode::startDecode(int gpuID)
+{
+	if (!m_pVideoSource->isValid())
+	{
+		printf(" unable to open video source <%s>\n", m_sFileName.c_str());
+		return false;
+	}
+
+	static std::atomic<int> nextStreamID(0);
+	m_nStreamID = nextStreamID++;
+
+	if (m_pCapacityPlanner)
+	{
+		AdmissionDecision decision = m_pCapacityPlanner->admit(m_nStreamID, m_pVideoSource->format());
+		if (decision != Admission_GPU)
+		{
+			// No CPU decode backend is wired in here, the caller sees a failed init
+			// and can hand the stream to one
+			printf(" stream refused by decoder capacity planner (%s)\n",
+				decision == Admission_CPU ? "redirect to CPU" : "refused");
+			return false;
+		}
+	}
 
 	// Determine the proper window size needed to create the correct *client* area
 	// that is of the size requested by m_dimensions.
@@ -146,10 +302,19 @@ void cudaDecode::init(char *filename, int gpuID)
 	// Other video memory resources will be available
 	int bTCC = 0;
 
-	initCudaResources(gpuID);
+	if (!initCudaResources(gpuID))
+	{
+		// Callers may drop a failed init() without uninit()
+		if (m_pCapacityPlanner)
+		{
+			m_pCapacityPlanner->release(m_nStreamID);
+		}
+		return false;
+	}
 
 
 	m_pVideoSource->start();
+	return true;
 }
 
 int main(int argc, char *argv[])
@@ -159,33 +324,140 @@ int main(int argc, char *argv[])
     setenv ("DISPLAY", ":0", 0);
 #endif
 
-	cudaDecode cudadecode_;
+#ifdef TEST_TIME
+	if (argc > 2 && strcmp(argv[1], "--bench-ts") == 0)
+	{
+		return benchmarkTsDemux(argv[2]);
+	}
+	if (argc > 2 && strcmp(argv[1], "--bench-nal") == 0)
+	{
+		EsFileParams oEsParams;
+		if (!EsFileReader::parseUrl(argv[2], oEsParams))
+		{
+			printf("--bench-nal needs an .h264/.h265 file or an es:// url\n");
+			return 1;
+		}
+		return benchmarkNalScan(oEsParams.sFileName.c_str(), oEsParams.eCodec);
+	}
+	if (argc > 2 && strcmp(argv[1], "--bench-analyze") == 0)
+	{
+		EsFileParams oEsParams;
+		if (!EsFileReader::parseUrl(argv[2], oEsParams))
+		{
+			printf("--bench-analyze needs an .h264/.h265 file or an es:// url\n");
+			return 1;
+		}
+		return benchmarkAnalyzer(oEsParams.sFileName.c_str(), oEsParams.eCodec);
+	}
+	if (argc > 1 && strcmp(argv[1], "--sim-scheduler") == 0)
+	{
+		return benchmarkScheduler(argc > 2 ? atoi(argv[2]) : 4);
+	}
+	if (argc > 1 && strcmp(argv[1], "--sim-placement") == 0)
+	{
+		return simulatePlacement();
+	}
+#endif
 
+	// [--pipelines N] [--gpu N] [--segment SECONDS] [--journal FILE] [--list FILE] [file|glob ...]
+	// or --daemon SOCKET [--gpu N] to serve other processes, see DecodeDaemon
+	unsigned int pipelines = 4;
 	int GPUID = 0;
-	char filename[] = "/home/al/video/short.mp4";
-    // parse the command line arguments
-	cudadecode_.init(filename, GPUID);
+	double segmentSeconds = 600;
+	const char *journal = 0;
+	const char *daemonSocket = 0;
+	std::vector<const char *> lists, inputs;
+
+	for (int i = 1; i < argc; i++)
+	{
+		if (strcmp(argv[i], "--pipelines") == 0 && i + 1 < argc)
+			pipelines = (unsigned int)atoi(argv[++i]);
+		else if (strcmp(argv[i], "--gpu") == 0 && i + 1 < argc)
+			GPUID = atoi(argv[++i]);
+		else if (strcmp(argv[i], "--segment") == 0 && i + 1 < argc)
+			segmentSeconds = atof(argv[++i]);
+		else if (strcmp(argv[i], "--journal") == 0 && i + 1 < argc)
+			journal = argv[++i];
+		else if (strcmp(argv[i], "--list") == 0 && i + 1 < argc)
+			lists.push_back(argv[++i]);
+		else if (strcmp(argv[i], "--daemon") == 0 && i + 1 < argc)
+			daemonSocket = argv[++i];
+		else
+			inputs.push_back(argv[i]);
+	}
+
+	if (daemonSocket)
+	{
+		DecodeDaemon daemon(daemonSocket, GPUID);
+		return daemon.run() ? 0 : 1;
+	}
 
-	while (true)
+	BatchRunner runner(pipelines, GPUID, segmentSeconds);
+	if (journal && !runner.setJournal(journal))
+	{
+		return 1;
+	}
+	for (size_t i = 0; i < lists.size(); i++)
 	{
-		if (cudadecode_.check_decode_end())
+		if (!runner.addList(lists[i]))
 		{
-			break;
+			return 1;
 		}
 	}
-	cudadecode_.uninit();
-
+	for (size_t i = 0; i < inputs.size(); i++)
+	{
+		if (strpbrk(inputs[i], "*?["))
+			runner.addGlob(inputs[i]);
+		else
+			runner.addFile(inputs[i]);
+	}
+	if (inputs.empty() && lists.empty())
+	{
+		printf("usage: %s [--pipelines N] [--gpu N] [--segment SECONDS] [--journal FILE] [--list FILE] [file|glob ...]\n"
+			"       %s --daemon SOCKET [--gpu N]\n", argv[0], argv[0]);
+		return 1;
+	}
 
-   
-    return 0;
+	return runner.run() ? 0 : 1;
 }
 
 void cudaDecode::uninit()
 {
 	m_pFrameQueue->endDecode();
 	m_pVideoSource->stop();
+	printf(" errors: create %lu decode %lu map %lu unmap %lu parse %lu demux %lu\n",
+		m_oStats.nCreateErrors.load(), m_oStats.nDecodeErrors.load(), m_oStats.nMapErrors.load(),
+		m_oStats.nUnmapErrors.load(), m_oStats.nParseErrors.load(), m_oStats.nDemuxErrors.load());
+	printf(" recoveries %lu, decoder resets %lu, format changes %lu, packets dropped %lu, skipped %lu\n",
+		m_oStats.nRecoveries.load(), m_oStats.nDecoderResets.load(), m_oStats.nFormatChanges.load(),
+		m_oStats.nPacketsDropped.load(), m_oStats.nPacketsSkipped.load());
+	printf(" loss events %lu, corrupt frames %lu\n",
+		m_oStats.nLossEvents.load(), m_oStats.nCorruptFrames.load());
+	if (m_dTargetFrameRate > 0)
+	{
+		printf(" decimation: %lu frames not output, %lu of them not decoded\n",
+			m_oStats.nFramesDecimated.load(), m_oStats.nDecodesSkipped.load());
+	}
+	if (m_oStats.nLatencySamples)
+	{
+		printf(" latency packet->frame: avg %.2f ms, max %.2f ms over %lu frames\n",
+			m_oStats.llLatencySumUs / 1000.0 / m_oStats.nLatencySamples, m_oStats.llLatencyMaxUs / 1000.0,
+			m_oStats.nLatencySamples.load());
+	}
 	// clean up CUDA and OpenGL resources
 	cleanup(true);
+
+	if (m_pStreamPlacer)
+	{
+		m_pStreamPlacer->removeStream(m_nPlacementID);
+		m_pStreamPlacer = 0;
+		m_nPlacementID = -1;
+	}
+
+	if (m_pCapacityPlanner)
+	{
+		m_pCapacityPlanner->release(m_nStreamID);
+	}
 }
 
 
@@ -195,7 +467,7 @@ cudaDecode::loadVideoSource(const char *video_file,
                 unsigned int &width    , unsigned int &height)
 {
     std::auto_ptr<FrameQueue> apFrameQueue(new FrameQueue);
-    std::auto_ptr<VideoSource> apVideoSource(new VideoSource(video_file, apFrameQueue.get()));
+    std::auto_ptr<VideoSource> apVideoSource(new VideoSource(video_file, apFrameQueue.get(), m_eProfile));
 
     // retrieve the video source (width,height)
     apVideoSource->getSourceDimensions(width, height);
@@ -205,6 +477,12 @@ cudaDecode::loadVideoSource(const char *video_file,
     m_pFrameQueue  = apFrameQueue.release();
     m_pVideoSource = apVideoSource.release();
 
+    if (m_bKeyFrameOnly)
+    {
+        m_pVideoSource->setKeyFrameOnly(true, (long long)(m_dKeyFrameStride * 1e6));
+    }
+    m_pVideoSource->setHoldAtEnd(m_bHoldAtEnd);
+
     if (m_pVideoSource->format().codec == cudaVideoCodec_JPEG ||
         m_pVideoSource->format().codec == cudaVideoCodec_MPEG2)
     {
@@ -216,7 +494,7 @@ cudaDecode::loadVideoSource(const char *video_file,
     return IsProgressive;
 }
 
-void
+bool
 cudaDecode::initCudaVideo()
 {
     // bind the context lock to the CUDA context
@@ -225,7 +503,9 @@ cudaDecode::initCudaVideo()
     if (result != CUDA_SUCCESS)
     {
         printf("cuvidCtxLockCreate failed: %d\n", result);
-        assert(0);
+        m_CtxLock = NULL;
+        m_oStats.nCreateErrors++;
+        return false;
     }
 
     size_t totalGlobalMem;
@@ -234,68 +514,113 @@ cudaDecode::initCudaVideo()
     cuMemGetInfo(&freeMem,&totalGlobalMem);
     printf("  Free memory:     %4.4f MB\n", (float)freeMem/(1024*1024));
 
-    std::auto_ptr<VideoDecoder> apVideoDecoder(new VideoDecoder(m_pVideoSource->format(), m_oContext, m_eVideoCreateFlags, m_CtxLock));
-    std::auto_ptr<VideoParser> apVideoParser(new VideoParser(apVideoDecoder.get(), m_pFrameQueue, &m_oContext));
+    std::auto_ptr<VideoDecoder> apVideoDecoder(new VideoDecoder(m_pVideoSource->format(), m_oContext, m_eVideoCreateFlags, m_CtxLock,
+		m_nOutputWidth, m_nOutputHeight));
+
+    if (apVideoDecoder->status() != CUDA_SUCCESS)
+    {
+        m_oStats.nCreateErrors++;
+        return false;
+    }
+
+    // Keyframes are decoded in isolation, there is nothing to reorder
+    unsigned int nDisplayDelay = (m_eProfile == StreamProfile_LowLatency || m_bKeyFrameOnly) ? 0 : 1;
+    std::auto_ptr<VideoParser> apVideoParser(new VideoParser(apVideoDecoder.get(), m_pFrameQueue, &m_oContext, &m_oStats,
+                                                             nDisplayDelay));
+
+    if (apVideoParser->status() != CUDA_SUCCESS)
+    {
+        return false;
+    }
+
+    apVideoParser->setFrameSink(m_pFrameSink);
+
+    if (m_dTargetFrameRate > 0)
+    {
+        apVideoParser->setTargetFrameRate(m_dTargetFrameRate, frameRate());
+    }
     m_pVideoSource->setParser(*apVideoParser.get());
 
     m_pVideoParser  = apVideoParser.release();
     m_pVideoDecoder = apVideoDecoder.release();
 
+    return true;
 }
 
 
-void
+bool
 cudaDecode::freeCudaResources(bool bDestroyContext)
 {
+    bool bResult = true;
+
+    // Cleared, so migrate() can create them again
     if (m_pVideoParser)
     {
         delete m_pVideoParser;
+        m_pVideoParser = 0;
     }
 
     if (m_pVideoDecoder)
     {
         delete m_pVideoDecoder;
+        m_pVideoDecoder = 0;
     }
 
     if (m_pVideoSource)
     {
         delete m_pVideoSource;
+        m_pVideoSource = 0;
     }
 
     if (m_pFrameQueue)
     {
         delete m_pFrameQueue;
+        m_pFrameQueue = 0;
     }
 
 
     if (m_CtxLock)
     {
-        checkCudaErrors(cuvidCtxLockDestroy(m_CtxLock));
+        CUresult result = cuvidCtxLockDestroy(m_CtxLock);
+        if (result != CUDA_SUCCESS)
+        {
+            printf("cuvidCtxLockDestroy: %d\n", result);
+            bResult = false;
+        }
+        m_CtxLock = NULL;
     }
 
     if (m_oContext && bDestroyContext)
     {
-        checkCudaErrors(cuCtxDestroy(m_oContext));
+        CUresult result = cuCtxDestroy(m_oContext);
+        if (result != CUDA_SUCCESS)
+        {
+            printf("cuCtxDestroy: %d\n", result);
+            bResult = false;
+        }
         m_oContext = NULL;
     }
+
+    return bResult;
 }
 
 
 // Release all previously initialized objects
 bool cudaDecode::cleanup(bool bDestroyContext)
 {
-    if (bDestroyContext)
+    // No context when init() failed before creating one
+    if (bDestroyContext && m_oContext)
     {
         // Attach the CUDA Context (so we may properly free memory)
-        checkCudaErrors(cuCtxPushCurrent(m_oContext));
-        // Detach from the Current thread
-        checkCudaErrors(cuCtxPopCurrent(NULL));
+        if (cuCtxPushCurrent(m_oContext) == CUDA_SUCCESS)
+        {
+            // Detach from the Current thread
+            cuCtxPopCurrent(NULL);
+        }
     }
 
 
-    freeCudaResources(bDestroyContext);
-
-    return true;
+    return freeCudaResources(bDestroyContext);
 }
 
 // Launches the CUDA kernels to fill in the texture data
@@ -305,3 +630,126 @@ bool cudaDecode::check_decode_end()
 	return m_pFrameQueue->isDecodeFinished();
 }
 
+const DecodeStats &cudaDecode::stats() const
+{
+	return m_oStats;
+}
+
+void cudaDecode::setFrameSink(FrameSink *sink)
+{
+	m_pFrameSink = sink;
+}
+
+void cudaDecode::setStreamProfile(StreamProfile profile)
+{
+	m_eProfile = profile;
+}
+
+void cudaDecode::setTargetFrameRate(double fps)
+{
+	m_dTargetFrameRate = fps;
+	if (m_pVideoParser)
+	{
+		m_pVideoParser->setTargetFrameRate(fps, frameRate());
+	}
+}
+
+void cudaDecode::setKeyFrameOnly(bool enable, double strideSeconds)
+{
+	m_bKeyFrameOnly = enable;
+	m_dKeyFrameStride = strideSeconds;
+	if (m_pVideoSource)
+	{
+		m_pVideoSource->setKeyFrameOnly(enable, (long long)(strideSeconds * 1e6));
+	}
+	// The display delay takes effect when the next seek recreates the parser
+	if (m_pVideoParser)
+	{
+		m_pVideoParser->setMaxDisplayDelay((m_eProfile == StreamProfile_LowLatency || enable) ? 0 : 1);
+	}
+}
+
+void cudaDecode::setHoldAtEnd(bool hold)
+{
+	m_bHoldAtEnd = hold;
+}
+
+bool cudaDecode::pause()
+{
+	return m_pVideoSource && m_pVideoSource->pause();
+}
+
+void cudaDecode::resume()
+{
+	if (m_pVideoSource)
+	{
+		m_pVideoSource->resume();
+	}
+}
+
+bool cudaDecode::seek(long long timestamp)
+{
+	return m_pVideoSource && m_pVideoSource->seek(timestamp);
+}
+
+bool cudaDecode::atEnd()
+{
+	return m_pVideoSource && m_pVideoSource->atEnd();
+}
+
+void cudaDecode::setSkipBefore(long long timestamp)
+{
+	if (m_pVideoParser)
+	{
+		m_pVideoParser->setSkipBefore(timestamp);
+	}
+}
+
+long long cudaDecode::startTimestamp()
+{
+	return m_pVideoSource ? m_pVideoSource->startTimestamp() : 0;
+}
+
+long long cudaDecode::creationTime()
+{
+	return m_pVideoSource ? m_pVideoSource->creationTime() : -1;
+}
+
+long long cudaDecode::duration()
+{
+	return m_pVideoSource ? m_pVideoSource->duration() : -1;
+}
+
+void cudaDecode::setOutputSize(unsigned int width, unsigned int height)
+{
+	m_nOutputWidth = width;
+	m_nOutputHeight = height;
+}
+
+int cudaDecode::get_frame_w()
+{
+	// Same rounding as the decoder's target size
+	return m_nOutputWidth ? (int)((m_nOutputWidth + 1) & ~1u) : (int)m_nVideoWidth;
+}
+
+int cudaDecode::get_frame_h()
+{
+	return m_nOutputHeight ? (int)((m_nOutputHeight + 1) & ~1u) : (int)m_nVideoHeight;
+}
+
+unsigned int cudaDecode::bitDepth()
+{
+	return m_pVideoSource ? m_pVideoSource->format().bit_depth_luma_minus8 + 8 : 8;
+}
+
+double cudaDecode::frameRate()
+{
+	if (!m_pVideoSource)
+	{
+		return 0;
+	}
+	CUVIDEOFORMAT format = m_pVideoSource->format();
+	return format.frame_rate.denominator ?
+		(double)format.frame_rate.numerator / format.frame_rate.denominator : 0;
+}
+
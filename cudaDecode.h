@@ -19,33 +19,94 @@
 #include <memory>
 #include <iostream>
 #include <cassert>
+#include <atomic>
+#include <vector>
 
 // cudaDecodeGL related helper functions
 #include "FrameQueue.h"
 #include "VideoSource.h"
 #include "VideoParser.h"
 #include "VideoDecoder.h"
+#include "DevicePlacement.h"
+#include "DecoderCapacity.h"
+#include "FrameSink.h"
 
 class cudaDecode
 {
 
 public:
-	void init(char *filename, int gpuID);
+	// Returns false if the stream couldn't be opened or decoding didn't start;
+	// check_decode_end() then reports the end right away.
+	bool init(char *filename, int gpuID);
+	// Let the placer choose the GPU from the stream's size and frame rate.
+	// Returns false if no device has room for the stream.
+	bool init(char *filename, StreamPlacer &placer);
+	// Recreates the decoder on the GPU the placer now has the stream on, e.g.
+	// after StreamPlacer::rebalance(). File sources continue after the last
+	// frame output, live sources with the next packet. No other thread may
+	// use this object meanwhile. Returns false if the stream couldn't be
+	// restarted; check_decode_end() then reports the end.
+	bool migrate();
+	// Runs placer.rebalance() and migrates the moved streams among decoders,
+	// all initialized with placer. Returns the number of streams moved.
+	static unsigned int rebalance(StreamPlacer &placer, const std::vector<cudaDecode *> &decoders);
+	// Ask the planner for admission before a decoder is created.
+	// Must be set before init(); the planner must outlive this object.
+	void setCapacityPlanner(DecoderCapacityPlanner *planner);
 	int get_frame_w();
 	int get_frame_h();
 	int get_frame_s();
 	void* get_frame_data();
 	bool check_decode_end();
+	// Failure and recovery counters of the stream.
+	const DecodeStats &stats() const;
+	// Hand every decoded frame to sink. Must be set before init().
+	void setFrameSink(FrameSink *sink);
+	// Demux and display-delay settings of the stream. Must be set before init().
+	void setStreamProfile(StreamProfile profile);
+	// Decode keyframes only, at most one per strideSeconds of media time
+	// (0 keeps all keyframes). Set before init() or while paused.
+	void setKeyFrameOnly(bool enable, double strideSeconds = 0);
+	// Output at most fps frames per second, evenly spaced (0 outputs all).
+	// Frames left out are not decoded when nothing references them and
+	// never mapped or read back. Set before init() or while paused.
+	void setTargetFrameRate(double fps);
+	// Playback control of file sources, see VideoSource::pause()/seek().
+	// With hold set (before init()) the source waits at the end of the
+	// stream for another seek instead of finishing.
+	void setHoldAtEnd(bool hold);
+	bool pause();
+	void resume();
+	bool seek(long long timestamp);
+	bool atEnd();
+	// Nominal frame rate of the source, 0 if unknown.
+	double frameRate();
+	// Leave out frames timestamped before timestamp (-1 for none), decoding
+	// them only where later frames reference them. Set while paused, e.g.
+	// before seek(timestamp).
+	void setSkipBefore(long long timestamp);
+	// Timestamp of the first frame, and the wall-clock time the recording
+	// started (us since the Unix epoch, -1 if unknown); see VideoSource.
+	long long startTimestamp();
+	long long creationTime();
+	// Length of the stream in timestamp units, -1 if unknown.
+	long long duration();
+	// Scale the decoded frames to width x height (0 x 0 keeps the coded
+	// size). Must be set before init().
+	void setOutputSize(unsigned int width, unsigned int height);
+	// Bit depth of the stream's luma samples, valid after init().
+	unsigned int bitDepth();
 	void uninit();
 
 private:
 	bool loadVideoSource(const char *video_file,
 		unsigned int &width, unsigned int &height);
-	void initCudaVideo();
-	void freeCudaResources(bool bDestroyContext);
+	bool initCudaVideo();
+	bool freeCudaResources(bool bDestroyContext);
 	bool cleanup(bool bDestroyContext);
 	bool initCudaResources(int gpuID);
 	void parseCommandLineArguments(char* filename, int gpuID);
+	bool startDecode(int gpuID);
 
 	int                 m_DeviceID = 0;
 
@@ -62,6 +123,22 @@ private:
 	unsigned int m_nVideoHeight = 0;
 
 	unsigned int m_FrameCount = 0;
+
+	StreamPlacer *m_pStreamPlacer = 0;
+	int           m_nPlacementID = -1;
+
+	DecodeStats   m_oStats;
+	FrameSink    *m_pFrameSink = 0;
+	StreamProfile m_eProfile = StreamProfile_Default;
+	bool          m_bKeyFrameOnly = false;
+	double        m_dKeyFrameStride = 0;
+	double        m_dTargetFrameRate = 0;
+	bool          m_bHoldAtEnd = false;
+	unsigned int  m_nOutputWidth = 0;
+	unsigned int  m_nOutputHeight = 0;
+
+	DecoderCapacityPlanner *m_pCapacityPlanner = 0;
+	int                     m_nStreamID = -1;
 };
 
 
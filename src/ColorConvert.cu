@@ -0,0 +1,208 @@
+/*
+* File		: ColorConvert.cu
+* Time : 2026 - 10 - 19
+*/
+
+#include "ColorConvert.h"
+
+#include "cuda_runtime.h"
+
+// Every thread handles a pair of horizontally adjacent samples, which
+// keeps the loads 32-bit wide for P016 and 16-bit wide for NV12.
+__global__ void
+p016ToNV12Kernel(const unsigned char *pSrc, unsigned int nSrcPitch,
+                 unsigned char *pDst, unsigned int nDstPitch,
+                 unsigned int nPairs, unsigned int nRows)
+{
+    unsigned int x = blockIdx.x * blockDim.x + threadIdx.x;
+    unsigned int y = blockIdx.y * blockDim.y + threadIdx.y;
+
+    if (x >= nPairs || y >= nRows)
+        return;
+
+    ushort2 s = ((const ushort2 *)(pSrc + y * nSrcPitch))[x];
+    ((uchar2 *)(pDst + y * nDstPitch))[x] = make_uchar2(s.x >> 8, s.y >> 8);
+}
+
+template<typename T>
+__device__ __forceinline__ float
+normalizeSample(T v);
+
+template<>
+__device__ __forceinline__ float
+normalizeSample<unsigned char>(unsigned char v)
+{
+    return (float)v;
+}
+
+template<>
+__device__ __forceinline__ float
+normalizeSample<unsigned short>(unsigned short v)
+{
+    // MSB aligned: keep the fractional bits, scaled to the 8-bit range
+    return (float)v * (1.0f / 256.0f);
+}
+
+__device__ __forceinline__ unsigned char
+clampToByte(float v)
+{
+    return (unsigned char)fminf(fmaxf(v + 0.5f, 0.0f), 255.0f);
+}
+
+// One thread per 2x2 luma block, sharing the block's chroma pair.
+template<typename T>
+__global__ void
+yuvToBgrKernel(const unsigned char *pSrc, unsigned int nSrcPitch,
+               unsigned char *pDst, unsigned int nDstPitch,
+               unsigned int nWidth, unsigned int nHeight)
+{
+    unsigned int x = (blockIdx.x * blockDim.x + threadIdx.x) * 2;
+    unsigned int y = (blockIdx.y * blockDim.y + threadIdx.y) * 2;
+
+    if (x >= nWidth || y >= nHeight)
+        return;
+
+    const T *pUV = (const T *)(pSrc + (nHeight + y / 2) * nSrcPitch) + x;
+    float u = normalizeSample<T>(pUV[0]) - 128.0f;
+    float v = normalizeSample<T>(pUV[1]) - 128.0f;
+
+    float r = 1.596f * v;
+    float g = -0.392f * u - 0.813f * v;
+    float b = 2.017f * u;
+
+    for (unsigned int dy = 0; dy < 2 && y + dy < nHeight; dy++)
+    {
+        const T *pY = (const T *)(pSrc + (y + dy) * nSrcPitch);
+        unsigned char *pOut = pDst + (y + dy) * nDstPitch;
+
+        for (unsigned int dx = 0; dx < 2 && x + dx < nWidth; dx++)
+        {
+            float l = 1.164f * (normalizeSample<T>(pY[x + dx]) - 16.0f);
+            pOut[(x + dx) * 3 + 0] = clampToByte(l + b);
+            pOut[(x + dx) * 3 + 1] = clampToByte(l + g);
+            pOut[(x + dx) * 3 + 2] = clampToByte(l + r);
+        }
+    }
+}
+
+// One thread per output pixel: luma is sampled bilinearly, chroma from
+// the nearest sample pair.
+template<typename T>
+__global__ void
+yuvToPlanarRgbKernel(const unsigned char *pSrc, unsigned int nSrcPitch,
+                     unsigned int nSrcWidth, unsigned int nSrcHeight,
+                     float *pDst, unsigned int nDstWidth, unsigned int nDstHeight,
+                     float3 scale, float3 offset)
+{
+    unsigned int x = blockIdx.x * blockDim.x + threadIdx.x;
+    unsigned int y = blockIdx.y * blockDim.y + threadIdx.y;
+
+    if (x >= nDstWidth || y >= nDstHeight)
+        return;
+
+    float fx = fmaxf((x + 0.5f) * nSrcWidth / nDstWidth - 0.5f, 0.0f);
+    float fy = fmaxf((y + 0.5f) * nSrcHeight / nDstHeight - 0.5f, 0.0f);
+    unsigned int x0 = min((unsigned int)fx, nSrcWidth - 1);
+    unsigned int y0 = min((unsigned int)fy, nSrcHeight - 1);
+    unsigned int x1 = min(x0 + 1, nSrcWidth - 1);
+    unsigned int y1 = min(y0 + 1, nSrcHeight - 1);
+    float ax = fx - x0;
+    float ay = fy - y0;
+
+    const T *pRow0 = (const T *)(pSrc + y0 * nSrcPitch);
+    const T *pRow1 = (const T *)(pSrc + y1 * nSrcPitch);
+    float l0 = normalizeSample<T>(pRow0[x0]) + ax * (normalizeSample<T>(pRow0[x1]) - normalizeSample<T>(pRow0[x0]));
+    float l1 = normalizeSample<T>(pRow1[x0]) + ax * (normalizeSample<T>(pRow1[x1]) - normalizeSample<T>(pRow1[x0]));
+    float l = 1.164f * (l0 + ay * (l1 - l0) - 16.0f);
+
+    unsigned int cx = min((unsigned int)(fx + 0.5f), nSrcWidth - 1) & ~1u;
+    unsigned int cy = min((unsigned int)(fy + 0.5f), nSrcHeight - 1) / 2;
+    const T *pUV = (const T *)(pSrc + (nSrcHeight + cy) * nSrcPitch) + cx;
+    float u = normalizeSample<T>(pUV[0]) - 128.0f;
+    float v = normalizeSample<T>(pUV[1]) - 128.0f;
+
+    float r = fminf(fmaxf(l + 1.596f * v, 0.0f), 255.0f);
+    float g = fminf(fmaxf(l - 0.392f * u - 0.813f * v, 0.0f), 255.0f);
+    float b = fminf(fmaxf(l + 2.017f * u, 0.0f), 255.0f);
+
+    size_t nPlane = (size_t)nDstWidth * nDstHeight;
+    size_t i = (size_t)y * nDstWidth + x;
+    pDst[i]              = r * scale.x + offset.x;
+    pDst[nPlane + i]     = g * scale.y + offset.y;
+    pDst[2 * nPlane + i] = b * scale.z + offset.z;
+}
+
+static CUresult
+launchResult()
+{
+    return cudaGetLastError() == cudaSuccess ? CUDA_SUCCESS : CUDA_ERROR_LAUNCH_FAILED;
+}
+
+CUresult
+convertP016ToNV12(CUdeviceptr dpSrc, unsigned int nSrcPitch,
+                  CUdeviceptr dpDst, unsigned int nDstPitch,
+                  unsigned int nWidth, unsigned int nHeight, CUstream hStream)
+{
+    unsigned int nPairs = (nWidth + 1) / 2;
+    unsigned int nRows  = nHeight + (nHeight + 1) / 2;
+    dim3 block(32, 8);
+    dim3 grid((nPairs + block.x - 1) / block.x, (nRows + block.y - 1) / block.y);
+
+    p016ToNV12Kernel<<<grid, block, 0, (cudaStream_t)hStream>>>((const unsigned char *)dpSrc, nSrcPitch,
+                                                                (unsigned char *)dpDst, nDstPitch,
+                                                                nPairs, nRows);
+    return launchResult();
+}
+
+CUresult
+convertNV12ToBgr(CUdeviceptr dpSrc, unsigned int nSrcPitch,
+                 CUdeviceptr dpDst, unsigned int nDstPitch,
+                 unsigned int nWidth, unsigned int nHeight, CUstream hStream)
+{
+    dim3 block(32, 8);
+    dim3 grid(((nWidth + 1) / 2 + block.x - 1) / block.x, ((nHeight + 1) / 2 + block.y - 1) / block.y);
+
+    yuvToBgrKernel<unsigned char><<<grid, block, 0, (cudaStream_t)hStream>>>((const unsigned char *)dpSrc, nSrcPitch,
+                                                                             (unsigned char *)dpDst, nDstPitch,
+                                                                             nWidth, nHeight);
+    return launchResult();
+}
+
+CUresult
+convertP016ToBgr(CUdeviceptr dpSrc, unsigned int nSrcPitch,
+                 CUdeviceptr dpDst, unsigned int nDstPitch,
+                 unsigned int nWidth, unsigned int nHeight, CUstream hStream)
+{
+    dim3 block(32, 8);
+    dim3 grid(((nWidth + 1) / 2 + block.x - 1) / block.x, ((nHeight + 1) / 2 + block.y - 1) / block.y);
+
+    yuvToBgrKernel<unsigned short><<<grid, block, 0, (cudaStream_t)hStream>>>((const unsigned char *)dpSrc, nSrcPitch,
+                                                                              (unsigned char *)dpDst, nDstPitch,
+                                                                              nWidth, nHeight);
+    return launchResult();
+}
+
+CUresult
+convertYuvToPlanarRgb(CUdeviceptr dpSrc, unsigned int nSrcPitch,
+                      unsigned int nSrcWidth, unsigned int nSrcHeight, bool bP016,
+                      CUdeviceptr dpDst, unsigned int nDstWidth, unsigned int nDstHeight,
+                      const float afMean[3], const float afStd[3], CUstream hStream)
+{
+    // (v / 255 - mean) / std as one multiply-add per sample
+    float3 scale  = make_float3(1.0f / (255.0f * afStd[0]), 1.0f / (255.0f * afStd[1]), 1.0f / (255.0f * afStd[2]));
+    float3 offset = make_float3(-afMean[0] / afStd[0], -afMean[1] / afStd[1], -afMean[2] / afStd[2]);
+    dim3 block(32, 8);
+    dim3 grid((nDstWidth + block.x - 1) / block.x, (nDstHeight + block.y - 1) / block.y);
+
+    if (bP016)
+        yuvToPlanarRgbKernel<unsigned short><<<grid, block, 0, (cudaStream_t)hStream>>>((const unsigned char *)dpSrc, nSrcPitch,
+                                                                                        nSrcWidth, nSrcHeight,
+                                                                                        (float *)dpDst, nDstWidth, nDstHeight,
+                                                                                        scale, offset);
+    else
+        yuvToPlanarRgbKernel<unsigned char><<<grid, block, 0, (cudaStream_t)hStream>>>((const unsigned char *)dpSrc, nSrcPitch,
+                                                                                       nSrcWidth, nSrcHeight,
+                                                                                       (float *)dpDst, nDstWidth, nDstHeight,
+                                                                                       scale, offset);
+    return launchResult();
+}